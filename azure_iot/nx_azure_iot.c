@@ -17,9 +17,6 @@
 #define NX_AZURE_IOT_WAIT_OPTION NX_WAIT_FOREVER
 #endif /* NX_AZURE_IOT_WAIT_OPTION */
 
-/* Define offset of MQTT telemetry packet. */
-#define NX_AZURE_IOT_PUBLISH_PACKET_START_OFFSET   7
-
 /* Convert number to upper hex */
 #define NX_AZURE_IOT_NUMBER_TO_UPPER_HEX(number)    (CHAR)(number + (number < 10 ? '0' : 'A' - 10))
 
@@ -91,10 +88,25 @@ NX_AZURE_IOT *nx_azure_iot_ptr = (NX_AZURE_IOT *)nx_azure_iot;
     }
 }
 
-static UINT nx_azure_iot_publish_packet_header_add(NX_PACKET* packet_ptr, UINT topic_len, UINT qos)
+UINT nx_azure_iot_publish_packet_header_add(NX_PACKET* packet_ptr, UINT topic_len, UINT qos)
+{
+
+    /* Set total length.
+     * 2 bytes for topic length.
+     * 2 bytes for packet id.
+     * data_size for payload.
+     *
+     * packet already contains topic length, packet id (optional) and data payload
+     */
+    return(nx_azure_iot_publish_packet_header_write(packet_ptr, topic_len, qos,
+                                                    (UINT)(packet_ptr -> nx_packet_length + 2)));
+}
+
+UINT nx_azure_iot_publish_packet_header_write(NX_PACKET* packet_ptr, UINT topic_len, UINT qos,
+                                              UINT remaining_length)
 {
 UCHAR *buffer_ptr;
-UINT length;
+UINT length = remaining_length;
 
     /* Check if packet has enough space to write MQTT header */
     if (NX_AZURE_IOT_PUBLISH_PACKET_START_OFFSET >
@@ -117,15 +129,6 @@ UINT length;
     buffer_ptr[5] = (UCHAR)(topic_len >> 8);
     buffer_ptr[6] = (UCHAR)(topic_len & 0xFF);
 
-    /* Set total length.
-     * 2 bytes for topic length.
-     * 2 bytes for packet id.
-     * data_size for payload.
-     *
-     * packet already contains topic length, packet id (optional) and data payload
-     */
-    length = packet_ptr -> nx_packet_length + 2;
-
     /* Total length is encoded in fixed four bytes format. */
     buffer_ptr[1] = (UCHAR)((length & 0x7F) | 0x80);
     length >>= 7;
@@ -142,6 +145,90 @@ UINT length;
     return(NX_AZURE_IOT_SUCCESS);
 }
 
+NX_PACKET *nx_azure_iot_packet_tail_get(NX_PACKET *packet_ptr)
+{
+
+    /* Head packet of a chain keeps track of the last one. */
+    return(packet_ptr -> nx_packet_last ? packet_ptr -> nx_packet_last : packet_ptr);
+}
+
+VOID nx_azure_iot_packet_tail_restore(NX_PACKET *packet_ptr, NX_PACKET *tail_ptr, UCHAR *append_ptr, ULONG length)
+{
+
+    /* Release packets chained after tail, and drop data appended to it. */
+    if (tail_ptr -> nx_packet_next)
+    {
+        nx_packet_release(tail_ptr -> nx_packet_next);
+        tail_ptr -> nx_packet_next = NX_NULL;
+    }
+
+    tail_ptr -> nx_packet_append_ptr = append_ptr;
+    packet_ptr -> nx_packet_last = (tail_ptr == packet_ptr) ? NX_NULL : tail_ptr;
+    packet_ptr -> nx_packet_length = length;
+}
+
+UINT nx_azure_iot_packet_data_gather(NX_PACKET *packet_ptr, const NX_AZURE_IOT_IOVEC *vec,
+                                     UINT count, UINT wait_option)
+{
+UINT status;
+UINT index;
+UINT copy_size;
+UINT data_size;
+UCHAR *data_ptr;
+UCHAR *append_ptr;
+ULONG length;
+NX_PACKET *tail_ptr;
+NX_PACKET *last_ptr;
+NX_PACKET *new_packet_ptr;
+
+    /* Chain state is kept, so that nothing is appended on failure. */
+    tail_ptr = nx_azure_iot_packet_tail_get(packet_ptr);
+    append_ptr = tail_ptr -> nx_packet_append_ptr;
+    length = packet_ptr -> nx_packet_length;
+    last_ptr = tail_ptr;
+
+    for (index = 0; index < count; index++)
+    {
+        data_ptr = vec[index].iovec_base;
+        data_size = vec[index].iovec_length;
+
+        while (data_size)
+        {
+            if (last_ptr -> nx_packet_append_ptr >= last_ptr -> nx_packet_data_end)
+            {
+
+                /* Current packet is full, chain a new one. */
+                status = nx_packet_allocate(packet_ptr -> nx_packet_pool_owner,
+                                            &new_packet_ptr, 0, wait_option);
+                if (status)
+                {
+                    nx_azure_iot_packet_tail_restore(packet_ptr, tail_ptr, append_ptr, length);
+                    return(status);
+                }
+
+                last_ptr -> nx_packet_next = new_packet_ptr;
+                packet_ptr -> nx_packet_last = new_packet_ptr;
+                last_ptr = new_packet_ptr;
+            }
+
+            /* Copy fragment straight into free space of the last packet. */
+            copy_size = (UINT)(last_ptr -> nx_packet_data_end - last_ptr -> nx_packet_append_ptr);
+            if (copy_size > data_size)
+            {
+                copy_size = data_size;
+            }
+
+            memcpy(last_ptr -> nx_packet_append_ptr, data_ptr, copy_size);
+            last_ptr -> nx_packet_append_ptr += copy_size;
+            packet_ptr -> nx_packet_length += copy_size;
+            data_ptr += copy_size;
+            data_size -= copy_size;
+        }
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
 NX_AZURE_IOT_RESOURCE *nx_azure_iot_resource_search(NXD_MQTT_CLIENT *client_ptr)
 {
 NX_AZURE_IOT_RESOURCE *resource_ptr;
@@ -342,7 +429,16 @@ UINT status;
         return(status);
     }
 
-    /* Note, mutex will be released by this function. */
+    return(nx_azure_iot_mqtt_packet_send(client_ptr, packet_ptr, packet_id, qos, wait_option));
+}
+
+UINT nx_azure_iot_mqtt_packet_send(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
+                                   UCHAR *packet_id, UINT qos, UINT wait_option)
+{
+UINT status;
+
+    /* Packet already contains one or more complete PUBLISH frames.
+       Note, mutex will be released by this function. */
     status = _nxd_mqtt_client_publish_packet_send(client_ptr, packet_ptr,
                                                   (USHORT)((packet_id[0] << 8) | packet_id[1]),
                                                   qos, wait_option);
@@ -355,6 +451,80 @@ UINT status;
     return(NX_AZURE_IOT_SUCCESS);
 }
 
+UINT nx_azure_iot_mqtt_packet_stream_send(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
+                                          const UCHAR *data_ptr, UINT data_size, UINT wait_option)
+{
+NX_PACKET *chunk_ptr;
+UINT chunk_size;
+UINT status;
+
+    /* Packet contains fixed header and topic of a QoS 0 PUBLISH, with remaining length that counts data.
+       Unlike nx_azure_iot_mqtt_packet_send(), packet is consumed in all cases, since it may already be
+       passed to TLS when data fails. Data is copied and encrypted one chunk at a time, so it is not
+       referenced once this function returns. Mutex is held so that no other frame is interleaved.  */
+    tx_mutex_get(client_ptr -> nxd_mqtt_client_mutex_ptr, TX_WAIT_FOREVER);
+
+    if (client_ptr -> nxd_mqtt_client_state != NXD_MQTT_CLIENT_STATE_CONNECTED)
+    {
+        tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+        LogError("Mqtt client stream send fail: NOT CONNECTED");
+        nx_packet_release(packet_ptr);
+        return(NXD_MQTT_NOT_CONNECTED);
+    }
+
+    status = nx_secure_tls_session_send(&(client_ptr -> nxd_mqtt_tls_session), packet_ptr, wait_option);
+    if (status)
+    {
+        tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+        LogError("Mqtt client stream send fail: HEADER SEND FAIL: 0x%02x", status);
+        nx_packet_release(packet_ptr);
+        return(status);
+    }
+
+    while (data_size)
+    {
+        chunk_size = (data_size > NX_AZURE_IOT_MQTT_STREAM_CHUNK_SIZE) ?
+                     NX_AZURE_IOT_MQTT_STREAM_CHUNK_SIZE : data_size;
+
+        status = nx_secure_tls_packet_allocate(&(client_ptr -> nxd_mqtt_tls_session),
+                                               client_ptr -> nxd_mqtt_client_packet_pool_ptr,
+                                               &chunk_ptr, wait_option);
+        if (status)
+        {
+            break;
+        }
+
+        status = nx_packet_data_append(chunk_ptr, (VOID *)data_ptr, chunk_size,
+                                       client_ptr -> nxd_mqtt_client_packet_pool_ptr, wait_option);
+        if (status == NX_SUCCESS)
+        {
+            status = nx_secure_tls_session_send(&(client_ptr -> nxd_mqtt_tls_session), chunk_ptr, wait_option);
+        }
+
+        if (status)
+        {
+            nx_packet_release(chunk_ptr);
+            break;
+        }
+
+        data_ptr += chunk_size;
+        data_size -= chunk_size;
+    }
+
+    tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+
+    if (status)
+    {
+
+        /* Frame is incomplete, so the connection cannot be used any more. Owner of client disconnects it,
+           so its own state is cleaned up too.  */
+        LogError("Mqtt client stream send fail: DATA SEND FAIL: 0x%02x", status);
+        return(NX_AZURE_IOT_INCOMPLETE_FRAME);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
 UINT nx_azure_iot_mqtt_packet_id_get(NXD_MQTT_CLIENT *client_ptr, UCHAR *packet_id, UINT wait_option)
 {
 UINT status;
@@ -457,6 +627,345 @@ NX_PACKET *current_packet_ptr;
     }
 }
 
+UINT nx_azure_iot_packet_cursor_init(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, NX_PACKET *packet_ptr)
+{
+    if ((cursor_ptr == NX_NULL) || (packet_ptr == NX_NULL))
+    {
+        LogError("IoT packet cursor init fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    cursor_ptr -> cursor_packet_ptr = packet_ptr;
+    cursor_ptr -> cursor_data_ptr = packet_ptr -> nx_packet_prepend_ptr;
+    cursor_ptr -> cursor_remaining = packet_ptr -> nx_packet_length;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static ULONG nx_azure_iot_packet_cursor_fragment_get(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr)
+{
+NX_PACKET *packet_ptr = cursor_ptr -> cursor_packet_ptr;
+ULONG available;
+
+    if (cursor_ptr -> cursor_remaining == 0)
+    {
+        return(0);
+    }
+
+    /* Skip exhausted or empty packets of the chain.  */
+    while (cursor_ptr -> cursor_data_ptr >= packet_ptr -> nx_packet_append_ptr)
+    {
+        packet_ptr = packet_ptr -> nx_packet_next;
+        if (packet_ptr == NX_NULL)
+        {
+
+            /* Chain holds less than its length.  */
+            cursor_ptr -> cursor_remaining = 0;
+            return(0);
+        }
+
+        cursor_ptr -> cursor_packet_ptr = packet_ptr;
+        cursor_ptr -> cursor_data_ptr = packet_ptr -> nx_packet_prepend_ptr;
+    }
+
+    available = (ULONG)(packet_ptr -> nx_packet_append_ptr - cursor_ptr -> cursor_data_ptr);
+    if (available > cursor_ptr -> cursor_remaining)
+    {
+        available = cursor_ptr -> cursor_remaining;
+    }
+
+    return(available);
+}
+
+UINT nx_azure_iot_packet_cursor_byte_read(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR *byte_ptr)
+{
+    if (nx_azure_iot_packet_cursor_fragment_get(cursor_ptr) == 0)
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    *byte_ptr = *(cursor_ptr -> cursor_data_ptr);
+    cursor_ptr -> cursor_data_ptr++;
+    cursor_ptr -> cursor_remaining--;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_packet_cursor_peek(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR *byte_ptr)
+{
+    if ((cursor_ptr == NX_NULL) || (byte_ptr == NX_NULL))
+    {
+        LogError("IoT packet cursor peek fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (nx_azure_iot_packet_cursor_fragment_get(cursor_ptr) == 0)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    *byte_ptr = *(cursor_ptr -> cursor_data_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_packet_cursor_read(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR *buffer_ptr,
+                                     UINT buffer_size, UINT *bytes_copied_ptr)
+{
+ULONG available;
+UINT copied = 0;
+
+    if ((cursor_ptr == NX_NULL) || (buffer_ptr == NX_NULL) || (bytes_copied_ptr == NX_NULL))
+    {
+        LogError("IoT packet cursor read fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    while (copied < buffer_size)
+    {
+        available = nx_azure_iot_packet_cursor_fragment_get(cursor_ptr);
+        if (available == 0)
+        {
+            break;
+        }
+
+        if (available > (ULONG)(buffer_size - copied))
+        {
+            available = (ULONG)(buffer_size - copied);
+        }
+
+        memcpy(buffer_ptr + copied, cursor_ptr -> cursor_data_ptr, available);
+        cursor_ptr -> cursor_data_ptr += available;
+        cursor_ptr -> cursor_remaining -= available;
+        copied += (UINT)available;
+    }
+
+    *bytes_copied_ptr = copied;
+
+    if ((copied == 0) && buffer_size)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_packet_cursor_skip(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, ULONG length)
+{
+ULONG available;
+
+    if (cursor_ptr == NX_NULL)
+    {
+        LogError("IoT packet cursor skip fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    while (length)
+    {
+        available = nx_azure_iot_packet_cursor_fragment_get(cursor_ptr);
+        if (available == 0)
+        {
+            return(NX_AZURE_IOT_INVALID_PACKET);
+        }
+
+        if (available > length)
+        {
+            available = length;
+        }
+
+        cursor_ptr -> cursor_data_ptr += available;
+        cursor_ptr -> cursor_remaining -= available;
+        length -= available;
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_packet_cursor_byte_find(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR byte, ULONG *offset_ptr)
+{
+NX_AZURE_IOT_PACKET_CURSOR start;
+ULONG available;
+ULONG offset = 0;
+UCHAR *found_ptr;
+
+    if (cursor_ptr == NX_NULL)
+    {
+        LogError("IoT packet cursor byte find fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    start = *cursor_ptr;
+    for (;;)
+    {
+        available = nx_azure_iot_packet_cursor_fragment_get(cursor_ptr);
+        if (available == 0)
+        {
+
+            /* Leave cursor where it was.  */
+            *cursor_ptr = start;
+            return(NX_AZURE_IOT_NOT_FOUND);
+        }
+
+        found_ptr = (UCHAR *)memchr(cursor_ptr -> cursor_data_ptr, byte, available);
+        if (found_ptr)
+        {
+            available = (ULONG)(found_ptr - cursor_ptr -> cursor_data_ptr);
+            cursor_ptr -> cursor_data_ptr = found_ptr;
+            cursor_ptr -> cursor_remaining -= available;
+            offset += available;
+            break;
+        }
+
+        cursor_ptr -> cursor_data_ptr += available;
+        cursor_ptr -> cursor_remaining -= available;
+        offset += available;
+    }
+
+    if (offset_ptr)
+    {
+        *offset_ptr = offset;
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_packet_cursor_span_get(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR **data_pptr,
+                                         UINT *length_ptr)
+{
+ULONG available;
+
+    if ((cursor_ptr == NX_NULL) || (data_pptr == NX_NULL) || (length_ptr == NX_NULL))
+    {
+        LogError("IoT packet cursor span get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    available = nx_azure_iot_packet_cursor_fragment_get(cursor_ptr);
+    if (available == 0)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    *data_pptr = cursor_ptr -> cursor_data_ptr;
+    *length_ptr = (UINT)available;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_mqtt_publish_topic_locate(NX_PACKET *packet_ptr, UINT *topic_offset_ptr,
+                                            UINT *topic_length_ptr)
+{
+NX_AZURE_IOT_PACKET_CURSOR cursor;
+UINT offset;
+UCHAR byte = 0;
+UCHAR length_msb = 0;
+
+    nx_azure_iot_packet_cursor_init(&cursor, packet_ptr);
+
+    /* Skip fixed header byte.  */
+    if (nx_azure_iot_packet_cursor_byte_read(&cursor, &byte))
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    /* Skip remaining length, encoded in at most four bytes.  */
+    for (offset = 1; offset <= 4; offset++)
+    {
+        if (nx_azure_iot_packet_cursor_byte_read(&cursor, &byte))
+        {
+            return(NX_AZURE_IOT_INVALID_PACKET);
+        }
+
+        if ((byte & 0x80) == 0)
+        {
+            break;
+        }
+    }
+
+    if (offset > 4)
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    /* Read topic length.  */
+    if (nx_azure_iot_packet_cursor_byte_read(&cursor, &length_msb) ||
+        nx_azure_iot_packet_cursor_byte_read(&cursor, &byte))
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    *topic_offset_ptr = offset + 3;
+    *topic_length_ptr = ((UINT)length_msb << 8) | byte;
+
+    if ((*topic_offset_ptr + *topic_length_ptr) > packet_ptr -> nx_packet_length)
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_packet_pullup(NX_PACKET *packet_ptr, UINT length)
+{
+UINT size;
+UINT copy_size;
+NX_PACKET *current_packet_ptr;
+
+    size = (UINT)(packet_ptr -> nx_packet_append_ptr - packet_ptr -> nx_packet_prepend_ptr);
+    if (size >= length)
+    {
+
+        /* Already contiguous.  */
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    if ((length > packet_ptr -> nx_packet_length) ||
+        (length > (UINT)(packet_ptr -> nx_packet_data_end - packet_ptr -> nx_packet_data_start)))
+    {
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    /* Only move data in the first packet when its tail can not hold the missing bytes.  */
+    if ((UINT)(packet_ptr -> nx_packet_data_end - packet_ptr -> nx_packet_prepend_ptr) < length)
+    {
+        memmove(packet_ptr -> nx_packet_data_start, packet_ptr -> nx_packet_prepend_ptr, size);
+        packet_ptr -> nx_packet_prepend_ptr = packet_ptr -> nx_packet_data_start;
+        packet_ptr -> nx_packet_append_ptr = packet_ptr -> nx_packet_data_start + size;
+    }
+
+    /* Copy only the missing bytes, rest of the chain stays where it is.  */
+    while (size < length)
+    {
+        current_packet_ptr = packet_ptr -> nx_packet_next;
+        copy_size = (UINT)(current_packet_ptr -> nx_packet_append_ptr - current_packet_ptr -> nx_packet_prepend_ptr);
+        if (copy_size > (length - size))
+        {
+            copy_size = length - size;
+        }
+
+        memcpy((VOID *)packet_ptr -> nx_packet_append_ptr, (VOID *)current_packet_ptr -> nx_packet_prepend_ptr, copy_size);
+        packet_ptr -> nx_packet_append_ptr += copy_size;
+        current_packet_ptr -> nx_packet_prepend_ptr += copy_size;
+        size += copy_size;
+
+        if (current_packet_ptr -> nx_packet_prepend_ptr == current_packet_ptr -> nx_packet_append_ptr)
+        {
+
+            /* Remove drained packet from packet chain.  */
+            packet_ptr -> nx_packet_next = current_packet_ptr -> nx_packet_next;
+            if (packet_ptr -> nx_packet_next == NX_NULL)
+            {
+                packet_ptr -> nx_packet_last = NX_NULL;
+            }
+
+            current_packet_ptr -> nx_packet_next = NX_NULL;
+            nx_packet_release(current_packet_ptr);
+        }
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
 UINT nx_azure_iot_mqtt_tls_setup(NXD_MQTT_CLIENT *client_ptr, NX_SECURE_TLS_SESSION *tls_session,
                                  NX_SECURE_X509_CERT *certificate,
                                  NX_SECURE_X509_CERT *trusted_certificate)
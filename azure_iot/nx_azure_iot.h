@@ -92,6 +92,9 @@ extern   "C" {
 /* Provisioning Client Disconnect event */
 #define NX_AZURE_IOT_PROVISIONING_CLIENT_DISCONNECT_EVENT ((ULONG)0x00000020)
 
+/* IoT Hub Client Publish event */
+#define NX_AZURE_IOT_HUB_CLIENT_PUBLISH_EVENT             ((ULONG)0x00000040)
+
 /* API return values.  */
 /**< The operation was successful. */
 #define NX_AZURE_IOT_SUCCESS                              0x0
@@ -117,6 +120,10 @@ extern   "C" {
 #define NX_AZURE_IOT_MESSAGE_TOO_LONG                     0x20010
 #define NX_AZURE_IOT_NO_AVAILABLE_CIPHER                  0x20011
 #define NX_AZURE_IOT_WRONG_STATE                          0x20012
+#define NX_AZURE_IOT_TIMEOUT                              0x20013
+#define NX_AZURE_IOT_INFLIGHT_WINDOW_FULL                 0x20014
+#define NX_AZURE_IOT_THROTTLED                            0x20015
+#define NX_AZURE_IOT_INCOMPLETE_FRAME                     0x20016
 
 
 /* Resource type managed by AZ_IOT.  */
@@ -134,6 +141,39 @@ extern   "C" {
 #define NX_AZURE_IOT_MQTT_KEEP_ALIVE                      (60 * 4)
 #endif /* NX_AZURE_IOT_MQTT_KEEP_ALIVE */
 
+/* Define offset of MQTT telemetry packet. */
+#define NX_AZURE_IOT_PUBLISH_PACKET_START_OFFSET          7
+
+/* Define the maximum remaining length of MQTT control packet.  */
+#define NX_AZURE_IOT_MQTT_MAX_REMAINING_LENGTH            (268435455)
+
+/* Define the size of chunk that external payload is copied into before TLS encryption.
+   Pool usage of streamed send is one chunk at a time. */
+#ifndef NX_AZURE_IOT_MQTT_STREAM_CHUNK_SIZE
+#define NX_AZURE_IOT_MQTT_STREAM_CHUNK_SIZE               (1024)
+#endif /* NX_AZURE_IOT_MQTT_STREAM_CHUNK_SIZE */
+
+/**
+ * @brief IO vector struct, describes one fragment of a scattered buffer.
+ *
+ */
+typedef struct NX_AZURE_IOT_IOVEC_STRUCT
+{
+    UCHAR                                 *iovec_base;
+    UINT                                   iovec_length;
+} NX_AZURE_IOT_IOVEC;
+
+/**
+ * @brief Packet cursor struct, reads bytes of a packet chain across packet boundaries.
+ *
+ */
+typedef struct NX_AZURE_IOT_PACKET_CURSOR_STRUCT
+{
+    NX_PACKET                             *cursor_packet_ptr;
+    UCHAR                                 *cursor_data_ptr;
+    ULONG                                  cursor_remaining;    /* Bytes left before end of chain. */
+} NX_AZURE_IOT_PACKET_CURSOR;
+
 /**
  * @brief Resource struct
  *
@@ -253,16 +293,113 @@ UINT nx_azure_iot_buffer_allocate(NX_AZURE_IOT *nx_azure_iot_ptr, UCHAR **buffer
  */
 UINT nx_azure_iot_buffer_free(VOID *buffer_context);
 
+/**
+ * @brief Initialize packet cursor
+ * @details Cursor reads `nx_packet_length` bytes of a packet chain from `nx_packet_prepend_ptr`, crossing
+ *          packet boundaries without copying the chain. Received payloads can be parsed this way while
+ *          the packet is held.
+ *
+ * @param[in] cursor_ptr A pointer to a #NX_AZURE_IOT_PACKET_CURSOR.
+ * @param[in] packet_ptr A pointer to first `NX_PACKET` of the chain.
+ * @return A `UINT` with the result of the API.
+ *  @retval #NX_AZURE_IOT_SUCCESS Successfully initialized cursor.
+ */
+UINT nx_azure_iot_packet_cursor_init(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, NX_PACKET *packet_ptr);
+
+/**
+ * @brief Peek next byte
+ *
+ * @param[in] cursor_ptr A pointer to a #NX_AZURE_IOT_PACKET_CURSOR.
+ * @param[out] byte_ptr Returned byte. Cursor does not move.
+ * @return A `UINT` with the result of the API.
+ *  @retval #NX_AZURE_IOT_SUCCESS Successfully returned byte.
+ *  @retval #NX_AZURE_IOT_NOT_FOUND Cursor is at end of chain.
+ */
+UINT nx_azure_iot_packet_cursor_peek(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR *byte_ptr);
+
+/**
+ * @brief Read bytes
+ * @details This routine copies up to `buffer_size` bytes and moves the cursor past them.
+ *
+ * @param[in] cursor_ptr A pointer to a #NX_AZURE_IOT_PACKET_CURSOR.
+ * @param[out] buffer_ptr Pointer to buffer receiving bytes.
+ * @param[in] buffer_size Size of buffer.
+ * @param[out] bytes_copied_ptr Number of bytes copied, less than `buffer_size` at end of chain.
+ * @return A `UINT` with the result of the API.
+ *  @retval #NX_AZURE_IOT_SUCCESS Successfully copied bytes.
+ *  @retval #NX_AZURE_IOT_NOT_FOUND Cursor is at end of chain.
+ */
+UINT nx_azure_iot_packet_cursor_read(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR *buffer_ptr,
+                                     UINT buffer_size, UINT *bytes_copied_ptr);
+
+/**
+ * @brief Skip bytes
+ *
+ * @param[in] cursor_ptr A pointer to a #NX_AZURE_IOT_PACKET_CURSOR.
+ * @param[in] length Number of bytes to skip.
+ * @return A `UINT` with the result of the API.
+ *  @retval #NX_AZURE_IOT_SUCCESS Successfully skipped bytes.
+ *  @retval #NX_AZURE_IOT_INVALID_PACKET Chain ends before `length` bytes. Cursor is left at end of chain.
+ */
+UINT nx_azure_iot_packet_cursor_skip(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, ULONG length);
+
+/**
+ * @brief Find byte
+ * @details This routine moves the cursor to the next occurrence of `byte`, which is not consumed.
+ *
+ * @param[in] cursor_ptr A pointer to a #NX_AZURE_IOT_PACKET_CURSOR.
+ * @param[in] byte Byte to find.
+ * @param[out] offset_ptr Number of bytes skipped to reach `byte`. Can be `NULL`.
+ * @return A `UINT` with the result of the API.
+ *  @retval #NX_AZURE_IOT_SUCCESS Successfully found byte.
+ *  @retval #NX_AZURE_IOT_NOT_FOUND Byte is not found. Cursor does not move.
+ */
+UINT nx_azure_iot_packet_cursor_byte_find(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR byte, ULONG *offset_ptr);
+
+/**
+ * @brief Get contiguous span at cursor
+ * @details This routine returns bytes from the cursor to the end of current packet of the chain, without
+ *          moving the cursor. Call nx_azure_iot_packet_cursor_skip() to consume them.
+ *
+ * @param[in] cursor_ptr A pointer to a #NX_AZURE_IOT_PACKET_CURSOR.
+ * @param[out] data_pptr Pointer to first byte of span.
+ * @param[out] length_ptr Length of span.
+ * @return A `UINT` with the result of the API.
+ *  @retval #NX_AZURE_IOT_SUCCESS Successfully returned span.
+ *  @retval #NX_AZURE_IOT_NOT_FOUND Cursor is at end of chain.
+ */
+UINT nx_azure_iot_packet_cursor_span_get(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR **data_pptr,
+                                         UINT *length_ptr);
+
 /* Internal APIs. */
 UINT nx_azure_iot_resource_add(NX_AZURE_IOT *nx_azure_iot_ptr, NX_AZURE_IOT_RESOURCE *resource);
 UINT nx_azure_iot_resource_remove(NX_AZURE_IOT *nx_azure_iot_ptr, NX_AZURE_IOT_RESOURCE *resource);
 NX_AZURE_IOT_RESOURCE *nx_azure_iot_resource_search(NXD_MQTT_CLIENT *client_ptr);
 UINT nx_azure_iot_publish_mqtt_packet(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
                                       UINT topic_len, UCHAR *packet_id, UINT qos, UINT wait_option);
+UINT nx_azure_iot_publish_packet_header_add(NX_PACKET *packet_ptr, UINT topic_len, UINT qos);
+UINT nx_azure_iot_publish_packet_header_write(NX_PACKET *packet_ptr, UINT topic_len, UINT qos,
+                                              UINT remaining_length);
+NX_PACKET *nx_azure_iot_packet_tail_get(NX_PACKET *packet_ptr);
+VOID nx_azure_iot_packet_tail_restore(NX_PACKET *packet_ptr, NX_PACKET *tail_ptr, UCHAR *append_ptr, ULONG length);
+/* Appends data after the last packet of the chain, filling it in place before chaining new packets.
+   Packet is left unchanged on failure.  */
+UINT nx_azure_iot_packet_data_gather(NX_PACKET *packet_ptr, const NX_AZURE_IOT_IOVEC *vec,
+                                     UINT count, UINT wait_option);
+UINT nx_azure_iot_mqtt_packet_send(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
+                                   UCHAR *packet_id, UINT qos, UINT wait_option);
 UINT nx_azure_iot_publish_packet_get(NX_AZURE_IOT *nx_azure_iot_ptr, NXD_MQTT_CLIENT *client_ptr,
                                      NX_PACKET **packet_pptr, UINT wait_option);
+/* Sends QoS 0 PUBLISH whose payload follows packet_ptr in caller memory. packet_ptr is released in all cases.
+   Returns NX_AZURE_IOT_INCOMPLETE_FRAME if only part of the frame is sent, then caller must disconnect.  */
+UINT nx_azure_iot_mqtt_packet_stream_send(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
+                                          const UCHAR *data_ptr, UINT data_size, UINT wait_option);
 UINT nx_azure_iot_mqtt_packet_id_get(NXD_MQTT_CLIENT *client_ptr, UCHAR *packet_id, UINT wait_option);
 VOID nx_azure_iot_mqtt_packet_adjust(NX_PACKET *packet_ptr);
+UINT nx_azure_iot_packet_cursor_byte_read(NX_AZURE_IOT_PACKET_CURSOR *cursor_ptr, UCHAR *byte_ptr);
+UINT nx_azure_iot_mqtt_publish_topic_locate(NX_PACKET *packet_ptr, UINT *topic_offset_ptr,
+                                            UINT *topic_length_ptr);
+UINT nx_azure_iot_packet_pullup(NX_PACKET *packet_ptr, UINT length);
 UINT nx_azure_iot_mqtt_tls_setup(NXD_MQTT_CLIENT *client_ptr, NX_SECURE_TLS_SESSION *tls_session,
                                  NX_SECURE_X509_CERT *certificate,
                                  NX_SECURE_X509_CERT *trusted_certificate);
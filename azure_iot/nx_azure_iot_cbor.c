@@ -0,0 +1,675 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+#include "nx_azure_iot_cbor.h"
+
+/* Major types.  */
+#define NX_AZURE_IOT_CBOR_MAJOR_UNSIGNED                  0
+#define NX_AZURE_IOT_CBOR_MAJOR_NEGATIVE                  1
+#define NX_AZURE_IOT_CBOR_MAJOR_BYTES                     2
+#define NX_AZURE_IOT_CBOR_MAJOR_TEXT                      3
+#define NX_AZURE_IOT_CBOR_MAJOR_ARRAY                     4
+#define NX_AZURE_IOT_CBOR_MAJOR_MAP                       5
+#define NX_AZURE_IOT_CBOR_MAJOR_TAG                       6
+#define NX_AZURE_IOT_CBOR_MAJOR_SIMPLE                    7
+
+/* Additional information in initial byte.  */
+#define NX_AZURE_IOT_CBOR_INFO_UINT8                      24
+#define NX_AZURE_IOT_CBOR_INFO_UINT16                     25
+#define NX_AZURE_IOT_CBOR_INFO_UINT32                     26
+#define NX_AZURE_IOT_CBOR_INFO_UINT64                     27
+#define NX_AZURE_IOT_CBOR_INFO_INDEFINITE                 31
+
+/* Simple values.  */
+#define NX_AZURE_IOT_CBOR_SIMPLE_FALSE                    20
+#define NX_AZURE_IOT_CBOR_SIMPLE_TRUE                     21
+#define NX_AZURE_IOT_CBOR_SIMPLE_NULL                     22
+#define NX_AZURE_IOT_CBOR_SIMPLE_UNDEFINED                23
+
+/* Floating point layout.  */
+#define NX_AZURE_IOT_CBOR_DOUBLE_EXPONENT_MASK            0x7FF0000000000000ULL
+#define NX_AZURE_IOT_CBOR_DOUBLE_SIGNIFICAND_MASK         0x000FFFFFFFFFFFFFULL
+#define NX_AZURE_IOT_CBOR_DOUBLE_SIGN_MASK                0x8000000000000000ULL
+#define NX_AZURE_IOT_CBOR_FLOAT_MAX                       3.4028234663852886e38
+#define NX_AZURE_IOT_CBOR_HALF_SIGN_MASK                  0x8000
+#define NX_AZURE_IOT_CBOR_HALF_INFINITY                   0x7C00
+#define NX_AZURE_IOT_CBOR_HALF_NAN                        0x7E00
+
+static UINT nx_azure_iot_cbor_encoder_write(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, const UCHAR *data_ptr,
+                                            UINT data_size)
+{
+NX_AZURE_IOT_IOVEC vec;
+UINT status;
+
+    if (encoder_ptr == NX_NULL)
+    {
+        LogError("IoT CBOR encoder fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Nothing is written on failure, so packet length stays in sync with encoder length.  */
+    vec.iovec_base = (UCHAR *)data_ptr;
+    vec.iovec_length = data_size;
+    status = nx_azure_iot_packet_data_gather(encoder_ptr -> cbor_encoder_packet_ptr, &vec, 1,
+                                             encoder_ptr -> cbor_encoder_wait_option);
+    if (status)
+    {
+        LogError("IoT CBOR encoder fail: APPEND FAIL: 0x%02x", status);
+        return(status);
+    }
+
+    encoder_ptr -> cbor_encoder_length += data_size;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_cbor_encoder_head_write(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT major_type,
+                                                 UINT argument)
+{
+UCHAR head[5];
+UINT length;
+
+    /* Argument is always written in its shortest form.  */
+    if (argument < NX_AZURE_IOT_CBOR_INFO_UINT8)
+    {
+        head[0] = (UCHAR)((major_type << 5) | argument);
+        length = 1;
+    }
+    else if (argument <= 0xFF)
+    {
+        head[0] = (UCHAR)((major_type << 5) | NX_AZURE_IOT_CBOR_INFO_UINT8);
+        head[1] = (UCHAR)argument;
+        length = 2;
+    }
+    else if (argument <= 0xFFFF)
+    {
+        head[0] = (UCHAR)((major_type << 5) | NX_AZURE_IOT_CBOR_INFO_UINT16);
+        head[1] = (UCHAR)(argument >> 8);
+        head[2] = (UCHAR)argument;
+        length = 3;
+    }
+    else
+    {
+        head[0] = (UCHAR)((major_type << 5) | NX_AZURE_IOT_CBOR_INFO_UINT32);
+        head[1] = (UCHAR)(argument >> 24);
+        head[2] = (UCHAR)(argument >> 16);
+        head[3] = (UCHAR)(argument >> 8);
+        head[4] = (UCHAR)argument;
+        length = 5;
+    }
+
+    return(nx_azure_iot_cbor_encoder_write(encoder_ptr, head, length));
+}
+
+static UINT nx_azure_iot_cbor_encoder_container_write(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT major_type,
+                                                      UINT count)
+{
+UCHAR head;
+
+    if (count == NX_AZURE_IOT_CBOR_INDEFINITE)
+    {
+        head = (UCHAR)((major_type << 5) | NX_AZURE_IOT_CBOR_INFO_INDEFINITE);
+        return(nx_azure_iot_cbor_encoder_write(encoder_ptr, &head, 1));
+    }
+
+    return(nx_azure_iot_cbor_encoder_head_write(encoder_ptr, major_type, count));
+}
+
+static UINT nx_azure_iot_cbor_encoder_string_write(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT major_type,
+                                                   const UCHAR *value, UINT value_length)
+{
+UINT status;
+
+    if ((value == NX_NULL) && value_length)
+    {
+        LogError("IoT CBOR encoder fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    status = nx_azure_iot_cbor_encoder_head_write(encoder_ptr, major_type, value_length);
+    if (status)
+    {
+        return(status);
+    }
+
+    return(nx_azure_iot_cbor_encoder_write(encoder_ptr, value, value_length));
+}
+
+static UINT nx_azure_iot_cbor_half_get(UINT single_bits, USHORT *half_ptr)
+{
+UINT sign = (UINT)((single_bits >> 16) & NX_AZURE_IOT_CBOR_HALF_SIGN_MASK);
+INT exponent = (INT)((single_bits >> 23) & 0xFF) - 127;
+UINT significand = single_bits & 0x7FFFFF;
+UINT shift;
+
+    if ((single_bits & 0x7FFFFFFF) == 0)
+    {
+        *half_ptr = (USHORT)sign;
+        return(NX_TRUE);
+    }
+
+    /* Normal half keeps 10 bits of significand.  */
+    if ((exponent >= -14) && (exponent <= 15))
+    {
+        if (significand & 0x1FFF)
+        {
+            return(NX_FALSE);
+        }
+
+        *half_ptr = (USHORT)(sign | ((UINT)(exponent + 15) << 10) | (UINT)(significand >> 13));
+        return(NX_TRUE);
+    }
+
+    /* Subnormal half is a multiple of 2^-24.  */
+    if ((exponent >= -24) && (exponent < -14))
+    {
+        significand |= 0x800000;
+        shift = (UINT)(-exponent - 1);
+        if (significand & ((1u << shift) - 1))
+        {
+            return(NX_FALSE);
+        }
+
+        *half_ptr = (USHORT)(sign | (UINT)(significand >> shift));
+        return(NX_TRUE);
+    }
+
+    return(NX_FALSE);
+}
+
+UINT nx_azure_iot_cbor_encoder_init(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, NX_PACKET *packet_ptr,
+                                    UINT wait_option)
+{
+    if ((encoder_ptr == NX_NULL) || (packet_ptr == NX_NULL))
+    {
+        LogError("IoT CBOR encoder init fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    memset(encoder_ptr, 0, sizeof(NX_AZURE_IOT_CBOR_ENCODER));
+    encoder_ptr -> cbor_encoder_packet_ptr = packet_ptr;
+    encoder_ptr -> cbor_encoder_wait_option = wait_option;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_cbor_encoder_length_get(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr)
+{
+    if (encoder_ptr == NX_NULL)
+    {
+        return(0);
+    }
+
+    return(encoder_ptr -> cbor_encoder_length);
+}
+
+UINT nx_azure_iot_cbor_encoder_append_map(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT count)
+{
+    return(nx_azure_iot_cbor_encoder_container_write(encoder_ptr, NX_AZURE_IOT_CBOR_MAJOR_MAP, count));
+}
+
+UINT nx_azure_iot_cbor_encoder_append_array(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT count)
+{
+    return(nx_azure_iot_cbor_encoder_container_write(encoder_ptr, NX_AZURE_IOT_CBOR_MAJOR_ARRAY, count));
+}
+
+UINT nx_azure_iot_cbor_encoder_append_break(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr)
+{
+UCHAR head = (UCHAR)((NX_AZURE_IOT_CBOR_MAJOR_SIMPLE << 5) | NX_AZURE_IOT_CBOR_INFO_INDEFINITE);
+
+    return(nx_azure_iot_cbor_encoder_write(encoder_ptr, &head, 1));
+}
+
+UINT nx_azure_iot_cbor_encoder_append_text(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr,
+                                           const UCHAR *value, UINT value_length)
+{
+    return(nx_azure_iot_cbor_encoder_string_write(encoder_ptr, NX_AZURE_IOT_CBOR_MAJOR_TEXT,
+                                                  value, value_length));
+}
+
+UINT nx_azure_iot_cbor_encoder_append_bytes(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr,
+                                            const UCHAR *value, UINT value_length)
+{
+    return(nx_azure_iot_cbor_encoder_string_write(encoder_ptr, NX_AZURE_IOT_CBOR_MAJOR_BYTES,
+                                                  value, value_length));
+}
+
+UINT nx_azure_iot_cbor_encoder_append_int32(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, INT value)
+{
+
+    /* Negative value -1 - n is carried as n.  */
+    if (value < 0)
+    {
+        return(nx_azure_iot_cbor_encoder_head_write(encoder_ptr, NX_AZURE_IOT_CBOR_MAJOR_NEGATIVE, ~(UINT)value));
+    }
+
+    return(nx_azure_iot_cbor_encoder_head_write(encoder_ptr, NX_AZURE_IOT_CBOR_MAJOR_UNSIGNED, (UINT)value));
+}
+
+UINT nx_azure_iot_cbor_encoder_append_double(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, double value)
+{
+UCHAR buffer[9];
+ULONG64 bits;
+UINT single_bits;
+USHORT half = 0;
+float single;
+UINT length = 0;
+UINT use_half = NX_FALSE;
+UINT index;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    if ((bits & NX_AZURE_IOT_CBOR_DOUBLE_EXPONENT_MASK) == NX_AZURE_IOT_CBOR_DOUBLE_EXPONENT_MASK)
+    {
+
+        /* NaN is written in canonical form.  */
+        if (bits & NX_AZURE_IOT_CBOR_DOUBLE_SIGNIFICAND_MASK)
+        {
+            half = NX_AZURE_IOT_CBOR_HALF_NAN;
+        }
+        else
+        {
+            half = (bits & NX_AZURE_IOT_CBOR_DOUBLE_SIGN_MASK) ?
+                   (NX_AZURE_IOT_CBOR_HALF_SIGN_MASK | NX_AZURE_IOT_CBOR_HALF_INFINITY) :
+                   NX_AZURE_IOT_CBOR_HALF_INFINITY;
+        }
+        use_half = NX_TRUE;
+    }
+    else if ((value >= -NX_AZURE_IOT_CBOR_FLOAT_MAX) && (value <= NX_AZURE_IOT_CBOR_FLOAT_MAX) &&
+             ((double)(single = (float)value) == value))
+    {
+        memcpy(&single_bits, &single, sizeof(single_bits));
+        use_half = nx_azure_iot_cbor_half_get(single_bits, &half);
+        if (!use_half)
+        {
+            buffer[length++] = (UCHAR)((NX_AZURE_IOT_CBOR_MAJOR_SIMPLE << 5) | NX_AZURE_IOT_CBOR_INFO_UINT32);
+            for (index = 0; index < 4; index++)
+            {
+                buffer[length++] = (UCHAR)(single_bits >> (24 - (index << 3)));
+            }
+        }
+    }
+    else
+    {
+        buffer[length++] = (UCHAR)((NX_AZURE_IOT_CBOR_MAJOR_SIMPLE << 5) | NX_AZURE_IOT_CBOR_INFO_UINT64);
+        for (index = 0; index < 8; index++)
+        {
+            buffer[length++] = (UCHAR)(bits >> (56 - (index << 3)));
+        }
+    }
+
+    if (use_half)
+    {
+        buffer[length++] = (UCHAR)((NX_AZURE_IOT_CBOR_MAJOR_SIMPLE << 5) | NX_AZURE_IOT_CBOR_INFO_UINT16);
+        buffer[length++] = (UCHAR)(half >> 8);
+        buffer[length++] = (UCHAR)half;
+    }
+
+    return(nx_azure_iot_cbor_encoder_write(encoder_ptr, buffer, length));
+}
+
+UINT nx_azure_iot_cbor_encoder_append_bool(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT value)
+{
+UCHAR head = (UCHAR)((NX_AZURE_IOT_CBOR_MAJOR_SIMPLE << 5) |
+                     (value ? NX_AZURE_IOT_CBOR_SIMPLE_TRUE : NX_AZURE_IOT_CBOR_SIMPLE_FALSE));
+
+    return(nx_azure_iot_cbor_encoder_write(encoder_ptr, &head, 1));
+}
+
+UINT nx_azure_iot_cbor_encoder_append_null(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr)
+{
+UCHAR head = (UCHAR)((NX_AZURE_IOT_CBOR_MAJOR_SIMPLE << 5) | NX_AZURE_IOT_CBOR_SIMPLE_NULL);
+
+    return(nx_azure_iot_cbor_encoder_write(encoder_ptr, &head, 1));
+}
+
+UINT nx_azure_iot_cbor_decoder_init(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr, const UCHAR *buffer,
+                                    UINT buffer_size)
+{
+    if ((decoder_ptr == NX_NULL) || ((buffer == NX_NULL) && buffer_size))
+    {
+        LogError("IoT CBOR decoder init fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    decoder_ptr -> cbor_decoder_buffer = buffer;
+    decoder_ptr -> cbor_decoder_buffer_size = buffer_size;
+    decoder_ptr -> cbor_decoder_offset = 0;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_cbor_decoder_packet_init(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr, NX_PACKET *packet_ptr)
+{
+    if ((decoder_ptr == NX_NULL) || (packet_ptr == NX_NULL))
+    {
+        LogError("IoT CBOR decoder init fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Items are returned in place, so payload must be contiguous.  */
+    if (packet_ptr -> nx_packet_next)
+    {
+        LogError("IoT CBOR decoder init fail: PAYLOAD CHAINED");
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    return(nx_azure_iot_cbor_decoder_init(decoder_ptr, packet_ptr -> nx_packet_prepend_ptr,
+                                          (UINT)packet_ptr -> nx_packet_length));
+}
+
+static VOID nx_azure_iot_cbor_half_decode(UINT half, double *value_ptr)
+{
+UINT sign = (half & NX_AZURE_IOT_CBOR_HALF_SIGN_MASK) << 16;
+UINT exponent = (half >> 10) & 0x1F;
+UINT significand = half & 0x3FF;
+UINT single_bits;
+INT normalized_exponent;
+float single;
+
+    if (exponent == 0x1F)
+    {
+        single_bits = sign | 0x7F800000u | (significand << 13);
+    }
+    else if (exponent)
+    {
+        single_bits = sign | ((exponent + 112) << 23) | (significand << 13);
+    }
+    else if (significand == 0)
+    {
+        single_bits = sign;
+    }
+    else
+    {
+
+        /* Subnormal half is normal as single.  */
+        normalized_exponent = -14;
+        while (!(significand & 0x400))
+        {
+            significand <<= 1;
+            normalized_exponent--;
+        }
+        single_bits = sign | ((UINT)(normalized_exponent + 127) << 23) | ((significand & 0x3FF) << 13);
+    }
+
+    memcpy(&single, &single_bits, sizeof(single));
+    *value_ptr = (double)single;
+}
+
+UINT nx_azure_iot_cbor_decoder_next(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr, NX_AZURE_IOT_CBOR_ITEM *item_ptr)
+{
+const UCHAR *data_ptr;
+UINT remaining;
+UINT major_type;
+UINT info;
+UINT argument_size;
+UINT index;
+ULONG64 argument = 0;
+UINT single_bits;
+float single;
+
+    if ((decoder_ptr == NX_NULL) || (item_ptr == NX_NULL))
+    {
+        LogError("IoT CBOR decoder fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    remaining = decoder_ptr -> cbor_decoder_buffer_size - decoder_ptr -> cbor_decoder_offset;
+    if (remaining == 0)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    data_ptr = decoder_ptr -> cbor_decoder_buffer + decoder_ptr -> cbor_decoder_offset;
+    major_type = (UINT)(data_ptr[0] >> 5);
+    info = (UINT)(data_ptr[0] & 0x1F);
+    memset(item_ptr, 0, sizeof(NX_AZURE_IOT_CBOR_ITEM));
+
+    if (info < NX_AZURE_IOT_CBOR_INFO_UINT8)
+    {
+        argument = info;
+        argument_size = 0;
+    }
+    else if (info <= NX_AZURE_IOT_CBOR_INFO_UINT64)
+    {
+        argument_size = 1u << (info - NX_AZURE_IOT_CBOR_INFO_UINT8);
+    }
+    else if ((info == NX_AZURE_IOT_CBOR_INFO_INDEFINITE) &&
+             ((major_type == NX_AZURE_IOT_CBOR_MAJOR_ARRAY) || (major_type == NX_AZURE_IOT_CBOR_MAJOR_MAP) ||
+              (major_type == NX_AZURE_IOT_CBOR_MAJOR_SIMPLE)))
+    {
+        argument_size = 0;
+    }
+    else if ((info == NX_AZURE_IOT_CBOR_INFO_INDEFINITE) &&
+             ((major_type == NX_AZURE_IOT_CBOR_MAJOR_BYTES) || (major_type == NX_AZURE_IOT_CBOR_MAJOR_TEXT)))
+    {
+        LogError("IoT CBOR decoder fail: INDEFINITE STRING");
+        return(NX_AZURE_IOT_NOT_SUPPORTED);
+    }
+    else
+    {
+        LogError("IoT CBOR decoder fail: INVALID HEAD 0x%02x", data_ptr[0]);
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    if (argument_size >= remaining)
+    {
+        LogError("IoT CBOR decoder fail: TRUNCATED");
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    for (index = 1; index <= argument_size; index++)
+    {
+        argument = (argument << 8) | data_ptr[index];
+    }
+    remaining -= 1 + argument_size;
+
+    switch (major_type)
+    {
+        case NX_AZURE_IOT_CBOR_MAJOR_UNSIGNED:
+        case NX_AZURE_IOT_CBOR_MAJOR_NEGATIVE:
+        case NX_AZURE_IOT_CBOR_MAJOR_TAG:
+            item_ptr -> item_type = (major_type == NX_AZURE_IOT_CBOR_MAJOR_TAG) ?
+                                    NX_AZURE_IOT_CBOR_TYPE_TAG : major_type;
+            item_ptr -> item_value = argument;
+            break;
+
+        case NX_AZURE_IOT_CBOR_MAJOR_BYTES:
+        case NX_AZURE_IOT_CBOR_MAJOR_TEXT:
+            if (argument > remaining)
+            {
+                LogError("IoT CBOR decoder fail: TRUNCATED");
+                return(NX_AZURE_IOT_INVALID_PACKET);
+            }
+
+            item_ptr -> item_type = major_type;
+            item_ptr -> item_data_ptr = data_ptr + 1 + argument_size;
+            item_ptr -> item_length = (UINT)argument;
+            argument_size += (UINT)argument;
+            break;
+
+        case NX_AZURE_IOT_CBOR_MAJOR_ARRAY:
+        case NX_AZURE_IOT_CBOR_MAJOR_MAP:
+            item_ptr -> item_type = major_type;
+            item_ptr -> item_value = (info == NX_AZURE_IOT_CBOR_INFO_INDEFINITE) ?
+                                     NX_AZURE_IOT_CBOR_INDEFINITE : argument;
+            break;
+
+        default:
+            switch (info)
+            {
+                case NX_AZURE_IOT_CBOR_SIMPLE_FALSE:
+                case NX_AZURE_IOT_CBOR_SIMPLE_TRUE:
+                    item_ptr -> item_type = NX_AZURE_IOT_CBOR_TYPE_BOOL;
+                    item_ptr -> item_bool = (info == NX_AZURE_IOT_CBOR_SIMPLE_TRUE);
+                    break;
+
+                case NX_AZURE_IOT_CBOR_SIMPLE_NULL:
+                    item_ptr -> item_type = NX_AZURE_IOT_CBOR_TYPE_NULL;
+                    break;
+
+                case NX_AZURE_IOT_CBOR_SIMPLE_UNDEFINED:
+                    item_ptr -> item_type = NX_AZURE_IOT_CBOR_TYPE_UNDEFINED;
+                    break;
+
+                case NX_AZURE_IOT_CBOR_INFO_UINT16:
+                    item_ptr -> item_type = NX_AZURE_IOT_CBOR_TYPE_FLOAT;
+                    nx_azure_iot_cbor_half_decode((UINT)argument, &(item_ptr -> item_float));
+                    break;
+
+                case NX_AZURE_IOT_CBOR_INFO_UINT32:
+                    item_ptr -> item_type = NX_AZURE_IOT_CBOR_TYPE_FLOAT;
+                    single_bits = (UINT)argument;
+                    memcpy(&single, &single_bits, sizeof(single));
+                    item_ptr -> item_float = (double)single;
+                    break;
+
+                case NX_AZURE_IOT_CBOR_INFO_UINT64:
+                    item_ptr -> item_type = NX_AZURE_IOT_CBOR_TYPE_FLOAT;
+                    memcpy(&(item_ptr -> item_float), &argument, sizeof(argument));
+                    break;
+
+                case NX_AZURE_IOT_CBOR_INFO_INDEFINITE:
+                    item_ptr -> item_type = NX_AZURE_IOT_CBOR_TYPE_BREAK;
+                    break;
+
+                default:
+                    LogError("IoT CBOR decoder fail: UNKNOWN SIMPLE VALUE");
+                    return(NX_AZURE_IOT_NOT_SUPPORTED);
+            }
+            break;
+    }
+
+    decoder_ptr -> cbor_decoder_offset += 1 + argument_size;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_cbor_decoder_content_skip(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr,
+                                                   NX_AZURE_IOT_CBOR_ITEM *item_ptr, UINT depth)
+{
+NX_AZURE_IOT_CBOR_ITEM child;
+ULONG64 count;
+UINT indefinite = NX_FALSE;
+UINT status;
+
+    if (item_ptr -> item_type == NX_AZURE_IOT_CBOR_TYPE_TAG)
+    {
+        count = 1;
+    }
+    else if ((item_ptr -> item_type == NX_AZURE_IOT_CBOR_TYPE_ARRAY) ||
+             (item_ptr -> item_type == NX_AZURE_IOT_CBOR_TYPE_MAP))
+    {
+        indefinite = (item_ptr -> item_value == NX_AZURE_IOT_CBOR_INDEFINITE);
+        count = item_ptr -> item_value;
+
+        /* Every item takes at least one byte.  */
+        if (!indefinite &&
+            (count > (decoder_ptr -> cbor_decoder_buffer_size - decoder_ptr -> cbor_decoder_offset)))
+        {
+            LogError("IoT CBOR decoder skip fail: TRUNCATED");
+            return(NX_AZURE_IOT_INVALID_PACKET);
+        }
+
+        if (item_ptr -> item_type == NX_AZURE_IOT_CBOR_TYPE_MAP)
+        {
+            count <<= 1;
+        }
+    }
+    else
+    {
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    if (depth >= NX_AZURE_IOT_CBOR_DECODER_MAX_DEPTH)
+    {
+        LogError("IoT CBOR decoder skip fail: TOO DEEP");
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    while (indefinite || count)
+    {
+        status = nx_azure_iot_cbor_decoder_next(decoder_ptr, &child);
+        if (status == NX_AZURE_IOT_NOT_FOUND)
+        {
+            LogError("IoT CBOR decoder skip fail: TRUNCATED");
+            return(NX_AZURE_IOT_INVALID_PACKET);
+        }
+        else if (status)
+        {
+            return(status);
+        }
+
+        if (child.item_type == NX_AZURE_IOT_CBOR_TYPE_BREAK)
+        {
+            if (indefinite)
+            {
+                break;
+            }
+
+            LogError("IoT CBOR decoder skip fail: UNEXPECTED BREAK");
+            return(NX_AZURE_IOT_INVALID_PACKET);
+        }
+
+        status = nx_azure_iot_cbor_decoder_content_skip(decoder_ptr, &child, depth + 1);
+        if (status)
+        {
+            return(status);
+        }
+
+        if (!indefinite)
+        {
+            count--;
+        }
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_cbor_decoder_skip(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr, NX_AZURE_IOT_CBOR_ITEM *item_ptr)
+{
+    if ((decoder_ptr == NX_NULL) || (item_ptr == NX_NULL))
+    {
+        LogError("IoT CBOR decoder skip fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    return(nx_azure_iot_cbor_decoder_content_skip(decoder_ptr, item_ptr, 0));
+}
+
+UINT nx_azure_iot_cbor_item_int32_get(NX_AZURE_IOT_CBOR_ITEM *item_ptr, INT *value_ptr)
+{
+    if ((item_ptr == NX_NULL) || (value_ptr == NX_NULL))
+    {
+        LogError("IoT CBOR item get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (((item_ptr -> item_type != NX_AZURE_IOT_CBOR_TYPE_UNSIGNED) &&
+         (item_ptr -> item_type != NX_AZURE_IOT_CBOR_TYPE_NEGATIVE)) ||
+        (item_ptr -> item_value > 0x7FFFFFFF))
+    {
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (item_ptr -> item_type == NX_AZURE_IOT_CBOR_TYPE_NEGATIVE)
+    {
+        *value_ptr = -1 - (INT)item_ptr -> item_value;
+    }
+    else
+    {
+        *value_ptr = (INT)item_ptr -> item_value;
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
@@ -0,0 +1,292 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+/**
+ * @file nx_azure_iot_cbor.h
+ *
+ * @brief Definition for the Azure IoT CBOR encoder and decoder.
+ * @remark The encoder appends CBOR (RFC 7049) items directly into a `NX_PACKET`, in the same way as
+ * #NX_AZURE_IOT_JSON_WRITER, with every integer and length in its shortest form and doubles narrowed to
+ * half or single precision whenever that is exact. The decoder walks a contiguous buffer, typically the
+ * payload of a received packet, and returns strings as pointers into that buffer, so neither side
+ * allocates memory.
+ *
+ */
+
+#ifndef NX_AZURE_IOT_CBOR_H
+#define NX_AZURE_IOT_CBOR_H
+
+#ifdef __cplusplus
+extern   "C" {
+#endif
+
+#include "nx_azure_iot.h"
+
+/* Set the maximum nesting of arrays and maps skipped by the decoder.  */
+#ifndef NX_AZURE_IOT_CBOR_DECODER_MAX_DEPTH
+#define NX_AZURE_IOT_CBOR_DECODER_MAX_DEPTH               (8)
+#endif /* NX_AZURE_IOT_CBOR_DECODER_MAX_DEPTH */
+
+/* Count of array or map whose length is not known up front. It is closed by a break.  */
+#define NX_AZURE_IOT_CBOR_INDEFINITE                      (0xFFFFFFFF)
+
+/* Decoded item types.  */
+#define NX_AZURE_IOT_CBOR_TYPE_UNSIGNED                   (0)
+#define NX_AZURE_IOT_CBOR_TYPE_NEGATIVE                   (1)
+#define NX_AZURE_IOT_CBOR_TYPE_BYTES                      (2)
+#define NX_AZURE_IOT_CBOR_TYPE_TEXT                       (3)
+#define NX_AZURE_IOT_CBOR_TYPE_ARRAY                      (4)
+#define NX_AZURE_IOT_CBOR_TYPE_MAP                        (5)
+#define NX_AZURE_IOT_CBOR_TYPE_TAG                        (6)
+#define NX_AZURE_IOT_CBOR_TYPE_FLOAT                      (7)
+#define NX_AZURE_IOT_CBOR_TYPE_BOOL                       (8)
+#define NX_AZURE_IOT_CBOR_TYPE_NULL                       (9)
+#define NX_AZURE_IOT_CBOR_TYPE_UNDEFINED                  (10)
+#define NX_AZURE_IOT_CBOR_TYPE_BREAK                      (11)
+
+/* Content type property set on CBOR telemetry.  */
+#define NX_AZURE_IOT_CBOR_CONTENT_TYPE_PROPERTY           "$.ct"
+#define NX_AZURE_IOT_CBOR_CONTENT_TYPE_VALUE              "application%2Fcbor"
+
+/**
+ * @brief Azure IoT CBOR encoder struct
+ *
+ */
+typedef struct NX_AZURE_IOT_CBOR_ENCODER_STRUCT
+{
+    NX_PACKET                          *cbor_encoder_packet_ptr;
+    UINT                                cbor_encoder_wait_option;
+    UINT                                cbor_encoder_length;        /* Bytes written. */
+} NX_AZURE_IOT_CBOR_ENCODER;
+
+/**
+ * @brief Azure IoT CBOR decoder struct
+ *
+ */
+typedef struct NX_AZURE_IOT_CBOR_DECODER_STRUCT
+{
+    const UCHAR                        *cbor_decoder_buffer;
+    UINT                                cbor_decoder_buffer_size;
+    UINT                                cbor_decoder_offset;
+} NX_AZURE_IOT_CBOR_DECODER;
+
+/**
+ * @brief Azure IoT CBOR item struct
+ * @details `item_value` holds an unsigned value, the argument `n` of a negative value `-1 - n`, the count of
+ *          an array or map, or a tag number. Bytes and text point into the decoder buffer.
+ *
+ */
+typedef struct NX_AZURE_IOT_CBOR_ITEM_STRUCT
+{
+    UINT                                item_type;
+    ULONG64                             item_value;
+    double                              item_float;
+    const UCHAR                        *item_data_ptr;
+    UINT                                item_length;
+    UINT                                item_bool;
+} NX_AZURE_IOT_CBOR_ITEM;
+
+/**
+ * @brief Initialize CBOR encoder
+ * @details CBOR items are appended after the data already in `packet_ptr`. Packets are allocated from
+ *          the pool of `packet_ptr` when more room is needed.
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @param[in] packet_ptr A pointer to packet to write to.
+ * @param[in] wait_option Ticks to wait for packet allocation.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if encoder is initialized.
+ */
+UINT nx_azure_iot_cbor_encoder_init(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, NX_PACKET *packet_ptr,
+                                    UINT wait_option);
+
+/**
+ * @brief Get length of CBOR data written
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @return Number of bytes written.
+ */
+UINT nx_azure_iot_cbor_encoder_length_get(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr);
+
+/**
+ * @brief Append begin of map
+ * @details `count` key and value pairs must follow. With #NX_AZURE_IOT_CBOR_INDEFINITE, the map is closed
+ *          by nx_azure_iot_cbor_encoder_append_break().
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @param[in] count Number of pairs, or #NX_AZURE_IOT_CBOR_INDEFINITE.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_map(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT count);
+
+/**
+ * @brief Append begin of array
+ * @details `count` items must follow. With #NX_AZURE_IOT_CBOR_INDEFINITE, the array is closed by
+ *          nx_azure_iot_cbor_encoder_append_break().
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @param[in] count Number of items, or #NX_AZURE_IOT_CBOR_INDEFINITE.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_array(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT count);
+
+/**
+ * @brief Append break
+ * @details Closes the innermost map or array opened with #NX_AZURE_IOT_CBOR_INDEFINITE.
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_break(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr);
+
+/**
+ * @brief Append text string
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @param[in] value Pointer to UTF-8 string.
+ * @param[in] value_length Length of string.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_text(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr,
+                                           const UCHAR *value, UINT value_length);
+
+/**
+ * @brief Append byte string
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @param[in] value Pointer to bytes.
+ * @param[in] value_length Number of bytes.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_bytes(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr,
+                                            const UCHAR *value, UINT value_length);
+
+/**
+ * @brief Append integer
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @param[in] value Integer value.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_int32(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, INT value);
+
+/**
+ * @brief Append double
+ * @details Value is written as half, single or double precision, whichever is the smallest that holds
+ *          it exactly. NaN and infinity are allowed.
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @param[in] value Double value.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_double(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, double value);
+
+/**
+ * @brief Append boolean
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @param[in] value `NX_TRUE` or `NX_FALSE`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_bool(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr, UINT value);
+
+/**
+ * @brief Append null
+ *
+ * @param[in] encoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_ENCODER.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_cbor_encoder_append_null(NX_AZURE_IOT_CBOR_ENCODER *encoder_ptr);
+
+/**
+ * @brief Initialize CBOR decoder
+ * @details Items are decoded in place, so `buffer` must stay valid while the decoder and its items are used.
+ *
+ * @param[in] decoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_DECODER.
+ * @param[in] buffer Pointer to CBOR data.
+ * @param[in] buffer_size Size of CBOR data.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if decoder is initialized.
+ */
+UINT nx_azure_iot_cbor_decoder_init(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr, const UCHAR *buffer,
+                                    UINT buffer_size);
+
+/**
+ * @brief Initialize CBOR decoder on a received packet
+ * @details Decodes the payload of a packet returned by nx_azure_iot_hub_client_cloud_message_receive() or
+ *          nx_azure_iot_hub_client_direct_method_message_receive() in place. The packet must not be released
+ *          while the decoder is used.
+ *
+ * @param[in] decoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_DECODER.
+ * @param[in] packet_ptr A pointer to received packet.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if decoder is initialized.
+ *   @retval #NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE Fail to initialize since payload spans more than one
+ *           packet. Copy it out with nx_packet_data_extract_offset() and use nx_azure_iot_cbor_decoder_init().
+ */
+UINT nx_azure_iot_cbor_decoder_packet_init(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr, NX_PACKET *packet_ptr);
+
+/**
+ * @brief Decode next item
+ * @details For arrays and maps, only the header is decoded and their content follows as the next items.
+ *          An indefinite array or map reports #NX_AZURE_IOT_CBOR_INDEFINITE as `item_value` and ends with an
+ *          item of type #NX_AZURE_IOT_CBOR_TYPE_BREAK.
+ *
+ * @param[in] decoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_DECODER.
+ * @param[out] item_ptr A pointer to a #NX_AZURE_IOT_CBOR_ITEM.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if item is decoded.
+ *   @retval #NX_AZURE_IOT_NOT_FOUND If there is no more data.
+ *   @retval #NX_AZURE_IOT_INVALID_PACKET Fail to decode since data is truncated or malformed.
+ *   @retval #NX_AZURE_IOT_NOT_SUPPORTED Fail to decode indefinite length string or unassigned simple value.
+ */
+UINT nx_azure_iot_cbor_decoder_next(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr, NX_AZURE_IOT_CBOR_ITEM *item_ptr);
+
+/**
+ * @brief Skip content of item
+ * @details Skips everything nested in an array, map or tag just returned by nx_azure_iot_cbor_decoder_next(),
+ *          so the next call returns its sibling. Other items have no content and are left as is.
+ *
+ * @param[in] decoder_ptr A pointer to a #NX_AZURE_IOT_CBOR_DECODER.
+ * @param[in] item_ptr A pointer to a #NX_AZURE_IOT_CBOR_ITEM.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if content is skipped.
+ *   @retval #NX_AZURE_IOT_INVALID_PACKET Fail to skip since data is truncated, malformed or nested deeper than
+ *           NX_AZURE_IOT_CBOR_DECODER_MAX_DEPTH.
+ */
+UINT nx_azure_iot_cbor_decoder_skip(NX_AZURE_IOT_CBOR_DECODER *decoder_ptr, NX_AZURE_IOT_CBOR_ITEM *item_ptr);
+
+/**
+ * @brief Get integer value of item
+ *
+ * @param[in] item_ptr A pointer to a #NX_AZURE_IOT_CBOR_ITEM.
+ * @param[out] value_ptr Returned integer value.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if value is returned.
+ *   @retval #NX_AZURE_IOT_INVALID_PARAMETER Fail since item is not an integer or does not fit in `INT`.
+ */
+UINT nx_azure_iot_cbor_item_int32_get(NX_AZURE_IOT_CBOR_ITEM *item_ptr, INT *value_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* NX_AZURE_IOT_CBOR_H */
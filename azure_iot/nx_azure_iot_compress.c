@@ -0,0 +1,367 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+#include "nx_azure_iot_compress.h"
+
+/* Match length limits of deflate.  */
+#define NX_AZURE_IOT_COMPRESS_MATCH_MIN                   (3)
+#define NX_AZURE_IOT_COMPRESS_MATCH_MAX                   (258)
+
+/* Size of zlib header, preset dictionary id and Adler-32 trailer.  */
+#define NX_AZURE_IOT_COMPRESS_HEADER_SIZE                 (2)
+#define NX_AZURE_IOT_COMPRESS_DICTIONARY_ID_SIZE          (4)
+#define NX_AZURE_IOT_COMPRESS_TRAILER_SIZE                (4)
+
+typedef struct NX_AZURE_IOT_COMPRESS_WRITER_STRUCT
+{
+    UCHAR  *writer_buffer;
+    UINT    writer_size;
+    UINT    writer_length;
+    ULONG   writer_bits;
+    UINT    writer_bit_count;
+    UINT    writer_overflow;
+} NX_AZURE_IOT_COMPRESS_WRITER;
+
+static const USHORT _nx_azure_iot_compress_length_base[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const UCHAR _nx_azure_iot_compress_length_extra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const USHORT _nx_azure_iot_compress_distance_base[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const UCHAR _nx_azure_iot_compress_distance_extra[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static ULONG nx_azure_iot_compress_adler32(ULONG adler, const UCHAR *data_ptr, UINT data_size)
+{
+ULONG s1 = adler & 0xFFFF;
+ULONG s2 = (adler >> 16) & 0xFFFF;
+UINT block_size;
+
+    while (data_size)
+    {
+
+        /* 5552 is the largest block that cannot overflow 32 bits before modulo.  */
+        block_size = (data_size < 5552) ? data_size : 5552;
+        data_size -= block_size;
+        while (block_size--)
+        {
+            s1 += *data_ptr++;
+            s2 += s1;
+        }
+
+        s1 %= 65521;
+        s2 %= 65521;
+    }
+
+    return((s2 << 16) | s1);
+}
+
+static VOID nx_azure_iot_compress_bits_write(NX_AZURE_IOT_COMPRESS_WRITER *writer_ptr, ULONG value, UINT count)
+{
+
+    /* Deflate packs bits starting from least significant bit.  */
+    writer_ptr -> writer_bits |= value << writer_ptr -> writer_bit_count;
+    writer_ptr -> writer_bit_count += count;
+
+    while (writer_ptr -> writer_bit_count >= 8)
+    {
+        if (writer_ptr -> writer_length < writer_ptr -> writer_size)
+        {
+            writer_ptr -> writer_buffer[writer_ptr -> writer_length++] = (UCHAR)(writer_ptr -> writer_bits & 0xFF);
+        }
+        else
+        {
+            writer_ptr -> writer_overflow = NX_TRUE;
+        }
+
+        writer_ptr -> writer_bits >>= 8;
+        writer_ptr -> writer_bit_count -= 8;
+    }
+}
+
+static VOID nx_azure_iot_compress_code_write(NX_AZURE_IOT_COMPRESS_WRITER *writer_ptr, UINT code, UINT count)
+{
+UINT reversed = 0;
+UINT i;
+
+    /* Huffman codes are packed starting from most significant bit.  */
+    for (i = 0; i < count; i++)
+    {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+
+    nx_azure_iot_compress_bits_write(writer_ptr, reversed, count);
+}
+
+static VOID nx_azure_iot_compress_bytes_write(NX_AZURE_IOT_COMPRESS_WRITER *writer_ptr, ULONG value, UINT count)
+{
+
+    /* zlib header and trailer fields are byte aligned and in big endian.  */
+    while (count--)
+    {
+        nx_azure_iot_compress_bits_write(writer_ptr, (value >> (count << 3)) & 0xFF, 8);
+    }
+}
+
+static VOID nx_azure_iot_compress_literal_write(NX_AZURE_IOT_COMPRESS_WRITER *writer_ptr, UINT symbol)
+{
+
+    /* Fixed Huffman code of literal/length alphabet, RFC 1951 section 3.2.6.  */
+    if (symbol < 144)
+    {
+        nx_azure_iot_compress_code_write(writer_ptr, 0x30 + symbol, 8);
+    }
+    else if (symbol < 256)
+    {
+        nx_azure_iot_compress_code_write(writer_ptr, 0x190 + (symbol - 144), 9);
+    }
+    else if (symbol < 280)
+    {
+        nx_azure_iot_compress_code_write(writer_ptr, symbol - 256, 7);
+    }
+    else
+    {
+        nx_azure_iot_compress_code_write(writer_ptr, 0xC0 + (symbol - 280), 8);
+    }
+}
+
+static VOID nx_azure_iot_compress_match_write(NX_AZURE_IOT_COMPRESS_WRITER *writer_ptr,
+                                              UINT length, UINT distance)
+{
+UINT code = 0;
+
+    while ((code < 28) && (_nx_azure_iot_compress_length_base[code + 1] <= length))
+    {
+        code++;
+    }
+
+    nx_azure_iot_compress_literal_write(writer_ptr, 257 + code);
+    nx_azure_iot_compress_bits_write(writer_ptr, length - _nx_azure_iot_compress_length_base[code],
+                                     _nx_azure_iot_compress_length_extra[code]);
+
+    code = 0;
+    while ((code < 29) && (_nx_azure_iot_compress_distance_base[code + 1] <= distance))
+    {
+        code++;
+    }
+
+    nx_azure_iot_compress_code_write(writer_ptr, code, 5);
+    nx_azure_iot_compress_bits_write(writer_ptr, distance - _nx_azure_iot_compress_distance_base[code],
+                                     _nx_azure_iot_compress_distance_extra[code]);
+}
+
+static UCHAR nx_azure_iot_compress_byte_get(NX_AZURE_IOT_COMPRESS *compress_ptr, const UCHAR *data_ptr,
+                                            UINT position)
+{
+
+    /* Dictionary is placed right before data.  */
+    if (position < compress_ptr -> compress_dictionary_size)
+    {
+        return(compress_ptr -> compress_dictionary[position]);
+    }
+
+    return(data_ptr[position - compress_ptr -> compress_dictionary_size]);
+}
+
+static UINT nx_azure_iot_compress_hash(NX_AZURE_IOT_COMPRESS *compress_ptr, const UCHAR *data_ptr, UINT position)
+{
+ULONG value;
+
+    value = ((ULONG)nx_azure_iot_compress_byte_get(compress_ptr, data_ptr, position) << 16) |
+            ((ULONG)nx_azure_iot_compress_byte_get(compress_ptr, data_ptr, position + 1) << 8) |
+            (ULONG)nx_azure_iot_compress_byte_get(compress_ptr, data_ptr, position + 2);
+
+    return((UINT)(((value * 2654435761UL) & 0xFFFFFFFF) >> (32 - NX_AZURE_IOT_COMPRESS_HASH_BITS)));
+}
+
+UINT nx_azure_iot_compress_init(NX_AZURE_IOT_COMPRESS *compress_ptr, UCHAR *arena_ptr, UINT arena_size,
+                                const UCHAR *dictionary_ptr, UINT dictionary_size)
+{
+UINT alignment;
+
+    if ((compress_ptr == NX_NULL) || (arena_ptr == NX_NULL) ||
+        ((dictionary_ptr == NX_NULL) && (dictionary_size != 0)))
+    {
+        LogError("IoT compress init fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Hash table is placed at start of arena, aligned for UINT access.  */
+    alignment = (UINT)((sizeof(UINT) - ((ULONG)arena_ptr % sizeof(UINT))) % sizeof(UINT));
+    if (arena_size <= (alignment + NX_AZURE_IOT_COMPRESS_HASH_TABLE_SIZE + NX_AZURE_IOT_COMPRESS_HEADER_SIZE +
+                       NX_AZURE_IOT_COMPRESS_DICTIONARY_ID_SIZE + NX_AZURE_IOT_COMPRESS_TRAILER_SIZE))
+    {
+        LogError("IoT compress init fail: ARENA TOO SMALL");
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    /* Only the part of dictionary within window can be referenced.  */
+    if (dictionary_size > NX_AZURE_IOT_COMPRESS_WINDOW_SIZE)
+    {
+        dictionary_ptr += dictionary_size - NX_AZURE_IOT_COMPRESS_WINDOW_SIZE;
+        dictionary_size = NX_AZURE_IOT_COMPRESS_WINDOW_SIZE;
+    }
+
+    memset(compress_ptr, 0, sizeof(NX_AZURE_IOT_COMPRESS));
+    compress_ptr -> compress_hash_table = (UINT *)(arena_ptr + alignment);
+    compress_ptr -> compress_output_buffer = arena_ptr + alignment + NX_AZURE_IOT_COMPRESS_HASH_TABLE_SIZE;
+    compress_ptr -> compress_output_buffer_size = arena_size - alignment - NX_AZURE_IOT_COMPRESS_HASH_TABLE_SIZE;
+    compress_ptr -> compress_dictionary = dictionary_ptr;
+    compress_ptr -> compress_dictionary_size = dictionary_size;
+    if (dictionary_size)
+    {
+        compress_ptr -> compress_dictionary_id = nx_azure_iot_compress_adler32(1, dictionary_ptr, dictionary_size);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_compress(NX_AZURE_IOT_COMPRESS *compress_ptr, const UCHAR *data_ptr, UINT data_size,
+                           UCHAR **output_pptr, UINT *output_size_ptr)
+{
+NX_AZURE_IOT_COMPRESS_WRITER writer;
+UINT *hash_table = compress_ptr -> compress_hash_table;
+UINT position;
+UINT end;
+UINT hash;
+UINT candidate;
+UINT length;
+UINT limit;
+UINT header;
+ULONG adler;
+
+    if ((data_ptr == NX_NULL) || (data_size == 0))
+    {
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Output is only useful if smaller than data.  */
+    writer.writer_buffer = compress_ptr -> compress_output_buffer;
+    writer.writer_size = (compress_ptr -> compress_output_buffer_size < data_size) ?
+                         compress_ptr -> compress_output_buffer_size : (data_size - 1);
+    writer.writer_length = 0;
+    writer.writer_bits = 0;
+    writer.writer_bit_count = 0;
+    writer.writer_overflow = NX_FALSE;
+
+    /* zlib header with 32K window and fastest level, FCHECK makes header a multiple of 31.  */
+    header = 0x7800;
+    if (compress_ptr -> compress_dictionary_size)
+    {
+        header |= 0x20;
+    }
+    header += (31 - (header % 31)) % 31;
+    nx_azure_iot_compress_bytes_write(&writer, header, NX_AZURE_IOT_COMPRESS_HEADER_SIZE);
+    if (compress_ptr -> compress_dictionary_size)
+    {
+        nx_azure_iot_compress_bytes_write(&writer, compress_ptr -> compress_dictionary_id,
+                                          NX_AZURE_IOT_COMPRESS_DICTIONARY_ID_SIZE);
+    }
+
+    /* Single final block with fixed Huffman codes.  */
+    nx_azure_iot_compress_bits_write(&writer, 1, 1);
+    nx_azure_iot_compress_bits_write(&writer, 1, 2);
+
+    /* Entries hold position plus one, zero is empty.  */
+    memset(hash_table, 0, NX_AZURE_IOT_COMPRESS_HASH_TABLE_SIZE);
+    end = compress_ptr -> compress_dictionary_size + data_size;
+    for (position = 0;
+         (position + NX_AZURE_IOT_COMPRESS_MATCH_MIN) <= compress_ptr -> compress_dictionary_size;
+         position++)
+    {
+        hash_table[nx_azure_iot_compress_hash(compress_ptr, data_ptr, position)] = position + 1;
+    }
+
+    position = compress_ptr -> compress_dictionary_size;
+    while ((position < end) && !writer.writer_overflow)
+    {
+        length = 0;
+        if ((position + NX_AZURE_IOT_COMPRESS_MATCH_MIN) <= end)
+        {
+            hash = nx_azure_iot_compress_hash(compress_ptr, data_ptr, position);
+            candidate = hash_table[hash];
+            hash_table[hash] = position + 1;
+
+            if (candidate && ((position - (candidate - 1)) <= NX_AZURE_IOT_COMPRESS_WINDOW_SIZE))
+            {
+                candidate--;
+                limit = end - position;
+                if (limit > NX_AZURE_IOT_COMPRESS_MATCH_MAX)
+                {
+                    limit = NX_AZURE_IOT_COMPRESS_MATCH_MAX;
+                }
+
+                while ((length < limit) &&
+                       (nx_azure_iot_compress_byte_get(compress_ptr, data_ptr, candidate + length) ==
+                        data_ptr[position + length - compress_ptr -> compress_dictionary_size]))
+                {
+                    length++;
+                }
+            }
+        }
+
+        if (length >= NX_AZURE_IOT_COMPRESS_MATCH_MIN)
+        {
+            nx_azure_iot_compress_match_write(&writer, length, position - candidate);
+
+            /* Index positions inside match so later data can refer to them.  */
+            for (position++, length--; length; position++, length--)
+            {
+                if ((position + NX_AZURE_IOT_COMPRESS_MATCH_MIN) <= end)
+                {
+                    hash_table[nx_azure_iot_compress_hash(compress_ptr, data_ptr, position)] = position + 1;
+                }
+            }
+        }
+        else
+        {
+            nx_azure_iot_compress_literal_write(&writer,
+                                                data_ptr[position - compress_ptr -> compress_dictionary_size]);
+            position++;
+        }
+    }
+
+    /* End of block, pad to byte boundary, then Adler-32 of data.  */
+    nx_azure_iot_compress_literal_write(&writer, 256);
+    nx_azure_iot_compress_bits_write(&writer, 0, (8 - writer.writer_bit_count) & 7);
+    adler = nx_azure_iot_compress_adler32(1, data_ptr, data_size);
+    nx_azure_iot_compress_bytes_write(&writer, adler, NX_AZURE_IOT_COMPRESS_TRAILER_SIZE);
+
+    if (writer.writer_overflow)
+    {
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    compress_ptr -> compress_input_bytes += data_size;
+    compress_ptr -> compress_output_bytes += writer.writer_length;
+    *output_pptr = writer.writer_buffer;
+    *output_size_ptr = writer.writer_length;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
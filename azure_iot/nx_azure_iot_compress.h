@@ -0,0 +1,71 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+/**
+ * @file nx_azure_iot_compress.h
+ *
+ * @brief Definition for the Azure IoT payload compression.
+ * @remark Payloads are encoded as a zlib stream (RFC 1950) holding a single deflate block (RFC 1951)
+ * with fixed Huffman codes. Matches are found through a hash table of last positions, so working
+ * memory is the hash table plus the output buffer, both carved from a caller supplied arena.
+ * An optional preset dictionary primes the window, and its Adler-32 is carried in the zlib header
+ * as required for inflateSetDictionary().
+ *
+ */
+
+#ifndef NX_AZURE_IOT_COMPRESS_H
+#define NX_AZURE_IOT_COMPRESS_H
+
+#ifdef __cplusplus
+extern   "C" {
+#endif
+
+#include "nx_azure_iot.h"
+
+/* Set the number of bits of match hash. Hash table takes 4 bytes per entry from arena.  */
+#ifndef NX_AZURE_IOT_COMPRESS_HASH_BITS
+#define NX_AZURE_IOT_COMPRESS_HASH_BITS                   (10)
+#endif /* NX_AZURE_IOT_COMPRESS_HASH_BITS */
+
+/* Size of hash table in arena.  */
+#define NX_AZURE_IOT_COMPRESS_HASH_TABLE_SIZE             ((1 << NX_AZURE_IOT_COMPRESS_HASH_BITS) * sizeof(UINT))
+
+/* Deflate window size. Only the last part of dictionary within window is used.  */
+#define NX_AZURE_IOT_COMPRESS_WINDOW_SIZE                 (32768)
+
+/**
+ * @brief Azure IoT compress struct
+ *
+ */
+typedef struct NX_AZURE_IOT_COMPRESS_STRUCT
+{
+    UINT                               *compress_hash_table;
+    UCHAR                              *compress_output_buffer;
+    UINT                                compress_output_buffer_size;
+    const UCHAR                        *compress_dictionary;
+    UINT                                compress_dictionary_size;
+    ULONG                               compress_dictionary_id;     /* Adler-32 of dictionary. */
+    ULONG                               compress_input_bytes;
+    ULONG                               compress_output_bytes;
+} NX_AZURE_IOT_COMPRESS;
+
+/* Internal APIs. */
+UINT nx_azure_iot_compress_init(NX_AZURE_IOT_COMPRESS *compress_ptr, UCHAR *arena_ptr, UINT arena_size,
+                                const UCHAR *dictionary_ptr, UINT dictionary_size);
+UINT nx_azure_iot_compress(NX_AZURE_IOT_COMPRESS *compress_ptr, const UCHAR *data_ptr, UINT data_size,
+                           UCHAR **output_pptr, UINT *output_size_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* NX_AZURE_IOT_COMPRESS_H */
@@ -0,0 +1,143 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+#include "nx_azure_iot_filter.h"
+
+UINT nx_azure_iot_filter_create(NX_AZURE_IOT_FILTER *filter_ptr, NX_AZURE_IOT_FILTER_SIGNAL *signals,
+                                UINT signal_count)
+{
+    if ((filter_ptr == NX_NULL) || (signals == NX_NULL) || (signal_count == 0))
+    {
+        LogError("IoT filter create fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    memset(filter_ptr, 0, sizeof(NX_AZURE_IOT_FILTER));
+    memset(signals, 0, sizeof(NX_AZURE_IOT_FILTER_SIGNAL) * signal_count);
+    filter_ptr -> filter_signals = signals;
+    filter_ptr -> filter_signal_count = signal_count;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_filter_signal_register(NX_AZURE_IOT_FILTER *filter_ptr, double absolute_deadband,
+                                         double relative_deadband, ULONG heartbeat, UINT *signal_id_ptr)
+{
+NX_AZURE_IOT_FILTER_SIGNAL *signal_ptr;
+
+    if ((filter_ptr == NX_NULL) || (signal_id_ptr == NX_NULL))
+    {
+        LogError("IoT filter signal register fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if ((absolute_deadband < 0) || (relative_deadband < 0))
+    {
+        LogError("IoT filter signal register fail: INVALID DEADBAND");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (filter_ptr -> filter_signal_used >= filter_ptr -> filter_signal_count)
+    {
+        LogError("IoT filter signal register fail: TABLE FULL");
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    signal_ptr = &(filter_ptr -> filter_signals[filter_ptr -> filter_signal_used]);
+    signal_ptr -> signal_absolute_deadband = absolute_deadband;
+    signal_ptr -> signal_relative_deadband = relative_deadband;
+    signal_ptr -> signal_heartbeat = heartbeat;
+    signal_ptr -> signal_last_valid = NX_FALSE;
+    *signal_id_ptr = filter_ptr -> filter_signal_used++;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_filter_signal_reset(NX_AZURE_IOT_FILTER *filter_ptr, UINT signal_id)
+{
+    if ((filter_ptr == NX_NULL) || (signal_id >= filter_ptr -> filter_signal_used))
+    {
+        LogError("IoT filter signal reset fail: INVALID PARAMETER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    filter_ptr -> filter_signals[signal_id].signal_last_valid = NX_FALSE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_filter_sample_check(NX_AZURE_IOT_FILTER *filter_ptr, UINT signal_id, double value,
+                                      UINT *pass_ptr)
+{
+NX_AZURE_IOT_FILTER_SIGNAL *signal_ptr;
+ULONG current_time;
+double delta;
+double magnitude;
+UINT pass;
+
+    if ((filter_ptr == NX_NULL) || (pass_ptr == NX_NULL) || (signal_id >= filter_ptr -> filter_signal_used))
+    {
+        LogError("IoT filter sample check fail: INVALID PARAMETER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    signal_ptr = &(filter_ptr -> filter_signals[signal_id]);
+    current_time = tx_time_get();
+
+    if (!signal_ptr -> signal_last_valid)
+    {
+        pass = NX_TRUE;
+    }
+    else if (signal_ptr -> signal_heartbeat &&
+             ((current_time - signal_ptr -> signal_last_time) >= signal_ptr -> signal_heartbeat))
+    {
+        pass = NX_TRUE;
+    }
+    else
+    {
+        delta = value - signal_ptr -> signal_last_value;
+        delta = (delta < 0) ? -delta : delta;
+        magnitude = (signal_ptr -> signal_last_value < 0) ? -signal_ptr -> signal_last_value :
+                                                             signal_ptr -> signal_last_value;
+
+        if ((signal_ptr -> signal_absolute_deadband == 0) && (signal_ptr -> signal_relative_deadband == 0))
+        {
+
+            /* Change only. NaN never compares equal, so it always passes.  */
+            pass = (value != signal_ptr -> signal_last_value);
+        }
+        else
+        {
+            pass = ((signal_ptr -> signal_absolute_deadband > 0) &&
+                    (delta > signal_ptr -> signal_absolute_deadband)) ||
+                   ((signal_ptr -> signal_relative_deadband > 0) &&
+                    (delta > (signal_ptr -> signal_relative_deadband * magnitude)));
+        }
+    }
+
+    if (pass)
+    {
+        signal_ptr -> signal_last_value = value;
+        signal_ptr -> signal_last_time = current_time;
+        signal_ptr -> signal_last_valid = NX_TRUE;
+        filter_ptr -> filter_passed_count++;
+    }
+    else
+    {
+        filter_ptr -> filter_dropped_count++;
+    }
+
+    *pass_ptr = pass;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
@@ -0,0 +1,120 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+/**
+ * @file nx_azure_iot_filter.h
+ *
+ * @brief Definition for the Azure IoT telemetry deadband filter.
+ * @remark The filter decides whether a sample of a signal is worth sending, before any packet is
+ * allocated. State of each signal lives in a fixed size table supplied by the caller and is indexed
+ * by signal id, so checking a sample takes constant time and never allocates.
+ *
+ */
+
+#ifndef NX_AZURE_IOT_FILTER_H
+#define NX_AZURE_IOT_FILTER_H
+
+#ifdef __cplusplus
+extern   "C" {
+#endif
+
+#include "nx_azure_iot.h"
+
+/**
+ * @brief Azure IoT filter signal struct
+ *
+ */
+typedef struct NX_AZURE_IOT_FILTER_SIGNAL_STRUCT
+{
+    double                              signal_last_value;          /* Last value passed. */
+    double                              signal_absolute_deadband;
+    double                              signal_relative_deadband;   /* Fraction of last value passed. */
+    ULONG                               signal_heartbeat;           /* Ticks. Zero if disabled. */
+    ULONG                               signal_last_time;
+    UINT                                signal_last_valid;
+} NX_AZURE_IOT_FILTER_SIGNAL;
+
+/**
+ * @brief Azure IoT filter struct
+ *
+ */
+typedef struct NX_AZURE_IOT_FILTER_STRUCT
+{
+    NX_AZURE_IOT_FILTER_SIGNAL         *filter_signals;
+    UINT                                filter_signal_count;
+    UINT                                filter_signal_used;
+    ULONG                               filter_passed_count;
+    ULONG                               filter_dropped_count;
+} NX_AZURE_IOT_FILTER;
+
+/**
+ * @brief Create telemetry filter
+ *
+ * @param[in] filter_ptr A pointer to a #NX_AZURE_IOT_FILTER.
+ * @param[in] signals A pointer to an array of #NX_AZURE_IOT_FILTER_SIGNAL.
+ * @param[in] signal_count Number of entries in `signals`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if filter is created.
+ */
+UINT nx_azure_iot_filter_create(NX_AZURE_IOT_FILTER *filter_ptr, NX_AZURE_IOT_FILTER_SIGNAL *signals,
+                                UINT signal_count);
+
+/**
+ * @brief Register signal
+ * @details This routine takes the next free entry of the table. A sample passes if the signal has no
+ *          previous sample, if `heartbeat` ticks elapsed since the last sample passed, or if it differs from
+ *          the last sample passed by more than `absolute_deadband` or by more than `relative_deadband` times
+ *          the magnitude of that sample. With both deadbands zero, any change passes.
+ *
+ * @param[in] filter_ptr A pointer to a #NX_AZURE_IOT_FILTER.
+ * @param[in] absolute_deadband Absolute deadband. Zero if not used.
+ * @param[in] relative_deadband Relative deadband, for example 0.01 for 1%. Zero if not used.
+ * @param[in] heartbeat Maximum ticks without a sample passed. Zero if not used.
+ * @param[out] signal_id_ptr Id of registered signal.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if signal is registered.
+ *   @retval #NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE Fail to register signal due to table full.
+ */
+UINT nx_azure_iot_filter_signal_register(NX_AZURE_IOT_FILTER *filter_ptr, double absolute_deadband,
+                                         double relative_deadband, ULONG heartbeat, UINT *signal_id_ptr);
+
+/**
+ * @brief Reset signal
+ * @details This routine forgets the last sample passed, so the next sample passes.
+ *
+ * @param[in] filter_ptr A pointer to a #NX_AZURE_IOT_FILTER.
+ * @param[in] signal_id Id of signal.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if signal is reset.
+ */
+UINT nx_azure_iot_filter_signal_reset(NX_AZURE_IOT_FILTER *filter_ptr, UINT signal_id);
+
+/**
+ * @brief Check sample
+ * @details This routine decides whether `value` should be sent, and records it as the last sample
+ *          passed if so. A signal must not be checked from more than one thread at the same time.
+ *
+ * @param[in] filter_ptr A pointer to a #NX_AZURE_IOT_FILTER.
+ * @param[in] signal_id Id of signal.
+ * @param[in] value Sample value.
+ * @param[out] pass_ptr `NX_TRUE` if sample should be sent, `NX_FALSE` if it is dropped.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if sample is checked.
+ */
+UINT nx_azure_iot_filter_sample_check(NX_AZURE_IOT_FILTER *filter_ptr, UINT signal_id, double value,
+                                      UINT *pass_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* NX_AZURE_IOT_FILTER_H */
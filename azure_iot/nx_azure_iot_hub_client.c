@@ -17,6 +17,22 @@
 
 #define NX_AZURE_IOT_HUB_CLIENT_EMPTY_JSON      "{}"
 
+/* Room left after topic for packet id when payload is written in place.  */
+#define NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE            2
+
+/* States of NX_AZURE_IOT_HUB_CLIENT_PAYLOAD.  */
+#define NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_RESERVED            1
+#define NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_COMMITTED           2
+
+/* Home slot of request id in reported properties table. Request ids are odd and sequential.  */
+#define NX_AZURE_IOT_HUB_CLIENT_RID_SLOT(id)                (((id) >> 1) & (NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE - 1))
+
+/* Prefixes of received topics. Those under "$iothub/" differ at the byte right after it.  */
+#define NX_AZURE_IOT_HUB_CLIENT_TOPIC_IOTHUB_PREFIX         "$iothub/"
+#define NX_AZURE_IOT_HUB_CLIENT_TOPIC_METHODS_PREFIX        "$iothub/methods/POST/"
+#define NX_AZURE_IOT_HUB_CLIENT_TOPIC_TWIN_PREFIX           "$iothub/twin/"
+#define NX_AZURE_IOT_HUB_CLIENT_TOPIC_DEVICES_PREFIX        "devices/"
+
 #ifndef NX_AZURE_IOT_HUB_CLIENT_USER_AGENT
 
 /* useragent e.g: DeviceClientType=c%2F1.0.0-preview.1%20%28nx%206.0%3Bazrtos%206.0%29 */
@@ -29,7 +45,29 @@
                                                 NX_AZURE_IOT_HUB_CLIENT_TO_STR(THREADX_MINOR_VERSION) "%29"
 #endif /* NX_AZURE_IOT_HUB_CLIENT_USER_AGENT */
 
+/* Header of each record in telemetry store. Topic and payload follow.  */
+typedef struct NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD_STRUCT
+{
+    UINT    record_topic_length;
+    UINT    record_payload_length;
+    UINT    record_qos;
+} NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD;
+
+/* Size of record header in spool: topic length, payload length and QoS, stored in little endian.  */
+#define NX_AZURE_IOT_HUB_CLIENT_SPOOL_RECORD_HEADER_SIZE  (9)
+
+/* Header of each record in receive ring. Topic and payload follow.  */
+typedef struct NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RECORD_STRUCT
+{
+    UINT    record_topic_length;
+    UINT    record_payload_length;
+    ULONG   record_truncated_length;
+} NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RECORD;
+
 static VOID nx_azure_iot_hub_client_received_message_cleanup(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *message);
+static NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *nx_azure_iot_hub_client_receive_message_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                                          UINT message_type);
+static VOID nx_azure_iot_hub_client_receive_resume(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
 static UINT nx_azure_iot_hub_client_cloud_message_sub_unsub(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
                                                             UINT is_subscribe);
 static UINT nx_azure_iot_hub_client_process_publish_packet(UCHAR *start_ptr,
@@ -51,13 +89,71 @@ extern UINT _nxd_mqtt_process_publish_packet(NX_PACKET *packet_ptr, ULONG *topic
 static VOID nx_azure_iot_hub_client_mqtt_connect_notify(struct NXD_MQTT_CLIENT_STRUCT *client_ptr,
                                                         UINT status, VOID *context);
 static VOID nx_azure_iot_hub_client_mqtt_disconnect_notify(NXD_MQTT_CLIENT *client_ptr);
+static UINT nx_azure_iot_hub_client_mqtt_packet_receive_notify(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
+                                                              VOID *context);
+static VOID nx_azure_iot_hub_client_telemetry_ack_process(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                          USHORT packet_id);
 VOID nx_azure_iot_hub_client_event_process(NX_AZURE_IOT *nx_azure_iot_ptr,
                                            ULONG common_events, ULONG module_own_events);
+static UINT nx_azure_iot_hub_client_thread_enqueue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                   NX_AZURE_IOT_THREAD *thread_list_ptr);
 static VOID nx_azure_iot_hub_client_thread_dequeue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
                                                    NX_AZURE_IOT_THREAD *thread_list_ptr);
+static VOID nx_azure_iot_hub_client_telemetry_inflight_process(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                               UINT status);
+static VOID nx_azure_iot_hub_client_telemetry_count_update(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                           UINT qos, UINT count);
+static UINT nx_azure_iot_hub_client_telemetry_store_put(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                        UINT data_size, UINT qos, UINT *stored_ptr);
+static VOID nx_azure_iot_hub_client_telemetry_store_drain(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+static UINT nx_azure_iot_hub_client_telemetry_spool_put(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                        UINT data_size, UINT qos, UINT *stored_ptr);
+static VOID nx_azure_iot_hub_client_telemetry_spool_replay(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+static VOID nx_azure_iot_hub_client_telemetry_spool_reset(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+static UINT nx_azure_iot_hub_client_telemetry_prepare(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                      UCHAR *telemetry_data, UINT data_size, UINT qos,
+                                                      UCHAR *packet_id, UINT *stored_ptr, UINT wait_option);
+static UINT nx_azure_iot_hub_client_rate_limit_acquire(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT limit_class,
+                                                       UINT count, UINT wait_option);
+static UINT nx_azure_iot_hub_client_telemetry_token_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT wait_option);
+static UINT nx_azure_iot_hub_client_telemetry_send_internal(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                            NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                            UINT data_size, UINT qos, UINT priority,
+                                                            UINT wait_option);
+static UINT nx_azure_iot_hub_client_publish(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                            NX_PACKET *packet_ptr, UINT topic_len, UCHAR *packet_id,
+                                            UINT qos, UINT wait_option);
+static UINT nx_azure_iot_hub_client_publish_packet(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                                   NX_PACKET *packet_ptr, UCHAR *packet_id, UINT qos,
+                                                   UINT wait_option);
+static UINT nx_azure_iot_hub_client_publish_enqueue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                                    NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY *new_entry_ptr,
+                                                    UINT wait_option);
+static VOID nx_azure_iot_hub_client_publish_schedule(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+static UINT nx_azure_iot_hub_client_stream_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                const UCHAR *data_ptr, UINT data_size, UINT wait_option);
+static VOID nx_azure_iot_hub_client_publish_flush(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+static VOID nx_azure_iot_hub_client_packet_chain_link(NX_PACKET *packet_ptr, NX_PACKET *payload_packet_ptr);
+static UINT nx_azure_iot_hub_client_json_publish(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                                 UCHAR *topic, UINT topic_length, NX_PACKET **json_packet_pptr,
+                                                 UINT wait_option);
+static UINT nx_azure_iot_hub_client_device_twin_reported_properties_publish(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                            UCHAR *message_buffer, UINT message_length,
+                                                                            NX_PACKET **json_packet_pptr,
+                                                                            UINT *request_id_ptr,
+                                                                            UINT *response_status_ptr,
+                                                                            UINT wait_option);
+static UINT nx_azure_iot_hub_client_direct_method_response_publish(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                   UINT status_code, VOID *context_ptr,
+                                                                   USHORT context_length, UCHAR *payload,
+                                                                   UINT payload_length, NX_PACKET **json_packet_pptr,
+                                                                   UINT wait_option);
 static UINT nx_azure_iot_hub_client_sas_token_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
                                                   ULONG expiry_time_secs, UCHAR *key, UINT key_len,
                                                   UCHAR *sas_buffer, UINT sas_buffer_len, UINT *sas_length);
+static UINT nx_azure_iot_hub_client_name_hash(const UCHAR *name, UINT name_length);
 
 UINT nx_azure_iot_hub_client_initialize(NX_AZURE_IOT_HUB_CLIENT* hub_client_ptr,
                                         NX_AZURE_IOT *nx_azure_iot_ptr,
@@ -87,6 +183,11 @@ az_result core_result;
     memset(hub_client_ptr, 0, sizeof(NX_AZURE_IOT_HUB_CLIENT));
 
     hub_client_ptr -> nx_azure_iot_ptr = nx_azure_iot_ptr;
+    hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_window = NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT;
+    hub_client_ptr -> nx_azure_iot_hub_client_c2d_message.message_count_max = NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DEPTH;
+    hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message.message_count_max = NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DEPTH;
+    hub_client_ptr -> nx_azure_iot_hub_client_device_twin_desired_properties_message.message_count_max = NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DEPTH;
+    hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message.message_count_max = NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DEPTH;
     hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_crypto_array = crypto_array;
     hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_crypto_array_size = crypto_array_size;
     hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_cipher_map = cipher_map;
@@ -131,6 +232,27 @@ az_result core_result;
         return(status);
     }
 
+    /* Compression arena has its own mutex, so the cloud mutex is not held while packets are appended.  */
+    status = tx_mutex_create(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex),
+                             "nx_azure_iot_hub_client_compress", TX_INHERIT);
+    if (status)
+    {
+        LogError("IoTHub client create fail: MUTEX CREATE FAIL: 0x%02x", status);
+        nxd_mqtt_client_delete(&(resource_ptr -> resource_mqtt));
+        return(status);
+    }
+
+    /* Senders wait on these events for room in publish queues.  */
+    status = tx_event_flags_create(&(hub_client_ptr -> nx_azure_iot_hub_client_publish_events),
+                                   "nx_azure_iot_hub_client_publish");
+    if (status)
+    {
+        LogError("IoTHub client create fail: EVENT FLAGS CREATE FAIL: 0x%02x", status);
+        tx_mutex_delete(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex));
+        nxd_mqtt_client_delete(&(resource_ptr -> resource_mqtt));
+        return(status);
+    }
+
     /* Obtain the mutex.   */
     tx_mutex_get(nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
 
@@ -348,6 +470,10 @@ az_result       core_result;
         mqtt_client_ptr -> nxd_mqtt_connect_context = hub_client_ptr;
     }
 
+    /* Set packet receive notify to complete telemetry on PUBACK.  */
+    mqtt_client_ptr -> nxd_mqtt_packet_receive_notify = nx_azure_iot_hub_client_mqtt_packet_receive_notify;
+    mqtt_client_ptr -> nxd_mqtt_packet_receive_context = hub_client_ptr;
+
     /* Save the resource buffer.  */
     resource_ptr -> resource_mqtt_buffer_context = buffer_context;
     resource_ptr -> resource_mqtt_buffer_size = buffer_size;
@@ -430,6 +556,14 @@ NX_AZURE_IOT_HUB_CLIENT *iot_hub_client = (NX_AZURE_IOT_HUB_CLIENT*)context;
     if (status == NXD_MQTT_SUCCESS)
     {
         iot_hub_client -> nx_azure_iot_hub_client_state = NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED;
+
+        /* Send stored telemetry from cloud helper thread.  */
+        if (iot_hub_client -> nx_azure_iot_hub_client_telemetry_store.store_used ||
+            nx_azure_iot_spool_pending(iot_hub_client -> nx_azure_iot_hub_client_telemetry_spool_ptr))
+        {
+            nx_cloud_module_event_set(&(iot_hub_client -> nx_azure_iot_ptr -> nx_azure_iot_cloud_module),
+                                      NX_AZURE_IOT_HUB_CLIENT_CONNECT_EVENT);
+        }
     }
     else
     {
@@ -458,6 +592,16 @@ NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr = NX_NULL;
         hub_client_ptr = (NX_AZURE_IOT_HUB_CLIENT *)resource -> resource_data_ptr;
     }
 
+    /* Stop direct sends, store drain and scheduler, then complete asynchronous telemetry and replay
+       unacknowledged spool records on next connection.  */
+    if (hub_client_ptr)
+    {
+        hub_client_ptr -> nx_azure_iot_hub_client_state = NX_AZURE_IOT_HUB_CLIENT_STATUS_NOT_CONNECTED;
+        nx_azure_iot_hub_client_telemetry_inflight_process(hub_client_ptr, NX_AZURE_IOT_DISCONNECTED);
+        nx_azure_iot_hub_client_telemetry_spool_reset(hub_client_ptr);
+        nx_azure_iot_hub_client_publish_flush(hub_client_ptr);
+    }
+
     /* Call connection notify if it is set.  */
     if (hub_client_ptr && hub_client_ptr -> nx_azure_iot_hub_client_connection_status_callback)
     {
@@ -469,20 +613,160 @@ NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr = NX_NULL;
 VOID nx_azure_iot_hub_client_event_process(NX_AZURE_IOT *nx_azure_iot_ptr,
                                            ULONG common_events, ULONG module_own_events)
 {
+NX_AZURE_IOT_RESOURCE *resource_ptr;
+NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr;
+
+    if (((common_events & NX_CLOUD_COMMON_PERIODIC_EVENT) == 0) &&
+        ((module_own_events & (NX_AZURE_IOT_HUB_CLIENT_CONNECT_EVENT | NX_AZURE_IOT_HUB_CLIENT_PUBLISH_EVENT)) == 0))
+    {
+        return;
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    /* Loop to check IoT Hub Client.  */
+    for (resource_ptr = nx_azure_iot_ptr -> nx_azure_iot_resource_list_header;
+         resource_ptr; resource_ptr = resource_ptr -> resource_next)
+    {
+        if (resource_ptr -> resource_type != NX_AZURE_IOT_RESOURCE_IOT_HUB)
+        {
+            continue;
+        }
+
+        hub_client_ptr = (NX_AZURE_IOT_HUB_CLIENT *)resource_ptr -> resource_data_ptr;
+
+        /* Check acknowledgement of asynchronous telemetry.  */
+        if (common_events & NX_CLOUD_COMMON_PERIODIC_EVENT)
+        {
+            nx_azure_iot_hub_client_telemetry_inflight_process(hub_client_ptr, NX_AZURE_IOT_SUCCESS);
+        }
+
+        /* Send queued messages first, by priority.  */
+        nx_azure_iot_hub_client_publish_schedule(hub_client_ptr);
+
+        /* Send stored telemetry. Periodic event retries what could not be sent before.  */
+        nx_azure_iot_hub_client_telemetry_store_drain(hub_client_ptr);
+        nx_azure_iot_hub_client_telemetry_spool_replay(hub_client_ptr);
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+}
+
+static UINT nx_azure_iot_hub_client_mqtt_packet_receive_notify(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
+                                                              VOID *context)
+{
+NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr = (NX_AZURE_IOT_HUB_CLIENT *)context;
+UCHAR fixed_header[4];
+ULONG bytes_copied;
+
+    NX_PARAMETER_NOT_USED(client_ptr);
+
+    /* This function is protected by MQTT mutex.
+       PUBACK is control byte, remaining length of 2 and packet id.  */
+    if (nx_packet_data_extract_offset(packet_ptr, 0, fixed_header, sizeof(fixed_header), &bytes_copied) ||
+        (bytes_copied != sizeof(fixed_header)) ||
+        ((fixed_header[0] >> 4) != MQTT_CONTROL_PACKET_TYPE_PUBACK))
+    {
+        return(NX_FALSE);
+    }
+
+    nx_azure_iot_hub_client_telemetry_ack_process(hub_client_ptr,
+                                                  (USHORT)((fixed_header[2] << 8) | fixed_header[3]));
+
+    /* Packet is not consumed, MQTT still releases the message from its transmit queue.  */
+    return(NX_FALSE);
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_ack_process(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                          USHORT packet_id)
+{
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT *inflight_ptr;
+UINT index;
+
+    /* This function must be called with mutex held.  */
+    for (index = 0; index < hub_client_ptr -> nx_azure_iot_hub_client_spool_pending_count; index++)
+    {
+        if (hub_client_ptr -> nx_azure_iot_hub_client_spool_pending[index].pending_packet_id == packet_id)
+        {
+            hub_client_ptr -> nx_azure_iot_hub_client_spool_pending[index].pending_acked = NX_TRUE;
+            return;
+        }
+    }
+
+    for (index = 0; index < NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT; index++)
+    {
+        inflight_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight[index]);
+        if (inflight_ptr -> inflight_packet_id != packet_id)
+        {
+            continue;
+        }
+
+        if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_ack_callback)
+        {
+            hub_client_ptr -> nx_azure_iot_hub_client_telemetry_ack_callback(hub_client_ptr,
+                                                                             packet_id,
+                                                                             NX_AZURE_IOT_SUCCESS,
+                                                                             hub_client_ptr -> nx_azure_iot_hub_client_telemetry_ack_callback_args);
+        }
+
+        inflight_ptr -> inflight_packet_id = 0;
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count--;
+        return;
+    }
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_inflight_process(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                               UINT status)
+{
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT *inflight_ptr;
+UINT index;
+UINT complete_status;
+ULONG current_time = tx_time_get();
+
+    /* This function must be called with mutex held.
+       Acknowledged messages are completed on PUBACK, what is left has timed out or is aborted.  */
+    for (index = 0; index < NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT; index++)
+    {
+        inflight_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight[index]);
+        if (inflight_ptr -> inflight_packet_id == 0)
+        {
+            continue;
+        }
 
-    NX_PARAMETER_NOT_USED(nx_azure_iot_ptr);
+        if (status != NX_AZURE_IOT_SUCCESS)
+        {
+            complete_status = status;
+        }
+        else if ((current_time - inflight_ptr -> inflight_start_time) >= NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_ACK_TIMEOUT)
+        {
+            complete_status = NX_AZURE_IOT_TIMEOUT;
+        }
+        else
+        {
+            continue;
+        }
 
-    /* Process common events.  */
-    NX_PARAMETER_NOT_USED(common_events);
+        if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_ack_callback)
+        {
+            hub_client_ptr -> nx_azure_iot_hub_client_telemetry_ack_callback(hub_client_ptr,
+                                                                             inflight_ptr -> inflight_packet_id,
+                                                                             complete_status,
+                                                                             hub_client_ptr -> nx_azure_iot_hub_client_telemetry_ack_callback_args);
+        }
 
-    /* Process module own events.  */
-    NX_PARAMETER_NOT_USED(module_own_events);
+        inflight_ptr -> inflight_packet_id = 0;
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count--;
+    }
 }
 
 UINT nx_azure_iot_hub_client_disconnect(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
 {
 UINT status;
+UINT index;
 NX_AZURE_IOT_THREAD *thread_list_ptr;
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message[4];
 
 
     /* Check for invalid input pointers.  */
@@ -503,6 +787,8 @@ NX_AZURE_IOT_THREAD *thread_list_ptr;
     /* Obtain the mutex.  */
     tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
 
+    hub_client_ptr -> nx_azure_iot_hub_client_state = NX_AZURE_IOT_HUB_CLIENT_STATUS_NOT_CONNECTED;
+
     /* Release the mqtt connection resource.  */
     if (hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt_buffer_context)
     {
@@ -510,14 +796,34 @@ NX_AZURE_IOT_THREAD *thread_list_ptr;
         hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt_buffer_context = NX_NULL;
     }
 
-    /* Wakeup all suspend threads.  */
-    for (thread_list_ptr = hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended;
-         thread_list_ptr;
-         thread_list_ptr = thread_list_ptr -> thread_next)
+    /* Wakeup all suspend threads. Each removes itself from wait queue.  */
+    receive_message[0] = &(hub_client_ptr -> nx_azure_iot_hub_client_c2d_message);
+    receive_message[1] = &(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message);
+    receive_message[2] = &(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_desired_properties_message);
+    receive_message[3] = &(hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message);
+    for (index = 0; index < 4; index++)
+    {
+        for (thread_list_ptr = receive_message[index] -> message_waiter_head;
+             thread_list_ptr;
+             thread_list_ptr = thread_list_ptr -> thread_next)
+        {
+            tx_semaphore_put(&(thread_list_ptr -> thread_semaphore));
+        }
+    }
+
+    for (index = 0; index < NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE; index++)
     {
-        tx_thread_wait_abort(thread_list_ptr -> thread_ptr);
+        if (hub_client_ptr -> nx_azure_iot_hub_client_rid_table[index])
+        {
+            tx_semaphore_put(&(hub_client_ptr -> nx_azure_iot_hub_client_rid_table[index] -> thread_semaphore));
+        }
     }
 
+    /* Complete asynchronous telemetry and replay unacknowledged spool records on next connection.  */
+    nx_azure_iot_hub_client_telemetry_inflight_process(hub_client_ptr, NX_AZURE_IOT_DISCONNECTED);
+    nx_azure_iot_hub_client_telemetry_spool_reset(hub_client_ptr);
+    nx_azure_iot_hub_client_publish_flush(hub_client_ptr);
+
     /* Cleanup received messages. */
     nx_azure_iot_hub_client_received_message_cleanup(&(hub_client_ptr -> nx_azure_iot_hub_client_c2d_message));
     nx_azure_iot_hub_client_received_message_cleanup(&(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message));
@@ -549,6 +855,7 @@ NX_PACKET *next_ptr;
     /* Reset received messages. */
     message -> message_head = NX_NULL;
     message -> message_tail = NX_NULL;
+    message -> message_count = 0;
 }
 
 UINT nx_azure_iot_hub_client_deinitialize(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
@@ -590,6 +897,9 @@ UINT status;
     /* Release the mutex.  */
     tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
 
+    tx_mutex_delete(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex));
+    tx_event_flags_delete(&(hub_client_ptr -> nx_azure_iot_hub_client_publish_events));
+
     return(NX_AZURE_IOT_SUCCESS);
 }
 
@@ -693,6 +1003,9 @@ UINT nx_azure_iot_hub_client_telemetry_property_add(NX_PACKET *packet_ptr,
                                                     UINT wait_option)
 {
 UINT status;
+NX_PACKET *last_ptr;
+NX_AZURE_IOT_IOVEC vec[4];
+UINT count = 0;
 
     if ((packet_ptr == NX_NULL) ||
         (property_name == NX_NULL) ||
@@ -702,149 +1015,2906 @@ UINT status;
         return(NX_AZURE_IOT_INVALID_PARAMETER);
     }
 
-    if (*(packet_ptr -> nx_packet_append_ptr - 1) != '/')
+    last_ptr = nx_azure_iot_packet_tail_get(packet_ptr);
+    if (*(last_ptr -> nx_packet_append_ptr - 1) != '/')
     {
-        status = nx_packet_data_append(packet_ptr, "&", 1,
-                                       packet_ptr -> nx_packet_pool_owner,
-                                       wait_option);
-        if (status)
-        {
-            LogError("Telemetry data append fail");
-            return(status);
-        }
+        vec[count].iovec_base = (UCHAR *)"&";
+        vec[count++].iovec_length = 1;
     }
 
-    status = nx_packet_data_append(packet_ptr, property_name, (UINT)property_name_length,
-                                   packet_ptr -> nx_packet_pool_owner, wait_option);
+    vec[count].iovec_base = property_name;
+    vec[count++].iovec_length = property_name_length;
+    vec[count].iovec_base = (UCHAR *)"=";
+    vec[count++].iovec_length = 1;
+    vec[count].iovec_base = property_value;
+    vec[count++].iovec_length = property_value_length;
+
+    /* Write "&name=value" in one pass. */
+    status = nx_azure_iot_packet_data_gather(packet_ptr, vec, count, wait_option);
     if (status)
     {
         LogError("Telemetry data append fail");
         return(status);
     }
 
-    status = nx_packet_data_append(packet_ptr, "=", 1,
-                                   packet_ptr -> nx_packet_pool_owner,
-                                   wait_option);
-    if (status)
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_template_create(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                       NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE *template_ptr,
+                                                       UCHAR *buffer, UINT buffer_size)
+{
+UINT topic_length = buffer_size;
+az_result core_result;
+
+    if ((hub_client_ptr == NX_NULL) ||
+        (template_ptr == NX_NULL) ||
+        (buffer == NX_NULL))
     {
-        LogError("Telemetry data append fail");
-        return(status);
+        LogError("IoTHub telemetry template create fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    core_result = az_iot_hub_client_telemetry_get_publish_topic(&hub_client_ptr -> iot_hub_client_core,
+                                                                NULL, (CHAR *)buffer,
+                                                                topic_length, &topic_length);
+    if (az_failed(core_result))
+    {
+        LogError("IoTHub client telemetry template create fail with error 0x%08x", core_result);
+        return(NX_AZURE_IOT_SDK_CORE_ERROR);
+    }
+
+    template_ptr -> template_hub_client_ptr = hub_client_ptr;
+    template_ptr -> template_buffer = buffer;
+    template_ptr -> template_buffer_size = buffer_size;
+    template_ptr -> template_length = topic_length;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_template_property_add(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE *template_ptr,
+                                                             UCHAR *property_name, USHORT property_name_length,
+                                                             UCHAR *property_value, USHORT property_value_length)
+{
+UCHAR *buffer_ptr;
+UINT separator_length;
+
+    if ((template_ptr == NX_NULL) ||
+        (template_ptr -> template_buffer == NX_NULL) ||
+        (property_name == NX_NULL) ||
+        (property_value == NX_NULL))
+    {
+        LogError("IoTHub telemetry template property add fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    buffer_ptr = template_ptr -> template_buffer + template_ptr -> template_length;
+    separator_length = (*(buffer_ptr - 1) != '/') ? 1 : 0;
+
+    if ((template_ptr -> template_length + separator_length + property_name_length + 1 + property_value_length) >
+        template_ptr -> template_buffer_size)
+    {
+        LogError("IoTHub telemetry template property add fail: BUFFER TOO SMALL");
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    if (separator_length)
+    {
+        *buffer_ptr++ = '&';
+    }
+
+    memcpy(buffer_ptr, property_name, property_name_length);
+    buffer_ptr += property_name_length;
+    *buffer_ptr++ = '=';
+    memcpy(buffer_ptr, property_value, property_value_length);
+    buffer_ptr += property_value_length;
+
+    template_ptr -> template_length = (UINT)(buffer_ptr - template_ptr -> template_buffer);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_template_message_create(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE *template_ptr,
+                                                               NX_PACKET **packet_pptr, UINT wait_option)
+{
+NX_PACKET *packet_ptr;
+NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr;
+UINT status;
+
+    if ((template_ptr == NX_NULL) ||
+        (template_ptr -> template_hub_client_ptr == NX_NULL) ||
+        (packet_pptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry template message create fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
     }
 
-    status = nx_packet_data_append(packet_ptr, property_value, (UINT)property_value_length,
-                                   packet_ptr -> nx_packet_pool_owner, wait_option);
+    hub_client_ptr = template_ptr -> template_hub_client_ptr;
+    status = nx_azure_iot_publish_packet_get(hub_client_ptr -> nx_azure_iot_ptr,
+                                             &(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                             &packet_ptr, wait_option);
     if (status)
     {
-        LogError("Telemetry data append fail");
+        LogError("Create telemetry data fail");
         return(status);
     }
 
+    /* Topic must stay in the first packet. */
+    if (template_ptr -> template_length >
+        (UINT)(packet_ptr -> nx_packet_data_end - packet_ptr -> nx_packet_prepend_ptr))
+    {
+        LogError("IoTHub telemetry template message create fail: TEMPLATE TOO LONG");
+        nx_packet_release(packet_ptr);
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    memcpy(packet_ptr -> nx_packet_prepend_ptr, template_ptr -> template_buffer, template_ptr -> template_length);
+    packet_ptr -> nx_packet_append_ptr = packet_ptr -> nx_packet_prepend_ptr + template_ptr -> template_length;
+    packet_ptr -> nx_packet_length = template_ptr -> template_length;
+    *packet_pptr = packet_ptr;
+
     return(NX_AZURE_IOT_SUCCESS);
 }
 
 UINT nx_azure_iot_hub_client_telemetry_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
                                             NX_PACKET *packet_ptr, UCHAR *telemetry_data,
                                             UINT data_size, UINT wait_option)
+{
+    return(nx_azure_iot_hub_client_telemetry_send_qos(hub_client_ptr, packet_ptr, telemetry_data,
+                                                      data_size, NX_AZURE_IOT_MQTT_QOS_1, wait_option));
+}
+
+UINT nx_azure_iot_hub_client_telemetry_send_qos(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                UCHAR *telemetry_data, UINT data_size, UINT qos, UINT wait_option)
+{
+    return(nx_azure_iot_hub_client_telemetry_send_internal(hub_client_ptr, packet_ptr, telemetry_data, data_size,
+                                                           qos, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK, wait_option));
+}
+
+UINT nx_azure_iot_hub_client_telemetry_send_priority(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                     UCHAR *telemetry_data, UINT data_size, UINT priority,
+                                                     UINT wait_option)
+{
+    /* Control queue is reserved for direct method responses.  */
+    if ((priority != NX_AZURE_IOT_HUB_CLIENT_PRIORITY_ALARM) && (priority != NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK))
+    {
+        LogError("IoTHub telemetry send fail: INVALID PRIORITY");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    return(nx_azure_iot_hub_client_telemetry_send_internal(hub_client_ptr, packet_ptr, telemetry_data, data_size,
+                                                           NX_AZURE_IOT_MQTT_QOS_1, priority, wait_option));
+}
+
+static UINT nx_azure_iot_hub_client_telemetry_send_internal(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                            NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                            UINT data_size, UINT qos, UINT priority,
+                                                            UINT wait_option)
 {
 UINT status;
 UINT topic_len;
-UCHAR packet_id[2];
+UINT stored = NX_FALSE;
+UCHAR packet_id[2] = { 0 };
+UCHAR *compressed_data;
+UINT compressed_size;
 
-    if ((hub_client_ptr == NX_NULL) || (packet_ptr == NX_NULL))
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) || (packet_ptr == NX_NULL))
     {
         LogError("IoTHub telemetry send fail: INVALID POINTER");
         return(NX_AZURE_IOT_INVALID_PARAMETER);
     }
 
-    topic_len = packet_ptr -> nx_packet_length;
-
-    status = nx_azure_iot_mqtt_packet_id_get(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
-                                             packet_id, wait_option);
-    if (status)
+    if ((qos != NX_AZURE_IOT_MQTT_QOS_0) && (qos != NX_AZURE_IOT_MQTT_QOS_1))
     {
-        LogError("Failed to get packet id");
-        return(status);
+        LogError("IoTHub telemetry send fail: INVALID QOS");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
     }
 
-    /* Append packet identifier */
-    status = nx_packet_data_append(packet_ptr, packet_id, sizeof(packet_id),
-                                   packet_ptr -> nx_packet_pool_owner,
-                                   wait_option);
+    status = nx_azure_iot_hub_client_telemetry_token_get(hub_client_ptr, wait_option);
     if (status)
     {
-        LogError("Telemetry append fail");
+        LogError("IoTHub telemetry send fail: THROTTLED");
         return(status);
     }
 
-    if (telemetry_data && (data_size != 0))
+    topic_len = (UINT)packet_ptr -> nx_packet_length;
+
+    /* Obtain the compression mutex. Arena is in use until compressed payload is copied out, which may
+       block on the packet pool, so the cloud mutex must not be held. Send uncompressed if arena is busy.  */
+    if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress.compress_output_buffer &&
+        telemetry_data && (data_size >= NX_AZURE_IOT_HUB_CLIENT_COMPRESS_MIN_SIZE) &&
+        (tx_mutex_get(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex),
+                      wait_option) == TX_SUCCESS))
     {
 
-        /* Append payload. */
-        status = nx_packet_data_append(packet_ptr, telemetry_data, data_size,
-                                       packet_ptr -> nx_packet_pool_owner,
-                                       wait_option);
-        if (status)
+        /* Send as is if compression was disabled meanwhile or payload does not get smaller.  */
+        if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress.compress_output_buffer &&
+            nx_azure_iot_compress(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress),
+                                  telemetry_data, data_size, &compressed_data, &compressed_size) == NX_AZURE_IOT_SUCCESS)
         {
-            LogError("Telemetry data append fail");
-            return(status);
+            status = nx_azure_iot_hub_client_telemetry_property_add(packet_ptr,
+                                                                    (UCHAR *)NX_AZURE_IOT_HUB_CLIENT_COMPRESSION_PROPERTY,
+                                                                    sizeof(NX_AZURE_IOT_HUB_CLIENT_COMPRESSION_PROPERTY) - 1,
+                                                                    (UCHAR *)NX_AZURE_IOT_HUB_CLIENT_COMPRESSION_ZLIB,
+                                                                    sizeof(NX_AZURE_IOT_HUB_CLIENT_COMPRESSION_ZLIB) - 1,
+                                                                    wait_option);
+            if (status)
+            {
+
+                /* Release the compression mutex.  */
+                tx_mutex_put(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex));
+                LogError("IoTHub telemetry send fail: COMPRESSION PROPERTY ADD FAIL: 0x%02x", status);
+                return(status);
+            }
+
+            topic_len = (UINT)packet_ptr -> nx_packet_length;
+            telemetry_data = compressed_data;
+            data_size = compressed_size;
         }
+
+        status = nx_azure_iot_hub_client_telemetry_prepare(hub_client_ptr, packet_ptr, telemetry_data,
+                                                           data_size, qos, packet_id, &stored, wait_option);
+
+        /* Release the compression mutex.  */
+        tx_mutex_put(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex));
+    }
+    else
+    {
+        status = nx_azure_iot_hub_client_telemetry_prepare(hub_client_ptr, packet_ptr, telemetry_data,
+                                                           data_size, qos, packet_id, &stored, wait_option);
+    }
+
+    if (status || stored)
+    {
+        return(status);
     }
 
-    status = nx_azure_iot_publish_mqtt_packet(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
-                                              packet_ptr, topic_len, packet_id, NX_AZURE_IOT_MQTT_QOS_1, wait_option);
+    status = nx_azure_iot_hub_client_publish(hub_client_ptr, priority, packet_ptr, topic_len, packet_id,
+                                             qos, wait_option);
     if (status)
     {
         LogError("IoTHub client send fail: PUBLISH FAIL: 0x%02x", status);
         return(status);
     }
 
+    nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, qos, 1);
+
     return(NX_AZURE_IOT_SUCCESS);
 }
 
-UINT nx_azure_iot_hub_client_receive_callback_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
-                                                  UINT message_type,
-                                                  VOID (*callback_ptr)(
-                                                        NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
-                                                        VOID *args),
-                                                  VOID *callback_args)
+static UINT nx_azure_iot_hub_client_telemetry_payload_available(NX_PACKET *packet_ptr)
 {
-    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+NX_PACKET *tail_ptr = nx_azure_iot_packet_tail_get(packet_ptr);
+UINT free_length = (UINT)(tail_ptr -> nx_packet_data_end - tail_ptr -> nx_packet_append_ptr);
+
+    if (free_length <= NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE)
     {
-        LogError("IoTHub receive callback set fail: INVALID POINTER");
-        return(NX_AZURE_IOT_INVALID_PARAMETER);
+        return(0);
     }
 
-    /* Obtain the mutex.  */
-    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+    return(free_length - NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE);
+}
 
-    if (message_type == NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE)
+static UINT nx_azure_iot_hub_client_telemetry_payload_check(NX_AZURE_IOT_HUB_CLIENT_PAYLOAD *payload_ptr)
+{
+NX_PACKET *tail_ptr;
+
+    /* Packet must end where it ended at reservation, or the payload was overwritten.  */
+    if (payload_ptr -> payload_packet_ptr == NX_NULL)
     {
-        hub_client_ptr -> nx_azure_iot_hub_client_c2d_message.message_callback = callback_ptr;
-        hub_client_ptr -> nx_azure_iot_hub_client_c2d_message.message_callback_args = callback_args;
+        return(NX_AZURE_IOT_NOT_FOUND);
     }
-    else if (message_type == NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES)
+
+    tail_ptr = nx_azure_iot_packet_tail_get(payload_ptr -> payload_packet_ptr);
+    if ((tail_ptr != payload_ptr -> payload_tail_ptr) ||
+        (tail_ptr -> nx_packet_append_ptr != payload_ptr -> payload_append_ptr) ||
+        (payload_ptr -> payload_packet_ptr -> nx_packet_length != payload_ptr -> payload_packet_length))
     {
-        hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message.message_callback = callback_ptr;
-        hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message.message_callback_args = callback_args;
+        return(NX_AZURE_IOT_INVALID_PACKET);
     }
-    else if (message_type == NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES)
-    {
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_hub_client_telemetry_token_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT wait_option)
+{
+
+    /* Messages queued behind stored telemetry take tokens when sent by cloud helper thread.  */
+    if ((hub_client_ptr -> nx_azure_iot_hub_client_state != NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED) ||
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store.store_used ||
+        nx_azure_iot_spool_pending(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr))
+    {
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    return(nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+                                                      1, wait_option));
+}
+
+UINT nx_azure_iot_hub_client_telemetry_payload_reserve(NX_AZURE_IOT_HUB_CLIENT_PAYLOAD *payload_ptr,
+                                                       NX_PACKET *packet_ptr, UINT max_length,
+                                                       UCHAR **payload_pptr, UINT *available_length_ptr)
+{
+UINT available_length;
+
+    if ((payload_ptr == NX_NULL) || (packet_ptr == NX_NULL) || (payload_pptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry payload reserve fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Payload is written in place, after topic and room for packet id, in the last packet.  */
+    available_length = nx_azure_iot_hub_client_telemetry_payload_available(packet_ptr);
+    if (available_length_ptr)
+    {
+        *available_length_ptr = available_length;
+    }
+
+    if (max_length > available_length)
+    {
+        LogError("IoTHub telemetry payload reserve fail: %u BYTES AVAILABLE", available_length);
+        *payload_pptr = NX_NULL;
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    /* Reservation is kept by caller, so nothing is written to packet memory beyond the payload.  */
+    payload_ptr -> payload_packet_ptr = packet_ptr;
+    payload_ptr -> payload_tail_ptr = nx_azure_iot_packet_tail_get(packet_ptr);
+    payload_ptr -> payload_append_ptr = payload_ptr -> payload_tail_ptr -> nx_packet_append_ptr;
+    payload_ptr -> payload_packet_length = packet_ptr -> nx_packet_length;
+    payload_ptr -> payload_max_length = max_length;
+    payload_ptr -> payload_used_length = 0;
+    payload_ptr -> payload_state = NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_RESERVED;
+    *payload_pptr = payload_ptr -> payload_append_ptr + NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_payload_commit(NX_AZURE_IOT_HUB_CLIENT_PAYLOAD *payload_ptr,
+                                                      UINT used_length)
+{
+    if (payload_ptr == NX_NULL)
+    {
+        LogError("IoTHub telemetry payload commit fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Commit may be repeated to change the length before send.  */
+    if (((payload_ptr -> payload_state != NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_RESERVED) &&
+         (payload_ptr -> payload_state != NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_COMMITTED)) ||
+        nx_azure_iot_hub_client_telemetry_payload_check(payload_ptr))
+    {
+        LogError("IoTHub telemetry payload commit fail: NOT RESERVED");
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    if (used_length > payload_ptr -> payload_max_length)
+    {
+        LogError("IoTHub telemetry payload commit fail: LENGTH EXCEEDS RESERVATION");
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    /* Packet still ends at topic until send.  */
+    payload_ptr -> payload_used_length = used_length;
+    payload_ptr -> payload_state = NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_COMMITTED;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_payload_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                    NX_AZURE_IOT_HUB_CLIENT_PAYLOAD *payload_ptr,
+                                                    UINT qos, UINT wait_option)
+{
+NX_PACKET *packet_ptr;
+NX_PACKET *tail_ptr;
+UCHAR *payload_data;
+UINT payload_length;
+UINT topic_len;
+UINT stored = NX_FALSE;
+UINT status = NX_AZURE_IOT_SUCCESS;
+UCHAR packet_id[2] = { 0 };
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        (payload_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry payload send fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if ((qos != NX_AZURE_IOT_MQTT_QOS_0) && (qos != NX_AZURE_IOT_MQTT_QOS_1))
+    {
+        LogError("IoTHub telemetry payload send fail: INVALID QOS");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Reservation is checked against current packet, so a payload overwritten by appends is rejected.  */
+    if ((payload_ptr -> payload_state != NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_COMMITTED) ||
+        nx_azure_iot_hub_client_telemetry_payload_check(payload_ptr))
+    {
+        LogError("IoTHub telemetry payload send fail: NOT COMMITTED");
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    packet_ptr = payload_ptr -> payload_packet_ptr;
+    tail_ptr = payload_ptr -> payload_tail_ptr;
+    payload_data = tail_ptr -> nx_packet_append_ptr + NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE;
+    payload_length = payload_ptr -> payload_used_length;
+
+    status = nx_azure_iot_hub_client_telemetry_token_get(hub_client_ptr, wait_option);
+    if (status)
+    {
+        LogError("IoTHub telemetry payload send fail: THROTTLED");
+        return(status);
+    }
+
+    /* Store and spool copy payload before packet is released.  */
+    if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr)
+    {
+        status = nx_azure_iot_hub_client_telemetry_spool_put(hub_client_ptr, packet_ptr, payload_data,
+                                                             payload_length, qos, &stored);
+    }
+    else if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store.store_buffer)
+    {
+        status = nx_azure_iot_hub_client_telemetry_store_put(hub_client_ptr, packet_ptr, payload_data,
+                                                             payload_length, qos, &stored);
+    }
+
+    if (status)
+    {
+        return(status);
+    }
+
+    /* Packet is consumed once stored, and is modified from here otherwise, so it can not be sent again.  */
+    memset(payload_ptr, 0, sizeof(NX_AZURE_IOT_HUB_CLIENT_PAYLOAD));
+    if (stored)
+    {
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    topic_len = (UINT)packet_ptr -> nx_packet_length;
+    if (qos == NX_AZURE_IOT_MQTT_QOS_1)
+    {
+
+        /* Packet id takes the gap.  */
+        status = nx_azure_iot_mqtt_packet_id_get(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                 packet_id, wait_option);
+        if (status)
+        {
+            LogError("Failed to get packet id");
+            return(status);
+        }
+
+        tail_ptr -> nx_packet_append_ptr[0] = packet_id[0];
+        tail_ptr -> nx_packet_append_ptr[1] = packet_id[1];
+        tail_ptr -> nx_packet_append_ptr += NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE;
+        packet_ptr -> nx_packet_length += NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE;
+    }
+    else if (tail_ptr == packet_ptr)
+    {
+
+        /* No packet id at QoS 0, so topic is moved up to close the gap.  */
+        memmove(packet_ptr -> nx_packet_prepend_ptr + NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE,
+                packet_ptr -> nx_packet_prepend_ptr, topic_len);
+        packet_ptr -> nx_packet_prepend_ptr += NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE;
+        packet_ptr -> nx_packet_append_ptr += NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_GAP_SIZE;
+    }
+    else
+    {
+
+        /* Topic spans packets, close the gap by moving payload instead.  */
+        memmove(tail_ptr -> nx_packet_append_ptr, payload_data, payload_length);
+    }
+
+    tail_ptr -> nx_packet_append_ptr += payload_length;
+    packet_ptr -> nx_packet_length += payload_length;
+
+    status = nx_azure_iot_hub_client_publish(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK, packet_ptr,
+                                             topic_len, packet_id, qos, wait_option);
+    if (status)
+    {
+        LogError("IoTHub client payload send fail: PUBLISH FAIL: 0x%02x", status);
+        return(status);
+    }
+
+    nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, qos, 1);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_send_external(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                     UCHAR *telemetry_data, UINT data_size, UINT qos,
+                                                     VOID (*release_callback)(
+                                                           NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                           UCHAR *telemetry_data, UINT status, VOID *args),
+                                                     VOID *callback_args, UINT wait_option)
+{
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY entry;
+UINT topic_len;
+UINT stored = NX_FALSE;
+UINT status;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        (packet_ptr == NX_NULL) || (telemetry_data == NX_NULL))
+    {
+        LogError("IoTHub telemetry external send fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Payload is not kept for retransmission, so only QoS 0 is streamed.  */
+    if (qos != NX_AZURE_IOT_MQTT_QOS_0)
+    {
+        LogError("IoTHub telemetry external send fail: INVALID QOS");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    status = nx_azure_iot_hub_client_telemetry_token_get(hub_client_ptr, wait_option);
+
+    /* Store and spool copy payload, so it is released right away.  */
+    if ((status == NX_AZURE_IOT_SUCCESS) && hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr)
+    {
+        status = nx_azure_iot_hub_client_telemetry_spool_put(hub_client_ptr, packet_ptr, telemetry_data,
+                                                             data_size, qos, &stored);
+    }
+    else if ((status == NX_AZURE_IOT_SUCCESS) && hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store.store_buffer)
+    {
+        status = nx_azure_iot_hub_client_telemetry_store_put(hub_client_ptr, packet_ptr, telemetry_data,
+                                                             data_size, qos, &stored);
+    }
+
+    if ((status == NX_AZURE_IOT_SUCCESS) && !stored)
+    {
+        topic_len = (UINT)packet_ptr -> nx_packet_length;
+
+        /* Remaining length counts payload that is streamed after the packet.  */
+        if ((ULONG)data_size > (NX_AZURE_IOT_MQTT_MAX_REMAINING_LENGTH - 2 - packet_ptr -> nx_packet_length))
+        {
+            status = NX_AZURE_IOT_MESSAGE_TOO_LONG;
+        }
+
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            status = nx_azure_iot_publish_packet_header_write(packet_ptr, topic_len, qos,
+                                                              (UINT)(packet_ptr -> nx_packet_length + 2 + data_size));
+        }
+
+        if (status)
+        {
+            nx_packet_release(packet_ptr);
+        }
+        else if (hub_client_ptr -> nx_azure_iot_hub_client_publish_scheduler_enabled)
+        {
+            memset(&entry, 0, sizeof(entry));
+            entry.entry_packet_ptr = packet_ptr;
+            entry.entry_qos = qos;
+            entry.entry_payload_ptr = telemetry_data;
+            entry.entry_payload_size = data_size;
+            entry.entry_payload_release = release_callback;
+            entry.entry_payload_args = callback_args;
+
+            /* Payload is released by cloud helper thread once sent.  */
+            status = nx_azure_iot_hub_client_publish_enqueue(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK,
+                                                             &entry, wait_option);
+            if (status == NX_AZURE_IOT_SUCCESS)
+            {
+                nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, qos, 1);
+                return(NX_AZURE_IOT_SUCCESS);
+            }
+
+            nx_packet_release(packet_ptr);
+        }
+        else
+        {
+            status = nx_azure_iot_hub_client_stream_send(hub_client_ptr, packet_ptr, telemetry_data, data_size,
+                                                         wait_option);
+        }
+    }
+    else if (status)
+    {
+        nx_packet_release(packet_ptr);
+    }
+
+    if (status)
+    {
+        LogError("IoTHub telemetry external send fail: 0x%02x", status);
+    }
+    else if (!stored)
+    {
+        nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, qos, 1);
+    }
+
+    if (release_callback)
+    {
+        release_callback(hub_client_ptr, telemetry_data, status, callback_args);
+    }
+
+    return(status);
+}
+
+static UINT nx_azure_iot_hub_client_telemetry_payload_packet_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                  NX_PACKET *packet_ptr, NX_PACKET *payload_packet_ptr,
+                                                                  UINT qos, UINT wait_option)
+{
+NX_PACKET *tail_ptr;
+UCHAR *prepend_ptr;
+UCHAR *append_ptr;
+UINT topic_len;
+UINT linked = NX_FALSE;
+UINT status;
+UCHAR packet_id[2] = { 0 };
+
+    if ((qos != NX_AZURE_IOT_MQTT_QOS_0) && (qos != NX_AZURE_IOT_MQTT_QOS_1))
+    {
+        LogError("IoTHub telemetry payload send fail: INVALID QOS");
+        nx_packet_release(payload_packet_ptr);
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Packet id, payload and MQTT header are added to packet, so its state is kept for rollback.  */
+    tail_ptr = nx_azure_iot_packet_tail_get(packet_ptr);
+    prepend_ptr = packet_ptr -> nx_packet_prepend_ptr;
+    append_ptr = tail_ptr -> nx_packet_append_ptr;
+    topic_len = (UINT)packet_ptr -> nx_packet_length;
+
+    status = nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+                                                        1, wait_option);
+    if ((status == NX_AZURE_IOT_SUCCESS) && (qos == NX_AZURE_IOT_MQTT_QOS_1))
+    {
+        status = nx_azure_iot_mqtt_packet_id_get(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                 packet_id, wait_option);
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            status = nx_packet_data_append(packet_ptr, packet_id, sizeof(packet_id),
+                                           packet_ptr -> nx_packet_pool_owner, wait_option);
+        }
+    }
+
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        nx_azure_iot_hub_client_packet_chain_link(packet_ptr, payload_packet_ptr);
+        linked = NX_TRUE;
+
+        status = nx_azure_iot_hub_client_publish(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK, packet_ptr,
+                                                 topic_len, packet_id, qos, wait_option);
+    }
+
+    if (status)
+    {
+
+        /* Caller still owns packet, so it is restored to the topic and properties it was passed with.  */
+        if (!linked)
+        {
+            nx_packet_release(payload_packet_ptr);
+        }
+
+        nx_azure_iot_packet_tail_restore(packet_ptr, tail_ptr, append_ptr, topic_len);
+        packet_ptr -> nx_packet_prepend_ptr = prepend_ptr;
+
+        LogError("IoTHub telemetry payload send fail: 0x%02x", status);
+        return(status);
+    }
+
+    nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, qos, 1);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_json_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                 NX_PACKET *json_packet_ptr, UINT qos, UINT wait_option)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        (packet_ptr == NX_NULL) || (json_packet_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry json send fail: INVALID POINTER");
+        if (json_packet_ptr)
+        {
+            nx_packet_release(json_packet_ptr);
+        }
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    return(nx_azure_iot_hub_client_telemetry_payload_packet_send(hub_client_ptr, packet_ptr, json_packet_ptr,
+                                                                 qos, wait_option));
+}
+
+UINT nx_azure_iot_hub_client_telemetry_cbor_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                 NX_PACKET *cbor_packet_ptr, UINT qos, UINT wait_option)
+{
+UINT status;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        (packet_ptr == NX_NULL) || (cbor_packet_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry cbor send fail: INVALID POINTER");
+        if (cbor_packet_ptr)
+        {
+            nx_packet_release(cbor_packet_ptr);
+        }
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Tag payload as CBOR, so that it can be routed and decoded by the service.  */
+    status = nx_azure_iot_hub_client_telemetry_property_add(packet_ptr,
+                                                            (UCHAR *)NX_AZURE_IOT_CBOR_CONTENT_TYPE_PROPERTY,
+                                                            sizeof(NX_AZURE_IOT_CBOR_CONTENT_TYPE_PROPERTY) - 1,
+                                                            (UCHAR *)NX_AZURE_IOT_CBOR_CONTENT_TYPE_VALUE,
+                                                            sizeof(NX_AZURE_IOT_CBOR_CONTENT_TYPE_VALUE) - 1,
+                                                            wait_option);
+    if (status)
+    {
+        LogError("IoTHub telemetry cbor send fail: PROPERTY ADD FAIL: 0x%02x", status);
+        nx_packet_release(cbor_packet_ptr);
+        return(status);
+    }
+
+    return(nx_azure_iot_hub_client_telemetry_payload_packet_send(hub_client_ptr, packet_ptr, cbor_packet_ptr,
+                                                                 qos, wait_option));
+}
+
+static UINT nx_azure_iot_hub_client_telemetry_prepare(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                      UCHAR *telemetry_data, UINT data_size, UINT qos,
+                                                      UCHAR *packet_id, UINT *stored_ptr, UINT wait_option)
+{
+UINT status;
+
+    if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr)
+    {
+        status = nx_azure_iot_hub_client_telemetry_spool_put(hub_client_ptr, packet_ptr, telemetry_data,
+                                                             data_size, qos, stored_ptr);
+        if (status || *stored_ptr)
+        {
+            return(status);
+        }
+    }
+    else if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store.store_buffer)
+    {
+        status = nx_azure_iot_hub_client_telemetry_store_put(hub_client_ptr, packet_ptr, telemetry_data,
+                                                             data_size, qos, stored_ptr);
+        if (status || *stored_ptr)
+        {
+            return(status);
+        }
+    }
+
+    /* QoS 0 PUBLISH carries no packet identifier. */
+    if (qos == NX_AZURE_IOT_MQTT_QOS_1)
+    {
+        status = nx_azure_iot_mqtt_packet_id_get(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                 packet_id, wait_option);
+        if (status)
+        {
+            LogError("Failed to get packet id");
+            return(status);
+        }
+
+        /* Append packet identifier */
+        status = nx_packet_data_append(packet_ptr, packet_id, 2,
+                                       packet_ptr -> nx_packet_pool_owner,
+                                       wait_option);
+        if (status)
+        {
+            LogError("Telemetry append fail");
+            return(status);
+        }
+    }
+
+    if (telemetry_data && (data_size != 0))
+    {
+
+        /* Append payload. */
+        status = nx_packet_data_append(packet_ptr, telemetry_data, data_size,
+                                       packet_ptr -> nx_packet_pool_owner,
+                                       wait_option);
+        if (status)
+        {
+            LogError("Telemetry data append fail");
+            return(status);
+        }
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_publish_scheduler_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                      UINT starvation_budget)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub publish scheduler enable fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    hub_client_ptr -> nx_azure_iot_hub_client_publish_starvation_budget = starvation_budget;
+    hub_client_ptr -> nx_azure_iot_hub_client_publish_budget_used = 0;
+    hub_client_ptr -> nx_azure_iot_hub_client_publish_scheduler_enabled = NX_TRUE;
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_publish_scheduler_disable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub publish scheduler disable fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    hub_client_ptr -> nx_azure_iot_hub_client_publish_scheduler_enabled = NX_FALSE;
+    nx_azure_iot_hub_client_publish_flush(hub_client_ptr);
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_publish_queue_status_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                                      UINT *depth_ptr, ULONG *sent_count_ptr,
+                                                      ULONG *dropped_count_ptr, ULONG *latency_average_ptr,
+                                                      ULONG *latency_max_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE *queue_ptr;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub publish queue status get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (priority >= NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT)
+    {
+        LogError("IoTHub publish queue status get fail: INVALID PRIORITY");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    queue_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_publish_queue[priority]);
+    if (depth_ptr)
+    {
+        *depth_ptr = queue_ptr -> queue_depth;
+    }
+
+    if (sent_count_ptr)
+    {
+        *sent_count_ptr = queue_ptr -> queue_sent_count;
+    }
+
+    if (dropped_count_ptr)
+    {
+        *dropped_count_ptr = queue_ptr -> queue_dropped_count;
+    }
+
+    if (latency_average_ptr)
+    {
+        *latency_average_ptr = queue_ptr -> queue_sent_count ?
+                               (queue_ptr -> queue_latency_total / queue_ptr -> queue_sent_count) : 0;
+    }
+
+    if (latency_max_ptr)
+    {
+        *latency_max_ptr = queue_ptr -> queue_latency_max;
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_hub_client_publish(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                            NX_PACKET *packet_ptr, UINT topic_len, UCHAR *packet_id,
+                                            UINT qos, UINT wait_option)
+{
+UINT status;
+
+    if (!hub_client_ptr -> nx_azure_iot_hub_client_publish_scheduler_enabled)
+    {
+        return(nx_azure_iot_publish_mqtt_packet(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                packet_ptr, topic_len, packet_id, qos, wait_option));
+    }
+
+    /* Writer sends packet as is, so MQTT fixed header is added now.  */
+    status = nx_azure_iot_publish_packet_header_add(packet_ptr, topic_len, qos);
+    if (status)
+    {
+        LogError("failed to add mqtt header");
+        return(status);
+    }
+
+    return(nx_azure_iot_hub_client_publish_packet(hub_client_ptr, priority, packet_ptr, packet_id, qos, wait_option));
+}
+
+static UINT nx_azure_iot_hub_client_publish_packet(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                                   NX_PACKET *packet_ptr, UCHAR *packet_id, UINT qos,
+                                                   UINT wait_option)
+{
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY entry;
+
+    /* Packet already contains complete PUBLISH frames.  */
+    if (!hub_client_ptr -> nx_azure_iot_hub_client_publish_scheduler_enabled)
+    {
+        return(nx_azure_iot_mqtt_packet_send(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                             packet_ptr, packet_id, qos, wait_option));
+    }
+
+    memset(&entry, 0, sizeof(entry));
+    entry.entry_packet_ptr = packet_ptr;
+    entry.entry_packet_id = (USHORT)((packet_id[0] << 8) | packet_id[1]);
+    entry.entry_qos = qos;
+
+    return(nx_azure_iot_hub_client_publish_enqueue(hub_client_ptr, priority, &entry, wait_option));
+}
+
+static VOID nx_azure_iot_hub_client_packet_chain_link(NX_PACKET *packet_ptr, NX_PACKET *payload_packet_ptr)
+{
+NX_PACKET *tail_ptr = nx_azure_iot_packet_tail_get(packet_ptr);
+
+    /* Payload packets follow as continuation packets, data is not copied.  */
+    tail_ptr -> nx_packet_next = payload_packet_ptr;
+    packet_ptr -> nx_packet_last = nx_azure_iot_packet_tail_get(payload_packet_ptr);
+    packet_ptr -> nx_packet_length += payload_packet_ptr -> nx_packet_length;
+}
+
+static UINT nx_azure_iot_hub_client_json_publish(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                                 UCHAR *topic, UINT topic_length, NX_PACKET **json_packet_pptr,
+                                                 UINT wait_option)
+{
+NX_PACKET *packet_ptr;
+UCHAR packet_id[2] = { 0 };
+UINT status;
+
+    status = nx_azure_iot_publish_packet_get(hub_client_ptr -> nx_azure_iot_ptr,
+                                             &(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                             &packet_ptr, wait_option);
+    if (status)
+    {
+        return(status);
+    }
+
+    status = nx_packet_data_append(packet_ptr, topic, topic_length, packet_ptr -> nx_packet_pool_owner, wait_option);
+    if (status)
+    {
+        nx_packet_release(packet_ptr);
+        return(status);
+    }
+
+    nx_azure_iot_hub_client_packet_chain_link(packet_ptr, *json_packet_pptr);
+    *json_packet_pptr = NX_NULL;
+
+    status = nx_azure_iot_hub_client_publish(hub_client_ptr, priority, packet_ptr, topic_length, packet_id,
+                                             NX_AZURE_IOT_MQTT_QOS_0, wait_option);
+    if (status)
+    {
+        nx_packet_release(packet_ptr);
+        return(status);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_hub_client_publish_enqueue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                                    NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY *new_entry_ptr,
+                                                    UINT wait_option)
+{
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE *queue_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_publish_queue[priority]);
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY *entry_ptr;
+ULONG room_event = ((ULONG)1 << priority);
+ULONG actual_events;
+ULONG start_time = tx_time_get();
+ULONG elapsed_time;
+
+    while (1)
+    {
+
+        /* Obtain the mutex.  */
+        tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+        if (hub_client_ptr -> nx_azure_iot_hub_client_state != NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED)
+        {
+
+            /* Release the mutex.  */
+            tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+            return(NX_AZURE_IOT_DISCONNECTED);
+        }
+
+        /* Scheduler may be disabled while waiting for room.  */
+        if (!hub_client_ptr -> nx_azure_iot_hub_client_publish_scheduler_enabled)
+        {
+
+            /* Release the mutex.  */
+            tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+            return(NX_AZURE_IOT_NOT_ENABLED);
+        }
+
+        if (queue_ptr -> queue_depth < NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_DEPTH)
+        {
+            break;
+        }
+
+        /* Cleared under mutex, so room made after this point is not missed.  */
+        tx_event_flags_set(&(hub_client_ptr -> nx_azure_iot_hub_client_publish_events), ~room_event, TX_AND);
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+        elapsed_time = tx_time_get() - start_time;
+        if ((wait_option != NX_WAIT_FOREVER) && (elapsed_time >= wait_option))
+        {
+            return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+        }
+
+        /* Wait for cloud helper thread to make room.  */
+        if (tx_event_flags_get(&(hub_client_ptr -> nx_azure_iot_hub_client_publish_events), room_event, TX_OR,
+                               &actual_events,
+                               (wait_option == NX_WAIT_FOREVER) ? NX_WAIT_FOREVER : (wait_option - elapsed_time)))
+        {
+            return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+        }
+    }
+
+    entry_ptr = &(queue_ptr -> queue_entry[(queue_ptr -> queue_head + queue_ptr -> queue_depth) %
+                                           NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_DEPTH]);
+    *entry_ptr = *new_entry_ptr;
+    entry_ptr -> entry_time = tx_time_get();
+    queue_ptr -> queue_depth++;
+
+    nx_cloud_module_event_set(&(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_cloud_module),
+                              NX_AZURE_IOT_HUB_CLIENT_PUBLISH_EVENT);
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_hub_client_publish_select(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE *queue_ptr = hub_client_ptr -> nx_azure_iot_hub_client_publish_queue;
+ULONG current_time = tx_time_get();
+ULONG wait_time;
+ULONG oldest_time = 0;
+UINT oldest = NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT;
+UINT top;
+UINT priority;
+
+    /* Strict priority.  */
+    for (top = 0; top < NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT; top++)
+    {
+        if (queue_ptr[top].queue_depth)
+        {
+            break;
+        }
+    }
+
+    if (top == NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT)
+    {
+        return(top);
+    }
+
+    /* Find the longest waiting message among lower priorities.  */
+    for (priority = top + 1; priority < NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT; priority++)
+    {
+        if (queue_ptr[priority].queue_depth == 0)
+        {
+            continue;
+        }
+
+        wait_time = current_time - queue_ptr[priority].queue_entry[queue_ptr[priority].queue_head].entry_time;
+        if ((oldest == NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT) || (wait_time > oldest_time))
+        {
+            oldest = priority;
+            oldest_time = wait_time;
+        }
+    }
+
+    if (oldest == NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT)
+    {
+
+        /* Nothing is starving.  */
+        hub_client_ptr -> nx_azure_iot_hub_client_publish_budget_used = 0;
+        return(top);
+    }
+
+    /* Anti-starvation: serve one lower priority message once budget is used up.  */
+    if (hub_client_ptr -> nx_azure_iot_hub_client_publish_starvation_budget &&
+        (hub_client_ptr -> nx_azure_iot_hub_client_publish_budget_used >=
+         hub_client_ptr -> nx_azure_iot_hub_client_publish_starvation_budget))
+    {
+        hub_client_ptr -> nx_azure_iot_hub_client_publish_budget_used = 0;
+        return(oldest);
+    }
+
+    hub_client_ptr -> nx_azure_iot_hub_client_publish_budget_used++;
+    return(top);
+}
+
+static UINT nx_azure_iot_hub_client_stream_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                const UCHAR *data_ptr, UINT data_size, UINT wait_option)
+{
+UINT status;
+
+    status = nx_azure_iot_mqtt_packet_stream_send(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                  packet_ptr, data_ptr, data_size, wait_option);
+    if (status == NX_AZURE_IOT_INCOMPLETE_FRAME)
+    {
+
+        /* Connection can not be used any more. Wake waiters, complete in-flight telemetry, rewind spool and
+           flush publish queues as an application disconnect does.  */
+        nx_azure_iot_hub_client_disconnect(hub_client_ptr);
+        status = NX_AZURE_IOT_DISCONNECTED;
+    }
+
+    return(status);
+}
+
+static VOID nx_azure_iot_hub_client_publish_schedule(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE *queue_ptr;
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY entry;
+UCHAR packet_id[2];
+ULONG latency;
+UINT priority;
+UINT status;
+
+    /* This function must be called with mutex held. Cloud helper thread is the only writer.  */
+    while (hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED)
+    {
+        priority = nx_azure_iot_hub_client_publish_select(hub_client_ptr);
+        if (priority == NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT)
+        {
+            return;
+        }
+
+        queue_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_publish_queue[priority]);
+        entry = queue_ptr -> queue_entry[queue_ptr -> queue_head];
+        queue_ptr -> queue_head = (queue_ptr -> queue_head + 1) % NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_DEPTH;
+        queue_ptr -> queue_depth--;
+
+        /* Wake senders waiting for room.  */
+        tx_event_flags_set(&(hub_client_ptr -> nx_azure_iot_hub_client_publish_events), ((ULONG)1 << priority), TX_OR);
+
+        if (entry.entry_payload_ptr)
+        {
+
+            /* Header packet is consumed by stream send.  */
+            status = nx_azure_iot_hub_client_stream_send(hub_client_ptr, entry.entry_packet_ptr,
+                                                         entry.entry_payload_ptr, entry.entry_payload_size,
+                                                         NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT);
+            if (entry.entry_payload_release)
+            {
+                entry.entry_payload_release(hub_client_ptr, entry.entry_payload_ptr, status,
+                                            entry.entry_payload_args);
+            }
+        }
+        else
+        {
+            packet_id[0] = (UCHAR)(entry.entry_packet_id >> 8);
+            packet_id[1] = (UCHAR)(entry.entry_packet_id & 0xFF);
+            status = nx_azure_iot_mqtt_packet_send(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                   entry.entry_packet_ptr, packet_id, entry.entry_qos,
+                                                   NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT);
+            if (status)
+            {
+                nx_packet_release(entry.entry_packet_ptr);
+            }
+        }
+
+        if (status)
+        {
+            LogError("IoTHub publish queue drop: 0x%02x", status);
+            queue_ptr -> queue_dropped_count++;
+            continue;
+        }
+
+        latency = tx_time_get() - entry.entry_time;
+        queue_ptr -> queue_sent_count++;
+        queue_ptr -> queue_latency_total += latency;
+        if (latency > queue_ptr -> queue_latency_max)
+        {
+            queue_ptr -> queue_latency_max = latency;
+        }
+    }
+}
+
+static VOID nx_azure_iot_hub_client_publish_flush(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE *queue_ptr;
+NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY *entry_ptr;
+UINT priority;
+
+    /* This function must be called with mutex held.  */
+    for (priority = 0; priority < NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT; priority++)
+    {
+        queue_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_publish_queue[priority]);
+        while (queue_ptr -> queue_depth)
+        {
+            entry_ptr = &(queue_ptr -> queue_entry[queue_ptr -> queue_head]);
+            nx_packet_release(entry_ptr -> entry_packet_ptr);
+            if (entry_ptr -> entry_payload_ptr && entry_ptr -> entry_payload_release)
+            {
+                entry_ptr -> entry_payload_release(hub_client_ptr, entry_ptr -> entry_payload_ptr,
+                                                   NX_AZURE_IOT_DISCONNECTED, entry_ptr -> entry_payload_args);
+            }
+            queue_ptr -> queue_head = (queue_ptr -> queue_head + 1) % NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_DEPTH;
+            queue_ptr -> queue_depth--;
+            queue_ptr -> queue_dropped_count++;
+        }
+    }
+
+    hub_client_ptr -> nx_azure_iot_hub_client_publish_budget_used = 0;
+
+    /* Wake all waiting senders, they see the new state.  */
+    tx_event_flags_set(&(hub_client_ptr -> nx_azure_iot_hub_client_publish_events),
+                       ((ULONG)1 << NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT) - 1, TX_OR);
+}
+
+UINT nx_azure_iot_hub_client_rate_limit_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT limit_class,
+                                            UINT rate, UINT period, UINT burst)
+{
+NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT *limit_ptr;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub rate limit set fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Credit is kept in tokens multiplied by period, so a full bucket must fit in 32 bits.  */
+    if ((limit_class >= NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_COUNT) ||
+        (rate && ((period == 0) || (burst == 0) || (burst > (NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_CREDIT_MAX / period)))))
+    {
+        LogError("IoTHub rate limit set fail: INVALID PARAMETER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    limit_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_rate_limit[limit_class]);
+    limit_ptr -> rate_limit_rate = rate;
+    limit_ptr -> rate_limit_period = period;
+    limit_ptr -> rate_limit_burst = burst;
+    limit_ptr -> rate_limit_credit = (ULONG)burst * period;
+    limit_ptr -> rate_limit_last_time = tx_time_get();
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static VOID nx_azure_iot_hub_client_rate_limit_refill(NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT *limit_ptr)
+{
+ULONG now = tx_time_get();
+ULONG elapsed = now - limit_ptr -> rate_limit_last_time;
+ULONG capacity = (ULONG)limit_ptr -> rate_limit_burst * limit_ptr -> rate_limit_period;
+ULONG missing = capacity - limit_ptr -> rate_limit_credit;
+
+    /* Credit is kept in tokens multiplied by period, so each tick adds rate. Compare ticks against
+       what is missing before multiplying, so a long idle time can not wrap around.  */
+    limit_ptr -> rate_limit_last_time = now;
+    if (elapsed > (missing / limit_ptr -> rate_limit_rate))
+    {
+        limit_ptr -> rate_limit_credit = capacity;
+    }
+    else
+    {
+        limit_ptr -> rate_limit_credit += elapsed * limit_ptr -> rate_limit_rate;
+    }
+}
+
+static UINT nx_azure_iot_hub_client_rate_limit_acquire(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT limit_class,
+                                                       UINT count, UINT wait_option)
+{
+NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT *limit_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_rate_limit[limit_class]);
+ULONG cost;
+ULONG wait_ticks;
+UINT throttled = NX_FALSE;
+
+    /* Must not be called with mutex held unless wait_option is NX_NO_WAIT.  */
+    while (1)
+    {
+
+        /* Obtain the mutex.  */
+        tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+        if (limit_ptr -> rate_limit_rate == 0)
+        {
+
+            /* Release the mutex.  */
+            tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+            return(NX_AZURE_IOT_SUCCESS);
+        }
+
+        /* Larger request than bucket takes a full bucket.  */
+        cost = (count < limit_ptr -> rate_limit_burst) ? count : limit_ptr -> rate_limit_burst;
+        cost *= limit_ptr -> rate_limit_period;
+
+        nx_azure_iot_hub_client_rate_limit_refill(limit_ptr);
+        if (limit_ptr -> rate_limit_credit >= cost)
+        {
+            limit_ptr -> rate_limit_credit -= cost;
+
+            /* Release the mutex.  */
+            tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+            return(NX_AZURE_IOT_SUCCESS);
+        }
+
+        /* Count each throttled send once.  */
+        if (!throttled)
+        {
+            limit_ptr -> rate_limit_throttle_count++;
+            throttled = NX_TRUE;
+        }
+
+        /* Round up without adding rate, which may wrap around.  */
+        wait_ticks = ((cost - limit_ptr -> rate_limit_credit - 1) / limit_ptr -> rate_limit_rate) + 1;
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+        /* Fail now rather than sleep for a token that cannot arrive in time.  */
+        if ((wait_option != NX_WAIT_FOREVER) && (wait_ticks > wait_option))
+        {
+            return(NX_AZURE_IOT_THROTTLED);
+        }
+
+        tx_thread_sleep(wait_ticks);
+        if (wait_option != NX_WAIT_FOREVER)
+        {
+            wait_option -= (UINT)wait_ticks;
+        }
+    }
+}
+
+UINT nx_azure_iot_hub_client_rate_limit_status_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT limit_class,
+                                                   UINT *tokens_ptr, ULONG *throttle_count_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT *limit_ptr;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub rate limit status get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (limit_class >= NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_COUNT)
+    {
+        LogError("IoTHub rate limit status get fail: INVALID PARAMETER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    limit_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_rate_limit[limit_class]);
+    if (limit_ptr -> rate_limit_rate)
+    {
+        nx_azure_iot_hub_client_rate_limit_refill(limit_ptr);
+    }
+
+    if (tokens_ptr)
+    {
+        *tokens_ptr = limit_ptr -> rate_limit_rate ?
+                      (UINT)(limit_ptr -> rate_limit_credit / limit_ptr -> rate_limit_period) : 0;
+    }
+
+    if (throttle_count_ptr)
+    {
+        *throttle_count_ptr = limit_ptr -> rate_limit_throttle_count;
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_compression_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                          UCHAR *arena, UINT arena_size,
+                                                          const UCHAR *dictionary, UINT dictionary_size)
+{
+UINT status;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) || (arena == NX_NULL))
+    {
+        LogError("IoTHub telemetry compression enable fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the compression mutex.  */
+    tx_mutex_get(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex), TX_WAIT_FOREVER);
+
+    status = nx_azure_iot_compress_init(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress),
+                                        arena, arena_size, dictionary, dictionary_size);
+
+    /* Release the compression mutex.  */
+    tx_mutex_put(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex));
+
+    if (status)
+    {
+        LogError("IoTHub telemetry compression enable fail: 0x%02x", status);
+        return(status);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_compression_disable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry compression disable fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the compression mutex.  */
+    tx_mutex_get(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex), TX_WAIT_FOREVER);
+
+    memset(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress), 0, sizeof(NX_AZURE_IOT_COMPRESS));
+
+    /* Release the compression mutex.  */
+    tx_mutex_put(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex));
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_compression_statistics_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                  ULONG *input_bytes_ptr, ULONG *output_bytes_ptr)
+{
+    if (hub_client_ptr == NX_NULL)
+    {
+        LogError("IoTHub telemetry compression statistics get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the compression mutex, so both totals are from the same payload.  */
+    tx_mutex_get(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex), TX_WAIT_FOREVER);
+
+    if (input_bytes_ptr)
+    {
+        *input_bytes_ptr = hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress.compress_input_bytes;
+    }
+
+    if (output_bytes_ptr)
+    {
+        *output_bytes_ptr = hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress.compress_output_bytes;
+    }
+
+    /* Release the compression mutex.  */
+    tx_mutex_put(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_compress_mutex));
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_statistics_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                      ULONG *qos0_count_ptr, ULONG *qos1_count_ptr)
+{
+    if (hub_client_ptr == NX_NULL)
+    {
+        LogError("IoTHub telemetry statistics get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (qos0_count_ptr)
+    {
+        *qos0_count_ptr = hub_client_ptr -> nx_azure_iot_hub_client_telemetry_qos0_count;
+    }
+
+    if (qos1_count_ptr)
+    {
+        *qos1_count_ptr = hub_client_ptr -> nx_azure_iot_hub_client_telemetry_qos1_count;
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_store_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                    UCHAR *buffer, UINT buffer_size, UINT policy)
+{
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE *store_ptr;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) || (buffer == NX_NULL))
+    {
+        LogError("IoTHub telemetry store enable fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if ((buffer_size <= sizeof(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD)) ||
+        ((policy != NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_OLDEST) &&
+         (policy != NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_NEWEST)))
+    {
+        LogError("IoTHub telemetry store enable fail: INVALID PARAMETER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    store_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store);
+    memset(store_ptr, 0, sizeof(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE));
+    store_ptr -> store_buffer = buffer;
+    store_ptr -> store_size = buffer_size;
+    store_ptr -> store_policy = policy;
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_store_disable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry store disable fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    memset(&(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store), 0,
+           sizeof(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE));
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_store_status_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        UINT *used_bytes_ptr, ULONG *dropped_count_ptr)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry store status get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    if (used_bytes_ptr)
+    {
+        *used_bytes_ptr = hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store.store_used;
+    }
+
+    if (dropped_count_ptr)
+    {
+        *dropped_count_ptr = hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store.store_dropped_count;
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_store_write(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE *store_ptr,
+                                                          const UCHAR *data_ptr, UINT data_size)
+{
+UINT offset = (store_ptr -> store_head + store_ptr -> store_used) % store_ptr -> store_size;
+UINT copy_size;
+
+    /* Caller makes sure there is enough free space.  */
+    copy_size = store_ptr -> store_size - offset;
+    if (copy_size > data_size)
+    {
+        copy_size = data_size;
+    }
+
+    memcpy(store_ptr -> store_buffer + offset, data_ptr, copy_size);
+    memcpy(store_ptr -> store_buffer, data_ptr + copy_size, data_size - copy_size);
+    store_ptr -> store_used += data_size;
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_store_read(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE *store_ptr,
+                                                         UINT offset, UCHAR *data_ptr, UINT data_size)
+{
+UINT copy_size;
+
+    offset = (store_ptr -> store_head + offset) % store_ptr -> store_size;
+    copy_size = store_ptr -> store_size - offset;
+    if (copy_size > data_size)
+    {
+        copy_size = data_size;
+    }
+
+    memcpy(data_ptr, store_ptr -> store_buffer + offset, copy_size);
+    memcpy(data_ptr + copy_size, store_ptr -> store_buffer, data_size - copy_size);
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_store_pop(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE *store_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD record;
+UINT record_size;
+
+    nx_azure_iot_hub_client_telemetry_store_read(store_ptr, 0, (UCHAR *)&record, sizeof(record));
+    record_size = (UINT)sizeof(record) + record.record_topic_length + record.record_payload_length;
+
+    store_ptr -> store_head = (store_ptr -> store_head + record_size) % store_ptr -> store_size;
+    store_ptr -> store_used -= record_size;
+}
+
+static UINT nx_azure_iot_hub_client_telemetry_store_put(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                        UINT data_size, UINT qos, UINT *stored_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE *store_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store);
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD record;
+NX_PACKET *current_ptr;
+UINT record_size;
+
+    *stored_ptr = NX_FALSE;
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    /* Send directly if connected and nothing is waiting in store.  */
+    if ((store_ptr -> store_buffer == NX_NULL) ||
+        ((hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED) &&
+         (store_ptr -> store_used == 0)))
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    if (telemetry_data == NX_NULL)
+    {
+        data_size = 0;
+    }
+
+    record.record_topic_length = (UINT)packet_ptr -> nx_packet_length;
+    record.record_payload_length = data_size;
+    record.record_qos = qos;
+    record_size = (UINT)sizeof(record) + record.record_topic_length + data_size;
+
+    if (record_size > store_ptr -> store_size)
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        LogError("IoTHub telemetry store fail: MESSAGE TOO LONG");
+        return(NX_AZURE_IOT_MESSAGE_TOO_LONG);
+    }
+
+    /* Make room according to policy.  */
+    while ((store_ptr -> store_size - store_ptr -> store_used) < record_size)
+    {
+        store_ptr -> store_dropped_count++;
+
+        if (store_ptr -> store_policy == NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_NEWEST)
+        {
+
+            /* Release the mutex.  */
+            tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+            return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+        }
+
+        nx_azure_iot_hub_client_telemetry_store_pop(store_ptr);
+    }
+
+    nx_azure_iot_hub_client_telemetry_store_write(store_ptr, (UCHAR *)&record, sizeof(record));
+    for (current_ptr = packet_ptr; current_ptr; current_ptr = current_ptr -> nx_packet_next)
+    {
+        nx_azure_iot_hub_client_telemetry_store_write(store_ptr, current_ptr -> nx_packet_prepend_ptr,
+                                                      (UINT)(current_ptr -> nx_packet_append_ptr -
+                                                             current_ptr -> nx_packet_prepend_ptr));
+    }
+
+    if (data_size)
+    {
+        nx_azure_iot_hub_client_telemetry_store_write(store_ptr, telemetry_data, data_size);
+    }
+
+    /* Drain soon if already connected.  */
+    if (hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED)
+    {
+        nx_cloud_module_event_set(&(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_cloud_module),
+                                  NX_AZURE_IOT_HUB_CLIENT_CONNECT_EVENT);
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    /* Message is copied, so the packet is consumed as it would be by a successful send.  */
+    nx_packet_release(packet_ptr);
+    *stored_ptr = NX_TRUE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_store_drain(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE *store_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_store);
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD record;
+NX_PACKET *packet_ptr;
+UCHAR packet_id[2];
+UINT offset;
+UINT copy_size;
+UINT status;
+UINT drain_count;
+ULONG dropped_count;
+
+    /* This function must be called with mutex held.
+       Packet is built without waiting while mutex is held, and mutex is released while it is sent.
+       Work is bounded per event so other resources and queued messages are not starved.  */
+    for (drain_count = 0;
+         (drain_count < NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DRAIN_COUNT) && store_ptr -> store_used &&
+         (hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED);
+         drain_count++)
+    {
+
+        /* Retry on next periodic event if throttled.  */
+        if (nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+                                                       1, NX_NO_WAIT))
+        {
+            return;
+        }
+
+        nx_azure_iot_hub_client_telemetry_store_read(store_ptr, 0, (UCHAR *)&record, sizeof(record));
+
+        status = nx_azure_iot_publish_packet_get(hub_client_ptr -> nx_azure_iot_ptr,
+                                                 &(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                 &packet_ptr, NX_NO_WAIT);
+        if (status)
+        {
+
+            /* Retry on next periodic event.  */
+            return;
+        }
+
+        /* Topic must stay in the first packet.  */
+        if (record.record_topic_length >
+            (UINT)(packet_ptr -> nx_packet_data_end - packet_ptr -> nx_packet_prepend_ptr))
+        {
+            LogError("IoTHub telemetry store drop: TOPIC TOO LONG");
+            nx_packet_release(packet_ptr);
+            nx_azure_iot_hub_client_telemetry_store_pop(store_ptr);
+            store_ptr -> store_dropped_count++;
+            continue;
+        }
+
+        nx_azure_iot_hub_client_telemetry_store_read(store_ptr, sizeof(record), packet_ptr -> nx_packet_prepend_ptr,
+                                                     record.record_topic_length);
+        packet_ptr -> nx_packet_append_ptr = packet_ptr -> nx_packet_prepend_ptr + record.record_topic_length;
+        packet_ptr -> nx_packet_length = record.record_topic_length;
+
+        status = NX_AZURE_IOT_SUCCESS;
+        packet_id[0] = 0;
+        packet_id[1] = 0;
+        if (record.record_qos == NX_AZURE_IOT_MQTT_QOS_1)
+        {
+            status = nx_azure_iot_mqtt_packet_id_get(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                     packet_id, NX_NO_WAIT);
+            if (status == NX_AZURE_IOT_SUCCESS)
+            {
+                status = nx_packet_data_append(packet_ptr, packet_id, sizeof(packet_id),
+                                               packet_ptr -> nx_packet_pool_owner, NX_NO_WAIT);
+            }
+        }
+
+        /* Append payload directly from store, in up to two pieces if it wraps.  */
+        offset = (store_ptr -> store_head + (UINT)sizeof(record) + record.record_topic_length) % store_ptr -> store_size;
+        copy_size = store_ptr -> store_size - offset;
+        if (copy_size > record.record_payload_length)
+        {
+            copy_size = record.record_payload_length;
+        }
+
+        if ((status == NX_AZURE_IOT_SUCCESS) && copy_size)
+        {
+            status = nx_packet_data_append(packet_ptr, store_ptr -> store_buffer + offset, copy_size,
+                                           packet_ptr -> nx_packet_pool_owner, NX_NO_WAIT);
+        }
+
+        if ((status == NX_AZURE_IOT_SUCCESS) && (record.record_payload_length > copy_size))
+        {
+            status = nx_packet_data_append(packet_ptr, store_ptr -> store_buffer,
+                                           record.record_payload_length - copy_size,
+                                           packet_ptr -> nx_packet_pool_owner, NX_NO_WAIT);
+        }
+
+        if (status)
+        {
+
+            /* Keep the record and retry on next periodic event.  */
+            nx_packet_release(packet_ptr);
+            return;
+        }
+
+        /* Record stays in the store while it is sent, so new messages still queue behind it.
+           Producers may drop it as the oldest record meanwhile, which is seen from dropped count.  */
+        dropped_count = store_ptr -> store_dropped_count;
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+        status = nx_azure_iot_publish_mqtt_packet(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                  packet_ptr, record.record_topic_length, packet_id,
+                                                  record.record_qos, NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT);
+
+        /* Obtain the mutex.  */
+        tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+        if (status)
+        {
+
+            /* Keep the record and retry on next periodic event.  */
+            LogError("IoTHub telemetry store send fail: 0x%02x", status);
+            nx_packet_release(packet_ptr);
+            return;
+        }
+
+        if (store_ptr -> store_dropped_count == dropped_count)
+        {
+            if (store_ptr -> store_used)
+            {
+                nx_azure_iot_hub_client_telemetry_store_pop(store_ptr);
+            }
+        }
+        else
+        {
+
+            /* Record was dropped while it was sent, it was delivered so do not count it.  */
+            store_ptr -> store_dropped_count--;
+        }
+
+        nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, record.record_qos, 1);
+    }
+
+    /* Come back for the rest once other events are processed.  */
+    if ((drain_count == NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DRAIN_COUNT) && store_ptr -> store_used)
+    {
+        nx_cloud_module_event_set(&(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_cloud_module),
+                                  NX_AZURE_IOT_HUB_CLIENT_PUBLISH_EVENT);
+    }
+}
+
+UINT nx_azure_iot_hub_client_telemetry_spool_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                 NX_AZURE_IOT_SPOOL *spool_ptr)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry spool set fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    nx_azure_iot_hub_client_telemetry_spool_reset(hub_client_ptr);
+    hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr = spool_ptr;
+
+    /* Replay what is left from previous run.  */
+    if ((hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED) &&
+        nx_azure_iot_spool_pending(spool_ptr))
+    {
+        nx_cloud_module_event_set(&(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_cloud_module),
+                                  NX_AZURE_IOT_HUB_CLIENT_CONNECT_EVENT);
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_hub_client_telemetry_spool_put(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                        UINT data_size, UINT qos, UINT *stored_ptr)
+{
+NX_AZURE_IOT_SPOOL *spool_ptr;
+UCHAR header[NX_AZURE_IOT_HUB_CLIENT_SPOOL_RECORD_HEADER_SIZE];
+NX_AZURE_IOT_IOVEC vec[NX_AZURE_IOT_HUB_CLIENT_SPOOL_VEC_MAX_COUNT];
+NX_PACKET *current_ptr;
+UINT count = 0;
+UINT status;
+
+    *stored_ptr = NX_FALSE;
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    /* Send directly if connected and nothing is waiting in spool.  */
+    spool_ptr = hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr;
+    if ((spool_ptr == NX_NULL) ||
+        ((hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED) &&
+         !nx_azure_iot_spool_pending(spool_ptr)))
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    if (telemetry_data == NX_NULL)
+    {
+        data_size = 0;
+    }
+
+    /* Record is made of record header, topic and payload.  */
+    nx_azure_iot_spool_ulong_put(header, packet_ptr -> nx_packet_length);
+    nx_azure_iot_spool_ulong_put(header + 4, data_size);
+    header[8] = (UCHAR)qos;
+    vec[count].iovec_base = header;
+    vec[count++].iovec_length = sizeof(header);
+
+    for (current_ptr = packet_ptr;
+         current_ptr && (count < (NX_AZURE_IOT_HUB_CLIENT_SPOOL_VEC_MAX_COUNT - 1));
+         current_ptr = current_ptr -> nx_packet_next)
+    {
+        vec[count].iovec_base = current_ptr -> nx_packet_prepend_ptr;
+        vec[count++].iovec_length = (UINT)(current_ptr -> nx_packet_append_ptr - current_ptr -> nx_packet_prepend_ptr);
+    }
+
+    if (current_ptr)
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        LogError("IoTHub telemetry spool fail: TOO MANY PACKETS IN CHAIN");
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    if (data_size)
+    {
+        vec[count].iovec_base = telemetry_data;
+        vec[count++].iovec_length = data_size;
+    }
+
+    status = nx_azure_iot_spool_append(spool_ptr, vec, count);
+    if (status)
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        LogError("IoTHub telemetry spool fail: 0x%02x", status);
+        return(status);
+    }
+
+    /* Replay soon if already connected.  */
+    if (hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED)
+    {
+        nx_cloud_module_event_set(&(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_cloud_module),
+                                  NX_AZURE_IOT_HUB_CLIENT_CONNECT_EVENT);
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    /* Message is persisted, so the packet is consumed as it would be by a successful send.  */
+    nx_packet_release(packet_ptr);
+    *stored_ptr = NX_TRUE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_hub_client_telemetry_spool_payload_read(NX_AZURE_IOT_SPOOL *spool_ptr,
+                                                                 NX_PACKET *packet_ptr, ULONG offset,
+                                                                 UINT length)
+{
+NX_PACKET *last_ptr;
+NX_PACKET *new_packet_ptr;
+UINT size;
+UINT status;
+
+    /* Read payload from spool directly into free space of packet chain.  */
+    last_ptr = nx_azure_iot_packet_tail_get(packet_ptr);
+    while (length)
+    {
+        size = (UINT)(last_ptr -> nx_packet_data_end - last_ptr -> nx_packet_append_ptr);
+        if (size == 0)
+        {
+            status = nx_packet_allocate(packet_ptr -> nx_packet_pool_owner, &new_packet_ptr, 0,
+                                        NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT);
+            if (status)
+            {
+                return(status);
+            }
+
+            last_ptr -> nx_packet_next = new_packet_ptr;
+            packet_ptr -> nx_packet_last = new_packet_ptr;
+            last_ptr = new_packet_ptr;
+            continue;
+        }
+
+        if (size > length)
+        {
+            size = length;
+        }
+
+        status = nx_azure_iot_spool_record_read(spool_ptr, offset, last_ptr -> nx_packet_append_ptr, size);
+        if (status)
+        {
+            return(status);
+        }
+
+        last_ptr -> nx_packet_append_ptr += size;
+        packet_ptr -> nx_packet_length += size;
+        offset += size;
+        length -= size;
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_spool_replay(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+NX_AZURE_IOT_SPOOL *spool_ptr = hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr;
+NX_AZURE_IOT_HUB_CLIENT_SPOOL_PENDING *pending_ptr = hub_client_ptr -> nx_azure_iot_hub_client_spool_pending;
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD record;
+UCHAR header[NX_AZURE_IOT_HUB_CLIENT_SPOOL_RECORD_HEADER_SIZE];
+NX_PACKET *packet_ptr;
+ULONG record_length;
+UCHAR packet_id[2];
+UINT acked_count;
+UINT status;
+
+    /* This function must be called with mutex held.  */
+    if (spool_ptr == NX_NULL)
+    {
+        return;
+    }
+
+    /* Commit records acknowledged in order. Records sent at QoS 0 have no acknowledgement.  */
+    for (acked_count = 0; acked_count < hub_client_ptr -> nx_azure_iot_hub_client_spool_pending_count; acked_count++)
+    {
+        if (pending_ptr[acked_count].pending_packet_id && !pending_ptr[acked_count].pending_acked)
+        {
+            break;
+        }
+    }
+
+    if (acked_count)
+    {
+        if (nx_azure_iot_spool_commit(spool_ptr, &(pending_ptr[acked_count - 1].pending_position)))
+        {
+
+            /* Keep pending records, commit is retried on next event.  */
+            return;
+        }
+
+        hub_client_ptr -> nx_azure_iot_hub_client_spool_pending_count -= acked_count;
+        memmove(pending_ptr, pending_ptr + acked_count,
+                hub_client_ptr -> nx_azure_iot_hub_client_spool_pending_count * sizeof(NX_AZURE_IOT_HUB_CLIENT_SPOOL_PENDING));
+    }
+
+    /* Replay records while in-flight window allows.  */
+    while ((hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED) &&
+           (hub_client_ptr -> nx_azure_iot_hub_client_spool_pending_count <
+            hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_window))
+    {
+        if (nx_azure_iot_spool_peek(spool_ptr, &record_length) ||
+            nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+                                                       1, NX_NO_WAIT))
+        {
+            return;
+        }
+
+        if ((record_length < sizeof(header)) ||
+            nx_azure_iot_spool_record_read(spool_ptr, 0, header, sizeof(header)))
+        {
+
+            /* Retry on next periodic event.  */
+            return;
+        }
+
+        record.record_topic_length = (UINT)nx_azure_iot_spool_ulong_get(header);
+        record.record_payload_length = (UINT)nx_azure_iot_spool_ulong_get(header + 4);
+        record.record_qos = header[8];
+
+        status = nx_azure_iot_publish_packet_get(hub_client_ptr -> nx_azure_iot_ptr,
+                                                 &(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                 &packet_ptr, NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT);
+        if (status)
+        {
+
+            /* Retry on next periodic event.  */
+            return;
+        }
+
+        /* Record that can never be sent is skipped, otherwise it would block the rest of spool.
+           It is committed along with the records around it.  Topic must stay in the first packet.  */
+        if ((record.record_topic_length > (record_length - sizeof(header))) ||
+            (record.record_payload_length != (record_length - sizeof(header) - record.record_topic_length)) ||
+            (record.record_qos > NX_AZURE_IOT_MQTT_QOS_1) ||
+            (record.record_topic_length >
+             (UINT)(packet_ptr -> nx_packet_data_end - packet_ptr -> nx_packet_prepend_ptr)))
+        {
+            LogError("IoTHub telemetry spool replay skip: INVALID RECORD");
+            nx_packet_release(packet_ptr);
+            pending_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_spool_pending[hub_client_ptr -> nx_azure_iot_hub_client_spool_pending_count++]);
+            pending_ptr -> pending_packet_id = 0;
+            pending_ptr -> pending_acked = NX_FALSE;
+            nx_azure_iot_spool_advance(spool_ptr, &(pending_ptr -> pending_position));
+            pending_ptr = hub_client_ptr -> nx_azure_iot_hub_client_spool_pending;
+            continue;
+        }
+
+        status = nx_azure_iot_spool_record_read(spool_ptr, sizeof(header), packet_ptr -> nx_packet_prepend_ptr,
+                                                record.record_topic_length);
+        packet_ptr -> nx_packet_append_ptr = packet_ptr -> nx_packet_prepend_ptr + record.record_topic_length;
+        packet_ptr -> nx_packet_length = record.record_topic_length;
+
+        packet_id[0] = 0;
+        packet_id[1] = 0;
+        if ((status == NX_AZURE_IOT_SUCCESS) && (record.record_qos == NX_AZURE_IOT_MQTT_QOS_1))
+        {
+            status = nx_azure_iot_mqtt_packet_id_get(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                     packet_id, NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT);
+            if (status == NX_AZURE_IOT_SUCCESS)
+            {
+                status = nx_packet_data_append(packet_ptr, packet_id, sizeof(packet_id),
+                                               packet_ptr -> nx_packet_pool_owner,
+                                               NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT);
+            }
+        }
+
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            status = nx_azure_iot_hub_client_telemetry_spool_payload_read(spool_ptr, packet_ptr,
+                                                                          sizeof(header) + record.record_topic_length,
+                                                                          record.record_payload_length);
+        }
+
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            status = nx_azure_iot_publish_mqtt_packet(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                                      packet_ptr, record.record_topic_length, packet_id,
+                                                      record.record_qos, NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT);
+        }
+
+        if (status)
+        {
+
+            /* Record stays at read position and is retried on next periodic event.  */
+            LogError("IoTHub telemetry spool replay fail: 0x%02x", status);
+            nx_packet_release(packet_ptr);
+            return;
+        }
+
+        /* Link dropped during send. Disconnect already rewound spool, so record is replayed on next connection.  */
+        if (hub_client_ptr -> nx_azure_iot_hub_client_state != NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED)
+        {
+            return;
+        }
+
+        pending_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_spool_pending[hub_client_ptr -> nx_azure_iot_hub_client_spool_pending_count++]);
+        pending_ptr -> pending_packet_id = (USHORT)((packet_id[0] << 8) | packet_id[1]);
+        pending_ptr -> pending_acked = NX_FALSE;
+        nx_azure_iot_spool_advance(spool_ptr, &(pending_ptr -> pending_position));
+        pending_ptr = hub_client_ptr -> nx_azure_iot_hub_client_spool_pending;
+
+        nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, record.record_qos, 1);
+    }
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_spool_reset(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+
+    /* This function must be called with mutex held.
+       Records without PUBACK are not committed and are replayed again.  */
+    hub_client_ptr -> nx_azure_iot_hub_client_spool_pending_count = 0;
+    if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr)
+    {
+        nx_azure_iot_spool_rewind(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_spool_ptr);
+    }
+}
+
+static VOID nx_azure_iot_hub_client_telemetry_count_update(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                           UINT qos, UINT count)
+{
+TX_INTERRUPT_SAVE_AREA
+
+    /* Counters are updated with interrupts disabled so QoS 0 path does not need any mutex. */
+    TX_DISABLE
+    if (qos == NX_AZURE_IOT_MQTT_QOS_0)
+    {
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_qos0_count += count;
+    }
+    else
+    {
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_qos1_count += count;
+    }
+    TX_RESTORE
+}
+
+UINT nx_azure_iot_hub_client_telemetry_ack_callback_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        VOID (*callback_ptr)(
+                                                              NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                              USHORT packet_id, UINT status, VOID *args),
+                                                        VOID *callback_args)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry ack callback set fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    hub_client_ptr -> nx_azure_iot_hub_client_telemetry_ack_callback = callback_ptr;
+    hub_client_ptr -> nx_azure_iot_hub_client_telemetry_ack_callback_args = callback_args;
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_inflight_window_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT window)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry inflight window set fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if ((window == 0) || (window > NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT))
+    {
+        LogError("IoTHub telemetry inflight window set fail: INVALID WINDOW");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_window = window;
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_send_async(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                  NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                  UINT data_size, USHORT *packet_id_ptr, UINT wait_option)
+{
+UINT status;
+UINT topic_len;
+UINT index;
+UCHAR packet_id[2];
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT *inflight_ptr;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        (packet_ptr == NX_NULL) || (packet_id_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry send async fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    status = nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+                                                        1, wait_option);
+    if (status)
+    {
+        LogError("IoTHub telemetry send async fail: THROTTLED");
+        return(status);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    /* Reclaim acknowledged entries before checking the window.  */
+    if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count >=
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_window)
+    {
+        nx_azure_iot_hub_client_telemetry_inflight_process(hub_client_ptr, NX_AZURE_IOT_SUCCESS);
+    }
+
+    if (hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count >=
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_window)
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        return(NX_AZURE_IOT_INFLIGHT_WINDOW_FULL);
+    }
+
+    status = nx_azure_iot_mqtt_packet_id_get(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                             packet_id, wait_option);
+    if (status)
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+        LogError("IoTHub client send async fail: 0x%02x", status);
+        return(status);
+    }
+
+    /* Track message before it is published, so a PUBACK arriving before publish returns completes it.  */
+    for (index = 0; index < NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT; index++)
+    {
+        inflight_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight[index]);
+        if (inflight_ptr -> inflight_packet_id == 0)
+        {
+            inflight_ptr -> inflight_packet_id = (USHORT)((packet_id[0] << 8) | packet_id[1]);
+            inflight_ptr -> inflight_start_time = tx_time_get();
+            hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count++;
+            break;
+        }
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    topic_len = (UINT)packet_ptr -> nx_packet_length;
+
+    /* Append packet identifier */
+    status = nx_packet_data_append(packet_ptr, packet_id, sizeof(packet_id),
+                                   packet_ptr -> nx_packet_pool_owner,
+                                   wait_option);
+
+    if ((status == NX_AZURE_IOT_SUCCESS) && telemetry_data && (data_size != 0))
+    {
+
+        /* Append payload. */
+        status = nx_packet_data_append(packet_ptr, telemetry_data, data_size,
+                                       packet_ptr -> nx_packet_pool_owner,
+                                       wait_option);
+    }
+
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = nx_azure_iot_hub_client_publish(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK, packet_ptr,
+                                                 topic_len, packet_id, NX_AZURE_IOT_MQTT_QOS_1, wait_option);
+    }
+
+    if (status)
+    {
+
+        /* Obtain the mutex.  */
+        tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+        /* Return entry to window, unless disconnect already completed it.  */
+        for (index = 0; index < NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT; index++)
+        {
+            inflight_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight[index]);
+            if (inflight_ptr -> inflight_packet_id == (USHORT)((packet_id[0] << 8) | packet_id[1]))
+            {
+                inflight_ptr -> inflight_packet_id = 0;
+                hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count--;
+                break;
+            }
+        }
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+        LogError("IoTHub client send async fail: 0x%02x", status);
+        return(status);
+    }
+
+    nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, NX_AZURE_IOT_MQTT_QOS_1, 1);
+
+    *packet_id_ptr = (USHORT)((packet_id[0] << 8) | packet_id[1]);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_sendv(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                             const NX_AZURE_IOT_IOVEC *vec, UINT count, UINT wait_option)
+{
+UINT status;
+UINT topic_len;
+UINT index;
+ULONG remaining_length;
+UCHAR packet_id[2];
+NX_AZURE_IOT_IOVEC packet_id_vec;
+
+    if ((hub_client_ptr == NX_NULL) || (packet_ptr == NX_NULL) ||
+        ((vec == NX_NULL) && (count != 0)))
+    {
+        LogError("IoTHub telemetry sendv fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    topic_len = (UINT)packet_ptr -> nx_packet_length;
+
+    /* Compute remaining length up front: topic length, topic, packet id and all fragments.
+       Each fragment is checked against the space left before it is added, so the sum cannot wrap.  */
+    remaining_length = 2 + (ULONG)topic_len + 2;
+    if (remaining_length > NX_AZURE_IOT_MQTT_MAX_REMAINING_LENGTH)
+    {
+        LogError("IoTHub telemetry sendv fail: MESSAGE TOO LONG");
+        return(NX_AZURE_IOT_MESSAGE_TOO_LONG);
+    }
+
+    for (index = 0; index < count; index++)
+    {
+        if (vec[index].iovec_length > (NX_AZURE_IOT_MQTT_MAX_REMAINING_LENGTH - remaining_length))
+        {
+            LogError("IoTHub telemetry sendv fail: MESSAGE TOO LONG");
+            return(NX_AZURE_IOT_MESSAGE_TOO_LONG);
+        }
+
+        remaining_length += vec[index].iovec_length;
+    }
+
+    status = nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+                                                        1, wait_option);
+    if (status)
+    {
+        LogError("IoTHub telemetry sendv fail: THROTTLED");
+        return(status);
+    }
+
+    status = nx_azure_iot_mqtt_packet_id_get(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                             packet_id, wait_option);
+    if (status)
+    {
+        LogError("Failed to get packet id");
+        return(status);
+    }
+
+    status = nx_azure_iot_publish_packet_header_write(packet_ptr, topic_len, NX_AZURE_IOT_MQTT_QOS_1,
+                                                      (UINT)remaining_length);
+    if (status)
+    {
+        LogError("failed to add mqtt header");
+        return(status);
+    }
+
+    /* Fill packet identifier and payload fragments in one pass. */
+    packet_id_vec.iovec_base = packet_id;
+    packet_id_vec.iovec_length = sizeof(packet_id);
+    status = nx_azure_iot_packet_data_gather(packet_ptr, &packet_id_vec, 1, wait_option);
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = nx_azure_iot_packet_data_gather(packet_ptr, vec, count, wait_option);
+    }
+
+    if (status)
+    {
+        LogError("Telemetry data gather fail");
+        return(status);
+    }
+
+    status = nx_azure_iot_hub_client_publish_packet(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK,
+                                                    packet_ptr, packet_id, NX_AZURE_IOT_MQTT_QOS_1, wait_option);
+    if (status)
+    {
+        LogError("IoTHub client send fail: PUBLISH FAIL: 0x%02x", status);
+        return(status);
+    }
+
+    nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, NX_AZURE_IOT_MQTT_QOS_1, 1);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_batch_begin(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                   NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH *batch_ptr)
+{
+    if ((hub_client_ptr == NX_NULL) || (batch_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry batch begin fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    memset(batch_ptr, 0, sizeof(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH));
+    batch_ptr -> batch_hub_client_ptr = hub_client_ptr;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_batch_add(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH *batch_ptr,
+                                                 NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                 UINT data_size, USHORT *packet_id_ptr, UINT wait_option)
+{
+UINT status;
+UINT topic_len;
+ULONG batch_length = 0;
+UCHAR packet_id[2];
+NX_PACKET *head_ptr;
+
+    if ((batch_ptr == NX_NULL) || (batch_ptr -> batch_hub_client_ptr == NX_NULL) || (packet_ptr == NX_NULL) ||
+        (packet_id_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry batch add fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    head_ptr = batch_ptr -> batch_packet_ptr;
+    if (head_ptr)
+    {
+        batch_length = head_ptr -> nx_packet_length;
+    }
+
+    /* Frame contains fixed header, topic, packet id and payload. Whole batch must fit the in-flight window,
+       so it can be tracked once flushed.  */
+    if ((batch_ptr -> batch_count >= NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_COUNT) ||
+        (batch_ptr -> batch_count >=
+         batch_ptr -> batch_hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_window) ||
+        ((batch_length + NX_AZURE_IOT_PUBLISH_PACKET_START_OFFSET + packet_ptr -> nx_packet_length +
+          sizeof(packet_id) + data_size) > NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_SIZE))
+    {
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    status = nx_azure_iot_mqtt_packet_id_get(&(batch_ptr -> batch_hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                             packet_id, wait_option);
+    if (status)
+    {
+        LogError("Failed to get packet id");
+        return(status);
+    }
+
+    topic_len = (UINT)packet_ptr -> nx_packet_length;
+
+    /* Append packet identifier */
+    status = nx_packet_data_append(packet_ptr, packet_id, sizeof(packet_id),
+                                   packet_ptr -> nx_packet_pool_owner,
+                                   wait_option);
+    if (status)
+    {
+        LogError("Failed to append data");
+        return(status);
+    }
+
+    if (telemetry_data && (data_size != 0))
+    {
+
+        /* Append payload. */
+        status = nx_packet_data_append(packet_ptr, telemetry_data, data_size,
+                                       packet_ptr -> nx_packet_pool_owner,
+                                       wait_option);
+        if (status)
+        {
+            LogError("Telemetry data append fail");
+            return(status);
+        }
+    }
+
+    status = nx_azure_iot_publish_packet_header_add(packet_ptr, topic_len, NX_AZURE_IOT_MQTT_QOS_1);
+    if (status)
+    {
+        LogError("failed to add mqtt header");
+        return(status);
+    }
+
+    if (head_ptr == NX_NULL)
+    {
+
+        /* First frame heads the batch, keeping the TLS header room of its packet. */
+        batch_ptr -> batch_packet_ptr = packet_ptr;
+    }
+    else
+    {
+
+        /* Chain frame after the last packet of the batch. */
+        nx_azure_iot_hub_client_packet_chain_link(head_ptr, packet_ptr);
+    }
+
+    batch_ptr -> batch_packet_id[batch_ptr -> batch_count] = (USHORT)((packet_id[0] << 8) | packet_id[1]);
+    batch_ptr -> batch_count++;
+    *packet_id_ptr = (USHORT)((packet_id[0] << 8) | packet_id[1]);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_telemetry_batch_flush(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH *batch_ptr,
+                                                   UINT wait_option)
+{
+UINT status;
+UINT batch_count;
+UINT index;
+UINT inflight_index = 0;
+UCHAR packet_id[2];
+NX_PACKET *packet_ptr;
+NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr;
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT *inflight_ptr;
+
+    if ((batch_ptr == NX_NULL) || (batch_ptr -> batch_hub_client_ptr == NX_NULL))
+    {
+        LogError("IoTHub telemetry batch flush fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    packet_ptr = batch_ptr -> batch_packet_ptr;
+    if (packet_ptr == NX_NULL)
+    {
+
+        /* Nothing to send. */
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    hub_client_ptr = batch_ptr -> batch_hub_client_ptr;
+
+    /* Batch is kept if throttled.  */
+    status = nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr,
+                                                        NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+                                                        batch_ptr -> batch_count, wait_option);
+    if (status)
+    {
+        LogError("IoTHub telemetry batch flush fail: THROTTLED");
+        return(status);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    /* Reclaim acknowledged entries before checking the window.  */
+    if ((hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count + batch_ptr -> batch_count) >
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_window)
+    {
+        nx_azure_iot_hub_client_telemetry_inflight_process(hub_client_ptr, NX_AZURE_IOT_SUCCESS);
+    }
+
+    if ((hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count + batch_ptr -> batch_count) >
+        hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_window)
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        return(NX_AZURE_IOT_INFLIGHT_WINDOW_FULL);
+    }
+
+    /* Track every message before the chain is published, so a PUBACK arriving before publish returns
+       completes it.  */
+    for (index = 0; index < batch_ptr -> batch_count; index++)
+    {
+        for (; inflight_index < NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT; inflight_index++)
+        {
+            inflight_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight[inflight_index]);
+            if (inflight_ptr -> inflight_packet_id == 0)
+            {
+                inflight_ptr -> inflight_packet_id = batch_ptr -> batch_packet_id[index];
+                inflight_ptr -> inflight_start_time = tx_time_get();
+                hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count++;
+                break;
+            }
+        }
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    /* Reset batch before sending, the packet chain is owned by MQTT or released below. */
+    batch_count = batch_ptr -> batch_count;
+    batch_ptr -> batch_packet_ptr = NX_NULL;
+    batch_ptr -> batch_count = 0;
+
+    /* MQTT keeps the chain for retransmission under packet id of its first frame. PUBACK of every frame
+       is matched against the in-flight table.  */
+    packet_id[0] = (UCHAR)(batch_ptr -> batch_packet_id[0] >> 8);
+    packet_id[1] = (UCHAR)(batch_ptr -> batch_packet_id[0] & 0xFF);
+    status = nx_azure_iot_hub_client_publish_packet(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK,
+                                                    packet_ptr, packet_id, NX_AZURE_IOT_MQTT_QOS_1, wait_option);
+    if (status)
+    {
+        LogError("IoTHub client batch send fail: PUBLISH FAIL: 0x%02x", status);
+        nx_packet_release(packet_ptr);
+
+        /* Obtain the mutex.  */
+        tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+        /* Return entries to window, unless disconnect already completed them.  */
+        for (index = 0; index < batch_count; index++)
+        {
+            for (inflight_index = 0; inflight_index < NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT;
+                 inflight_index++)
+            {
+                inflight_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight[inflight_index]);
+                if (inflight_ptr -> inflight_packet_id == batch_ptr -> batch_packet_id[index])
+                {
+                    inflight_ptr -> inflight_packet_id = 0;
+                    hub_client_ptr -> nx_azure_iot_hub_client_telemetry_inflight_count--;
+                    break;
+                }
+            }
+        }
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+        return(status);
+    }
+
+    nx_azure_iot_hub_client_telemetry_count_update(hub_client_ptr, NX_AZURE_IOT_MQTT_QOS_1, batch_count);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_receive_callback_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                  UINT message_type,
+                                                  VOID (*callback_ptr)(
+                                                        NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        VOID *args),
+                                                  VOID *callback_args)
+{
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub receive callback set fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    if (message_type == NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE)
+    {
+        hub_client_ptr -> nx_azure_iot_hub_client_c2d_message.message_callback = callback_ptr;
+        hub_client_ptr -> nx_azure_iot_hub_client_c2d_message.message_callback_args = callback_args;
+    }
+    else if (message_type == NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES)
+    {
+        hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message.message_callback = callback_ptr;
+        hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message.message_callback_args = callback_args;
+    }
+    else if (message_type == NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES)
+    {
         hub_client_ptr -> nx_azure_iot_hub_client_device_twin_desired_properties_message.message_callback = callback_ptr;
         hub_client_ptr -> nx_azure_iot_hub_client_device_twin_desired_properties_message.message_callback_args = callback_args;
     }
-    else if (message_type == NX_AZURE_IOT_HUB_DIRECT_METHOD)
+    else if (message_type == NX_AZURE_IOT_HUB_DIRECT_METHOD)
+    {
+        hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message.message_callback = callback_ptr;
+        hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message.message_callback_args = callback_args;
+    }
+    else
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        return(NX_AZURE_IOT_NOT_SUPPORTED);
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_receive_packet_callback_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                         UINT message_type,
+                                                         VOID (*callback_ptr)(
+                                                               NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                               NX_PACKET *packet_ptr,
+                                                               const NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO *info_ptr,
+                                                               VOID *args),
+                                                         VOID *callback_args)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub receive packet callback set fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr, message_type);
+    if (receive_message == NX_NULL)
+    {
+        return(NX_AZURE_IOT_NOT_SUPPORTED);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    receive_message -> message_packet_callback = callback_ptr;
+    receive_message -> message_packet_callback_args = callback_args;
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *nx_azure_iot_hub_client_receive_message_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                                          UINT message_type)
+{
+    switch (message_type)
+    {
+        case NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE :
+            return(&(hub_client_ptr -> nx_azure_iot_hub_client_c2d_message));
+
+        case NX_AZURE_IOT_HUB_DIRECT_METHOD :
+            return(&(hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message));
+
+        case NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES :
+            return(&(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message));
+
+        case NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES :
+            return(&(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_desired_properties_message));
+
+        default :
+            return(NX_NULL);
+    }
+}
+
+UINT nx_azure_iot_hub_client_receive_queue_configure(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type,
+                                                     UINT depth, UINT policy)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub receive queue configure fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (policy > NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_STOP_READING)
+    {
+        LogError("IoTHub receive queue configure fail: INVALID POLICY");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr, message_type);
+    if (receive_message == NX_NULL)
     {
-        hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message.message_callback = callback_ptr;
-        hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message.message_callback_args = callback_args;
+        LogError("IoTHub receive queue configure fail: NOT SUPPORTED");
+        return(NX_AZURE_IOT_NOT_SUPPORTED);
     }
-    else
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    receive_message -> message_count_max = depth;
+    receive_message -> message_policy = policy;
+
+    /* Held messages may fit or be dropped under new settings. */
+    nx_azure_iot_hub_client_receive_resume(hub_client_ptr);
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_receive_queue_status_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type,
+                                                      UINT *depth_ptr, UINT *high_water_mark_ptr,
+                                                      ULONG *dropped_count_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
     {
+        LogError("IoTHub receive queue status get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
 
-        /* Release the mutex.  */
-        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+    receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr, message_type);
+    if (receive_message == NX_NULL)
+    {
+        LogError("IoTHub receive queue status get fail: NOT SUPPORTED");
         return(NX_AZURE_IOT_NOT_SUPPORTED);
     }
 
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    if (depth_ptr)
+    {
+        *depth_ptr = receive_message -> message_count;
+    }
+
+    if (high_water_mark_ptr)
+    {
+        *high_water_mark_ptr = receive_message -> message_high_water_mark;
+    }
+
+    if (dropped_count_ptr)
+    {
+        *dropped_count_ptr = receive_message -> message_dropped_count;
+    }
+
     /* Release the mutex.  */
     tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
 
@@ -912,8 +3982,8 @@ static UINT nx_azure_iot_hub_client_message_receive(NX_AZURE_IOT_HUB_CLIENT *hub
                                                     NX_PACKET **packet_pptr, UINT wait_option)
 {
 NX_PACKET *packet_ptr = NX_NULL;
-UINT old_threshold;
 NX_AZURE_IOT_THREAD thread_list;
+UINT status;
 
     if ((hub_client_ptr == NX_NULL) ||
         (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
@@ -940,84 +4010,434 @@ NX_AZURE_IOT_THREAD thread_list;
             receive_message -> message_tail = NX_NULL;
         }
         receive_message -> message_head = packet_ptr -> nx_packet_queue_next;
+        receive_message -> message_count--;
+
+        /* Queue has room now, dispatch messages held by stop reading policy. */
+        nx_azure_iot_hub_client_receive_resume(hub_client_ptr);
     }
     else if (wait_option)
     {
         thread_list.thread_message_type = message_type;
-        thread_list.thread_ptr = tx_thread_identify();
         thread_list.thread_received_message = NX_NULL;
         thread_list.thread_expected_id = 0;
-        thread_list.thread_next = hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended;
-        hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended = &thread_list;
+        status = nx_azure_iot_hub_client_thread_enqueue(hub_client_ptr, &thread_list);
+        if (status)
+        {
+
+            /* Release the mutex.  */
+            tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+            LogError("IoTHub message receive fail: WAIT FAIL: 0x%02x", status);
+            return(status);
+        }
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+        /* Message handed over after the mutex is released leaves the semaphore put, so it is not missed. */
+        tx_semaphore_get(&(thread_list.thread_semaphore), wait_option);
+
+        /* Obtain the mutex.  */
+        tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+        nx_azure_iot_hub_client_thread_dequeue(hub_client_ptr, &thread_list);
+        packet_ptr = thread_list.thread_received_message;
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    if (packet_ptr == NX_NULL)
+    {
+        return(NX_AZURE_IOT_NO_PACKET);
+    }
+
+    *packet_pptr = packet_ptr;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_hub_client_adjust_payload(NX_PACKET *packet_ptr)
+{
+UINT status;
+ULONG topic_offset;
+USHORT topic_length;
+ULONG message_offset;
+ULONG message_length;
+UCHAR *header_ptr;
+NX_PACKET *current_packet_ptr;
+
+    status = _nxd_mqtt_process_publish_packet(packet_ptr, &topic_offset,
+                                              &topic_length, &message_offset,
+                                              &message_length);
+    if (status)
+    {
+        nx_packet_release(packet_ptr);
+        return(status);
+    }
+
+    header_ptr = packet_ptr -> nx_packet_prepend_ptr;
+    packet_ptr -> nx_packet_length = message_length;
+
+    /* Adjust packet to pointer to message payload. */
+    for (current_packet_ptr = packet_ptr;
+         current_packet_ptr;
+         current_packet_ptr = current_packet_ptr -> nx_packet_next)
+    {
+        if ((ULONG)(current_packet_ptr -> nx_packet_append_ptr - current_packet_ptr -> nx_packet_prepend_ptr) > message_offset)
+        {
+
+            /* This packet contains message payload. */
+            current_packet_ptr -> nx_packet_prepend_ptr = current_packet_ptr -> nx_packet_prepend_ptr + message_offset;
+            break;
+        }
+
+        message_offset -= (ULONG)(current_packet_ptr -> nx_packet_append_ptr - current_packet_ptr -> nx_packet_prepend_ptr);
+
+        /* Set current packet to empty. */
+        current_packet_ptr -> nx_packet_prepend_ptr = current_packet_ptr -> nx_packet_append_ptr;
+    }
+
+    /* Header and topic are contiguous in the first packet. Keep them at nx_packet_data_start so topic can still
+     * be parsed, and leave payload where the driver put it. Header only moves backward and ends before payload.  */
+    if (header_ptr != packet_ptr -> nx_packet_data_start)
+    {
+        memmove(packet_ptr -> nx_packet_data_start, header_ptr, (UINT)(topic_offset + topic_length));
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static VOID nx_azure_iot_hub_client_receive_ring_write(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message,
+                                                       const UCHAR *data_ptr, UINT data_size)
+{
+UINT offset = (receive_message -> message_ring_head + receive_message -> message_ring_used) %
+              receive_message -> message_ring_size;
+UINT copy_size;
+
+    /* Caller makes sure there is enough free space.  */
+    copy_size = receive_message -> message_ring_size - offset;
+    if (copy_size > data_size)
+    {
+        copy_size = data_size;
+    }
+
+    memcpy(receive_message -> message_ring_buffer + offset, data_ptr, copy_size);
+    memcpy(receive_message -> message_ring_buffer, data_ptr + copy_size, data_size - copy_size);
+    receive_message -> message_ring_used += data_size;
+}
+
+static VOID nx_azure_iot_hub_client_receive_ring_read(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message,
+                                                      UINT offset, UCHAR *data_ptr, UINT data_size)
+{
+UINT copy_size;
+
+    offset = (receive_message -> message_ring_head + offset) % receive_message -> message_ring_size;
+    copy_size = receive_message -> message_ring_size - offset;
+    if (copy_size > data_size)
+    {
+        copy_size = data_size;
+    }
+
+    memcpy(data_ptr, receive_message -> message_ring_buffer + offset, copy_size);
+    memcpy(data_ptr + copy_size, receive_message -> message_ring_buffer, data_size - copy_size);
+}
+
+static VOID nx_azure_iot_hub_client_receive_ring_pop(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RECORD record;
+UINT record_size;
+
+    nx_azure_iot_hub_client_receive_ring_read(receive_message, 0, (UCHAR *)&record, sizeof(record));
+    record_size = (UINT)sizeof(record) + record.record_topic_length + record.record_payload_length;
 
-        /* Disable preemption. */
-        tx_thread_preemption_change(tx_thread_identify(), 0, &old_threshold);
+    receive_message -> message_ring_head = (receive_message -> message_ring_head + record_size) %
+                                           receive_message -> message_ring_size;
+    receive_message -> message_ring_used -= record_size;
+}
+
+static UINT nx_azure_iot_hub_client_receive_ring_put(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                     NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message,
+                                                     NX_PACKET *packet_ptr,
+                                                     NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO *info_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RECORD record;
+NX_AZURE_IOT_PACKET_CURSOR cursor;
+ULONG topic_offset;
+USHORT topic_length;
+ULONG message_offset;
+ULONG message_length;
+UINT topic_size;
+UINT free_size;
+UINT payload_size;
+UCHAR *data_ptr;
+UINT length;
+
+    /* This function is protected by MQTT mutex. Packet is consumed unless NX_AZURE_IOT_PENDING is returned. */
+    if (_nxd_mqtt_process_publish_packet(packet_ptr, &topic_offset, &topic_length,
+                                         &message_offset, &message_length))
+    {
+        LogError("IoTHub client receive ring put fail: INVALID PACKET");
+        nx_packet_release(packet_ptr);
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    topic_size = (receive_message -> message_ring_flags & NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RING_TOPIC) ?
+                 info_ptr -> info_topic_length : 0;
+
+    /* Make room according to policy.  */
+    if ((receive_message -> message_ring_size - receive_message -> message_ring_used) <
+        ((ULONG)sizeof(record) + topic_size + message_length))
+    {
+        if ((receive_message -> message_policy == NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_STOP_READING) &&
+            receive_message -> message_ring_used)
+        {
+
+            /* Leave message with MQTT until application reads ring. */
+            return(NX_AZURE_IOT_PENDING);
+        }
+
+        while ((receive_message -> message_policy == NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_OLDEST) &&
+               receive_message -> message_ring_used &&
+               ((receive_message -> message_ring_size - receive_message -> message_ring_used) <
+                ((ULONG)sizeof(record) + topic_size + message_length)))
+        {
+            nx_azure_iot_hub_client_receive_ring_pop(receive_message);
+            receive_message -> message_dropped_count++;
+        }
+
+        if ((receive_message -> message_policy == NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_NEWEST) &&
+            receive_message -> message_ring_used)
+        {
+
+            /* Drop new message whole, as the packet queue does. */
+            receive_message -> message_dropped_count++;
+            nx_packet_release(packet_ptr);
+            return(NX_AZURE_IOT_SUCCESS);
+        }
+    }
+
+    free_size = receive_message -> message_ring_size - receive_message -> message_ring_used;
+    if (free_size < ((UINT)sizeof(record) + topic_size))
+    {
+        receive_message -> message_dropped_count++;
+        nx_packet_release(packet_ptr);
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    /* Ring is empty here unless message fits. Payload larger than the whole ring is truncated.  */
+    payload_size = free_size - (UINT)sizeof(record) - topic_size;
+    if (payload_size > message_length)
+    {
+        payload_size = (UINT)message_length;
+    }
+
+    record.record_topic_length = topic_size;
+    record.record_payload_length = payload_size;
+    record.record_truncated_length = message_length - payload_size;
+    nx_azure_iot_hub_client_receive_ring_write(receive_message, (UCHAR *)&record, sizeof(record));
+    nx_azure_iot_hub_client_receive_ring_write(receive_message, info_ptr -> info_topic, topic_size);
+
+    nx_azure_iot_packet_cursor_init(&cursor, packet_ptr);
+    nx_azure_iot_packet_cursor_skip(&cursor, message_offset);
+    while (payload_size &&
+           (nx_azure_iot_packet_cursor_span_get(&cursor, &data_ptr, &length) == NX_AZURE_IOT_SUCCESS))
+    {
+        if (length > payload_size)
+        {
+            length = payload_size;
+        }
+
+        nx_azure_iot_hub_client_receive_ring_write(receive_message, data_ptr, length);
+        nx_azure_iot_packet_cursor_skip(&cursor, length);
+        payload_size -= length;
+    }
+
+    /* Message is copied, return packets to pool now. */
+    nx_packet_release(packet_ptr);
+
+    /* Check for user callback function. */
+    if (receive_message -> message_callback)
+    {
+        receive_message -> message_callback(hub_client_ptr, receive_message -> message_callback_args);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_receive_ring_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type,
+                                                 UCHAR *buffer, UINT buffer_size, UINT flags)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        (buffer == NX_NULL) || (buffer_size <= sizeof(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RECORD)))
+    {
+        LogError("IoTHub receive ring enable fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr, message_type);
+    if ((receive_message == NX_NULL) || (message_type == NX_AZURE_IOT_HUB_DIRECT_METHOD))
+    {
+        return(NX_AZURE_IOT_NOT_SUPPORTED);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    receive_message -> message_ring_buffer = buffer;
+    receive_message -> message_ring_size = buffer_size;
+    receive_message -> message_ring_head = 0;
+    receive_message -> message_ring_used = 0;
+    receive_message -> message_ring_flags = flags;
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_receive_ring_disable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL))
+    {
+        LogError("IoTHub receive ring disable fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr, message_type);
+    if (receive_message == NX_NULL)
+    {
+        return(NX_AZURE_IOT_NOT_SUPPORTED);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    receive_message -> message_ring_buffer = NX_NULL;
+    receive_message -> message_ring_size = 0;
+    receive_message -> message_ring_head = 0;
+    receive_message -> message_ring_used = 0;
+
+    /* Messages held for the ring can be queued as packets now. */
+    nx_azure_iot_hub_client_receive_resume(hub_client_ptr);
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_message_copy_receive(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type,
+                                                  UCHAR *buffer, UINT buffer_size, UINT *topic_length_ptr,
+                                                  UINT *payload_length_ptr, ULONG *truncated_length_ptr,
+                                                  UINT wait_option)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RECORD record;
+NX_AZURE_IOT_PACKET_CURSOR cursor;
+NX_PACKET *packet_ptr;
+ULONG topic_offset;
+USHORT topic_length;
+ULONG message_length;
+UINT topic_copy = 0;
+UINT payload_copy = 0;
+UINT status;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        ((buffer == NX_NULL) && buffer_size) || (payload_length_ptr == NX_NULL))
+    {
+        LogError("IoTHub message copy receive fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr, message_type);
+    if ((receive_message == NX_NULL) || (message_type == NX_AZURE_IOT_HUB_DIRECT_METHOD))
+    {
+        return(NX_AZURE_IOT_NOT_SUPPORTED);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    if (receive_message -> message_ring_used)
+    {
+        nx_azure_iot_hub_client_receive_ring_read(receive_message, 0, (UCHAR *)&record, sizeof(record));
+        message_length = record.record_payload_length + record.record_truncated_length;
+
+        if (topic_length_ptr)
+        {
+            topic_copy = (record.record_topic_length > buffer_size) ? buffer_size : record.record_topic_length;
+            nx_azure_iot_hub_client_receive_ring_read(receive_message, sizeof(record), buffer, topic_copy);
+            message_length += record.record_topic_length;
+        }
+
+        payload_copy = buffer_size - topic_copy;
+        if (payload_copy > record.record_payload_length)
+        {
+            payload_copy = record.record_payload_length;
+        }
+
+        nx_azure_iot_hub_client_receive_ring_read(receive_message, (UINT)sizeof(record) + record.record_topic_length,
+                                                  buffer + topic_copy, payload_copy);
+        nx_azure_iot_hub_client_receive_ring_pop(receive_message);
+
+        /* Ring has room now, dispatch messages held by stop reading policy. */
+        nx_azure_iot_hub_client_receive_resume(hub_client_ptr);
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+    }
+    else
+    {
 
         /* Release the mutex.  */
         tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
 
-        tx_thread_sleep(wait_option);
+        status = nx_azure_iot_hub_client_message_receive(hub_client_ptr, message_type, receive_message,
+                                                         &packet_ptr, wait_option);
+        if (status)
+        {
+            return(status);
+        }
 
-        /* Obtain the mutex.  */
-        tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+        status = nx_azure_iot_hub_client_adjust_payload(packet_ptr);
+        if (status)
+        {
+            return(status);
+        }
 
-        nx_azure_iot_hub_client_thread_dequeue(hub_client_ptr, &thread_list);
+        message_length = packet_ptr -> nx_packet_length;
 
-        /* Restore preemption. */
-        tx_thread_preemption_change(tx_thread_identify(), old_threshold, &old_threshold);
-        packet_ptr = thread_list.thread_received_message;
-    }
+        /* Receive path keeps header and topic at nx_packet_data_start.  */
+        if (topic_length_ptr &&
+            (nx_azure_iot_hub_client_process_publish_packet(packet_ptr -> nx_packet_data_start,
+                                                            &topic_offset, &topic_length) == NX_AZURE_IOT_SUCCESS))
+        {
+            topic_copy = (topic_length > buffer_size) ? buffer_size : topic_length;
+            memcpy(buffer, packet_ptr -> nx_packet_data_start + topic_offset, topic_copy);
+            message_length += topic_length;
+        }
 
-    /* Release the mutex.  */
-    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        nx_azure_iot_packet_cursor_init(&cursor, packet_ptr);
+        nx_azure_iot_packet_cursor_read(&cursor, buffer + topic_copy, buffer_size - topic_copy, &payload_copy);
 
-    if (packet_ptr == NX_NULL)
-    {
-        return(NX_AZURE_IOT_NO_PACKET);
+        /* Message is copied, return packets to pool now. */
+        nx_packet_release(packet_ptr);
     }
 
-    *packet_pptr = packet_ptr;
-
-    return(NX_AZURE_IOT_SUCCESS);
-}
-
-static UINT nx_azure_iot_hub_client_adjust_payload(NX_PACKET *packet_ptr)
-{
-UINT status;
-ULONG topic_offset;
-USHORT topic_length;
-ULONG message_offset;
-ULONG message_length;
-
-    status = _nxd_mqtt_process_publish_packet(packet_ptr, &topic_offset,
-                                              &topic_length, &message_offset,
-                                              &message_length);
-    if (status)
+    if (topic_length_ptr)
     {
-        nx_packet_release(packet_ptr);
-        return(status);
+        *topic_length_ptr = topic_copy;
     }
 
-    packet_ptr -> nx_packet_length = message_length;
+    *payload_length_ptr = payload_copy;
 
-    /* Adjust packet to pointer to message payload. */
-    while (packet_ptr)
+    if (truncated_length_ptr)
     {
-        if ((ULONG)(packet_ptr -> nx_packet_append_ptr - packet_ptr -> nx_packet_prepend_ptr) > message_offset)
-        {
-
-            /* This packet contains message payload. */
-            packet_ptr -> nx_packet_prepend_ptr = packet_ptr -> nx_packet_prepend_ptr + message_offset;
-            break;
-        }
-
-        message_offset -= (ULONG)(packet_ptr -> nx_packet_append_ptr - packet_ptr -> nx_packet_prepend_ptr);
-
-        /* Set current packet to empty. */
-        packet_ptr -> nx_packet_prepend_ptr = packet_ptr -> nx_packet_append_ptr;
-
-        /* Move to next packet. */
-        packet_ptr = packet_ptr -> nx_packet_next;
+        *truncated_length_ptr = message_length - topic_copy - payload_copy;
     }
 
     return(NX_AZURE_IOT_SUCCESS);
@@ -1069,15 +4489,9 @@ az_span span;
         return(status);
     }
 
+    /* Receive path keeps header and topic at nx_packet_data_start.  */
     topic_name = packet_ptr -> nx_packet_data_start + topic_offset;
 
-    /* NOTE: Current implementation does not support topic to span multiple packets */
-    if ((ULONG)(packet_ptr -> nx_packet_append_ptr - topic_name) < (ULONG)topic_size)
-    {
-        LogError("IoTHub cloud message get property fail: topic out of boundaries of single packet");
-        return(NX_AZURE_IOT_TOPIC_TOO_LONG);
-    }
-
     receive_topic = az_span_init(topic_name, (INT)topic_size);
     core_result = az_iot_hub_client_c2d_parse_received_topic(&hub_client_ptr -> iot_hub_client_core,
                                                              receive_topic, &request);
@@ -1110,6 +4524,152 @@ az_span span;
     return(NX_AZURE_IOT_SUCCESS);
 }
 
+UINT nx_azure_iot_hub_client_cloud_message_property_index_build(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                NX_PACKET *packet_ptr,
+                                                                NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX *index_ptr)
+{
+USHORT topic_size;
+UINT status;
+UINT bucket;
+ULONG topic_offset;
+UCHAR *topic_name;
+az_iot_hub_client_c2d_request request;
+az_span receive_topic;
+az_result core_result;
+az_pair property;
+NX_AZURE_IOT_HUB_CLIENT_PROPERTY_ENTRY *entry_ptr;
+
+    if ((hub_client_ptr == NX_NULL) || (packet_ptr == NX_NULL) || (index_ptr == NX_NULL))
+    {
+        LogError("IoTHub cloud message property index build fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    status = nx_azure_iot_hub_client_process_publish_packet(packet_ptr -> nx_packet_data_start,
+                                                            &topic_offset, &topic_size);
+    if (status)
+    {
+        return(status);
+    }
+
+    /* Receive path keeps header and topic at nx_packet_data_start.  */
+    topic_name = packet_ptr -> nx_packet_data_start + topic_offset;
+
+    receive_topic = az_span_init(topic_name, (INT)topic_size);
+    core_result = az_iot_hub_client_c2d_parse_received_topic(&hub_client_ptr -> iot_hub_client_core,
+                                                             receive_topic, &request);
+    if (az_failed(core_result))
+    {
+        LogError("IoTHub cloud message property index build fail: parsing error");
+        return(NX_AZURE_IOT_SDK_CORE_ERROR);
+    }
+
+    memset(index_ptr, 0, sizeof(NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX));
+    index_ptr -> index_topic = topic_name;
+
+    /* Walk property bag once, keeping offsets into topic.  */
+    for (;;)
+    {
+        core_result = az_iot_hub_client_properties_next(&request.properties, &property);
+        if (core_result == AZ_ERROR_IOT_END_OF_PROPERTIES)
+        {
+            break;
+        }
+
+        if (az_failed(core_result))
+        {
+            LogError("IoTHub cloud message property index build fail: property next");
+            return(NX_AZURE_IOT_SDK_CORE_ERROR);
+        }
+
+        if (index_ptr -> index_count >= NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE)
+        {
+            LogError("IoTHub cloud message property index build fail: TOO MANY PROPERTIES");
+            return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+        }
+
+        entry_ptr = &(index_ptr -> index_entry[index_ptr -> index_count]);
+        entry_ptr -> entry_name_offset = (USHORT)(az_span_ptr(property.key) - topic_name);
+        entry_ptr -> entry_name_length = (USHORT)az_span_size(property.key);
+        entry_ptr -> entry_value_offset = (USHORT)(az_span_ptr(property.value) - topic_name);
+        entry_ptr -> entry_value_length = (USHORT)az_span_size(property.value);
+
+        /* Chain entry into its bucket. Links are entry position plus one, zero ends chain.  */
+        bucket = nx_azure_iot_hub_client_name_hash(az_span_ptr(property.key), entry_ptr -> entry_name_length) &
+                 (NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE - 1);
+        entry_ptr -> entry_next = index_ptr -> index_bucket[bucket];
+        index_ptr -> index_count++;
+        index_ptr -> index_bucket[bucket] = (UCHAR)index_ptr -> index_count;
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_cloud_message_property_index_get(NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX *index_ptr,
+                                                              const UCHAR *property_name, USHORT property_name_length,
+                                                              const UCHAR **property_value, USHORT *property_value_length)
+{
+UINT link;
+NX_AZURE_IOT_HUB_CLIENT_PROPERTY_ENTRY *entry_ptr;
+
+    if ((index_ptr == NX_NULL) || (property_name == NX_NULL) ||
+        (property_value == NX_NULL) || (property_value_length == NX_NULL))
+    {
+        LogError("IoTHub cloud message property index get fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    link = index_ptr -> index_bucket[nx_azure_iot_hub_client_name_hash(property_name, property_name_length) &
+                                     (NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE - 1)];
+    while (link)
+    {
+        entry_ptr = &(index_ptr -> index_entry[link - 1]);
+        if ((entry_ptr -> entry_name_length == property_name_length) &&
+            (memcmp(index_ptr -> index_topic + entry_ptr -> entry_name_offset,
+                    property_name, property_name_length) == 0))
+        {
+            *property_value = index_ptr -> index_topic + entry_ptr -> entry_value_offset;
+            *property_value_length = entry_ptr -> entry_value_length;
+            return(NX_AZURE_IOT_SUCCESS);
+        }
+
+        link = entry_ptr -> entry_next;
+    }
+
+    return(NX_AZURE_IOT_NOT_FOUND);
+}
+
+UINT nx_azure_iot_hub_client_cloud_message_property_index_next(NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX *index_ptr,
+                                                               UINT *position_ptr,
+                                                               const UCHAR **property_name, USHORT *property_name_length,
+                                                               const UCHAR **property_value, USHORT *property_value_length)
+{
+NX_AZURE_IOT_HUB_CLIENT_PROPERTY_ENTRY *entry_ptr;
+
+    if ((index_ptr == NX_NULL) || (position_ptr == NX_NULL) ||
+        (property_name == NX_NULL) || (property_name_length == NX_NULL) ||
+        (property_value == NX_NULL) || (property_value_length == NX_NULL))
+    {
+        LogError("IoTHub cloud message property index next fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (*position_ptr >= index_ptr -> index_count)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    /* Entries are kept in topic order.  */
+    entry_ptr = &(index_ptr -> index_entry[*position_ptr]);
+    *property_name = index_ptr -> index_topic + entry_ptr -> entry_name_offset;
+    *property_name_length = entry_ptr -> entry_name_length;
+    *property_value = index_ptr -> index_topic + entry_ptr -> entry_value_offset;
+    *property_value_length = entry_ptr -> entry_value_length;
+    (*position_ptr)++;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
 UINT nx_azure_iot_hub_client_device_twin_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
 {
 UINT status;
@@ -1206,6 +4766,45 @@ UINT nx_azure_iot_hub_client_device_twin_reported_properties_send(NX_AZURE_IOT_H
                                                                   UCHAR *message_buffer, UINT message_length,
                                                                   UINT *request_id_ptr, UINT *response_status_ptr,
                                                                   UINT wait_option)
+{
+    return(nx_azure_iot_hub_client_device_twin_reported_properties_publish(hub_client_ptr, message_buffer,
+                                                                           message_length, NX_NULL,
+                                                                           request_id_ptr, response_status_ptr,
+                                                                           wait_option));
+}
+
+UINT nx_azure_iot_hub_client_device_twin_reported_properties_json_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                       NX_PACKET *json_packet_ptr,
+                                                                       UINT *request_id_ptr, UINT *response_status_ptr,
+                                                                       UINT wait_option)
+{
+UINT status;
+
+    if (json_packet_ptr == NX_NULL)
+    {
+        LogError("IoTHub client device twin json send fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    status = nx_azure_iot_hub_client_device_twin_reported_properties_publish(hub_client_ptr, NX_NULL, 0,
+                                                                             &json_packet_ptr, request_id_ptr,
+                                                                             response_status_ptr, wait_option);
+
+    /* Payload packet is not chained if message was not published.  */
+    if (json_packet_ptr)
+    {
+        nx_packet_release(json_packet_ptr);
+    }
+
+    return(status);
+}
+
+static UINT nx_azure_iot_hub_client_device_twin_reported_properties_publish(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                            UCHAR *message_buffer, UINT message_length,
+                                                                            NX_PACKET **json_packet_pptr,
+                                                                            UINT *request_id_ptr,
+                                                                            UINT *response_status_ptr,
+                                                                            UINT wait_option)
 {
 UINT status;
 UCHAR *buffer_ptr;
@@ -1236,6 +4835,14 @@ az_result core_result;
         return(NX_AZURE_IOT_NOT_ENABLED);
     }
 
+    status = nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TWIN,
+                                                        1, wait_option);
+    if (status)
+    {
+        LogError("IoTHub client device twin fail: THROTTLED");
+        return(status);
+    }
+
     status = nx_azure_iot_buffer_allocate(hub_client_ptr -> nx_azure_iot_ptr, &buffer_ptr,
                                           &buffer_size, &buffer_context);
     if (status)
@@ -1283,20 +4890,35 @@ az_result core_result;
     }
 
     thread_list.thread_message_type = NX_AZURE_IOT_HUB_DEVICE_TWIN_REPORTED_PROPERTIES_RESPONSE;
-    thread_list.thread_ptr = tx_thread_identify();
     thread_list.thread_expected_id = request_id;
     thread_list.thread_received_message = NX_NULL;
     thread_list.thread_response_status = 0;
-    thread_list.thread_next = hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended;
-    hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended = &thread_list;
+    status = nx_azure_iot_hub_client_thread_enqueue(hub_client_ptr, &thread_list);
+    if (status)
+    {
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        LogError("IoTHub client reported state send fail: TOO MANY PENDING REQUESTS");
+        nx_azure_iot_buffer_free(buffer_context);
+        return(status);
+    }
 
     /* Release the mutex.  */
     tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
 
-    status = nxd_mqtt_client_publish(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
-                                     (CHAR *)az_span_ptr(topic_span), topic_length,
-                                     (CHAR *)message_buffer, message_length, 0,
-                                     NX_AZURE_IOT_MQTT_QOS_0, wait_option);
+    if (json_packet_pptr)
+    {
+        status = nx_azure_iot_hub_client_json_publish(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_CONTROL,
+                                                      az_span_ptr(topic_span), topic_length,
+                                                      json_packet_pptr, wait_option);
+    }
+    else
+    {
+        status = nxd_mqtt_client_publish(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
+                                         (CHAR *)az_span_ptr(topic_span), topic_length,
+                                         (CHAR *)message_buffer, message_length, 0,
+                                         NX_AZURE_IOT_MQTT_QOS_0, wait_option);
+    }
     nx_azure_iot_buffer_free(buffer_context);
 
     if (status)
@@ -1311,9 +4933,9 @@ az_result core_result;
     }
     LogDebug("[%s]request_id: %u", __func__, request_id);
 
-    if ((thread_list.thread_received_message) == NX_NULL && wait_option)
+    if (wait_option)
     {
-        tx_thread_sleep(wait_option);
+        tx_semaphore_get(&(thread_list.thread_semaphore), wait_option);
     }
 
     /* Obtain the mutex.  */
@@ -1368,6 +4990,14 @@ az_result core_result;
     /* Steps.
      * 1. Publish message to topic "$iothub/twin/GET/?$rid={request id}"
      * */
+    status = nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TWIN,
+                                                        1, wait_option);
+    if (status)
+    {
+        LogError("IoTHub client device twin publish fail: THROTTLED");
+        return(status);
+    }
+
     status = nx_azure_iot_buffer_allocate(hub_client_ptr -> nx_azure_iot_ptr, &buffer_ptr,
                                           &buffer_size, &buffer_context);
     if (status)
@@ -1562,15 +5192,67 @@ UINT status;
     return(NX_AZURE_IOT_SUCCESS);
 }
 
+static NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *nx_azure_iot_hub_client_topic_classify(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                                       const UCHAR *topic,
+                                                                                       USHORT topic_length)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *message_ptr;
+const CHAR *prefix;
+UINT prefix_length;
+
+    /* Pick the only candidate from one or two bytes, then compare its prefix once.
+       The handler of that message type parses the full topic.  */
+    if ((topic_length >= sizeof(NX_AZURE_IOT_HUB_CLIENT_TOPIC_IOTHUB_PREFIX)) && (topic[0] == '$'))
+    {
+        switch (topic[sizeof(NX_AZURE_IOT_HUB_CLIENT_TOPIC_IOTHUB_PREFIX) - 1])
+        {
+            case 'm' :
+                prefix = NX_AZURE_IOT_HUB_CLIENT_TOPIC_METHODS_PREFIX;
+                prefix_length = sizeof(NX_AZURE_IOT_HUB_CLIENT_TOPIC_METHODS_PREFIX) - 1;
+                message_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message);
+                break;
+
+            case 't' :
+                prefix = NX_AZURE_IOT_HUB_CLIENT_TOPIC_TWIN_PREFIX;
+                prefix_length = sizeof(NX_AZURE_IOT_HUB_CLIENT_TOPIC_TWIN_PREFIX) - 1;
+                message_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message);
+                break;
+
+            default :
+                return(NX_NULL);
+        }
+    }
+    else if (topic_length && (topic[0] == 'd'))
+    {
+        prefix = NX_AZURE_IOT_HUB_CLIENT_TOPIC_DEVICES_PREFIX;
+        prefix_length = sizeof(NX_AZURE_IOT_HUB_CLIENT_TOPIC_DEVICES_PREFIX) - 1;
+        message_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_c2d_message);
+    }
+    else
+    {
+        return(NX_NULL);
+    }
+
+    if ((topic_length < prefix_length) || memcmp(topic, prefix, prefix_length))
+    {
+        return(NX_NULL);
+    }
+
+    return(message_ptr);
+}
+
 static VOID nx_azure_iot_hub_client_mqtt_receive_callback(NXD_MQTT_CLIENT* client_ptr,
                                                           UINT number_of_messages)
 {
 NX_AZURE_IOT_RESOURCE *resource = nx_azure_iot_resource_search(client_ptr);
 NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr = NX_NULL;
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *message_ptr;
 NX_PACKET *packet_ptr;
 NX_PACKET *packet_next_ptr;
-ULONG topic_offset;
-USHORT topic_length;
+NX_PACKET *packet_tail_ptr;
+UINT topic_offset;
+UINT topic_length;
+UINT status;
 
     /* This function is protected by MQTT mutex. */
 
@@ -1583,80 +5265,171 @@ USHORT topic_length;
 
     if (hub_client_ptr)
     {
-        for (packet_ptr = client_ptr -> message_receive_queue_head;
-             packet_ptr;
-             packet_ptr = packet_next_ptr)
+
+        /* Take all messages from MQTT receive queue, so a receive call made from a user callback does not
+           dispatch them again. */
+        packet_ptr = client_ptr -> message_receive_queue_head;
+        packet_tail_ptr = client_ptr -> message_receive_queue_tail;
+        client_ptr -> message_receive_queue_head = NX_NULL;
+        client_ptr -> message_receive_queue_tail = NX_NULL;
+        client_ptr -> message_receive_queue_depth = 0;
+
+        for (; packet_ptr; packet_ptr = packet_next_ptr)
         {
 
             /* Store next packet in case current packet is consumed. */
             packet_next_ptr = packet_ptr -> nx_packet_queue_next;
 
-            /* Adjust packet to simply process logic. */
-            nx_azure_iot_mqtt_packet_adjust(packet_ptr);
-
-            if (nx_azure_iot_hub_client_process_publish_packet(packet_ptr -> nx_packet_prepend_ptr, &topic_offset,
-                                                               &topic_length))
+            /* Locate topic across the packet chain, then pull only header and topic into the first packet.
+               Payload stays where the driver put it. */
+            if (nx_azure_iot_mqtt_publish_topic_locate(packet_ptr, &topic_offset, &topic_length) ||
+                nx_azure_iot_packet_pullup(packet_ptr, topic_offset + topic_length))
             {
 
                 /* Message not supported. It will be released. */
+                LogError("IoTHub client dropped malformed message or topic larger than packet");
                 nx_packet_release(packet_ptr);
                 continue;
             }
 
-            if ((topic_offset + topic_length) >
-                (ULONG)(packet_ptr -> nx_packet_append_ptr - packet_ptr -> nx_packet_prepend_ptr))
+            /* Classify topic once, and hand the packet to the only handler it may belong to. */
+            message_ptr = nx_azure_iot_hub_client_topic_classify(hub_client_ptr,
+                                                                 &(packet_ptr -> nx_packet_prepend_ptr[topic_offset]),
+                                                                 (USHORT)topic_length);
+            status = NX_AZURE_IOT_NOT_FOUND;
+            if (message_ptr && message_ptr -> message_process)
             {
-
-                /* Only process topic in the first packet since the fixed topic is short enough to fit into one packet. */
-                topic_length = (USHORT)(((ULONG)(packet_ptr -> nx_packet_append_ptr - packet_ptr -> nx_packet_prepend_ptr) -
-                                         topic_offset) & 0xFFFF);
+                status = message_ptr -> message_process(hub_client_ptr, packet_ptr, topic_offset,
+                                                        (USHORT)topic_length);
             }
 
-            if (hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message.message_process &&
-                (hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message.message_process(hub_client_ptr, packet_ptr,
-                                                                                                 topic_offset,
-                                                                                                 topic_length) == NX_AZURE_IOT_SUCCESS))
+            if (status == NX_AZURE_IOT_PENDING)
             {
 
-                /* Direct method message is processed. */
-                continue;
+                /* Receive queue is full. Stop reading, and keep this message and all after it in MQTT
+                   receive queue until application makes room. */
+                client_ptr -> message_receive_queue_head = packet_ptr;
+                client_ptr -> message_receive_queue_tail = packet_tail_ptr;
+                for (; packet_ptr; packet_ptr = packet_ptr -> nx_packet_queue_next)
+                {
+                    client_ptr -> message_receive_queue_depth++;
+                }
+                return;
             }
 
-            if (hub_client_ptr -> nx_azure_iot_hub_client_c2d_message.message_process &&
-                (hub_client_ptr -> nx_azure_iot_hub_client_c2d_message.message_process(hub_client_ptr, packet_ptr,
-                                                                                       topic_offset,
-                                                                                       topic_length) == NX_AZURE_IOT_SUCCESS))
+            if (status == NX_AZURE_IOT_SUCCESS)
             {
 
-                /* Could to Device message is processed. */
+                /* Message is processed. */
                 continue;
             }
 
-            if ((hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message.message_process) &&
-                (hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message.message_process(hub_client_ptr,
-                                                                                               packet_ptr, topic_offset,
-                                                                                               topic_length) == NX_AZURE_IOT_SUCCESS))
-            {
+            /* Message not supported. It will be released. */
+            nx_packet_release(packet_ptr);
+        }
+    }
+}
 
-                /* Device Twin message is processed. */
-                continue;
+static VOID nx_azure_iot_hub_client_receive_resume(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+NXD_MQTT_CLIENT *client_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt);
+
+    /* This function is protected by MQTT mutex. */
+
+    /* Messages are left in MQTT receive queue only by stop reading policy. */
+    if (client_ptr -> message_receive_queue_head)
+    {
+        nx_azure_iot_hub_client_mqtt_receive_callback(client_ptr, client_ptr -> message_receive_queue_depth);
+    }
+}
+
+static VOID nx_azure_iot_hub_client_message_deliver(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                    NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message,
+                                                    NX_PACKET *packet_ptr,
+                                                    NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO *info_ptr)
+{
+UCHAR *header_ptr = packet_ptr -> nx_packet_prepend_ptr;
+ULONG shift;
+
+    /* This function is protected by MQTT mutex. Packet is consumed in all cases. */
+    if (nx_azure_iot_hub_client_adjust_payload(packet_ptr))
+    {
+        LogError("IoTHub client message deliver fail: INVALID PACKET");
+        return;
+    }
+
+    /* Header and topic are moved to nx_packet_data_start, rebase spans parsed from topic. */
+    shift = (ULONG)(header_ptr - packet_ptr -> nx_packet_data_start);
+    info_ptr -> info_topic -= shift;
+    if (info_ptr -> info_request_id)
+    {
+        info_ptr -> info_request_id -= shift;
+    }
+
+    if (info_ptr -> info_method_name)
+    {
+        info_ptr -> info_method_name -= shift;
+    }
+    info_ptr -> info_payload_length = packet_ptr -> nx_packet_length;
+
+    receive_message -> message_packet_callback(hub_client_ptr, packet_ptr, info_ptr,
+                                               receive_message -> message_packet_callback_args);
+}
+
+static UINT nx_azure_iot_hub_client_message_notify(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                   NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message,
+                                                   NX_PACKET *packet_ptr,
+                                                   NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO *info_ptr)
+{
+NX_PACKET *drop_ptr;
+
+    /* Owner callback takes message directly, so queue and its policy do not apply. */
+    if (receive_message -> message_packet_callback)
+    {
+        nx_azure_iot_hub_client_message_deliver(hub_client_ptr, receive_message, packet_ptr, info_ptr);
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    /* Ring keeps a copy, so packet goes back to pool at once. */
+    if (receive_message -> message_ring_buffer)
+    {
+        return(nx_azure_iot_hub_client_receive_ring_put(hub_client_ptr, receive_message, packet_ptr, info_ptr));
+    }
+
+    if (receive_message -> message_count_max &&
+        (receive_message -> message_count >= receive_message -> message_count_max))
+    {
+        if (receive_message -> message_policy == NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_STOP_READING)
+        {
+
+            /* Leave message with MQTT until application makes room. */
+            return(NX_AZURE_IOT_PENDING);
+        }
+
+        receive_message -> message_dropped_count++;
+
+        if (receive_message -> message_policy == NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_NEWEST)
+        {
+            nx_packet_release(packet_ptr);
+            return(NX_AZURE_IOT_SUCCESS);
+        }
+
+        /* Drop oldest messages, more than one if depth was lowered. */
+        while (receive_message -> message_count >= receive_message -> message_count_max)
+        {
+            drop_ptr = receive_message -> message_head;
+            receive_message -> message_head = drop_ptr -> nx_packet_queue_next;
+            if (receive_message -> message_tail == drop_ptr)
+            {
+                receive_message -> message_tail = NX_NULL;
             }
 
-            /* Message not supported. It will be released. */
-            nx_packet_release(packet_ptr);
+            drop_ptr -> nx_packet_queue_next = NX_NULL;
+            nx_packet_release(drop_ptr);
+            receive_message -> message_count--;
         }
-
-        /* Clear all message from MQTT receive queue. */
-        client_ptr -> message_receive_queue_head = NX_NULL;
-        client_ptr -> message_receive_queue_tail = NX_NULL;
-        client_ptr -> message_receive_queue_depth = 0;
     }
-}
 
-static VOID nx_azure_iot_hub_client_message_notify(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
-                                                   NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message,
-                                                   NX_PACKET *packet_ptr)
-{
     if (receive_message -> message_tail)
     {
         receive_message -> message_tail -> nx_packet_queue_next = packet_ptr;
@@ -1666,48 +5439,128 @@ static VOID nx_azure_iot_hub_client_message_notify(NX_AZURE_IOT_HUB_CLIENT *hub_
         receive_message -> message_head = packet_ptr;
     }
     receive_message -> message_tail = packet_ptr;
+    packet_ptr -> nx_packet_queue_next = NX_NULL;
+
+    receive_message -> message_count++;
+    if (receive_message -> message_count > receive_message -> message_high_water_mark)
+    {
+        receive_message -> message_high_water_mark = receive_message -> message_count;
+    }
 
     /* Check for user callback function. */
     if (receive_message -> message_callback)
     {
         receive_message -> message_callback(hub_client_ptr, receive_message -> message_callback_args);
     }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static VOID nx_azure_iot_hub_client_rid_remove(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT index)
+{
+NX_AZURE_IOT_THREAD **table = hub_client_ptr -> nx_azure_iot_hub_client_rid_table;
+UINT next;
+UINT home;
+
+    /* Shift following entries of the probe sequence back, so lookups never need tombstones. */
+    table[index] = NX_NULL;
+    next = index;
+    for (;;)
+    {
+        next = (next + 1) & (NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE - 1);
+        if (table[next] == NX_NULL)
+        {
+            break;
+        }
+
+        /* Entry can move to the hole only if its home slot is not cyclically within (index, next]. */
+        home = NX_AZURE_IOT_HUB_CLIENT_RID_SLOT(table[next] -> thread_expected_id);
+        if (((next - home) & (NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE - 1)) >=
+            ((next - index) & (NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE - 1)))
+        {
+            table[index] = table[next];
+            table[next] = NX_NULL;
+            index = next;
+        }
+    }
+}
+
+static VOID nx_azure_iot_hub_client_waiter_unlink(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message,
+                                                  NX_AZURE_IOT_THREAD *thread_list_ptr)
+{
+    if (thread_list_ptr -> thread_prev)
+    {
+        thread_list_ptr -> thread_prev -> thread_next = thread_list_ptr -> thread_next;
+    }
+    else
+    {
+        receive_message -> message_waiter_head = thread_list_ptr -> thread_next;
+    }
+
+    if (thread_list_ptr -> thread_next)
+    {
+        thread_list_ptr -> thread_next -> thread_prev = thread_list_ptr -> thread_prev;
+    }
+    else
+    {
+        receive_message -> message_waiter_tail = thread_list_ptr -> thread_prev;
+    }
+
+    thread_list_ptr -> thread_next = NX_NULL;
+    thread_list_ptr -> thread_prev = NX_NULL;
 }
 
 static UINT nx_azure_iot_hub_client_receive_thread_find(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
                                                         NX_PACKET *packet_ptr, UINT message_type,
                                                         UINT request_id, NX_AZURE_IOT_THREAD **thread_list_pptr)
 {
-NX_AZURE_IOT_THREAD *thread_list_prev = NX_NULL;
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
 NX_AZURE_IOT_THREAD *thread_list_ptr;
+UINT index;
+UINT count;
+
+    /* This function is protected by MQTT mutex. */
 
-    /* Search thread waiting for message type. */
-    for (thread_list_ptr = hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended;
-         thread_list_ptr;
-         thread_list_ptr = thread_list_ptr -> thread_next)
+    if (message_type == NX_AZURE_IOT_HUB_DEVICE_TWIN_REPORTED_PROPERTIES_RESPONSE)
     {
-        if ((thread_list_ptr -> thread_message_type == message_type) &&
-            (request_id == thread_list_ptr -> thread_expected_id))
-        {
 
-            /* Found a thread waiting for message type. */
-            if (thread_list_prev == NX_NULL)
+        /* Probe from home slot of request id until an empty slot. */
+        index = NX_AZURE_IOT_HUB_CLIENT_RID_SLOT(request_id);
+        for (count = 0; count < NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE; count++)
+        {
+            thread_list_ptr = hub_client_ptr -> nx_azure_iot_hub_client_rid_table[index];
+            if (thread_list_ptr == NX_NULL)
             {
-                hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended = thread_list_ptr -> thread_next;
+                break;
             }
-            else
+
+            if (thread_list_ptr -> thread_expected_id == request_id)
             {
-                thread_list_prev -> thread_next = thread_list_ptr -> thread_next;
+                nx_azure_iot_hub_client_rid_remove(hub_client_ptr, index);
+                thread_list_ptr -> thread_received_message = packet_ptr;
+                *thread_list_pptr = thread_list_ptr;
+                return(NX_AZURE_IOT_SUCCESS);
             }
-            thread_list_ptr -> thread_received_message = packet_ptr;
-            *thread_list_pptr =  thread_list_ptr;
-            return(NX_AZURE_IOT_SUCCESS);
+
+            index = (index + 1) & (NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE - 1);
         }
 
-        thread_list_prev = thread_list_ptr;
+        return(NX_AZURE_IOT_NOT_FOUND);
     }
 
-    return(NX_AZURE_IOT_NOT_FOUND);
+    receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr, message_type);
+    if ((receive_message == NX_NULL) || (receive_message -> message_waiter_head == NX_NULL))
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    /* Oldest waiter takes the message. */
+    thread_list_ptr = receive_message -> message_waiter_head;
+    nx_azure_iot_hub_client_waiter_unlink(receive_message, thread_list_ptr);
+    thread_list_ptr -> thread_received_message = packet_ptr;
+    *thread_list_pptr = thread_list_ptr;
+
+    return(NX_AZURE_IOT_SUCCESS);
 }
 
 static UINT nx_azure_iot_hub_client_c2d_process(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
@@ -1721,19 +5574,13 @@ az_span receive_topic;
 az_result core_result;
 UINT status;
 NX_AZURE_IOT_THREAD *thread_list_ptr;
+NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO info;
 
     /* This function is protected by MQTT mutex. */
 
     /* Check message type first. */
     topic_name = &(packet_ptr -> nx_packet_prepend_ptr[topic_offset]);
 
-    /* NOTE: Current implementation does not support topic to span multiple packets */
-    if ((ULONG)(packet_ptr -> nx_packet_append_ptr - topic_name) < topic_length)
-    {
-        LogError("topic out of boundaries of single packet");
-        return(NX_AZURE_IOT_TOPIC_TOO_LONG);
-    }
-
     receive_topic = az_span_init(topic_name, topic_length);
     core_result = az_iot_hub_client_c2d_parse_received_topic(&hub_client_ptr -> iot_hub_client_core,
                                                              receive_topic, &request);
@@ -1750,16 +5597,115 @@ NX_AZURE_IOT_THREAD *thread_list_ptr;
                                                          0, &thread_list_ptr);
     if (status == NX_AZURE_IOT_SUCCESS)
     {
-        tx_thread_wait_abort(thread_list_ptr -> thread_ptr);
+        tx_semaphore_put(&(thread_list_ptr -> thread_semaphore));
         return(NX_AZURE_IOT_SUCCESS);
     }
 
     /* No thread is waiting for C2D message yet. */
-    nx_azure_iot_hub_client_message_notify(hub_client_ptr,
-                                           &(hub_client_ptr -> nx_azure_iot_hub_client_c2d_message),
-                                           packet_ptr);
+    memset(&info, 0, sizeof(info));
+    info.info_message_type = NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE;
+    info.info_topic = topic_name;
+    info.info_topic_length = topic_length;
+    return(nx_azure_iot_hub_client_message_notify(hub_client_ptr,
+                                                  &(hub_client_ptr -> nx_azure_iot_hub_client_c2d_message),
+                                                  packet_ptr, &info));
+}
 
-    return(NX_AZURE_IOT_SUCCESS);
+static UINT nx_azure_iot_hub_client_name_hash(const UCHAR *name, UINT name_length)
+{
+UINT hash = 2166136261u;
+UINT i;
+
+    /* FNV-1a.  */
+    for (i = 0; i < name_length; i++)
+    {
+        hash ^= name[i];
+        hash *= 16777619u;
+    }
+
+    return(hash);
+}
+
+static NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *nx_azure_iot_hub_client_method_handler_find(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                                         const UCHAR *method_name,
+                                                                                         UINT method_name_length)
+{
+NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *handler_ptr;
+UINT hash = nx_azure_iot_hub_client_name_hash(method_name, method_name_length);
+
+    for (handler_ptr = hub_client_ptr -> nx_azure_iot_hub_client_method_table[hash & (NX_AZURE_IOT_HUB_CLIENT_METHOD_TABLE_SIZE - 1)];
+         handler_ptr;
+         handler_ptr = handler_ptr -> handler_next)
+    {
+        if ((handler_ptr -> handler_hash == hash) &&
+            (handler_ptr -> handler_method_name_length == method_name_length) &&
+            (memcmp(handler_ptr -> handler_method_name, method_name, method_name_length) == 0))
+        {
+            return(handler_ptr);
+        }
+    }
+
+    return(NX_NULL);
+}
+
+static VOID nx_azure_iot_hub_client_direct_method_dispatch(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                           NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *handler_ptr,
+                                                           NX_PACKET *packet_ptr, az_span request_id)
+{
+UINT status;
+UINT status_code;
+UINT request_id_offset;
+NX_PACKET *json_packet_ptr;
+NX_AZURE_IOT_JSON_WRITER writer;
+
+    /* This function is protected by MQTT mutex. Packet is consumed in all cases. */
+
+    /* Header is kept at nx_packet_data_start when packet is adjusted, request id stays at same offset. */
+    request_id_offset = (UINT)(az_span_ptr(request_id) - packet_ptr -> nx_packet_prepend_ptr);
+    if (nx_azure_iot_hub_client_adjust_payload(packet_ptr))
+    {
+        LogError("IoTHub direct method dispatch fail: INVALID PACKET");
+        return;
+    }
+
+    status = nx_packet_allocate(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_pool_ptr,
+                                &json_packet_ptr, 0, NX_NO_WAIT);
+    if (status)
+    {
+        LogError("IoTHub direct method dispatch fail: NO PACKET");
+        nx_packet_release(packet_ptr);
+        return;
+    }
+
+    nx_azure_iot_json_writer_init(&writer, json_packet_ptr, NX_NO_WAIT);
+    status_code = handler_ptr -> handler_callback(hub_client_ptr, packet_ptr, &writer,
+                                                  handler_ptr -> handler_callback_args);
+
+    if (nx_azure_iot_json_writer_length_get(&writer) == 0)
+    {
+
+        /* Empty payload is sent as empty JSON object. */
+        nx_packet_release(json_packet_ptr);
+        json_packet_ptr = NX_NULL;
+    }
+
+    status = nx_azure_iot_hub_client_direct_method_response_publish(hub_client_ptr, status_code,
+                                                                    &(packet_ptr -> nx_packet_data_start[request_id_offset]),
+                                                                    (USHORT)az_span_size(request_id), NX_NULL, 0,
+                                                                    json_packet_ptr ? &json_packet_ptr : NX_NULL,
+                                                                    NX_NO_WAIT);
+    if (status)
+    {
+        LogError("IoTHub direct method dispatch response fail: 0x%02x", status);
+    }
+
+    /* Payload packet is not chained if response packet was not built.  */
+    if (json_packet_ptr)
+    {
+        nx_packet_release(json_packet_ptr);
+    }
+
+    nx_packet_release(packet_ptr);
 }
 
 static UINT nx_azure_iot_hub_client_direct_method_process(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
@@ -1773,19 +5719,14 @@ az_span receive_topic;
 az_result core_result;
 UINT status;
 NX_AZURE_IOT_THREAD *thread_list_ptr;
+NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *handler_ptr;
+NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO info;
 
     /* This function is protected by MQTT mutex. */
 
     /* Check message type first. */
     topic_name = &(packet_ptr -> nx_packet_prepend_ptr[topic_offset]);
 
-    /* NOTE: Current implementation does not support topic to span multiple packets */
-    if ((ULONG)(packet_ptr -> nx_packet_append_ptr - topic_name) < topic_length)
-    {
-        LogError("topic out of boundaries of single packet");
-        return(NX_AZURE_IOT_TOPIC_TOO_LONG);
-    }
-
     receive_topic = az_span_init(topic_name, topic_length);
     core_result = az_iot_hub_client_methods_parse_received_topic(&(hub_client_ptr -> iot_hub_client_core),
                                                                  receive_topic, &request);
@@ -1796,21 +5737,37 @@ NX_AZURE_IOT_THREAD *thread_list_ptr;
         return(NX_AZURE_IOT_NOT_FOUND);
     }
 
+    /* Registered method is served here, without handing message to a thread. */
+    handler_ptr = nx_azure_iot_hub_client_method_handler_find(hub_client_ptr, az_span_ptr(request.name),
+                                                              (UINT)az_span_size(request.name));
+    if (handler_ptr)
+    {
+        nx_azure_iot_hub_client_direct_method_dispatch(hub_client_ptr, handler_ptr, packet_ptr, request.request_id);
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
     status = nx_azure_iot_hub_client_receive_thread_find(hub_client_ptr,
                                                          packet_ptr,
                                                          NX_AZURE_IOT_HUB_DIRECT_METHOD,
                                                          0, &thread_list_ptr);
     if (status == NX_AZURE_IOT_SUCCESS)
     {
-        tx_thread_wait_abort(thread_list_ptr -> thread_ptr);
+        tx_semaphore_put(&(thread_list_ptr -> thread_semaphore));
         return(NX_AZURE_IOT_SUCCESS);
     }
 
     /* No thread is waiting for direct method message yet. */
-    nx_azure_iot_hub_client_message_notify(hub_client_ptr,
-                                           &(hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message),
-                                           packet_ptr);
-    return(NX_AZURE_IOT_SUCCESS);
+    memset(&info, 0, sizeof(info));
+    info.info_message_type = NX_AZURE_IOT_HUB_DIRECT_METHOD;
+    info.info_topic = topic_name;
+    info.info_topic_length = topic_length;
+    info.info_request_id = az_span_ptr(request.request_id);
+    info.info_request_id_length = (USHORT)az_span_size(request.request_id);
+    info.info_method_name = az_span_ptr(request.name);
+    info.info_method_name_length = (USHORT)az_span_size(request.name);
+    return(nx_azure_iot_hub_client_message_notify(hub_client_ptr,
+                                                  &(hub_client_ptr -> nx_azure_iot_hub_client_direct_method_message),
+                                                  packet_ptr, &info));
 }
 
 static UINT nx_azure_iot_hub_client_device_twin_message_type_get(az_iot_hub_client_twin_response *out_twin_response_ptr,
@@ -1858,6 +5815,7 @@ UINT status;
 az_result core_result;
 az_span topic_span;
 az_iot_hub_client_twin_response out_twin_response;
+NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO info;
 
     /* This function is protected by MQTT mutex. */
 
@@ -1897,10 +5855,18 @@ az_iot_hub_client_twin_response out_twin_response;
     if (status == NX_AZURE_IOT_SUCCESS)
     {
         thread_list_ptr -> thread_response_status = (UINT)out_twin_response.status;
-        tx_thread_wait_abort(thread_list_ptr -> thread_ptr);
+        tx_semaphore_put(&(thread_list_ptr -> thread_semaphore));
         return(NX_AZURE_IOT_SUCCESS);
     }
 
+    memset(&info, 0, sizeof(info));
+    info.info_message_type = message_type;
+    info.info_topic = az_span_ptr(topic_span);
+    info.info_topic_length = topic_length;
+    info.info_request_id = az_span_ptr(out_twin_response.request_id);
+    info.info_request_id_length = (USHORT)az_span_size(out_twin_response.request_id);
+    info.info_response_status = (UINT)out_twin_response.status;
+
     switch(message_type)
     {
         case NX_AZURE_IOT_HUB_DEVICE_TWIN_REPORTED_PROPERTIES_RESPONSE :
@@ -1921,20 +5887,18 @@ az_iot_hub_client_twin_response out_twin_response;
         {
 
             /* No thread is waiting for device twin message yet. */
-            nx_azure_iot_hub_client_message_notify(hub_client_ptr,
-                                                   &(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message),
-                                                   packet_ptr);
+            return(nx_azure_iot_hub_client_message_notify(hub_client_ptr,
+                                                          &(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_message),
+                                                          packet_ptr, &info));
         }
-        break;
 
         case NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES :
         {
             /* No thread is waiting for device twin message yet. */
-            nx_azure_iot_hub_client_message_notify(hub_client_ptr,
-                                                   &(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_desired_properties_message),
-                                                   packet_ptr);
+            return(nx_azure_iot_hub_client_message_notify(hub_client_ptr,
+                                                          &(hub_client_ptr -> nx_azure_iot_hub_client_device_twin_desired_properties_message),
+                                                          packet_ptr, &info));
         }
-        break;
 
         default :
             nx_packet_release(packet_ptr);
@@ -1943,33 +5907,104 @@ az_iot_hub_client_twin_response out_twin_response;
     return(NX_AZURE_IOT_SUCCESS);
 }
 
-static VOID nx_azure_iot_hub_client_thread_dequeue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+static UINT nx_azure_iot_hub_client_thread_enqueue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
                                                    NX_AZURE_IOT_THREAD *thread_list_ptr)
 {
-NX_AZURE_IOT_THREAD *thread_list_prev = NX_NULL;
-NX_AZURE_IOT_THREAD *thread_list_current;
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
+UINT index;
+UINT count;
+UINT status;
 
-    for (thread_list_current = hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended;
-         thread_list_current;
-         thread_list_current = thread_list_current -> thread_next)
+    /* This function must be called with mutex held. Thread is linked only once it can be woken up. */
+    thread_list_ptr -> thread_next = NX_NULL;
+    thread_list_ptr -> thread_prev = NX_NULL;
+    status = tx_semaphore_create(&(thread_list_ptr -> thread_semaphore), "nx_azure_iot_hub_client_thread", 0);
+    if (status)
+    {
+        return(status);
+    }
+
+    if (thread_list_ptr -> thread_message_type == NX_AZURE_IOT_HUB_DEVICE_TWIN_REPORTED_PROPERTIES_RESPONSE)
     {
-        if (thread_list_current == thread_list_ptr)
-        {
 
-            /* Found the thread to dequeue. */
-            if (thread_list_prev == NX_NULL)
+        /* Take first empty slot from home slot of request id. */
+        index = NX_AZURE_IOT_HUB_CLIENT_RID_SLOT(thread_list_ptr -> thread_expected_id);
+        for (count = 0; count < NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE; count++)
+        {
+            if (hub_client_ptr -> nx_azure_iot_hub_client_rid_table[index] == NX_NULL)
             {
-                hub_client_ptr -> nx_azure_iot_hub_client_thread_suspended = thread_list_current -> thread_next;
+                break;
             }
-            else
+
+            index = (index + 1) & (NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE - 1);
+        }
+
+        if (count == NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE)
+        {
+            tx_semaphore_delete(&(thread_list_ptr -> thread_semaphore));
+            return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+        }
+
+        hub_client_ptr -> nx_azure_iot_hub_client_rid_table[index] = thread_list_ptr;
+    }
+    else
+    {
+        receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr,
+                                                                     thread_list_ptr -> thread_message_type);
+        if (receive_message == NX_NULL)
+        {
+            tx_semaphore_delete(&(thread_list_ptr -> thread_semaphore));
+            return(NX_AZURE_IOT_NOT_SUPPORTED);
+        }
+
+        thread_list_ptr -> thread_prev = receive_message -> message_waiter_tail;
+        if (receive_message -> message_waiter_tail)
+        {
+            receive_message -> message_waiter_tail -> thread_next = thread_list_ptr;
+        }
+        else
+        {
+            receive_message -> message_waiter_head = thread_list_ptr;
+        }
+        receive_message -> message_waiter_tail = thread_list_ptr;
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static VOID nx_azure_iot_hub_client_thread_dequeue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                   NX_AZURE_IOT_THREAD *thread_list_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *receive_message;
+UINT index;
+UINT count;
+
+    /* This function must be called with mutex held. Thread that got a message is already removed. */
+    if (thread_list_ptr -> thread_received_message == NX_NULL)
+    {
+        if (thread_list_ptr -> thread_message_type == NX_AZURE_IOT_HUB_DEVICE_TWIN_REPORTED_PROPERTIES_RESPONSE)
+        {
+            index = NX_AZURE_IOT_HUB_CLIENT_RID_SLOT(thread_list_ptr -> thread_expected_id);
+            for (count = 0; count < NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE; count++)
             {
-                thread_list_prev -> thread_next = thread_list_current -> thread_next;
+                if (hub_client_ptr -> nx_azure_iot_hub_client_rid_table[index] == thread_list_ptr)
+                {
+                    nx_azure_iot_hub_client_rid_remove(hub_client_ptr, index);
+                    break;
+                }
+
+                index = (index + 1) & (NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE - 1);
             }
-            break;
         }
-
-        thread_list_prev = thread_list_current;
+        else
+        {
+            receive_message = nx_azure_iot_hub_client_receive_message_get(hub_client_ptr,
+                                                                         thread_list_ptr -> thread_message_type);
+            nx_azure_iot_hub_client_waiter_unlink(receive_message, thread_list_ptr);
+        }
     }
+
+    tx_semaphore_delete(&(thread_list_ptr -> thread_semaphore));
 }
 
 static UINT nx_azure_iot_hub_client_sas_token_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
@@ -2085,8 +6120,6 @@ UINT status;
 ULONG topic_offset;
 USHORT topic_length;
 az_span topic_span;
-ULONG message_offset;
-ULONG message_length;
 NX_PACKET *packet_ptr;
 az_result core_result;
 az_iot_hub_client_method_request request;
@@ -2111,14 +6144,22 @@ az_iot_hub_client_method_request request;
     }
 
     packet_ptr = *packet_pptr;
-    status = _nxd_mqtt_process_publish_packet(packet_ptr, &topic_offset, &topic_length, &message_offset, &message_length);
+    status = nx_azure_iot_hub_client_adjust_payload(packet_ptr);
+    if (status)
+    {
+        return(status);
+    }
+
+    /* Method name and request id are returned in place, parse topic where it is kept.  */
+    status = nx_azure_iot_hub_client_process_publish_packet(packet_ptr -> nx_packet_data_start,
+                                                            &topic_offset, &topic_length);
     if (status)
     {
         nx_packet_release(packet_ptr);
         return(status);
     }
 
-    topic_span = az_span_init(&(packet_ptr -> nx_packet_prepend_ptr[topic_offset]), topic_length);
+    topic_span = az_span_init(&(packet_ptr -> nx_packet_data_start[topic_offset]), topic_length);
     core_result = az_iot_hub_client_methods_parse_received_topic(&(hub_client_ptr -> iot_hub_client_core),
                                                                  topic_span, &request);
     if (az_failed(core_result))
@@ -2127,29 +6168,6 @@ az_iot_hub_client_method_request request;
         return(NX_AZURE_IOT_SDK_CORE_ERROR);
     }
 
-    *packet_pptr = packet_ptr;
-    packet_ptr -> nx_packet_length = message_length;
-
-    /* Adjust packet to pointer to message payload. */
-    while (packet_ptr)
-    {
-        if ((ULONG)(packet_ptr -> nx_packet_append_ptr - packet_ptr -> nx_packet_prepend_ptr) > message_offset)
-        {
-
-            /* This packet contains message payload. */
-            packet_ptr -> nx_packet_prepend_ptr = packet_ptr -> nx_packet_prepend_ptr + message_offset;
-            break;
-        }
-
-        message_offset -= (ULONG)(packet_ptr -> nx_packet_append_ptr - packet_ptr -> nx_packet_prepend_ptr);
-
-        /* Set current packet to empty. */
-        packet_ptr -> nx_packet_prepend_ptr = packet_ptr -> nx_packet_append_ptr;
-
-        /* Move to next packet. */
-        packet_ptr = packet_ptr -> nx_packet_next;
-    }
-
     *method_name_pptr = az_span_ptr(request.name);
     *method_name_length_ptr = (USHORT)az_span_size(request.name);
     *context_pptr = (VOID*)az_span_ptr(request.request_id);
@@ -2162,6 +6180,129 @@ UINT nx_azure_iot_hub_client_direct_method_message_response(NX_AZURE_IOT_HUB_CLI
                                                             UINT status_code, VOID *context_ptr,
                                                             USHORT context_length, UCHAR *payload,
                                                             UINT payload_length, UINT wait_option)
+{
+    return(nx_azure_iot_hub_client_direct_method_response_publish(hub_client_ptr, status_code, context_ptr,
+                                                                  context_length, payload, payload_length,
+                                                                  NX_NULL, wait_option));
+}
+
+UINT nx_azure_iot_hub_client_direct_method_message_json_response(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                 UINT status_code, VOID *context_ptr,
+                                                                 USHORT context_length, NX_PACKET *json_packet_ptr,
+                                                                 UINT wait_option)
+{
+UINT status;
+
+    if (json_packet_ptr == NX_NULL)
+    {
+        LogError("IoTHub direct method json response fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    status = nx_azure_iot_hub_client_direct_method_response_publish(hub_client_ptr, status_code, context_ptr,
+                                                                    context_length, NX_NULL, 0,
+                                                                    &json_packet_ptr, wait_option);
+
+    /* Payload packet is not chained if response packet was not built.  */
+    if (json_packet_ptr)
+    {
+        nx_packet_release(json_packet_ptr);
+    }
+
+    return(status);
+}
+
+UINT nx_azure_iot_hub_client_direct_method_handler_register(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                            NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *handler_ptr,
+                                                            const UCHAR *method_name, UINT method_name_length,
+                                                            UINT (*callback_ptr)(
+                                                                  NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                  NX_PACKET *packet_ptr,
+                                                                  NX_AZURE_IOT_JSON_WRITER *response_writer_ptr,
+                                                                  VOID *args),
+                                                            VOID *callback_args)
+{
+NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER **bucket_pptr;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        (handler_ptr == NX_NULL) || (method_name == NX_NULL) || (method_name_length == 0) ||
+        (callback_ptr == NX_NULL))
+    {
+        LogError("IoTHub direct method handler register fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    if (nx_azure_iot_hub_client_method_handler_find(hub_client_ptr, method_name, method_name_length))
+    {
+
+        /* Release the mutex.  */
+        tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+        LogError("IoTHub direct method handler register fail: ALREADY REGISTERED");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    handler_ptr -> handler_method_name = method_name;
+    handler_ptr -> handler_method_name_length = method_name_length;
+    handler_ptr -> handler_hash = nx_azure_iot_hub_client_name_hash(method_name, method_name_length);
+    handler_ptr -> handler_callback = callback_ptr;
+    handler_ptr -> handler_callback_args = callback_args;
+
+    bucket_pptr = &(hub_client_ptr -> nx_azure_iot_hub_client_method_table[handler_ptr -> handler_hash &
+                                                                            (NX_AZURE_IOT_HUB_CLIENT_METHOD_TABLE_SIZE - 1)]);
+    handler_ptr -> handler_next = *bucket_pptr;
+    *bucket_pptr = handler_ptr;
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_hub_client_direct_method_handler_deregister(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                              NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *handler_ptr)
+{
+NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER **link_pptr;
+
+    if ((hub_client_ptr == NX_NULL) || (hub_client_ptr -> nx_azure_iot_ptr == NX_NULL) ||
+        (handler_ptr == NX_NULL))
+    {
+        LogError("IoTHub direct method handler deregister fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+
+    for (link_pptr = &(hub_client_ptr -> nx_azure_iot_hub_client_method_table[handler_ptr -> handler_hash &
+                                                                               (NX_AZURE_IOT_HUB_CLIENT_METHOD_TABLE_SIZE - 1)]);
+         *link_pptr;
+         link_pptr = &((*link_pptr) -> handler_next))
+    {
+        if (*link_pptr == handler_ptr)
+        {
+            *link_pptr = handler_ptr -> handler_next;
+            handler_ptr -> handler_next = NX_NULL;
+
+            /* Release the mutex.  */
+            tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+            return(NX_AZURE_IOT_SUCCESS);
+        }
+    }
+
+    /* Release the mutex.  */
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+
+    return(NX_AZURE_IOT_NOT_FOUND);
+}
+
+static UINT nx_azure_iot_hub_client_direct_method_response_publish(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                   UINT status_code, VOID *context_ptr,
+                                                                   USHORT context_length, UCHAR *payload,
+                                                                   UINT payload_length, NX_PACKET **json_packet_pptr,
+                                                                   UINT wait_option)
 {
 NX_PACKET *packet_ptr;
 UINT topic_length;
@@ -2179,6 +6320,14 @@ UCHAR packet_id[2];
         return(NX_AZURE_IOT_INVALID_PARAMETER);
     }
 
+    status = nx_azure_iot_hub_client_rate_limit_acquire(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_METHOD,
+                                                        1, wait_option);
+    if (status)
+    {
+        LogError("IoTHub direct method response fail: THROTTLED");
+        return(status);
+    }
+
     /* prepare response packet */
     status = nx_azure_iot_publish_packet_get(hub_client_ptr -> nx_azure_iot_ptr,
                                              &(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
@@ -2206,7 +6355,14 @@ UCHAR packet_id[2];
     packet_ptr -> nx_packet_append_ptr = packet_ptr -> nx_packet_prepend_ptr + topic_length;
     packet_ptr -> nx_packet_length = topic_length;
 
-    if (payload && (payload_length != 0))
+    if (json_packet_pptr)
+    {
+
+        /* Chain payload packet, it is released with response packet from now on.  */
+        nx_azure_iot_hub_client_packet_chain_link(packet_ptr, *json_packet_pptr);
+        *json_packet_pptr = NX_NULL;
+    }
+    else if (payload && (payload_length != 0))
     {
 
         /* Append payload. */
@@ -2235,9 +6391,9 @@ UCHAR packet_id[2];
         }
     }
 
-    status = nx_azure_iot_publish_mqtt_packet(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt),
-                                              packet_ptr, topic_length, packet_id, NX_AZURE_IOT_MQTT_QOS_0,
-                                              wait_option);
+    status = nx_azure_iot_hub_client_publish(hub_client_ptr, NX_AZURE_IOT_HUB_CLIENT_PRIORITY_CONTROL,
+                                             packet_ptr, topic_length, packet_id, NX_AZURE_IOT_MQTT_QOS_0,
+                                             wait_option);
     if (status)
     {
         LogError("IoTHub client method response fail: PUBLISH FAIL: 0x%02x", status);
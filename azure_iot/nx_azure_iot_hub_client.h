@@ -29,6 +29,10 @@ extern   "C" {
 
 #include "az_iot_hub_client.h"
 #include "nx_azure_iot.h"
+#include "nx_azure_iot_spool.h"
+#include "nx_azure_iot_compress.h"
+#include "nx_azure_iot_json_writer.h"
+#include "nx_azure_iot_cbor.h"
 #include "nx_api.h"
 #include "nx_cloud.h"
 #include "nxd_dns.h"
@@ -65,6 +69,125 @@ extern   "C" {
 #define NX_AZURE_IOT_HUB_CLIENT_TOKEN_EXPIRY            (3600)
 #endif /* NX_AZURE_IOT_HUB_CLIENT_TOKEN_EXPIRY */
 
+/* Set the maximum number of telemetry messages in one batch.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_COUNT
+#define NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_COUNT (16)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_COUNT */
+
+/* Set the maximum size in bytes of one telemetry batch. The batch is sent as a single TLS record.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_SIZE
+#define NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_SIZE  (4096)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_SIZE */
+
+/* Set the maximum number of asynchronous telemetry messages waiting for PUBACK.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT
+#define NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT (8)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT */
+
+/* Set the timeout in ticks before an asynchronous telemetry message is reported as not acknowledged.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_ACK_TIMEOUT
+#define NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_ACK_TIMEOUT     (30 * NX_IP_PERIODIC_RATE)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_ACK_TIMEOUT */
+
+/* Set the wait option in ticks used by cloud helper thread when sending stored telemetry.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT
+#define NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT      (NX_IP_PERIODIC_RATE)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_WAIT */
+
+/* Set the maximum number of stored telemetry messages sent by cloud helper thread per event.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DRAIN_COUNT
+#define NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DRAIN_COUNT (8)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DRAIN_COUNT */
+
+/* Set the number of messages each publish priority queue can hold.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_DEPTH
+#define NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_DEPTH       (8)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_DEPTH */
+
+/* Set the number of messages each receive queue holds by default. Zero means no limit.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DEPTH
+#define NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DEPTH       (0)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DEPTH */
+
+/* Set the number of buckets of direct method handler table. Must be power of 2.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_METHOD_TABLE_SIZE
+#define NX_AZURE_IOT_HUB_CLIENT_METHOD_TABLE_SIZE         (8)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_METHOD_TABLE_SIZE */
+
+/* Set the number of reported properties requests that can wait for response at the same time.
+   Must be power of 2.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE
+#define NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE            (32)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE */
+
+/* Set the maximum number of C2D message properties kept in a property index. Must be power of 2 and
+   not above 128.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE
+#define NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE       (16)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE */
+
+/* Set the minimum telemetry payload size that is compressed.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_COMPRESS_MIN_SIZE
+#define NX_AZURE_IOT_HUB_CLIENT_COMPRESS_MIN_SIZE         (64)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_COMPRESS_MIN_SIZE */
+
+/* Application property that marks a compressed telemetry payload.  */
+#define NX_AZURE_IOT_HUB_CLIENT_COMPRESSION_PROPERTY      "compression"
+#define NX_AZURE_IOT_HUB_CLIENT_COMPRESSION_ZLIB          "zlib"
+
+/* Set the maximum number of packets in a telemetry message chain that can be spooled.  */
+#ifndef NX_AZURE_IOT_HUB_CLIENT_SPOOL_VEC_MAX_COUNT
+#define NX_AZURE_IOT_HUB_CLIENT_SPOOL_VEC_MAX_COUNT       (8)
+#endif /* NX_AZURE_IOT_HUB_CLIENT_SPOOL_VEC_MAX_COUNT */
+
+/* Define telemetry store policy when store is full.  */
+/**< Discard oldest stored messages to make room for new message */
+#define NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_OLDEST         0
+
+/**< Reject new message */
+#define NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_NEWEST         1
+
+/* Define receive queue policy when queue is full.  */
+/**< Discard oldest queued message to make room for new message */
+#define NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_OLDEST           0
+
+/**< Discard new message */
+#define NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_NEWEST           1
+
+/**< Leave new message and all after it with MQTT until the queue has room */
+#define NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_STOP_READING          2
+
+/* Define publish priority. Lower value is served first.  */
+/**< Direct method responses */
+#define NX_AZURE_IOT_HUB_CLIENT_PRIORITY_CONTROL                    0
+
+/**< Alarm telemetry */
+#define NX_AZURE_IOT_HUB_CLIENT_PRIORITY_ALARM                      1
+
+/**< Bulk telemetry */
+#define NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK                       2
+
+#define NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT                      3
+
+/* Define rate limit class.  */
+/**< Telemetry messages */
+#define NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY                0
+
+/**< Device twin reported properties and requests */
+#define NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TWIN                     1
+
+/**< Direct method responses */
+#define NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_METHOD                   2
+
+#define NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_COUNT                    3
+
+/* Largest burst multiplied by period accepted by nx_azure_iot_hub_client_rate_limit_set().  */
+#define NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_CREDIT_MAX               (0xFFFFFFFFUL)
+
+/* Define receive ring flags.  */
+/**< Keep topic, which holds message properties, in front of payload */
+#define NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RING_TOPIC                  0x1
+
 /* Define AZ IoT Hub Client state.  */
 /**< The client is not connected */
 #define NX_AZURE_IOT_HUB_CLIENT_STATUS_NOT_CONNECTED    0
@@ -78,8 +201,9 @@ extern   "C" {
 
 typedef struct NX_AZURE_IOT_THREAD_STRUCT
 {
-    TX_THREAD                           *thread_ptr;
+    TX_SEMAPHORE                         thread_semaphore;       /* Put once message is handed over. */
     struct NX_AZURE_IOT_THREAD_STRUCT   *thread_next;
+    struct NX_AZURE_IOT_THREAD_STRUCT   *thread_prev;
     UINT                                 thread_message_type;
     UINT                                 thread_expected_id;     /* Used by device twin. */
     UINT                                 thread_response_status; /* Used by device twin. */
@@ -89,16 +213,169 @@ typedef struct NX_AZURE_IOT_THREAD_STRUCT
 /* Forward declration*/
 struct NX_AZURE_IOT_HUB_CLIENT_STRUCT;
 
+/**
+ * @brief Metadata of received message parsed from its topic
+ * @details Pointers refer into the topic kept in the message packet and stay valid while the packet is held.
+ *          Fields that do not apply to the message type are zero.
+ *
+ */
+typedef struct NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO_STRUCT
+{
+    UINT          info_message_type;
+    const UCHAR  *info_topic;
+    USHORT        info_topic_length;
+    const UCHAR  *info_request_id;          /* Direct method and device twin. */
+    USHORT        info_request_id_length;
+    const UCHAR  *info_method_name;         /* Direct method. */
+    USHORT        info_method_name_length;
+    UINT          info_response_status;     /* Device twin. */
+    ULONG         info_payload_length;      /* Payload starts at nx_packet_prepend_ptr. */
+} NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO;
+
+typedef struct NX_AZURE_IOT_HUB_CLIENT_PROPERTY_ENTRY_STRUCT
+{
+    USHORT        entry_name_offset;        /* Offsets are from start of topic. */
+    USHORT        entry_name_length;
+    USHORT        entry_value_offset;
+    USHORT        entry_value_length;
+    UCHAR         entry_next;               /* Next entry in bucket plus one, zero if last. */
+} NX_AZURE_IOT_HUB_CLIENT_PROPERTY_ENTRY;
+
+/**
+ * @brief Index of C2D message properties
+ * @details Built once from the topic of a received C2D message. It refers into the packet and stays valid
+ *          while the packet is held.
+ *
+ */
+typedef struct NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_STRUCT
+{
+    const UCHAR  *index_topic;
+    UINT          index_count;
+    UCHAR         index_bucket[NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE];
+    NX_AZURE_IOT_HUB_CLIENT_PROPERTY_ENTRY
+                  index_entry[NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE];
+} NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX;
+
 typedef struct NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE_STRUCT
 {
     NX_PACKET    *message_head;
     NX_PACKET    *message_tail;
+    UINT          message_count;
+    UINT          message_count_max;    /* Zero if queue is not bounded. */
+    UINT          message_policy;
+    UINT          message_high_water_mark;
+    ULONG         message_dropped_count;
+    NX_AZURE_IOT_THREAD
+                 *message_waiter_head;  /* Threads waiting for this message type, oldest first. */
+    NX_AZURE_IOT_THREAD
+                 *message_waiter_tail;
+    UCHAR        *message_ring_buffer;  /* NX_NULL if messages are kept as packets. */
+    UINT          message_ring_size;
+    UINT          message_ring_head;    /* Offset of oldest record. */
+    UINT          message_ring_used;
+    UINT          message_ring_flags;
     VOID        (*message_callback)(struct NX_AZURE_IOT_HUB_CLIENT_STRUCT *hub_client_ptr, VOID *args);
     VOID         *message_callback_args;
+    VOID        (*message_packet_callback)(struct NX_AZURE_IOT_HUB_CLIENT_STRUCT *hub_client_ptr,
+                                           NX_PACKET *packet_ptr,
+                                           const NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO *info_ptr,
+                                           VOID *args);
+    VOID         *message_packet_callback_args;
     UINT        (*message_process)(struct NX_AZURE_IOT_HUB_CLIENT_STRUCT *hub_client_ptr,
                                    NX_PACKET *packet_ptr, ULONG topic_offset, USHORT topic_length);
 } NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE;
 
+typedef struct NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_STRUCT
+{
+    USHORT        inflight_packet_id;   /* Zero if entry is free. */
+    ULONG         inflight_start_time;
+} NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT;
+
+/**
+ * @brief Telemetry payload reservation struct
+ * @details Filled by nx_azure_iot_hub_client_telemetry_payload_reserve() and owned by the caller until
+ *          the payload is sent. Members are internal.
+ *
+ */
+typedef struct NX_AZURE_IOT_HUB_CLIENT_PAYLOAD_STRUCT
+{
+    NX_PACKET    *payload_packet_ptr;   /* NX_NULL if nothing is reserved. */
+    NX_PACKET    *payload_tail_ptr;     /* Last packet of chain at reservation. */
+    UCHAR        *payload_append_ptr;   /* Append pointer of last packet at reservation. */
+    ULONG         payload_packet_length;
+    UINT          payload_max_length;
+    UINT          payload_used_length;
+    UINT          payload_state;
+} NX_AZURE_IOT_HUB_CLIENT_PAYLOAD;
+
+typedef struct NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_STRUCT
+{
+    UCHAR        *store_buffer;         /* NX_NULL if store is disabled. */
+    UINT          store_size;
+    UINT          store_head;           /* Offset of oldest record. */
+    UINT          store_used;
+    UINT          store_policy;
+    ULONG         store_dropped_count;
+} NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE;
+
+typedef struct NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY_STRUCT
+{
+    NX_PACKET    *entry_packet_ptr;     /* Complete PUBLISH packet, or its header if payload is external. */
+    ULONG         entry_time;
+    USHORT        entry_packet_id;
+    UINT          entry_qos;
+    UCHAR        *entry_payload_ptr;    /* Externally owned payload streamed after packet. */
+    UINT          entry_payload_size;
+    VOID        (*entry_payload_release)(struct NX_AZURE_IOT_HUB_CLIENT_STRUCT *hub_client_ptr,
+                                         UCHAR *telemetry_data, UINT status, VOID *args);
+    VOID         *entry_payload_args;
+} NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY;
+
+typedef struct NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_STRUCT
+{
+    NX_AZURE_IOT_HUB_CLIENT_PUBLISH_ENTRY queue_entry[NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE_DEPTH];
+    UINT          queue_head;
+    UINT          queue_depth;
+    ULONG         queue_sent_count;
+    ULONG         queue_dropped_count;
+    ULONG         queue_latency_total;  /* Ticks from enqueue to send, summed over sent messages. */
+    ULONG         queue_latency_max;
+} NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE;
+
+typedef struct NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_STRUCT
+{
+    UINT          rate_limit_rate;          /* Tokens added per period. Zero if limiter is disabled. */
+    UINT          rate_limit_period;        /* Period in ticks. */
+    UINT          rate_limit_burst;         /* Bucket size in tokens. */
+    ULONG         rate_limit_credit;        /* Tokens multiplied by period. */
+    ULONG         rate_limit_last_time;
+    ULONG         rate_limit_throttle_count;
+} NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT;
+
+typedef struct NX_AZURE_IOT_HUB_CLIENT_SPOOL_PENDING_STRUCT
+{
+    USHORT                        pending_packet_id;    /* Zero for QoS 0 record. */
+    USHORT                        pending_acked;        /* Set when PUBACK is received. */
+    NX_AZURE_IOT_SPOOL_POSITION   pending_position;     /* Position after the record. */
+} NX_AZURE_IOT_HUB_CLIENT_SPOOL_PENDING;
+
+/**
+ * @brief Azure IoT Hub Client direct method handler struct
+ *
+ */
+typedef struct NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER_STRUCT
+{
+    const UCHAR  *handler_method_name;
+    UINT          handler_method_name_length;
+    UINT          handler_hash;
+    UINT        (*handler_callback)(struct NX_AZURE_IOT_HUB_CLIENT_STRUCT *hub_client_ptr,
+                                    NX_PACKET *packet_ptr, NX_AZURE_IOT_JSON_WRITER *response_writer_ptr,
+                                    VOID *args);
+    VOID         *handler_callback_args;
+    struct NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER_STRUCT
+                 *handler_next;
+} NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER;
+
 /**
  * @brief Azure IoT Hub Client struct
  *
@@ -108,15 +385,38 @@ typedef struct NX_AZURE_IOT_HUB_CLIENT_STRUCT
     NX_AZURE_IOT                           *nx_azure_iot_ptr;
 
     UINT                                    nx_azure_iot_hub_client_state;
-    NX_AZURE_IOT_THREAD                    *nx_azure_iot_hub_client_thread_suspended;
+    NX_AZURE_IOT_THREAD                    *nx_azure_iot_hub_client_rid_table[NX_AZURE_IOT_HUB_CLIENT_RID_TABLE_SIZE];
     NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE nx_azure_iot_hub_client_c2d_message;
     NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE nx_azure_iot_hub_client_device_twin_message;
     NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE nx_azure_iot_hub_client_device_twin_desired_properties_message;
     NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE nx_azure_iot_hub_client_direct_method_message;
+    NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *nx_azure_iot_hub_client_method_table[NX_AZURE_IOT_HUB_CLIENT_METHOD_TABLE_SIZE];
     VOID                                  (*nx_azure_iot_hub_client_report_properties_response_callback)(
                                            struct NX_AZURE_IOT_HUB_CLIENT_STRUCT *hub_client_ptr,
                                            UINT request_id, UINT response_status, VOID *args);
     VOID                                   *nx_azure_iot_hub_client_report_properties_response_callback_args;
+    VOID                                  (*nx_azure_iot_hub_client_telemetry_ack_callback)(
+                                           struct NX_AZURE_IOT_HUB_CLIENT_STRUCT *hub_client_ptr,
+                                           USHORT packet_id, UINT status, VOID *args);
+    VOID                                   *nx_azure_iot_hub_client_telemetry_ack_callback_args;
+    NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT
+                                            nx_azure_iot_hub_client_telemetry_inflight[NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT];
+    UINT                                    nx_azure_iot_hub_client_telemetry_inflight_count;
+    UINT                                    nx_azure_iot_hub_client_telemetry_inflight_window;
+    ULONG                                   nx_azure_iot_hub_client_telemetry_qos0_count;
+    ULONG                                   nx_azure_iot_hub_client_telemetry_qos1_count;
+    NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE nx_azure_iot_hub_client_telemetry_store;
+    NX_AZURE_IOT_SPOOL                     *nx_azure_iot_hub_client_telemetry_spool_ptr;
+    NX_AZURE_IOT_COMPRESS                   nx_azure_iot_hub_client_telemetry_compress;
+    TX_MUTEX                                nx_azure_iot_hub_client_telemetry_compress_mutex;
+    NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT      nx_azure_iot_hub_client_rate_limit[NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_COUNT];
+    NX_AZURE_IOT_HUB_CLIENT_PUBLISH_QUEUE   nx_azure_iot_hub_client_publish_queue[NX_AZURE_IOT_HUB_CLIENT_PRIORITY_COUNT];
+    TX_EVENT_FLAGS_GROUP                    nx_azure_iot_hub_client_publish_events;    /* Bit per priority, set when queue has room. */
+    UINT                                    nx_azure_iot_hub_client_publish_scheduler_enabled;
+    UINT                                    nx_azure_iot_hub_client_publish_starvation_budget;
+    UINT                                    nx_azure_iot_hub_client_publish_budget_used;
+    NX_AZURE_IOT_HUB_CLIENT_SPOOL_PENDING   nx_azure_iot_hub_client_spool_pending[NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT];
+    UINT                                    nx_azure_iot_hub_client_spool_pending_count;
 
     VOID                                  (*nx_azure_iot_hub_client_connection_status_callback)(
                                            struct NX_AZURE_IOT_HUB_CLIENT_STRUCT *hub_client_ptr,
@@ -134,6 +434,30 @@ typedef struct NX_AZURE_IOT_HUB_CLIENT_STRUCT
     az_iot_hub_client                       iot_hub_client_core;
 } NX_AZURE_IOT_HUB_CLIENT;
 
+/**
+ * @brief Azure IoT Hub Client telemetry template struct
+ *
+ */
+typedef struct NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE_STRUCT
+{
+    NX_AZURE_IOT_HUB_CLIENT                *template_hub_client_ptr;
+    UCHAR                                  *template_buffer;        /* Rendered topic and static properties. */
+    UINT                                    template_buffer_size;
+    UINT                                    template_length;
+} NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE;
+
+/**
+ * @brief Azure IoT Hub Client telemetry batch struct
+ *
+ */
+typedef struct NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_STRUCT
+{
+    NX_AZURE_IOT_HUB_CLIENT                *batch_hub_client_ptr;
+    NX_PACKET                              *batch_packet_ptr;       /* PUBLISH frames chained back-to-back. */
+    UINT                                    batch_count;
+    USHORT                                  batch_packet_id[NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH_MAX_COUNT];
+} NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH;
+
 
 /**
  * @brief Initialize Azure IoT hub instance
@@ -266,6 +590,38 @@ UINT nx_azure_iot_hub_client_receive_callback_set(NX_AZURE_IOT_HUB_CLIENT *hub_c
                                                         VOID *args),
                                                   VOID *callback_args);
 
+/**
+ * @brief Sets receive callback function that takes ownership of messages
+ * @details Messages of `message_type` are handed to this callback as soon as they are received, together
+ *          with metadata parsed from the topic, and are never queued for the receive APIs. The packet is
+ *          adjusted the same way as packets returned by the receive APIs, so message property and direct
+ *          method response APIs apply. Callback owns the packet and must release it. Callback runs in the
+ *          MQTT thread with client mutex held and must not block. Threads already waiting in the receive
+ *          APIs are still served first. Setting the callback function to `NULL` returns to queued receive.
+ *          Message types can be:
+ *
+ *          - #NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE
+ *          - #NX_AZURE_IOT_HUB_DIRECT_METHOD
+ *          - #NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES
+ *          - #NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] message_type Message type of callback function.
+ * @param[in] callback_ptr Pointer to a callback function invoked with each received message.
+ * @param[in] callback_args Pointer to an argument passed to callback function.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS if callback function is set successfully.
+ *   @retval #NX_AZURE_IOT_NOT_SUPPORTED Fail to set callback due to unknown message type.
+ */
+UINT nx_azure_iot_hub_client_receive_packet_callback_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                         UINT message_type,
+                                                         VOID (*callback_ptr)(
+                                                               NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                               NX_PACKET *packet_ptr,
+                                                               const NX_AZURE_IOT_HUB_CLIENT_MESSAGE_INFO *info_ptr,
+                                                               VOID *args),
+                                                         VOID *callback_args);
+
 /**
  * @brief Creates telemetry message.
  * @details This routine prepares a packet for sending telemetry data. After the packet is properly created,
@@ -327,6 +683,658 @@ UINT nx_azure_iot_hub_client_telemetry_property_add(NX_PACKET *packet_ptr,
 UINT nx_azure_iot_hub_client_telemetry_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
                                             UCHAR *telemetry_data, UINT data_size, UINT wait_option);
 
+/**
+ * @brief Sends telemetry message to IoTHub with specified QoS.
+ * @details This routine sends telemetry to IoTHub like nx_azure_iot_hub_client_telemetry_send(). With
+ *          #NX_AZURE_IOT_MQTT_QOS_0, no packet id is allocated and the message is not acknowledged
+ *          or retransmitted, which suits high-rate, loss-tolerant streams.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] telemetry_data Pointer to telemetry data.
+ * @param[in] data_size Size of telemetry data.
+ * @param[in] qos #NX_AZURE_IOT_MQTT_QOS_0 or #NX_AZURE_IOT_MQTT_QOS_1.
+ * @param[in] wait_option Ticks to wait for message to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is sent out.
+ */
+UINT nx_azure_iot_hub_client_telemetry_send_qos(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                UCHAR *telemetry_data, UINT data_size, UINT qos, UINT wait_option);
+
+/**
+ * @brief Reserves telemetry payload in place.
+ * @details This routine returns a pointer to the free space of the telemetry packet, after the topic and
+ *          room for the packet id, so a serializer can write the payload directly into packet memory.
+ *          Reservation must fit in the last packet of `packet_ptr`, and is recorded in `payload_ptr`.
+ *          Once written, the payload is committed by nx_azure_iot_hub_client_telemetry_payload_commit()
+ *          and sent by nx_azure_iot_hub_client_telemetry_payload_send(). No property can be added after
+ *          reservation; commit and send fail if the packet was appended to.
+ *
+ * @param[out] payload_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_PAYLOAD.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] max_length Maximum payload length to be written.
+ * @param[out] payload_pptr Pointer to write payload to.
+ * @param[out] available_length_ptr Length available for payload. Can be `NULL`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if payload is reserved.
+ *   @retval #NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE Fail to reserve payload since `max_length` exceeds
+ *                                                   the available length.
+ */
+UINT nx_azure_iot_hub_client_telemetry_payload_reserve(NX_AZURE_IOT_HUB_CLIENT_PAYLOAD *payload_ptr,
+                                                       NX_PACKET *packet_ptr, UINT max_length,
+                                                       UCHAR **payload_pptr, UINT *available_length_ptr);
+
+/**
+ * @brief Commits telemetry payload written in place.
+ * @details This routine records `used_length`, which must not exceed `max_length` of the reservation.
+ *          It can be called again before send to change the length.
+ *
+ * @param[in] payload_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_PAYLOAD.
+ * @param[in] used_length Length of payload written.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if payload is committed.
+ *   @retval #NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE Fail to commit since `used_length` exceeds reservation.
+ *   @retval #NX_AZURE_IOT_INVALID_PACKET Fail to commit since payload is not reserved, or packet was
+ *                                        appended to after reservation.
+ */
+UINT nx_azure_iot_hub_client_telemetry_payload_commit(NX_AZURE_IOT_HUB_CLIENT_PAYLOAD *payload_ptr,
+                                                      UINT used_length);
+
+/**
+ * @brief Sends telemetry message with payload written in place.
+ * @details This routine sends the payload committed by nx_azure_iot_hub_client_telemetry_payload_commit()
+ *          without copying it. Compression is not applied. Once the packet is handed over, `payload_ptr` is
+ *          cleared, so the payload can not be sent twice.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] payload_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_PAYLOAD.
+ * @param[in] qos #NX_AZURE_IOT_MQTT_QOS_0 or #NX_AZURE_IOT_MQTT_QOS_1.
+ * @param[in] wait_option Ticks to wait for message to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is sent out.
+ *   @retval #NX_AZURE_IOT_INVALID_PACKET Fail to send since payload is not committed, or packet was
+ *                                        appended to after reservation.
+ */
+UINT nx_azure_iot_hub_client_telemetry_payload_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                    NX_AZURE_IOT_HUB_CLIENT_PAYLOAD *payload_ptr,
+                                                    UINT qos, UINT wait_option);
+
+/**
+ * @brief Sends telemetry message with externally owned payload.
+ * @details This routine sends telemetry whose payload stays in caller memory, such as a DMA buffer.
+ *          Payload is copied into one packet of #NX_AZURE_IOT_MQTT_STREAM_CHUNK_SIZE bytes at a time
+ *          and encrypted, so the packet pool does not need to hold the whole message.
+ *          `release_callback` is invoked exactly once, when payload is no longer referenced,
+ *          with the final status. With publish scheduler enabled it is invoked from cloud helper
+ *          thread and must not block. Payload must not be modified until then.
+ *          Unless #NX_AZURE_IOT_INVALID_PARAMETER is returned, `packet_ptr` is released by the SDK.
+ *          Only QoS 0 is supported, since payload is not kept for retransmission. If sending fails after
+ *          part of the message went out, the client is disconnected. Compression is not applied.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] telemetry_data Pointer to externally owned telemetry data.
+ * @param[in] data_size Size of telemetry data.
+ * @param[in] qos #NX_AZURE_IOT_MQTT_QOS_0.
+ * @param[in] release_callback Callback invoked when payload is released. Can be `NULL`.
+ * @param[in] callback_args Pointer to an argument passed to `release_callback`.
+ * @param[in] wait_option Ticks to wait for message to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is queued or sent out.
+ */
+UINT nx_azure_iot_hub_client_telemetry_send_external(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                     UCHAR *telemetry_data, UINT data_size, UINT qos,
+                                                     VOID (*release_callback)(
+                                                           NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                           UCHAR *telemetry_data, UINT status, VOID *args),
+                                                     VOID *callback_args, UINT wait_option);
+
+/**
+ * @brief Sends telemetry message with JSON payload packet.
+ * @details This routine sends telemetry whose payload was written by #NX_AZURE_IOT_JSON_WRITER into
+ *          `json_packet_ptr`. The payload packet is chained after the topic without copying.
+ *          `json_packet_ptr` is released by the SDK, whatever the result. On failure `packet_ptr` is
+ *          restored to its topic and properties, so it can be sent again. Like
+ *          nx_azure_iot_hub_client_telemetry_sendv(), telemetry store, spool and compression are not used.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] json_packet_ptr A pointer to packet holding JSON payload.
+ * @param[in] qos #NX_AZURE_IOT_MQTT_QOS_0 or #NX_AZURE_IOT_MQTT_QOS_1.
+ * @param[in] wait_option Ticks to wait for message to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is sent out.
+ */
+UINT nx_azure_iot_hub_client_telemetry_json_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                 NX_PACKET *json_packet_ptr, UINT qos, UINT wait_option);
+
+/**
+ * @brief Sends telemetry message with CBOR payload packet.
+ * @details This routine sends telemetry whose payload was written by #NX_AZURE_IOT_CBOR_ENCODER into
+ *          `cbor_packet_ptr`, in the same way as nx_azure_iot_hub_client_telemetry_json_send(). The content
+ *          type property `$.ct=application/cbor` is added to `packet_ptr` first, and stays there if the
+ *          message is not sent. `cbor_packet_ptr` is released by the SDK, whatever the result.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] cbor_packet_ptr A pointer to packet holding CBOR payload.
+ * @param[in] qos #NX_AZURE_IOT_MQTT_QOS_0 or #NX_AZURE_IOT_MQTT_QOS_1.
+ * @param[in] wait_option Ticks to wait for message to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is sent out.
+ */
+UINT nx_azure_iot_hub_client_telemetry_cbor_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                 NX_PACKET *cbor_packet_ptr, UINT qos, UINT wait_option);
+
+/**
+ * @brief Gets telemetry statistics.
+ * @details This routine returns the number of telemetry messages sent out at each QoS level.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[out] qos0_count_ptr Returned number of QoS 0 messages. Can be `NULL`.
+ * @param[out] qos1_count_ptr Returned number of QoS 1 messages. Can be `NULL`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if statistics are returned.
+ */
+UINT nx_azure_iot_hub_client_telemetry_statistics_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                      ULONG *qos0_count_ptr, ULONG *qos1_count_ptr);
+
+/**
+ * @brief Creates telemetry message template.
+ * @details This routine renders the telemetry topic once into `buffer`. Static properties can then be
+ *          added to the template, and messages created from it start with a copy of the whole image.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] template_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE.
+ * @param[in] buffer A `UCHAR` pointer to memory holding the template image.
+ * @param[in] buffer_size Size of `buffer`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if template is created.
+ */
+UINT nx_azure_iot_hub_client_telemetry_template_create(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                       NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE *template_ptr,
+                                                       UCHAR *buffer, UINT buffer_size);
+
+/**
+ * @brief Add static property to telemetry message template
+ * @details This routine adds a property that is part of every message created from the template.
+ *
+ * @param[in] template_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE.
+ * @param[in] property_name Pointer to property name.
+ * @param[in] property_name_length Length of property name.
+ * @param[in] property_value Pointer to property value.
+ * @param[in] property_value_length Length of property value.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if property is added.
+ *   @retval #NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE If template buffer is too small.
+ */
+UINT nx_azure_iot_hub_client_telemetry_template_property_add(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE *template_ptr,
+                                                             UCHAR *property_name, USHORT property_name_length,
+                                                             UCHAR *property_value, USHORT property_value_length);
+
+/**
+ * @brief Creates telemetry message from template.
+ * @details This routine prepares a packet for sending telemetry data, with topic and static properties
+ *          copied from the template. Application can add per-message properties before sending out.
+ *
+ * @param[in] template_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE.
+ * @param[out] packet_pptr Returned allocated `NX_PACKET` on success.
+ * @param[in] wait_option Ticks to wait if no packet is available.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if a packet is allocated.
+ */
+UINT nx_azure_iot_hub_client_telemetry_template_message_create(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_TEMPLATE *template_ptr,
+                                                               NX_PACKET **packet_pptr, UINT wait_option);
+
+/**
+ * @brief Enables telemetry store and forward
+ * @details This routine enables a RAM ring of `buffer_size` bytes. Telemetry sent while the client is not
+ *          connected is copied into the ring, and is sent out from the cloud helper thread once connection
+ *          is established. Messages sent while stored messages remain are queued behind them to keep order.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] buffer A `UCHAR` pointer to memory of the ring.
+ * @param[in] buffer_size Size of `buffer`.
+ * @param[in] policy #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_OLDEST or
+ *                   #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_NEWEST.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if store is enabled.
+ */
+UINT nx_azure_iot_hub_client_telemetry_store_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                    UCHAR *buffer, UINT buffer_size, UINT policy);
+
+/**
+ * @brief Disables telemetry store and forward
+ * @details This routine disables the store. Messages still stored are discarded.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if store is disabled.
+ */
+UINT nx_azure_iot_hub_client_telemetry_store_disable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+
+/**
+ * @brief Gets telemetry store status
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[out] used_bytes_ptr Returned number of bytes in use. Can be `NULL`.
+ * @param[out] dropped_count_ptr Returned number of messages dropped because store was full. Can be `NULL`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if status is returned.
+ */
+UINT nx_azure_iot_hub_client_telemetry_store_status_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        UINT *used_bytes_ptr, ULONG *dropped_count_ptr);
+
+/**
+ * @brief Sends telemetry message with priority
+ * @details This routine sends telemetry at QoS 1 like nx_azure_iot_hub_client_telemetry_send(), through
+ *          the publish queue of `priority` when the publish scheduler is enabled. Without the scheduler,
+ *          `priority` is ignored. #NX_AZURE_IOT_HUB_CLIENT_PRIORITY_CONTROL is reserved for direct method
+ *          responses and is rejected.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] telemetry_data Pointer to telemetry data.
+ * @param[in] data_size Size of telemetry data.
+ * @param[in] priority #NX_AZURE_IOT_HUB_CLIENT_PRIORITY_ALARM or #NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK.
+ * @param[in] wait_option Ticks to wait for message to be queued or sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is queued or sent out.
+ */
+UINT nx_azure_iot_hub_client_telemetry_send_priority(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                                     UCHAR *telemetry_data, UINT data_size, UINT priority,
+                                                     UINT wait_option);
+
+/**
+ * @brief Enables publish scheduler
+ * @details This routine routes telemetry, direct method responses and device twin reported properties
+ *          written by NX_AZURE_IOT_JSON_WRITER through one queue per priority. Direct method responses and
+ *          reported properties use #NX_AZURE_IOT_HUB_CLIENT_PRIORITY_CONTROL, telemetry sent by
+ *          nx_azure_iot_hub_client_telemetry_send_priority() uses the given priority and all other telemetry
+ *          uses #NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK. Send APIs return once the complete PUBLISH packet is
+ *          queued, and wait up to their `wait_option` while the queue is full. The cloud helper thread sends
+ *          queued messages: it always sends from the highest priority queue that is not empty, except that
+ *          after `starvation_budget` consecutive messages sent while a lower priority queue waits, it sends
+ *          the oldest waiting message of the lower priorities. Messages still queued on disconnect are
+ *          released and counted as dropped.
+ *
+ *          Not queued: device twin document requests and reported properties sent from a buffer are
+ *          published by the calling thread, and telemetry held by store or spool is replayed by the cloud
+ *          helper thread after the queues are served.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] starvation_budget Number of consecutive higher priority messages before a lower priority
+ *                              message is served. Zero means strict priority.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if scheduler is enabled.
+ */
+UINT nx_azure_iot_hub_client_publish_scheduler_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                      UINT starvation_budget);
+
+/**
+ * @brief Disables publish scheduler
+ * @details This routine disables the scheduler. Messages still queued are released and counted as dropped.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if scheduler is disabled.
+ */
+UINT nx_azure_iot_hub_client_publish_scheduler_disable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+
+/**
+ * @brief Gets publish queue status
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] priority #NX_AZURE_IOT_HUB_CLIENT_PRIORITY_CONTROL, #NX_AZURE_IOT_HUB_CLIENT_PRIORITY_ALARM or
+ *                     #NX_AZURE_IOT_HUB_CLIENT_PRIORITY_BULK.
+ * @param[out] depth_ptr Number of messages queued. Can be `NULL`.
+ * @param[out] sent_count_ptr Number of messages sent from queue. Can be `NULL`.
+ * @param[out] dropped_count_ptr Number of messages that failed to send or were released on disconnect.
+ *                               Can be `NULL`.
+ * @param[out] latency_average_ptr Average ticks from enqueue to send. Can be `NULL`.
+ * @param[out] latency_max_ptr Maximum ticks from enqueue to send. Can be `NULL`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if status is returned.
+ */
+UINT nx_azure_iot_hub_client_publish_queue_status_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT priority,
+                                                      UINT *depth_ptr, ULONG *sent_count_ptr,
+                                                      ULONG *dropped_count_ptr, ULONG *latency_average_ptr,
+                                                      ULONG *latency_max_ptr);
+
+/**
+ * @brief Configures receive queue
+ * @details This routine bounds the number of received messages of one type that are kept until application
+ *          receives them, so a slow application can not drain the packet pool shared with telemetry and
+ *          acknowledgements. When the queue is full, `policy` decides what happens to a new message:
+ *
+ *          - #NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_OLDEST releases the oldest queued message.
+ *          - #NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_NEWEST releases the new message.
+ *          - #NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_STOP_READING stops taking messages of any type from MQTT.
+ *            They are dispatched again once application receives from the full queue. Note NetX Duo MQTT
+ *            still reads the socket, so held messages keep using its receive queue.
+ *
+ *          Queue depth defaults to NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DEPTH with drop oldest policy.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] message_type #NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE, #NX_AZURE_IOT_HUB_DIRECT_METHOD,
+ *                         #NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES or
+ *                         #NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES.
+ * @param[in] depth Maximum number of queued messages. Zero means no limit.
+ * @param[in] policy Policy when queue is full.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if receive queue is configured.
+ */
+UINT nx_azure_iot_hub_client_receive_queue_configure(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type,
+                                                     UINT depth, UINT policy);
+
+/**
+ * @brief Gets receive queue status
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] message_type #NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE, #NX_AZURE_IOT_HUB_DIRECT_METHOD,
+ *                         #NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES or
+ *                         #NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES.
+ * @param[out] depth_ptr Number of messages queued. Can be `NULL`.
+ * @param[out] high_water_mark_ptr Maximum number of messages ever queued. Can be `NULL`.
+ * @param[out] dropped_count_ptr Number of messages dropped because queue was full. Can be `NULL`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if status is returned.
+ */
+UINT nx_azure_iot_hub_client_receive_queue_status_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type,
+                                                      UINT *depth_ptr, UINT *high_water_mark_ptr,
+                                                      ULONG *dropped_count_ptr);
+
+/**
+ * @brief Enables receive ring of one message type
+ * @details Messages of `message_type` are copied into a ring of `buffer_size` bytes when they are received,
+ *          and their packets are released to the pool right away. Read them with
+ *          nx_azure_iot_hub_client_message_copy_receive(). When the ring has no room, the queue policy set by
+ *          nx_azure_iot_hub_client_receive_queue_configure() applies:
+ *          #NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_OLDEST discards oldest messages,
+ *          #NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_NEWEST discards the new message, and
+ *          #NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_STOP_READING holds the message with MQTT until ring is read.
+ *          Discarded messages are counted as dropped. A payload larger than the whole ring is truncated.
+ *          Message types can be:
+ *
+ *          - #NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE
+ *          - #NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES
+ *          - #NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] message_type Message type kept in ring.
+ * @param[in] buffer A `UCHAR` pointer to memory of the ring.
+ * @param[in] buffer_size Size of `buffer`.
+ * @param[in] flags Zero or #NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RING_TOPIC.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if ring is enabled.
+ *   @retval #NX_AZURE_IOT_NOT_SUPPORTED Fail to enable ring due to unsupported message type.
+ */
+UINT nx_azure_iot_hub_client_receive_ring_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type,
+                                                 UCHAR *buffer, UINT buffer_size, UINT flags);
+
+/**
+ * @brief Disables receive ring of one message type
+ * @details Messages still in the ring are discarded, and new messages are queued as packets again.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] message_type Message type kept in ring.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if ring is disabled.
+ */
+UINT nx_azure_iot_hub_client_receive_ring_disable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type);
+
+/**
+ * @brief Receives message by copy
+ * @details This routine copies the next message of `message_type` into `buffer` and releases its packets at
+ *          once, so application does not hold pool packets. The message comes from the receive ring if one
+ *          is enabled, otherwise from the packet queue. If `topic_length_ptr` is not `NULL`, the topic, which
+ *          holds the message properties, is copied in front of the payload when it is available.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] message_type #NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE, #NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES
+ *                         or #NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES.
+ * @param[out] buffer A `UCHAR` pointer to buffer receiving message.
+ * @param[in] buffer_size Size of `buffer`.
+ * @param[out] topic_length_ptr Returned length of topic copied. Can be `NULL`.
+ * @param[out] payload_length_ptr Returned length of payload copied.
+ * @param[out] truncated_length_ptr Returned number of bytes of the message that are not copied, because ring
+ *                                  or `buffer` was too small. Can be `NULL`.
+ * @param[in] wait_option Ticks to wait for message to arrive.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if message is copied.
+ *   @retval #NX_AZURE_IOT_NO_PACKET No message is received.
+ */
+UINT nx_azure_iot_hub_client_message_copy_receive(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT message_type,
+                                                  UCHAR *buffer, UINT buffer_size, UINT *topic_length_ptr,
+                                                  UINT *payload_length_ptr, ULONG *truncated_length_ptr,
+                                                  UINT wait_option);
+
+/**
+ * @brief Sets rate limit of outgoing messages
+ * @details This routine configures a token bucket for one class of messages, so the device stays within
+ *          IoT Hub throttling quotas. The bucket holds up to `burst` tokens and is refilled with `rate`
+ *          tokens every `period` ticks. Each message takes one token. If no token is available, the send
+ *          API waits for the next token when `wait_option` allows, or returns #NX_AZURE_IOT_THROTTLED.
+ *          Stored telemetry sent from the cloud helper thread also takes tokens and is kept until tokens
+ *          are available. Setting `rate` to zero disables the limiter. The bucket starts full. `burst`
+ *          multiplied by `period` must not exceed #NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_CREDIT_MAX.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] limit_class #NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+ *                        #NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TWIN or #NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_METHOD.
+ * @param[in] rate Number of tokens added per `period`.
+ * @param[in] period Period in ticks.
+ * @param[in] burst Maximum number of tokens.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if rate limit is set.
+ *   @retval #NX_AZURE_IOT_INVALID_PARAMETER If `period` or `burst` is zero, or the bucket does not fit.
+ */
+UINT nx_azure_iot_hub_client_rate_limit_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT limit_class,
+                                            UINT rate, UINT period, UINT burst);
+
+/**
+ * @brief Gets rate limit status
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] limit_class #NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TELEMETRY,
+ *                        #NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_TWIN or #NX_AZURE_IOT_HUB_CLIENT_RATE_LIMIT_METHOD.
+ * @param[out] tokens_ptr Number of tokens currently available. Can be `NULL`.
+ * @param[out] throttle_count_ptr Number of sends that found no token. Can be `NULL`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if status is returned.
+ */
+UINT nx_azure_iot_hub_client_rate_limit_status_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT limit_class,
+                                                   UINT *tokens_ptr, ULONG *throttle_count_ptr);
+
+/**
+ * @brief Enables telemetry payload compression
+ * @details This routine enables compression of telemetry sent by nx_azure_iot_hub_client_telemetry_send()
+ *          and nx_azure_iot_hub_client_telemetry_send_qos(). Payloads of at least
+ *          #NX_AZURE_IOT_HUB_CLIENT_COMPRESS_MIN_SIZE bytes are encoded as zlib stream and marked with the
+ *          application property #NX_AZURE_IOT_HUB_CLIENT_COMPRESSION_PROPERTY set to
+ *          #NX_AZURE_IOT_HUB_CLIENT_COMPRESSION_ZLIB. IoTHub does not inflate payloads, and `$.ce` only
+ *          takes a character set there, so it is not used. Routing queries on the message body can not
+ *          match a compressed payload. Payloads that do not get smaller are sent as is. The hash
+ *          table and output buffer are taken from `arena`, so the largest compressed payload is `arena_size`
+ *          minus #NX_AZURE_IOT_COMPRESS_HASH_TABLE_SIZE. An optional preset dictionary, such as frequent
+ *          JSON keys, improves compression of small payloads. Receiver must use the same dictionary.
+ *          One sender uses `arena` at a time. A payload is sent as is if `arena` is not free within the
+ *          `wait_option` of the send.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] arena A `UCHAR` pointer to working memory.
+ * @param[in] arena_size Size of `arena`.
+ * @param[in] dictionary A `UCHAR` pointer to preset dictionary. Can be `NULL`.
+ * @param[in] dictionary_size Size of `dictionary`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if compression is enabled.
+ */
+UINT nx_azure_iot_hub_client_telemetry_compression_enable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                          UCHAR *arena, UINT arena_size,
+                                                          const UCHAR *dictionary, UINT dictionary_size);
+
+/**
+ * @brief Disables telemetry payload compression
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if compression is disabled.
+ */
+UINT nx_azure_iot_hub_client_telemetry_compression_disable(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+
+/**
+ * @brief Gets telemetry compression statistics
+ * @details This routine returns the total size of payloads before and after compression. Payloads sent
+ *          without compression are not counted.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[out] input_bytes_ptr Total size of payloads before compression. Can be `NULL`.
+ * @param[out] output_bytes_ptr Total size of payloads after compression. Can be `NULL`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if statistics are returned.
+ */
+UINT nx_azure_iot_hub_client_telemetry_compression_statistics_get(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                  ULONG *input_bytes_ptr, ULONG *output_bytes_ptr);
+
+/**
+ * @brief Sets persistent telemetry spool
+ * @details This routine attaches an opened #NX_AZURE_IOT_SPOOL to the hub client. Telemetry sent while
+ *          the client is not connected, or while spooled messages remain, is appended to the spool. After
+ *          connection is established, spooled messages are replayed in order from the cloud helper thread,
+ *          and the committed position advances only as PUBACKs arrive. The spool takes precedence over the
+ *          RAM store. Setting `spool_ptr` to `NULL` detaches the spool.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] spool_ptr A pointer to an opened #NX_AZURE_IOT_SPOOL.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if spool is set.
+ */
+UINT nx_azure_iot_hub_client_telemetry_spool_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                 NX_AZURE_IOT_SPOOL *spool_ptr);
+
+/**
+ * @brief Sets the telemetry acknowledgement callback
+ * @details This routine sets the callback function invoked when an asynchronous telemetry message completes.
+ *          `status` is #NX_AZURE_IOT_SUCCESS when PUBACK is received, #NX_AZURE_IOT_TIMEOUT if no PUBACK arrived
+ *          in #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_ACK_TIMEOUT ticks, or #NX_AZURE_IOT_DISCONNECTED if connection
+ *          is lost. Setting the callback function to `NULL` disables the callback function.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] callback_ptr Pointer to a callback function invoked when a message completes.
+ * @param[in] callback_args Pointer to an argument passed to callback function.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if callback function is set.
+ */
+UINT nx_azure_iot_hub_client_telemetry_ack_callback_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                        VOID (*callback_ptr)(
+                                                              NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                              USHORT packet_id, UINT status, VOID *args),
+                                                        VOID *callback_args);
+
+/**
+ * @brief Sets the telemetry in-flight window
+ * @details This routine sets the number of asynchronous telemetry messages allowed to wait for PUBACK.
+ *          Default is #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] window Number of messages, from 1 to #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_INFLIGHT_MAX_COUNT.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if window is set.
+ */
+UINT nx_azure_iot_hub_client_telemetry_inflight_window_set(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, UINT window);
+
+/**
+ * @brief Sends telemetry message to IoTHub without waiting for acknowledgement.
+ * @details This routine sends telemetry to IoTHub like nx_azure_iot_hub_client_telemetry_send(), and returns
+ *          the MQTT packet id of the message. Completion is reported through the callback set by
+ *          nx_azure_iot_hub_client_telemetry_ack_callback_set(). Message is tracked before it is published,
+ *          so the callback may run before this routine returns. No callback is made for a message whose
+ *          send fails, unless the connection was lost meanwhile.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] telemetry_data Pointer to telemetry data.
+ * @param[in] data_size Size of telemetry data.
+ * @param[out] packet_id_ptr Returned MQTT packet id of the message.
+ * @param[in] wait_option Ticks to wait for message to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is sent out.
+ *   @retval #NX_AZURE_IOT_INFLIGHT_WINDOW_FULL If in-flight window is full.
+ */
+UINT nx_azure_iot_hub_client_telemetry_send_async(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                  NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                  UINT data_size, USHORT *packet_id_ptr, UINT wait_option);
+
+/**
+ * @brief Sends telemetry message with scattered payload to IoTHub.
+ * @details This routine sends telemetry to IoTHub like nx_azure_iot_hub_client_telemetry_send(), but gathers
+ *          the payload from `count` fragments, copying each one straight into the packet chain.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] vec Pointer to array of #NX_AZURE_IOT_IOVEC describing the payload fragments.
+ * @param[in] count Number of entries in `vec`.
+ * @param[in] wait_option Ticks to wait for message to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is sent out.
+ *   @retval #NX_AZURE_IOT_MESSAGE_TOO_LONG If message exceeds the MQTT remaining length limit.
+ */
+UINT nx_azure_iot_hub_client_telemetry_sendv(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                             const NX_AZURE_IOT_IOVEC *vec, UINT count, UINT wait_option);
+
+/**
+ * @brief Begins a telemetry batch.
+ * @details This routine initializes a batch that coalesces several telemetry messages into one
+ *          packet chain, so they are sent to IoTHub in a single TLS record. Batched messages are
+ *          sent with #NX_AZURE_IOT_MQTT_QOS_1 and each has its own packet id. Their completion is
+ *          reported through the callback set by nx_azure_iot_hub_client_telemetry_ack_callback_set(),
+ *          as for nx_azure_iot_hub_client_telemetry_send_async().
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] batch_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if batch is initialized.
+ */
+UINT nx_azure_iot_hub_client_telemetry_batch_begin(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                   NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH *batch_ptr);
+
+/**
+ * @brief Adds telemetry message to a batch.
+ * @details This routine completes the PUBLISH frame of a telemetry message created by
+ *          nx_azure_iot_hub_client_telemetry_message_create() and appends it to the batch. On success,
+ *          the batch owns `packet_ptr`. The frame is built with #NX_AZURE_IOT_MQTT_QOS_1 and a packet id
+ *          of its own. A batch holds no more messages than the in-flight window.
+ *
+ * @param[in] batch_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH.
+ * @param[in] packet_ptr A pointer to telemetry property packet.
+ * @param[in] telemetry_data Pointer to telemetry data.
+ * @param[in] data_size Size of telemetry data.
+ * @param[out] packet_id_ptr Packet id of the message, passed to the acknowledgement callback.
+ * @param[in] wait_option Ticks to wait if packet needs to be expanded.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry message is added to the batch.
+ *   @retval #NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE If batch is full and must be flushed first.
+ */
+UINT nx_azure_iot_hub_client_telemetry_batch_add(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH *batch_ptr,
+                                                 NX_PACKET *packet_ptr, UCHAR *telemetry_data,
+                                                 UINT data_size, USHORT *packet_id_ptr, UINT wait_option);
+
+/**
+ * @brief Sends all telemetry messages in a batch to IoTHub.
+ * @details This routine hands all PUBLISH frames of the batch to TLS in a single write. Each message
+ *          takes an entry of the in-flight window until its PUBACK arrives. The batch is kept if it is
+ *          throttled or the window has no room for it. Otherwise it is empty after return, and its
+ *          packets are released if the send fails.
+ *
+ * @param[in] batch_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH.
+ * @param[in] wait_option Ticks to wait for messages to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if telemetry messages are sent out.
+ *   @retval #NX_AZURE_IOT_INFLIGHT_WINDOW_FULL If in-flight window has no room for the batch.
+ */
+UINT nx_azure_iot_hub_client_telemetry_batch_flush(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_BATCH *batch_ptr,
+                                                   UINT wait_option);
+
 /**
  * @brief Enable receiving C2D message from IoTHub.
  *
@@ -378,6 +1386,58 @@ UINT nx_azure_iot_hub_client_cloud_message_property_get(NX_AZURE_IOT_HUB_CLIENT
                                                         USHORT property_name_length, UCHAR **property_value,
                                                         USHORT *property_value_length);
 
+/**
+ * @brief Build property index of the C2D message
+ * @details This routine parses the topic of the C2D message once and keeps offsets of all its properties,
+ *          so reading several properties does not parse the topic again.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] packet_ptr Pointer to NX_PACKET containing C2D message.
+ * @param[out] index_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if index is built.
+ *   @retval #NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE Fail to build index since message has more than
+ *           NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX_SIZE properties.
+ */
+UINT nx_azure_iot_hub_client_cloud_message_property_index_build(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                NX_PACKET *packet_ptr,
+                                                                NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX *index_ptr);
+
+/**
+ * @brief Retrieve the property with given property name from property index.
+ *
+ * @param[in] index_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX.
+ * @param[in] property_name A `UCHAR` pointer to property name.
+ * @param[in] property_name_length Length of `property_name`.
+ * @param[out] property_value Pointer to property value in the message.
+ * @param[out] property_value_length A `USHORT` pointer to size of `property_value`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if property is found.
+ *   @retval #NX_AZURE_IOT_NOT_FOUND If property is not found.
+ */
+UINT nx_azure_iot_hub_client_cloud_message_property_index_get(NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX *index_ptr,
+                                                              const UCHAR *property_name, USHORT property_name_length,
+                                                              const UCHAR **property_value, USHORT *property_value_length);
+
+/**
+ * @brief Iterate properties of property index.
+ * @details Properties are returned in the order of the topic. Set `*position_ptr` to zero before first call.
+ *
+ * @param[in] index_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX.
+ * @param[in,out] position_ptr Position of next property, advanced on success.
+ * @param[out] property_name Pointer to property name in the message.
+ * @param[out] property_name_length A `USHORT` pointer to size of `property_name`.
+ * @param[out] property_value Pointer to property value in the message.
+ * @param[out] property_value_length A `USHORT` pointer to size of `property_value`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if property is returned.
+ *   @retval #NX_AZURE_IOT_NOT_FOUND If all properties are returned.
+ */
+UINT nx_azure_iot_hub_client_cloud_message_property_index_next(NX_AZURE_IOT_HUB_CLIENT_PROPERTY_INDEX *index_ptr,
+                                                               UINT *position_ptr,
+                                                               const UCHAR **property_name, USHORT *property_name_length,
+                                                               const UCHAR **property_value, USHORT *property_value_length);
+
 /**
  * @brief Enables device twin feature
  * @details This routine enables device twin feature.
@@ -437,6 +1497,24 @@ UINT nx_azure_iot_hub_client_device_twin_reported_properties_send(NX_AZURE_IOT_H
                                                                   UINT *request_id_ptr, UINT *response_status_ptr,
                                                                   UINT wait_option);
 
+/**
+ * @brief Send device twin reported properties from JSON payload packet
+ * @details This routine sends device twin reported properties written by #NX_AZURE_IOT_JSON_WRITER into
+ *          `json_packet_ptr`, which is chained after the topic without copying and released by the SDK.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] json_packet_ptr A pointer to packet holding JSON document of reported properties.
+ * @param[out] request_id_ptr Request Id assigned to the request.
+ * @param[out] response_status_ptr Status return for successful send of reported properties.
+ * @param[in] wait_option Ticks to wait for message to send.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if device twin reported properties is sent successfully.
+ */
+UINT nx_azure_iot_hub_client_device_twin_reported_properties_json_send(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                       NX_PACKET *json_packet_ptr,
+                                                                       UINT *request_id_ptr, UINT *response_status_ptr,
+                                                                       UINT wait_option);
+
 /**
  * @brief Request complete device twin properties
  * @details This routine requests complete device twin properties.
@@ -533,6 +1611,70 @@ UINT nx_azure_iot_hub_client_direct_method_message_response(NX_AZURE_IOT_HUB_CLI
                                                             UINT status_code, VOID *context_ptr,
                                                             USHORT context_length, UCHAR *payload,
                                                             UINT payload_length, UINT wait_option);
+
+/**
+ * @brief Return response to direct method message from JSON payload packet
+ * @details This routine returns response whose payload was written by #NX_AZURE_IOT_JSON_WRITER into
+ *          `json_packet_ptr`, which is chained after the topic without copying and released by the SDK.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] status_code Status code for direct method.
+ * @param[in] context_ptr Pointer to context return from nx_azure_iot_hub_client_direct_method_message_receive().
+ * @param[in] context_length Length of context.
+ * @param[in] json_packet_ptr A pointer to packet holding JSON payload of response.
+ * @param[in] wait_option Ticks to wait for message to send.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS  Successful if direct method response is send.
+ */
+UINT nx_azure_iot_hub_client_direct_method_message_json_response(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                 UINT status_code, VOID *context_ptr,
+                                                                 USHORT context_length, NX_PACKET *json_packet_ptr,
+                                                                 UINT wait_option);
+
+/**
+ * @brief Registers direct method handler
+ * @details This routine registers `callback_ptr` for method `method_name`. Method names are hashed into a
+ *          table once here, so an incoming method is matched with one hash and one compare. A matched method
+ *          is served directly in the receive path: the callback is invoked with the request payload in
+ *          `packet_ptr` and a JSON writer for the response payload, and the response is published with the
+ *          status code the callback returns. Methods without handler are still queued for
+ *          nx_azure_iot_hub_client_direct_method_message_receive().
+ *
+ *          The callback runs in the MQTT thread with the client mutex held, so it must not block. Packets for
+ *          the response payload are taken from the pool without waiting, and the callback must check results
+ *          of the writer. An empty payload is sent as `{}`. `packet_ptr` is released after the callback returns.
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] handler_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER, which must stay valid until
+ *                        the handler is deregistered.
+ * @param[in] method_name Pointer to method name, which must stay valid.
+ * @param[in] method_name_length Length of `method_name`.
+ * @param[in] callback_ptr Pointer to a callback function that returns status code of response.
+ * @param[in] callback_args Pointer to an argument passed to callback function.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if handler is registered.
+ */
+UINT nx_azure_iot_hub_client_direct_method_handler_register(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                            NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *handler_ptr,
+                                                            const UCHAR *method_name, UINT method_name_length,
+                                                            UINT (*callback_ptr)(
+                                                                  NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                                  NX_PACKET *packet_ptr,
+                                                                  NX_AZURE_IOT_JSON_WRITER *response_writer_ptr,
+                                                                  VOID *args),
+                                                            VOID *callback_args);
+
+/**
+ * @brief Deregisters direct method handler
+ *
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] handler_ptr A pointer to a registered #NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if handler is deregistered.
+ *   @retval #NX_AZURE_IOT_NOT_FOUND Fail since handler is not registered.
+ */
+UINT nx_azure_iot_hub_client_direct_method_handler_deregister(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                                              NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER *handler_ptr);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,771 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+#include "nx_azure_iot_json_writer.h"
+
+/* Double layout.  */
+#define NX_AZURE_IOT_JSON_DOUBLE_SIGN_MASK                0x8000000000000000ULL
+#define NX_AZURE_IOT_JSON_DOUBLE_EXPONENT_MASK            0x7FF0000000000000ULL
+#define NX_AZURE_IOT_JSON_DOUBLE_SIGNIFICAND_MASK         0x000FFFFFFFFFFFFFULL
+#define NX_AZURE_IOT_JSON_DOUBLE_HIDDEN_BIT               0x0010000000000000ULL
+#define NX_AZURE_IOT_JSON_DOUBLE_SIGNIFICAND_SIZE         52
+#define NX_AZURE_IOT_JSON_DOUBLE_EXPONENT_BIAS            (0x3FF + NX_AZURE_IOT_JSON_DOUBLE_SIGNIFICAND_SIZE)
+
+/* Decimal exponent of first cached power and step between entries.  */
+#define NX_AZURE_IOT_JSON_CACHED_POWER_MIN_EXPONENT       (-348)
+#define NX_AZURE_IOT_JSON_CACHED_POWER_STEP               8
+
+/* Floating point number f * 2^e with 64-bit significand.  */
+typedef struct NX_AZURE_IOT_JSON_FP_STRUCT
+{
+    ULONG64     fp_f;
+    INT         fp_e;
+} NX_AZURE_IOT_JSON_FP;
+
+static const CHAR nx_azure_iot_json_digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const ULONG64 nx_azure_iot_json_pow10[] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/* Normalized 10^k for k = -348, -340, ..., 340.  */
+static const ULONG64 nx_azure_iot_json_cached_power_f[] =
+{
+    0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL, 0x8B16FB203055AC76ULL,
+    0xCF42894A5DCE35EAULL, 0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL,
+    0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL, 0xBE5691EF416BD60CULL,
+    0x8DD01FAD907FFC3CULL, 0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+    0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL, 0x823C12795DB6CE57ULL,
+    0xC21094364DFB5637ULL, 0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL,
+    0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL, 0xB23867FB2A35B28EULL,
+    0x84C8D4DFD2C63F3BULL, 0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+    0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL, 0xF3E2F893DEC3F126ULL,
+    0xB5B5ADA8AAFF80B8ULL, 0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL,
+    0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL, 0xA6DFBD9FB8E5B88FULL,
+    0xF8A95FCF88747D94ULL, 0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+    0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL, 0xE45C10C42A2B3B06ULL,
+    0xAA242499697392D3ULL, 0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL,
+    0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL, 0x9C40000000000000ULL,
+    0xE8D4A51000000000ULL, 0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+    0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL, 0xD5D238A4ABE98068ULL,
+    0x9F4F2726179A2245ULL, 0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL,
+    0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL, 0x924D692CA61BE758ULL,
+    0xDA01EE641A708DEAULL, 0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+    0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL, 0xC83553C5C8965D3DULL,
+    0x952AB45CFA97A0B3ULL, 0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL,
+    0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL, 0x88FCF317F22241E2ULL,
+    0xCC20CE9BD35C78A5ULL, 0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+    0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL, 0xBB764C4CA7A44410ULL,
+    0x8BAB8EEFB6409C1AULL, 0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL,
+    0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL, 0x80444B5E7AA7CF85ULL,
+    0xBF21E44003ACDD2DULL, 0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+    0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL, 0xAF87023B9BF0EE6BULL
+};
+
+static const SHORT nx_azure_iot_json_cached_power_e[] =
+{
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static NX_AZURE_IOT_JSON_FP nx_azure_iot_json_fp_multiply(NX_AZURE_IOT_JSON_FP x, NX_AZURE_IOT_JSON_FP y)
+{
+NX_AZURE_IOT_JSON_FP result;
+ULONG64 a = x.fp_f >> 32;
+ULONG64 b = x.fp_f & 0xFFFFFFFF;
+ULONG64 c = y.fp_f >> 32;
+ULONG64 d = y.fp_f & 0xFFFFFFFF;
+ULONG64 ac = a * c;
+ULONG64 bc = b * c;
+ULONG64 ad = a * d;
+ULONG64 bd = b * d;
+ULONG64 mid;
+
+    /* Upper 64 bits of product, rounded.  */
+    mid = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF) + (1ULL << 31);
+    result.fp_f = ac + (ad >> 32) + (bc >> 32) + (mid >> 32);
+    result.fp_e = x.fp_e + y.fp_e + 64;
+
+    return(result);
+}
+
+static NX_AZURE_IOT_JSON_FP nx_azure_iot_json_fp_normalize(NX_AZURE_IOT_JSON_FP x)
+{
+    while (!(x.fp_f & NX_AZURE_IOT_JSON_DOUBLE_SIGN_MASK))
+    {
+        x.fp_f <<= 1;
+        x.fp_e--;
+    }
+
+    return(x);
+}
+
+static VOID nx_azure_iot_json_fp_boundaries(NX_AZURE_IOT_JSON_FP v, NX_AZURE_IOT_JSON_FP *minus_ptr,
+                                            NX_AZURE_IOT_JSON_FP *plus_ptr)
+{
+NX_AZURE_IOT_JSON_FP plus;
+NX_AZURE_IOT_JSON_FP minus;
+
+    /* Boundaries are halfway to the neighbouring doubles.  */
+    plus.fp_f = (v.fp_f << 1) + 1;
+    plus.fp_e = v.fp_e - 1;
+    plus = nx_azure_iot_json_fp_normalize(plus);
+
+    /* Lower neighbour is closer at a power of two.  */
+    if (v.fp_f == NX_AZURE_IOT_JSON_DOUBLE_HIDDEN_BIT)
+    {
+        minus.fp_f = (v.fp_f << 2) - 1;
+        minus.fp_e = v.fp_e - 2;
+    }
+    else
+    {
+        minus.fp_f = (v.fp_f << 1) - 1;
+        minus.fp_e = v.fp_e - 1;
+    }
+
+    minus.fp_f <<= minus.fp_e - plus.fp_e;
+    minus.fp_e = plus.fp_e;
+
+    *minus_ptr = minus;
+    *plus_ptr = plus;
+}
+
+static NX_AZURE_IOT_JSON_FP nx_azure_iot_json_cached_power_get(INT e, INT *k_ptr)
+{
+NX_AZURE_IOT_JSON_FP result;
+double dk = (-61 - e) * 0.30102999566398114 + 347;
+INT k = (INT)dk;
+UINT index;
+
+    /* Pick 10^-k so that the scaled exponent lands in [-60, -32].  */
+    if ((dk - k) > 0.0)
+    {
+        k++;
+    }
+
+    index = (UINT)((k >> 3) + 1);
+    *k_ptr = -(NX_AZURE_IOT_JSON_CACHED_POWER_MIN_EXPONENT + (INT)(index * NX_AZURE_IOT_JSON_CACHED_POWER_STEP));
+
+    result.fp_f = nx_azure_iot_json_cached_power_f[index];
+    result.fp_e = nx_azure_iot_json_cached_power_e[index];
+
+    return(result);
+}
+
+static VOID nx_azure_iot_json_digit_round(CHAR *buffer_ptr, UINT length, ULONG64 delta, ULONG64 rest,
+                                          ULONG64 ten_kappa, ULONG64 distance)
+{
+
+    /* Move last digit towards the exact value while staying within boundaries.  */
+    while ((rest < distance) && ((delta - rest) >= ten_kappa) &&
+           (((rest + ten_kappa) < distance) || ((distance - rest) > (rest + ten_kappa - distance))))
+    {
+        buffer_ptr[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static UINT nx_azure_iot_json_digit_generate(NX_AZURE_IOT_JSON_FP w, NX_AZURE_IOT_JSON_FP plus, ULONG64 delta,
+                                             CHAR *buffer_ptr, INT *k_ptr)
+{
+UINT shift = (UINT)(-plus.fp_e);
+ULONG64 one = 1ULL << shift;
+ULONG64 distance = plus.fp_f - w.fp_f;
+UINT integral = (UINT)(plus.fp_f >> shift);
+ULONG64 fractional = plus.fp_f & (one - 1);
+ULONG64 rest;
+UINT length = 0;
+INT kappa = 1;
+UINT digit;
+
+    while ((kappa < 10) && (integral >= nx_azure_iot_json_pow10[kappa]))
+    {
+        kappa++;
+    }
+
+    /* Integral part.  */
+    while (kappa > 0)
+    {
+        digit = (UINT)(integral / nx_azure_iot_json_pow10[kappa - 1]);
+        integral = (UINT)(integral % nx_azure_iot_json_pow10[kappa - 1]);
+        if (digit || length)
+        {
+            buffer_ptr[length++] = (CHAR)('0' + digit);
+        }
+
+        kappa--;
+        rest = ((ULONG64)integral << shift) + fractional;
+        if (rest <= delta)
+        {
+            *k_ptr += kappa;
+            nx_azure_iot_json_digit_round(buffer_ptr, length, delta, rest,
+                                          nx_azure_iot_json_pow10[kappa] << shift, distance);
+            return(length);
+        }
+    }
+
+    /* Fractional part.  */
+    while (1)
+    {
+        fractional *= 10;
+        delta *= 10;
+        digit = (UINT)(fractional >> shift);
+        if (digit || length)
+        {
+            buffer_ptr[length++] = (CHAR)('0' + digit);
+        }
+
+        fractional &= one - 1;
+        kappa--;
+        if (fractional < delta)
+        {
+            *k_ptr += kappa;
+            nx_azure_iot_json_digit_round(buffer_ptr, length, delta, fractional, one,
+                                          (-kappa < 20) ? (distance * nx_azure_iot_json_pow10[-kappa]) : 0);
+            return(length);
+        }
+    }
+}
+
+static UINT nx_azure_iot_json_exponent_write(INT exponent, CHAR *buffer_ptr)
+{
+UINT length = 0;
+
+    if (exponent < 0)
+    {
+        buffer_ptr[length++] = '-';
+        exponent = -exponent;
+    }
+
+    if (exponent >= 100)
+    {
+        buffer_ptr[length++] = (CHAR)('0' + exponent / 100);
+        exponent %= 100;
+        buffer_ptr[length++] = nx_azure_iot_json_digit_pairs[exponent * 2];
+        buffer_ptr[length++] = nx_azure_iot_json_digit_pairs[exponent * 2 + 1];
+    }
+    else if (exponent >= 10)
+    {
+        buffer_ptr[length++] = nx_azure_iot_json_digit_pairs[exponent * 2];
+        buffer_ptr[length++] = nx_azure_iot_json_digit_pairs[exponent * 2 + 1];
+    }
+    else
+    {
+        buffer_ptr[length++] = (CHAR)('0' + exponent);
+    }
+
+    return(length);
+}
+
+static UINT nx_azure_iot_json_digits_layout(CHAR *buffer_ptr, UINT length, INT k)
+{
+INT point = (INT)length + k;
+INT index;
+
+    /* Digits d1..dn stand for 0.d1..dn * 10^point.  */
+    if ((k >= 0) && (point <= 21))
+    {
+
+        /* Integer, 1234e7 -> 12340000000.  */
+        for (index = (INT)length; index < point; index++)
+        {
+            buffer_ptr[index] = '0';
+        }
+
+        return((UINT)point);
+    }
+    else if ((point > 0) && (point <= 21))
+    {
+
+        /* 1234e-2 -> 12.34.  */
+        memmove(&buffer_ptr[point + 1], &buffer_ptr[point], length - (UINT)point);
+        buffer_ptr[point] = '.';
+        return(length + 1);
+    }
+    else if ((point > -6) && (point <= 0))
+    {
+
+        /* 1234e-6 -> 0.001234.  */
+        index = 2 - point;
+        memmove(&buffer_ptr[index], &buffer_ptr[0], length);
+        buffer_ptr[0] = '0';
+        buffer_ptr[1] = '.';
+        memset(&buffer_ptr[2], '0', (UINT)(index - 2));
+        return(length + (UINT)index);
+    }
+    else if (length == 1)
+    {
+
+        /* 1e30.  */
+        buffer_ptr[1] = 'e';
+        return(2 + nx_azure_iot_json_exponent_write(point - 1, &buffer_ptr[2]));
+    }
+
+    /* 1234e30 -> 1.234e33.  */
+    memmove(&buffer_ptr[2], &buffer_ptr[1], length - 1);
+    buffer_ptr[1] = '.';
+    buffer_ptr[length + 1] = 'e';
+    return(length + 2 + nx_azure_iot_json_exponent_write(point - 1, &buffer_ptr[length + 2]));
+}
+
+UINT nx_azure_iot_json_int32_format(INT value, CHAR *buffer_ptr)
+{
+CHAR digits[10];
+UINT magnitude;
+UINT count = 0;
+UINT length = 0;
+UINT pair;
+
+    if (value < 0)
+    {
+        buffer_ptr[length++] = '-';
+        magnitude = 0u - (UINT)value;
+    }
+    else
+    {
+        magnitude = (UINT)value;
+    }
+
+    /* Digits are produced from the right, two at a time.  */
+    while (magnitude >= 100)
+    {
+        pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        digits[count++] = nx_azure_iot_json_digit_pairs[pair + 1];
+        digits[count++] = nx_azure_iot_json_digit_pairs[pair];
+    }
+
+    if (magnitude >= 10)
+    {
+        pair = magnitude * 2;
+        digits[count++] = nx_azure_iot_json_digit_pairs[pair + 1];
+        digits[count++] = nx_azure_iot_json_digit_pairs[pair];
+    }
+    else
+    {
+        digits[count++] = (CHAR)('0' + magnitude);
+    }
+
+    while (count)
+    {
+        buffer_ptr[length++] = digits[--count];
+    }
+
+    return(length);
+}
+
+UINT nx_azure_iot_json_double_format(double value, CHAR *buffer_ptr)
+{
+NX_AZURE_IOT_JSON_FP v;
+NX_AZURE_IOT_JSON_FP w;
+NX_AZURE_IOT_JSON_FP minus;
+NX_AZURE_IOT_JSON_FP plus;
+NX_AZURE_IOT_JSON_FP cached_power;
+ULONG64 bits;
+UINT biased_exponent;
+UINT length = 0;
+UINT digit_count;
+INT k;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    /* NaN and infinity.  */
+    if ((bits & NX_AZURE_IOT_JSON_DOUBLE_EXPONENT_MASK) == NX_AZURE_IOT_JSON_DOUBLE_EXPONENT_MASK)
+    {
+        return(0);
+    }
+
+    if (bits & NX_AZURE_IOT_JSON_DOUBLE_SIGN_MASK)
+    {
+        buffer_ptr[length++] = '-';
+    }
+
+    if ((bits & ~NX_AZURE_IOT_JSON_DOUBLE_SIGN_MASK) == 0)
+    {
+        buffer_ptr[length++] = '0';
+        return(length);
+    }
+
+    biased_exponent = (UINT)((bits & NX_AZURE_IOT_JSON_DOUBLE_EXPONENT_MASK) >> NX_AZURE_IOT_JSON_DOUBLE_SIGNIFICAND_SIZE);
+    v.fp_f = bits & NX_AZURE_IOT_JSON_DOUBLE_SIGNIFICAND_MASK;
+    if (biased_exponent)
+    {
+        v.fp_f += NX_AZURE_IOT_JSON_DOUBLE_HIDDEN_BIT;
+        v.fp_e = (INT)biased_exponent - NX_AZURE_IOT_JSON_DOUBLE_EXPONENT_BIAS;
+    }
+    else
+    {
+
+        /* Subnormal.  */
+        v.fp_e = 1 - NX_AZURE_IOT_JSON_DOUBLE_EXPONENT_BIAS;
+    }
+
+    /* Grisu2: scale value and its boundaries by a cached power of ten, then generate digits
+       of the upper boundary until the result is within the boundaries.  */
+    nx_azure_iot_json_fp_boundaries(v, &minus, &plus);
+    cached_power = nx_azure_iot_json_cached_power_get(plus.fp_e, &k);
+    w = nx_azure_iot_json_fp_multiply(nx_azure_iot_json_fp_normalize(v), cached_power);
+    plus = nx_azure_iot_json_fp_multiply(plus, cached_power);
+    minus = nx_azure_iot_json_fp_multiply(minus, cached_power);
+    minus.fp_f++;
+    plus.fp_f--;
+
+    digit_count = nx_azure_iot_json_digit_generate(w, plus, plus.fp_f - minus.fp_f, &buffer_ptr[length], &k);
+
+    return(length + nx_azure_iot_json_digits_layout(&buffer_ptr[length], digit_count, k));
+}
+
+static UINT nx_azure_iot_json_writer_write(NX_AZURE_IOT_JSON_WRITER *writer_ptr, const UCHAR *data_ptr,
+                                           UINT data_size)
+{
+NX_AZURE_IOT_IOVEC vec;
+UINT status;
+
+    /* Nothing is written on failure, so packet length stays in sync with writer length.  */
+    vec.iovec_base = (UCHAR *)data_ptr;
+    vec.iovec_length = data_size;
+    status = nx_azure_iot_packet_data_gather(writer_ptr -> json_writer_packet_ptr, &vec, 1,
+                                             writer_ptr -> json_writer_wait_option);
+    if (status)
+    {
+        LogError("IoT JSON writer fail: APPEND FAIL: 0x%02x", status);
+        return(status);
+    }
+
+    writer_ptr -> json_writer_length += data_size;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_json_writer_token_write(NX_AZURE_IOT_JSON_WRITER *writer_ptr, const CHAR *token_ptr,
+                                                 UINT token_length)
+{
+UINT status;
+
+    if (writer_ptr == NX_NULL)
+    {
+        LogError("IoT JSON writer fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (writer_ptr -> json_writer_need_comma)
+    {
+        status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)",", 1);
+        if (status)
+        {
+            return(status);
+        }
+    }
+
+    status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)token_ptr, token_length);
+    if (status)
+    {
+        return(status);
+    }
+
+    writer_ptr -> json_writer_need_comma = NX_TRUE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_json_writer_string_write(NX_AZURE_IOT_JSON_WRITER *writer_ptr, const UCHAR *value,
+                                                  UINT value_length)
+{
+UCHAR escape[6] = { '\\', 'u', '0', '0', 0, 0 };
+UINT escape_length;
+UINT start = 0;
+UINT index;
+UINT status;
+UCHAR ch;
+
+    status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)"\"", 1);
+
+    for (index = 0; (status == NX_AZURE_IOT_SUCCESS) && (index < value_length); index++)
+    {
+        ch = value[index];
+        if ((ch >= 0x20) && (ch != '"') && (ch != '\\'))
+        {
+            continue;
+        }
+
+        /* Write run of plain characters, then the escape.  */
+        status = nx_azure_iot_json_writer_write(writer_ptr, &value[start], index - start);
+        if (status)
+        {
+            break;
+        }
+
+        escape_length = 2;
+        switch (ch)
+        {
+            case '"':
+            case '\\':
+                escape[1] = ch;
+                break;
+            case '\b':
+                escape[1] = 'b';
+                break;
+            case '\f':
+                escape[1] = 'f';
+                break;
+            case '\n':
+                escape[1] = 'n';
+                break;
+            case '\r':
+                escape[1] = 'r';
+                break;
+            case '\t':
+                escape[1] = 't';
+                break;
+            default:
+                escape[1] = 'u';
+                escape[4] = (UCHAR)('0' + (ch >> 4));
+                escape[5] = (UCHAR)((ch & 0xF) < 10 ? ('0' + (ch & 0xF)) : ('A' + (ch & 0xF) - 10));
+                escape_length = 6;
+                break;
+        }
+
+        status = nx_azure_iot_json_writer_write(writer_ptr, escape, escape_length);
+        start = index + 1;
+    }
+
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = nx_azure_iot_json_writer_write(writer_ptr, &value[start], value_length - start);
+    }
+
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)"\"", 1);
+    }
+
+    return(status);
+}
+
+UINT nx_azure_iot_json_writer_init(NX_AZURE_IOT_JSON_WRITER *writer_ptr, NX_PACKET *packet_ptr,
+                                   UINT wait_option)
+{
+    if ((writer_ptr == NX_NULL) || (packet_ptr == NX_NULL))
+    {
+        LogError("IoT JSON writer init fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    memset(writer_ptr, 0, sizeof(NX_AZURE_IOT_JSON_WRITER));
+    writer_ptr -> json_writer_packet_ptr = packet_ptr;
+    writer_ptr -> json_writer_wait_option = wait_option;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_json_writer_length_get(NX_AZURE_IOT_JSON_WRITER *writer_ptr)
+{
+    if (writer_ptr == NX_NULL)
+    {
+        return(0);
+    }
+
+    return(writer_ptr -> json_writer_length);
+}
+
+UINT nx_azure_iot_json_writer_append_begin_object(NX_AZURE_IOT_JSON_WRITER *writer_ptr)
+{
+UINT status;
+
+    status = nx_azure_iot_json_writer_token_write(writer_ptr, "{", 1);
+    if (status)
+    {
+        return(status);
+    }
+
+    writer_ptr -> json_writer_depth++;
+    writer_ptr -> json_writer_need_comma = NX_FALSE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_json_writer_append_end_object(NX_AZURE_IOT_JSON_WRITER *writer_ptr)
+{
+UINT status;
+
+    if ((writer_ptr == NX_NULL) || (writer_ptr -> json_writer_depth == 0))
+    {
+        LogError("IoT JSON writer fail: NOT IN OBJECT");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)"}", 1);
+    if (status)
+    {
+        return(status);
+    }
+
+    writer_ptr -> json_writer_depth--;
+    writer_ptr -> json_writer_need_comma = NX_TRUE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_json_writer_append_begin_array(NX_AZURE_IOT_JSON_WRITER *writer_ptr)
+{
+UINT status;
+
+    status = nx_azure_iot_json_writer_token_write(writer_ptr, "[", 1);
+    if (status)
+    {
+        return(status);
+    }
+
+    writer_ptr -> json_writer_depth++;
+    writer_ptr -> json_writer_need_comma = NX_FALSE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_json_writer_append_end_array(NX_AZURE_IOT_JSON_WRITER *writer_ptr)
+{
+UINT status;
+
+    if ((writer_ptr == NX_NULL) || (writer_ptr -> json_writer_depth == 0))
+    {
+        LogError("IoT JSON writer fail: NOT IN ARRAY");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)"]", 1);
+    if (status)
+    {
+        return(status);
+    }
+
+    writer_ptr -> json_writer_depth--;
+    writer_ptr -> json_writer_need_comma = NX_TRUE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_json_writer_append_property_name(NX_AZURE_IOT_JSON_WRITER *writer_ptr,
+                                                   const UCHAR *name, UINT name_length)
+{
+UINT status;
+
+    if ((writer_ptr == NX_NULL) || (name == NX_NULL))
+    {
+        LogError("IoT JSON writer fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (writer_ptr -> json_writer_need_comma)
+    {
+        status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)",", 1);
+        if (status)
+        {
+            return(status);
+        }
+    }
+
+    status = nx_azure_iot_json_writer_string_write(writer_ptr, name, name_length);
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)":", 1);
+    }
+
+    /* Value follows without comma.  */
+    writer_ptr -> json_writer_need_comma = NX_FALSE;
+
+    return(status);
+}
+
+UINT nx_azure_iot_json_writer_append_string(NX_AZURE_IOT_JSON_WRITER *writer_ptr,
+                                            const UCHAR *value, UINT value_length)
+{
+UINT status;
+
+    if ((writer_ptr == NX_NULL) || ((value == NX_NULL) && (value_length != 0)))
+    {
+        LogError("IoT JSON writer fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (writer_ptr -> json_writer_need_comma)
+    {
+        status = nx_azure_iot_json_writer_write(writer_ptr, (const UCHAR *)",", 1);
+        if (status)
+        {
+            return(status);
+        }
+    }
+
+    status = nx_azure_iot_json_writer_string_write(writer_ptr, value, value_length);
+    writer_ptr -> json_writer_need_comma = NX_TRUE;
+
+    return(status);
+}
+
+UINT nx_azure_iot_json_writer_append_int32(NX_AZURE_IOT_JSON_WRITER *writer_ptr, INT value)
+{
+CHAR buffer[NX_AZURE_IOT_JSON_WRITER_NUMBER_SIZE];
+
+    return(nx_azure_iot_json_writer_token_write(writer_ptr, buffer,
+                                                nx_azure_iot_json_int32_format(value, buffer)));
+}
+
+UINT nx_azure_iot_json_writer_append_double(NX_AZURE_IOT_JSON_WRITER *writer_ptr, double value)
+{
+CHAR buffer[NX_AZURE_IOT_JSON_WRITER_NUMBER_SIZE];
+UINT length;
+
+    length = nx_azure_iot_json_double_format(value, buffer);
+    if (length == 0)
+    {
+        LogError("IoT JSON writer fail: NOT FINITE");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    return(nx_azure_iot_json_writer_token_write(writer_ptr, buffer, length));
+}
+
+UINT nx_azure_iot_json_writer_append_bool(NX_AZURE_IOT_JSON_WRITER *writer_ptr, UINT value)
+{
+    if (value)
+    {
+        return(nx_azure_iot_json_writer_token_write(writer_ptr, "true", sizeof("true") - 1));
+    }
+
+    return(nx_azure_iot_json_writer_token_write(writer_ptr, "false", sizeof("false") - 1));
+}
+
+UINT nx_azure_iot_json_writer_append_null(NX_AZURE_IOT_JSON_WRITER *writer_ptr)
+{
+    return(nx_azure_iot_json_writer_token_write(writer_ptr, "null", sizeof("null") - 1));
+}
@@ -0,0 +1,181 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+/**
+ * @file nx_azure_iot_json_writer.h
+ *
+ * @brief Definition for the Azure IoT JSON writer.
+ * @remark The writer appends JSON text directly into a `NX_PACKET`, chaining packets from the pool
+ * of that packet once the last one is full, so the document does not need a flat buffer sized for
+ * the worst case. Numbers are formatted without `printf`: integers two digits at a time, and doubles
+ * with the Grisu2 algorithm, which always round-trips and gives the shortest digits in nearly all cases.
+ *
+ */
+
+#ifndef NX_AZURE_IOT_JSON_WRITER_H
+#define NX_AZURE_IOT_JSON_WRITER_H
+
+#ifdef __cplusplus
+extern   "C" {
+#endif
+
+#include "nx_azure_iot.h"
+
+/* Size of buffer needed to format any number.  */
+#define NX_AZURE_IOT_JSON_WRITER_NUMBER_SIZE              (32)
+
+/**
+ * @brief Azure IoT JSON writer struct
+ *
+ */
+typedef struct NX_AZURE_IOT_JSON_WRITER_STRUCT
+{
+    NX_PACKET                          *json_writer_packet_ptr;
+    UINT                                json_writer_wait_option;
+    UINT                                json_writer_length;         /* Bytes written. */
+    UINT                                json_writer_depth;
+    UINT                                json_writer_need_comma;
+} NX_AZURE_IOT_JSON_WRITER;
+
+/**
+ * @brief Initialize JSON writer
+ * @details JSON text is appended after the data already in `packet_ptr`. Packets are allocated from
+ *          the pool of `packet_ptr` when more room is needed.
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @param[in] packet_ptr A pointer to packet to write to.
+ * @param[in] wait_option Ticks to wait for packet allocation.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if writer is initialized.
+ */
+UINT nx_azure_iot_json_writer_init(NX_AZURE_IOT_JSON_WRITER *writer_ptr, NX_PACKET *packet_ptr,
+                                   UINT wait_option);
+
+/**
+ * @brief Get length of JSON text written
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @return Number of bytes written.
+ */
+UINT nx_azure_iot_json_writer_length_get(NX_AZURE_IOT_JSON_WRITER *writer_ptr);
+
+/**
+ * @brief Append begin of object
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_begin_object(NX_AZURE_IOT_JSON_WRITER *writer_ptr);
+
+/**
+ * @brief Append end of object
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_end_object(NX_AZURE_IOT_JSON_WRITER *writer_ptr);
+
+/**
+ * @brief Append begin of array
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_begin_array(NX_AZURE_IOT_JSON_WRITER *writer_ptr);
+
+/**
+ * @brief Append end of array
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_end_array(NX_AZURE_IOT_JSON_WRITER *writer_ptr);
+
+/**
+ * @brief Append property name
+ * @details Name is escaped and followed by a colon. Value must be appended next.
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @param[in] name Pointer to property name.
+ * @param[in] name_length Length of property name.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_property_name(NX_AZURE_IOT_JSON_WRITER *writer_ptr,
+                                                   const UCHAR *name, UINT name_length);
+
+/**
+ * @brief Append string
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @param[in] value Pointer to UTF-8 string, which is escaped as needed.
+ * @param[in] value_length Length of string.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_string(NX_AZURE_IOT_JSON_WRITER *writer_ptr,
+                                            const UCHAR *value, UINT value_length);
+
+/**
+ * @brief Append integer
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @param[in] value Integer value.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_int32(NX_AZURE_IOT_JSON_WRITER *writer_ptr, INT value);
+
+/**
+ * @brief Append double
+ * @details Value is written with the shortest digits that read back as the same double.
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @param[in] value Double value. NaN and infinity are not valid JSON.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ *   @retval #NX_AZURE_IOT_INVALID_PARAMETER Fail to append since value is not finite.
+ */
+UINT nx_azure_iot_json_writer_append_double(NX_AZURE_IOT_JSON_WRITER *writer_ptr, double value);
+
+/**
+ * @brief Append boolean
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @param[in] value `NX_TRUE` or `NX_FALSE`.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_bool(NX_AZURE_IOT_JSON_WRITER *writer_ptr, UINT value);
+
+/**
+ * @brief Append null
+ *
+ * @param[in] writer_ptr A pointer to a #NX_AZURE_IOT_JSON_WRITER.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if appended.
+ */
+UINT nx_azure_iot_json_writer_append_null(NX_AZURE_IOT_JSON_WRITER *writer_ptr);
+
+/* Internal APIs. */
+UINT nx_azure_iot_json_int32_format(INT value, CHAR *buffer_ptr);
+UINT nx_azure_iot_json_double_format(double value, CHAR *buffer_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* NX_AZURE_IOT_JSON_WRITER_H */
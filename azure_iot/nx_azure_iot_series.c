@@ -0,0 +1,566 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+#include "nx_azure_iot_series.h"
+
+/* Window of meaningful XOR bits not set yet.  */
+#define NX_AZURE_IOT_SERIES_WINDOW_NONE                   0xFF
+
+/* Leading zeros are written in 5 bits.  */
+#define NX_AZURE_IOT_SERIES_LEADING_MAX                   31
+
+static UINT nx_azure_iot_series_leading_zeros(ULONG64 value)
+{
+UINT count = 0;
+
+    if (!(value >> 32))
+    {
+        count += 32;
+        value <<= 32;
+    }
+
+    if (!(value >> 48))
+    {
+        count += 16;
+        value <<= 16;
+    }
+
+    if (!(value >> 56))
+    {
+        count += 8;
+        value <<= 8;
+    }
+
+    if (!(value >> 60))
+    {
+        count += 4;
+        value <<= 4;
+    }
+
+    if (!(value >> 62))
+    {
+        count += 2;
+        value <<= 2;
+    }
+
+    if (!(value >> 63))
+    {
+        count++;
+    }
+
+    return(count);
+}
+
+static UINT nx_azure_iot_series_trailing_zeros(ULONG64 value)
+{
+UINT count = 0;
+
+    if (!(value & 0xFFFFFFFFULL))
+    {
+        count += 32;
+        value >>= 32;
+    }
+
+    if (!(value & 0xFFFF))
+    {
+        count += 16;
+        value >>= 16;
+    }
+
+    if (!(value & 0xFF))
+    {
+        count += 8;
+        value >>= 8;
+    }
+
+    if (!(value & 0xF))
+    {
+        count += 4;
+        value >>= 4;
+    }
+
+    if (!(value & 0x3))
+    {
+        count += 2;
+        value >>= 2;
+    }
+
+    if (!(value & 0x1))
+    {
+        count++;
+    }
+
+    return(count);
+}
+
+static VOID nx_azure_iot_series_bits_write(NX_AZURE_IOT_SERIES *series_ptr, ULONG64 value, UINT bit_count)
+{
+UCHAR *data_ptr = series_ptr -> series_block + NX_AZURE_IOT_SERIES_HEADER_SIZE;
+UINT free_bits;
+UINT chunk;
+
+    /* Bits are written most significant first into a zeroed block.  */
+    while (bit_count)
+    {
+        free_bits = 8 - (series_ptr -> series_bit_offset & 7);
+        chunk = (bit_count < free_bits) ? bit_count : free_bits;
+        data_ptr[series_ptr -> series_bit_offset >> 3] |=
+            (UCHAR)(((value >> (bit_count - chunk)) & ((1u << chunk) - 1)) << (free_bits - chunk));
+        series_ptr -> series_bit_offset += chunk;
+        bit_count -= chunk;
+    }
+}
+
+static VOID nx_azure_iot_series_block_reset(NX_AZURE_IOT_SERIES *series_ptr)
+{
+    memset(series_ptr -> series_block, 0, series_ptr -> series_block_size);
+    series_ptr -> series_bit_offset = 0;
+    series_ptr -> series_sample_count = 0;
+}
+
+static UINT nx_azure_iot_series_block_send(NX_AZURE_IOT_SERIES *series_ptr, UINT wait_option)
+{
+NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr = series_ptr -> series_hub_client_ptr;
+NX_PACKET *packet_ptr;
+UCHAR *block = series_ptr -> series_block;
+UINT block_size = NX_AZURE_IOT_SERIES_HEADER_SIZE + ((series_ptr -> series_bit_offset + 7) >> 3);
+UINT status;
+
+    block[0] = NX_AZURE_IOT_SERIES_FORMAT;
+    block[1] = (UCHAR)(series_ptr -> series_sample_count >> 8);
+    block[2] = (UCHAR)(series_ptr -> series_sample_count);
+
+    status = nx_azure_iot_hub_client_telemetry_message_create(hub_client_ptr, &packet_ptr, wait_option);
+    if (status)
+    {
+        LogError("IoT series send fail: MESSAGE CREATE FAIL: 0x%02x", status);
+        return(status);
+    }
+
+    status = nx_azure_iot_hub_client_telemetry_property_add(packet_ptr,
+                                                            (UCHAR *)NX_AZURE_IOT_SERIES_CONTENT_TYPE_PROPERTY,
+                                                            sizeof(NX_AZURE_IOT_SERIES_CONTENT_TYPE_PROPERTY) - 1,
+                                                            (UCHAR *)NX_AZURE_IOT_SERIES_CONTENT_TYPE_VALUE,
+                                                            sizeof(NX_AZURE_IOT_SERIES_CONTENT_TYPE_VALUE) - 1,
+                                                            wait_option);
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = nx_azure_iot_hub_client_telemetry_property_add(packet_ptr,
+                                                                (UCHAR *)NX_AZURE_IOT_SERIES_STREAM_PROPERTY,
+                                                                sizeof(NX_AZURE_IOT_SERIES_STREAM_PROPERTY) - 1,
+                                                                (UCHAR *)series_ptr -> series_stream_name,
+                                                                (USHORT)series_ptr -> series_stream_name_length,
+                                                                wait_option);
+    }
+
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = nx_azure_iot_hub_client_telemetry_send(hub_client_ptr, packet_ptr, block, block_size, wait_option);
+    }
+
+    if (status)
+    {
+        LogError("IoT series send fail: 0x%02x", status);
+        nx_azure_iot_hub_client_telemetry_message_delete(packet_ptr);
+        return(status);
+    }
+
+    series_ptr -> series_message_count++;
+    nx_azure_iot_series_block_reset(series_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_series_deadline_passed(NX_AZURE_IOT_SERIES *series_ptr)
+{
+    return(series_ptr -> series_sample_count && series_ptr -> series_deadline &&
+           ((tx_time_get() - series_ptr -> series_block_start_time) >= series_ptr -> series_deadline));
+}
+
+UINT nx_azure_iot_series_create(NX_AZURE_IOT_SERIES *series_ptr, NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                const UCHAR *stream_name, UINT stream_name_length,
+                                UCHAR *block, UINT block_size, ULONG deadline)
+{
+    if ((series_ptr == NX_NULL) || (hub_client_ptr == NX_NULL) || (stream_name == NX_NULL) ||
+        (block == NX_NULL))
+    {
+        LogError("IoT series create fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if ((stream_name_length == 0) || (stream_name_length > 0xFFFF) ||
+        (block_size < NX_AZURE_IOT_SERIES_BLOCK_MIN_SIZE))
+    {
+        LogError("IoT series create fail: INVALID PARAMETER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    memset(series_ptr, 0, sizeof(NX_AZURE_IOT_SERIES));
+    series_ptr -> series_hub_client_ptr = hub_client_ptr;
+    series_ptr -> series_stream_name = stream_name;
+    series_ptr -> series_stream_name_length = stream_name_length;
+    series_ptr -> series_block = block;
+    series_ptr -> series_block_size = block_size;
+    series_ptr -> series_deadline = deadline;
+    nx_azure_iot_series_block_reset(series_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_series_sample_add(NX_AZURE_IOT_SERIES *series_ptr, UINT timestamp, double value,
+                                    UINT wait_option)
+{
+ULONG64 bits;
+ULONG64 xor_value;
+UINT room;
+UINT delta;
+INT delta_of_delta;
+UINT leading;
+UINT trailing;
+UINT meaningful;
+UINT status;
+
+    if (series_ptr == NX_NULL)
+    {
+        LogError("IoT series sample add fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    /* Send block first if it cannot take a worst case sample.  */
+    room = ((series_ptr -> series_block_size - NX_AZURE_IOT_SERIES_HEADER_SIZE) << 3) -
+           series_ptr -> series_bit_offset;
+    if (series_ptr -> series_sample_count &&
+        ((room < NX_AZURE_IOT_SERIES_SAMPLE_MAX_BITS) ||
+         (series_ptr -> series_sample_count >= NX_AZURE_IOT_SERIES_SAMPLE_MAX_COUNT) ||
+         nx_azure_iot_series_deadline_passed(series_ptr)))
+    {
+        status = nx_azure_iot_series_block_send(series_ptr, wait_option);
+        if (status)
+        {
+            return(status);
+        }
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    if (series_ptr -> series_sample_count == 0)
+    {
+
+        /* First sample of block is written in full.  */
+        series_ptr -> series_block_start_time = tx_time_get();
+        nx_azure_iot_series_bits_write(series_ptr, timestamp, 32);
+        nx_azure_iot_series_bits_write(series_ptr, bits, 64);
+        series_ptr -> series_last_delta = 0;
+        series_ptr -> series_last_leading = NX_AZURE_IOT_SERIES_WINDOW_NONE;
+    }
+    else
+    {
+        delta = timestamp - series_ptr -> series_last_timestamp;
+        delta_of_delta = (INT)(delta - series_ptr -> series_last_delta);
+
+        if (delta_of_delta == 0)
+        {
+            nx_azure_iot_series_bits_write(series_ptr, 0x0, 1);
+        }
+        else if ((delta_of_delta >= -64) && (delta_of_delta <= 63))
+        {
+            nx_azure_iot_series_bits_write(series_ptr, 0x2, 2);
+            nx_azure_iot_series_bits_write(series_ptr, (UINT)delta_of_delta, 7);
+        }
+        else if ((delta_of_delta >= -256) && (delta_of_delta <= 255))
+        {
+            nx_azure_iot_series_bits_write(series_ptr, 0x6, 3);
+            nx_azure_iot_series_bits_write(series_ptr, (UINT)delta_of_delta, 9);
+        }
+        else if ((delta_of_delta >= -2048) && (delta_of_delta <= 2047))
+        {
+            nx_azure_iot_series_bits_write(series_ptr, 0xE, 4);
+            nx_azure_iot_series_bits_write(series_ptr, (UINT)delta_of_delta, 12);
+        }
+        else
+        {
+            nx_azure_iot_series_bits_write(series_ptr, 0xF, 4);
+            nx_azure_iot_series_bits_write(series_ptr, (UINT)delta_of_delta, 32);
+        }
+
+        series_ptr -> series_last_delta = delta;
+
+        xor_value = bits ^ series_ptr -> series_last_value;
+        if (xor_value == 0)
+        {
+            nx_azure_iot_series_bits_write(series_ptr, 0x0, 1);
+        }
+        else
+        {
+            leading = nx_azure_iot_series_leading_zeros(xor_value);
+            trailing = nx_azure_iot_series_trailing_zeros(xor_value);
+            if (leading > NX_AZURE_IOT_SERIES_LEADING_MAX)
+            {
+                leading = NX_AZURE_IOT_SERIES_LEADING_MAX;
+            }
+
+            if ((series_ptr -> series_last_leading != NX_AZURE_IOT_SERIES_WINDOW_NONE) &&
+                (leading >= series_ptr -> series_last_leading) &&
+                (trailing >= series_ptr -> series_last_trailing))
+            {
+
+                /* Meaningful bits fit in previous window.  */
+                meaningful = 64 - series_ptr -> series_last_leading - series_ptr -> series_last_trailing;
+                nx_azure_iot_series_bits_write(series_ptr, 0x2, 2);
+                nx_azure_iot_series_bits_write(series_ptr, xor_value >> series_ptr -> series_last_trailing,
+                                               meaningful);
+            }
+            else
+            {
+                meaningful = 64 - leading - trailing;
+                nx_azure_iot_series_bits_write(series_ptr, 0x3, 2);
+                nx_azure_iot_series_bits_write(series_ptr, leading, 5);
+                nx_azure_iot_series_bits_write(series_ptr, meaningful & 0x3F, 6);
+                nx_azure_iot_series_bits_write(series_ptr, xor_value >> trailing, meaningful);
+                series_ptr -> series_last_leading = leading;
+                series_ptr -> series_last_trailing = trailing;
+            }
+        }
+    }
+
+    series_ptr -> series_last_timestamp = timestamp;
+    series_ptr -> series_last_value = bits;
+    series_ptr -> series_sample_count++;
+    series_ptr -> series_sample_total++;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_series_poll(NX_AZURE_IOT_SERIES *series_ptr, UINT wait_option)
+{
+    if (series_ptr == NX_NULL)
+    {
+        LogError("IoT series poll fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (!nx_azure_iot_series_deadline_passed(series_ptr))
+    {
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    return(nx_azure_iot_series_block_send(series_ptr, wait_option));
+}
+
+UINT nx_azure_iot_series_flush(NX_AZURE_IOT_SERIES *series_ptr, UINT wait_option)
+{
+    if (series_ptr == NX_NULL)
+    {
+        LogError("IoT series flush fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (series_ptr -> series_sample_count == 0)
+    {
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    return(nx_azure_iot_series_block_send(series_ptr, wait_option));
+}
+
+static UINT nx_azure_iot_series_bits_read(NX_AZURE_IOT_SERIES_DECODER *decoder_ptr, UINT bit_count,
+                                          ULONG64 *value_ptr)
+{
+const UCHAR *data_ptr = decoder_ptr -> series_decoder_buffer + NX_AZURE_IOT_SERIES_HEADER_SIZE;
+UINT total_bits = (decoder_ptr -> series_decoder_buffer_size - NX_AZURE_IOT_SERIES_HEADER_SIZE) << 3;
+ULONG64 value = 0;
+UINT available;
+UINT chunk;
+
+    if (bit_count > (total_bits - decoder_ptr -> series_decoder_bit_offset))
+    {
+        LogError("IoT series decoder fail: TRUNCATED");
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    while (bit_count)
+    {
+        available = 8 - (decoder_ptr -> series_decoder_bit_offset & 7);
+        chunk = (bit_count < available) ? bit_count : available;
+        value = (value << chunk) |
+                ((data_ptr[decoder_ptr -> series_decoder_bit_offset >> 3] >> (available - chunk)) &
+                 ((1u << chunk) - 1));
+        decoder_ptr -> series_decoder_bit_offset += chunk;
+        bit_count -= chunk;
+    }
+
+    *value_ptr = value;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_series_decoder_init(NX_AZURE_IOT_SERIES_DECODER *decoder_ptr, const UCHAR *buffer,
+                                      UINT buffer_size)
+{
+    if ((decoder_ptr == NX_NULL) || (buffer == NX_NULL))
+    {
+        LogError("IoT series decoder init fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if ((buffer_size < NX_AZURE_IOT_SERIES_HEADER_SIZE) || (buffer[0] != NX_AZURE_IOT_SERIES_FORMAT))
+    {
+        LogError("IoT series decoder init fail: UNKNOWN FORMAT");
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    memset(decoder_ptr, 0, sizeof(NX_AZURE_IOT_SERIES_DECODER));
+    decoder_ptr -> series_decoder_buffer = buffer;
+    decoder_ptr -> series_decoder_buffer_size = buffer_size;
+    decoder_ptr -> series_decoder_sample_count = ((UINT)buffer[1] << 8) | buffer[2];
+    decoder_ptr -> series_decoder_last_leading = NX_AZURE_IOT_SERIES_WINDOW_NONE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_series_decoder_next(NX_AZURE_IOT_SERIES_DECODER *decoder_ptr, UINT *timestamp_ptr,
+                                      double *value_ptr)
+{
+ULONG64 bits;
+ULONG64 prefix = 0;
+UINT prefix_count = 0;
+UINT delta_of_delta;
+UINT meaningful;
+UINT status;
+static const UINT delta_of_delta_size[] = { 0, 7, 9, 12, 32 };
+
+    if ((decoder_ptr == NX_NULL) || (timestamp_ptr == NX_NULL) || (value_ptr == NX_NULL))
+    {
+        LogError("IoT series decoder fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if (decoder_ptr -> series_decoder_sample_index >= decoder_ptr -> series_decoder_sample_count)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    if (decoder_ptr -> series_decoder_sample_index == 0)
+    {
+        status = nx_azure_iot_series_bits_read(decoder_ptr, 32, &bits);
+        if (status)
+        {
+            return(status);
+        }
+        decoder_ptr -> series_decoder_last_timestamp = (UINT)bits;
+
+        status = nx_azure_iot_series_bits_read(decoder_ptr, 64, &bits);
+        if (status)
+        {
+            return(status);
+        }
+        decoder_ptr -> series_decoder_last_value = bits;
+    }
+    else
+    {
+
+        /* Count leading ones of delta of delta prefix.  */
+        do
+        {
+            status = nx_azure_iot_series_bits_read(decoder_ptr, 1, &prefix);
+            if (status)
+            {
+                return(status);
+            }
+        } while (prefix && (++prefix_count < 4));
+
+        delta_of_delta = 0;
+        if (prefix_count)
+        {
+            status = nx_azure_iot_series_bits_read(decoder_ptr, delta_of_delta_size[prefix_count], &bits);
+            if (status)
+            {
+                return(status);
+            }
+
+            /* Sign extend.  */
+            delta_of_delta = (UINT)bits;
+            if ((prefix_count < 4) && (bits >> (delta_of_delta_size[prefix_count] - 1)))
+            {
+                delta_of_delta |= ~0u << delta_of_delta_size[prefix_count];
+            }
+        }
+
+        decoder_ptr -> series_decoder_last_delta += delta_of_delta;
+        decoder_ptr -> series_decoder_last_timestamp += decoder_ptr -> series_decoder_last_delta;
+
+        status = nx_azure_iot_series_bits_read(decoder_ptr, 1, &bits);
+        if (status)
+        {
+            return(status);
+        }
+
+        if (bits)
+        {
+            status = nx_azure_iot_series_bits_read(decoder_ptr, 1, &bits);
+            if (status)
+            {
+                return(status);
+            }
+
+            if (bits)
+            {
+                status = nx_azure_iot_series_bits_read(decoder_ptr, 5, &bits);
+                if (status)
+                {
+                    return(status);
+                }
+                decoder_ptr -> series_decoder_last_leading = (UINT)bits;
+
+                status = nx_azure_iot_series_bits_read(decoder_ptr, 6, &bits);
+                if (status)
+                {
+                    return(status);
+                }
+                meaningful = bits ? (UINT)bits : 64;
+
+                if ((decoder_ptr -> series_decoder_last_leading + meaningful) > 64)
+                {
+                    LogError("IoT series decoder fail: INVALID WINDOW");
+                    return(NX_AZURE_IOT_INVALID_PACKET);
+                }
+                decoder_ptr -> series_decoder_last_trailing = 64 - decoder_ptr -> series_decoder_last_leading -
+                                                              meaningful;
+            }
+            else if (decoder_ptr -> series_decoder_last_leading == NX_AZURE_IOT_SERIES_WINDOW_NONE)
+            {
+                LogError("IoT series decoder fail: NO WINDOW");
+                return(NX_AZURE_IOT_INVALID_PACKET);
+            }
+            else
+            {
+                meaningful = 64 - decoder_ptr -> series_decoder_last_leading -
+                             decoder_ptr -> series_decoder_last_trailing;
+            }
+
+            status = nx_azure_iot_series_bits_read(decoder_ptr, meaningful, &bits);
+            if (status)
+            {
+                return(status);
+            }
+
+            decoder_ptr -> series_decoder_last_value ^= bits << decoder_ptr -> series_decoder_last_trailing;
+        }
+    }
+
+    decoder_ptr -> series_decoder_sample_index++;
+    *timestamp_ptr = decoder_ptr -> series_decoder_last_timestamp;
+    memcpy(value_ptr, &(decoder_ptr -> series_decoder_last_value), sizeof(double));
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
@@ -0,0 +1,191 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+/**
+ * @file nx_azure_iot_series.h
+ *
+ * @brief Definition for the Azure IoT time series batching.
+ * @remark Samples of one stream are packed into a caller supplied block with the Gorilla scheme:
+ * timestamps as delta of delta and values as XOR with the previous value, both written to a bit
+ * stream. Regular sampling of a slowly moving value then costs a few bits per sample. The block is
+ * sent as one telemetry message once it is full or its deadline has passed.
+ *
+ * Block layout is a format byte, the sample count as 16-bit big endian, then the bit stream. The first
+ * sample holds a 32-bit timestamp and the raw 64-bit double. Each next sample holds:
+ * - Delta of delta of timestamp: `0` if zero, else `10`, `110` or `1110` followed by 7, 9 or 12 bits
+ *   two's complement, else `1111` followed by 32 bits.
+ * - XOR with previous value: `0` if zero, `10` followed by the meaningful bits if they fit in the
+ *   previous window, else `11`, 5 bits of leading zeros, 6 bits of meaningful length (0 for 64)
+ *   and the meaningful bits.
+ *
+ */
+
+#ifndef NX_AZURE_IOT_SERIES_H
+#define NX_AZURE_IOT_SERIES_H
+
+#ifdef __cplusplus
+extern   "C" {
+#endif
+
+#include "nx_azure_iot_hub_client.h"
+
+/* Block format written in first byte.  */
+#define NX_AZURE_IOT_SERIES_FORMAT                        (1)
+
+/* Size of block header.  */
+#define NX_AZURE_IOT_SERIES_HEADER_SIZE                   (3)
+
+/* Worst case size of one sample in bits, and smallest usable block.  */
+#define NX_AZURE_IOT_SERIES_SAMPLE_MAX_BITS               (113)
+#define NX_AZURE_IOT_SERIES_BLOCK_MIN_SIZE                (NX_AZURE_IOT_SERIES_HEADER_SIZE + 15)
+
+/* Maximum samples in one block.  */
+#define NX_AZURE_IOT_SERIES_SAMPLE_MAX_COUNT              (0xFFFF)
+
+/* Properties of series telemetry.  */
+#define NX_AZURE_IOT_SERIES_STREAM_PROPERTY               "series"
+#define NX_AZURE_IOT_SERIES_CONTENT_TYPE_PROPERTY         "$.ct"
+#define NX_AZURE_IOT_SERIES_CONTENT_TYPE_VALUE            "application%2Foctet-stream"
+
+/**
+ * @brief Azure IoT series struct
+ *
+ */
+typedef struct NX_AZURE_IOT_SERIES_STRUCT
+{
+    NX_AZURE_IOT_HUB_CLIENT            *series_hub_client_ptr;
+    const UCHAR                        *series_stream_name;
+    UINT                                series_stream_name_length;
+    UCHAR                              *series_block;
+    UINT                                series_block_size;
+    ULONG                               series_deadline;            /* Ticks. Zero if disabled. */
+    ULONG                               series_block_start_time;    /* Time first sample was added. */
+    UINT                                series_bit_offset;
+    UINT                                series_sample_count;
+    UINT                                series_last_timestamp;
+    UINT                                series_last_delta;
+    ULONG64                             series_last_value;
+    UINT                                series_last_leading;
+    UINT                                series_last_trailing;
+    ULONG                               series_message_count;
+    ULONG                               series_sample_total;
+} NX_AZURE_IOT_SERIES;
+
+/**
+ * @brief Azure IoT series decoder struct
+ *
+ */
+typedef struct NX_AZURE_IOT_SERIES_DECODER_STRUCT
+{
+    const UCHAR                        *series_decoder_buffer;
+    UINT                                series_decoder_buffer_size;
+    UINT                                series_decoder_bit_offset;
+    UINT                                series_decoder_sample_count;
+    UINT                                series_decoder_sample_index;
+    UINT                                series_decoder_last_timestamp;
+    UINT                                series_decoder_last_delta;
+    ULONG64                             series_decoder_last_value;
+    UINT                                series_decoder_last_leading;
+    UINT                                series_decoder_last_trailing;
+} NX_AZURE_IOT_SERIES_DECODER;
+
+/**
+ * @brief Create time series stream
+ * @details Each stream packs its samples into its own `block`. The block is sent as telemetry with property
+ *          `series` set to `stream_name`, which must stay valid and be URL encoded.
+ *
+ * @param[in] series_ptr A pointer to a #NX_AZURE_IOT_SERIES.
+ * @param[in] hub_client_ptr A pointer to a #NX_AZURE_IOT_HUB_CLIENT.
+ * @param[in] stream_name Pointer to stream name.
+ * @param[in] stream_name_length Length of stream name.
+ * @param[in] block Pointer to memory holding samples not sent yet.
+ * @param[in] block_size Size of `block`, at least NX_AZURE_IOT_SERIES_BLOCK_MIN_SIZE.
+ * @param[in] deadline Maximum ticks a sample waits in block before it is sent. Zero if not used.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if stream is created.
+ */
+UINT nx_azure_iot_series_create(NX_AZURE_IOT_SERIES *series_ptr, NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr,
+                                const UCHAR *stream_name, UINT stream_name_length,
+                                UCHAR *block, UINT block_size, ULONG deadline);
+
+/**
+ * @brief Add sample to time series stream
+ * @details Block is sent first if it has no room for another sample, or if its deadline has passed.
+ *          If sending fails, the sample is not added and the block is kept for the next try.
+ *          A stream must not be used from more than one thread at the same time.
+ *
+ * @param[in] series_ptr A pointer to a #NX_AZURE_IOT_SERIES.
+ * @param[in] timestamp Timestamp of sample in any unit, for example milliseconds. Kept modulo 2^32.
+ * @param[in] value Sample value.
+ * @param[in] wait_option Ticks to wait if block is sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if sample is added.
+ */
+UINT nx_azure_iot_series_sample_add(NX_AZURE_IOT_SERIES *series_ptr, UINT timestamp, double value,
+                                    UINT wait_option);
+
+/**
+ * @brief Poll time series stream
+ * @details This routine sends the block if its deadline has passed. It is meant to be called
+ *          periodically when samples may stop arriving.
+ *
+ * @param[in] series_ptr A pointer to a #NX_AZURE_IOT_SERIES.
+ * @param[in] wait_option Ticks to wait if block is sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if nothing is due or block is sent.
+ */
+UINT nx_azure_iot_series_poll(NX_AZURE_IOT_SERIES *series_ptr, UINT wait_option);
+
+/**
+ * @brief Flush time series stream
+ * @details This routine sends the block now if it holds any sample.
+ *
+ * @param[in] series_ptr A pointer to a #NX_AZURE_IOT_SERIES.
+ * @param[in] wait_option Ticks to wait for message to be sent.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if block is empty or sent.
+ */
+UINT nx_azure_iot_series_flush(NX_AZURE_IOT_SERIES *series_ptr, UINT wait_option);
+
+/**
+ * @brief Initialize time series decoder
+ * @details Reference decoder for a block received as telemetry payload.
+ *
+ * @param[in] decoder_ptr A pointer to a #NX_AZURE_IOT_SERIES_DECODER.
+ * @param[in] buffer Pointer to block.
+ * @param[in] buffer_size Size of block.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if decoder is initialized.
+ *   @retval #NX_AZURE_IOT_INVALID_PACKET Fail to initialize due to unknown format.
+ */
+UINT nx_azure_iot_series_decoder_init(NX_AZURE_IOT_SERIES_DECODER *decoder_ptr, const UCHAR *buffer,
+                                      UINT buffer_size);
+
+/**
+ * @brief Decode next sample
+ *
+ * @param[in] decoder_ptr A pointer to a #NX_AZURE_IOT_SERIES_DECODER.
+ * @param[out] timestamp_ptr Returned timestamp.
+ * @param[out] value_ptr Returned value.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if sample is decoded.
+ *   @retval #NX_AZURE_IOT_NOT_FOUND If all samples are decoded.
+ *   @retval #NX_AZURE_IOT_INVALID_PACKET Fail to decode since block is truncated.
+ */
+UINT nx_azure_iot_series_decoder_next(NX_AZURE_IOT_SERIES_DECODER *decoder_ptr, UINT *timestamp_ptr,
+                                      double *value_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* NX_AZURE_IOT_SERIES_H */
@@ -0,0 +1,443 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+#include "nx_azure_iot_spool.h"
+
+/* Size of index: committed sequence, committed offset and CRC-32.  */
+#define NX_AZURE_IOT_SPOOL_INDEX_SIZE                     (12)
+
+static const ULONG _nx_azure_iot_spool_crc_table[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static ULONG nx_azure_iot_spool_crc32(ULONG crc, const UCHAR *data_ptr, UINT data_size)
+{
+
+    /* CRC-32 (IEEE 802.3), four bits at a time.  */
+    while (data_size--)
+    {
+        crc ^= *data_ptr++;
+        crc = (crc >> 4) ^ _nx_azure_iot_spool_crc_table[crc & 0xF];
+        crc = (crc >> 4) ^ _nx_azure_iot_spool_crc_table[crc & 0xF];
+    }
+
+    return(crc);
+}
+
+VOID nx_azure_iot_spool_ulong_put(UCHAR *buffer_ptr, ULONG value)
+{
+
+    /* Stored in little endian so spool content does not depend on ULONG size.  */
+    buffer_ptr[0] = (UCHAR)(value & 0xFF);
+    buffer_ptr[1] = (UCHAR)((value >> 8) & 0xFF);
+    buffer_ptr[2] = (UCHAR)((value >> 16) & 0xFF);
+    buffer_ptr[3] = (UCHAR)((value >> 24) & 0xFF);
+}
+
+ULONG nx_azure_iot_spool_ulong_get(const UCHAR *buffer_ptr)
+{
+    return((ULONG)buffer_ptr[0] | ((ULONG)buffer_ptr[1] << 8) |
+           ((ULONG)buffer_ptr[2] << 16) | ((ULONG)buffer_ptr[3] << 24));
+}
+
+static UINT nx_azure_iot_spool_segment_check(NX_AZURE_IOT_SPOOL *spool_ptr, ULONG sequence)
+{
+UCHAR header[NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE];
+
+    if (spool_ptr -> spool_backend_ptr -> backend_read(spool_ptr -> spool_backend_context,
+                                                       (UINT)(sequence % spool_ptr -> spool_segment_count),
+                                                       0, header, sizeof(header)))
+    {
+        return(NX_FALSE);
+    }
+
+    return((nx_azure_iot_spool_ulong_get(header) == NX_AZURE_IOT_SPOOL_SEGMENT_MAGIC) &&
+           (nx_azure_iot_spool_ulong_get(header + 4) == (sequence & 0xFFFFFFFF)));
+}
+
+static UINT nx_azure_iot_spool_segment_init(NX_AZURE_IOT_SPOOL *spool_ptr, ULONG sequence)
+{
+UCHAR header[NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE];
+UINT segment = (UINT)(sequence % spool_ptr -> spool_segment_count);
+UINT status;
+
+    status = spool_ptr -> spool_backend_ptr -> backend_erase(spool_ptr -> spool_backend_context, segment);
+    if (status)
+    {
+        LogError("IoT spool segment erase fail: 0x%02x", status);
+        return(status);
+    }
+
+    nx_azure_iot_spool_ulong_put(header, NX_AZURE_IOT_SPOOL_SEGMENT_MAGIC);
+    nx_azure_iot_spool_ulong_put(header + 4, sequence);
+    status = spool_ptr -> spool_backend_ptr -> backend_write(spool_ptr -> spool_backend_context, segment,
+                                                             0, header, sizeof(header));
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = spool_ptr -> spool_backend_ptr -> backend_sync(spool_ptr -> spool_backend_context, segment);
+    }
+
+    if (status)
+    {
+        LogError("IoT spool segment header write fail: 0x%02x", status);
+        return(status);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_spool_record_check(NX_AZURE_IOT_SPOOL *spool_ptr,
+                                            const NX_AZURE_IOT_SPOOL_POSITION *position_ptr,
+                                            ULONG *record_length_ptr)
+{
+UCHAR buffer[NX_AZURE_IOT_SPOOL_CRC_BUFFER_SIZE];
+UINT segment = (UINT)(position_ptr -> position_sequence % spool_ptr -> spool_segment_count);
+ULONG offset = position_ptr -> position_offset;
+ULONG record_length;
+ULONG record_crc;
+ULONG crc;
+ULONG remaining;
+UINT size;
+
+    if ((offset + NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE) > spool_ptr -> spool_segment_size)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    if (spool_ptr -> spool_backend_ptr -> backend_read(spool_ptr -> spool_backend_context, segment, offset,
+                                                       buffer, NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE))
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    record_length = nx_azure_iot_spool_ulong_get(buffer);
+    record_crc = nx_azure_iot_spool_ulong_get(buffer + 4);
+    if ((record_length == 0) ||
+        (record_length > (spool_ptr -> spool_segment_size - offset - NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE)))
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    /* CRC covers length and data.  */
+    crc = nx_azure_iot_spool_crc32(0xFFFFFFFF, buffer, 4);
+    offset += NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE;
+    for (remaining = record_length; remaining; remaining -= size)
+    {
+        size = (remaining > sizeof(buffer)) ? (UINT)sizeof(buffer) : (UINT)remaining;
+        if (spool_ptr -> spool_backend_ptr -> backend_read(spool_ptr -> spool_backend_context, segment,
+                                                           offset, buffer, size))
+        {
+            return(NX_AZURE_IOT_NOT_FOUND);
+        }
+
+        crc = nx_azure_iot_spool_crc32(crc, buffer, size);
+        offset += size;
+    }
+
+    /* Length is returned on CRC failure too, so a corrupted record can be skipped.  */
+    *record_length_ptr = record_length;
+    if ((crc ^ 0xFFFFFFFF) != record_crc)
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_spool_open(NX_AZURE_IOT_SPOOL *spool_ptr, const NX_AZURE_IOT_SPOOL_BACKEND *backend_ptr,
+                             VOID *backend_context, ULONG segment_size, UINT segment_count)
+{
+UCHAR index[NX_AZURE_IOT_SPOOL_INDEX_SIZE];
+NX_AZURE_IOT_SPOOL_POSITION position;
+ULONG record_length;
+UINT status;
+
+    if ((spool_ptr == NX_NULL) || (backend_ptr == NX_NULL))
+    {
+        LogError("IoT spool open fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    if ((segment_count < 2) ||
+        (segment_size <= (NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE + NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE)))
+    {
+        LogError("IoT spool open fail: INVALID SIZE");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    memset(spool_ptr, 0, sizeof(NX_AZURE_IOT_SPOOL));
+    spool_ptr -> spool_backend_ptr = backend_ptr;
+    spool_ptr -> spool_backend_context = backend_context;
+    spool_ptr -> spool_segment_size = segment_size;
+    spool_ptr -> spool_segment_count = segment_count;
+
+    /* Load committed position. Start from empty spool if index is missing or corrupted.  */
+    position.position_sequence = 0;
+    position.position_offset = NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE;
+    if ((backend_ptr -> backend_index_read(backend_context, index, sizeof(index)) == NX_AZURE_IOT_SUCCESS) &&
+        ((nx_azure_iot_spool_crc32(0xFFFFFFFF, index, 8) ^ 0xFFFFFFFF) == nx_azure_iot_spool_ulong_get(index + 8)))
+    {
+        position.position_sequence = nx_azure_iot_spool_ulong_get(index);
+        position.position_offset = nx_azure_iot_spool_ulong_get(index + 4);
+    }
+
+    spool_ptr -> spool_committed_position = position;
+    spool_ptr -> spool_read_position = position;
+
+    if (!nx_azure_iot_spool_segment_check(spool_ptr, position.position_sequence))
+    {
+
+        /* Nothing written after committed position.  */
+        position.position_offset = NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE;
+        spool_ptr -> spool_committed_position = position;
+        spool_ptr -> spool_read_position = position;
+        spool_ptr -> spool_write_position = position;
+        return(nx_azure_iot_spool_segment_init(spool_ptr, position.position_sequence));
+    }
+
+    /* Scan forward to recover write position.  */
+    for (;;)
+    {
+        status = nx_azure_iot_spool_record_check(spool_ptr, &position, &record_length);
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            position.position_offset += NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE + record_length;
+            continue;
+        }
+
+        if (((position.position_sequence + 1 - spool_ptr -> spool_committed_position.position_sequence) <
+             spool_ptr -> spool_segment_count) &&
+            nx_azure_iot_spool_segment_check(spool_ptr, position.position_sequence + 1))
+        {
+            position.position_sequence++;
+            position.position_offset = NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE;
+            continue;
+        }
+
+        break;
+    }
+
+    spool_ptr -> spool_write_position = position;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_spool_pending(NX_AZURE_IOT_SPOOL *spool_ptr)
+{
+    if (spool_ptr == NX_NULL)
+    {
+        return(NX_FALSE);
+    }
+
+    return((spool_ptr -> spool_committed_position.position_sequence !=
+            spool_ptr -> spool_write_position.position_sequence) ||
+           (spool_ptr -> spool_committed_position.position_offset !=
+            spool_ptr -> spool_write_position.position_offset));
+}
+
+UINT nx_azure_iot_spool_append(NX_AZURE_IOT_SPOOL *spool_ptr, const NX_AZURE_IOT_IOVEC *vec, UINT count)
+{
+UCHAR header[NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE];
+NX_AZURE_IOT_SPOOL_POSITION *write_ptr = &(spool_ptr -> spool_write_position);
+ULONG record_length = 0;
+ULONG offset;
+ULONG crc;
+UINT segment;
+UINT index;
+UINT status;
+
+    for (index = 0; index < count; index++)
+    {
+        record_length += vec[index].iovec_length;
+    }
+
+    if ((record_length == 0) ||
+        (record_length > (spool_ptr -> spool_segment_size - NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE -
+                          NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE)))
+    {
+        LogError("IoT spool append fail: INVALID RECORD LENGTH");
+        return(NX_AZURE_IOT_MESSAGE_TOO_LONG);
+    }
+
+    /* Move to next segment if record does not fit.  */
+    if ((write_ptr -> position_offset + NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE + record_length) >
+        spool_ptr -> spool_segment_size)
+    {
+
+        /* Segments holding uncommitted records are never reused.  */
+        if ((write_ptr -> position_sequence + 1 - spool_ptr -> spool_committed_position.position_sequence) >=
+            spool_ptr -> spool_segment_count)
+        {
+            return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+        }
+
+        status = nx_azure_iot_spool_segment_init(spool_ptr, write_ptr -> position_sequence + 1);
+        if (status)
+        {
+            return(status);
+        }
+
+        write_ptr -> position_sequence++;
+        write_ptr -> position_offset = NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE;
+    }
+
+    nx_azure_iot_spool_ulong_put(header, record_length);
+    crc = nx_azure_iot_spool_crc32(0xFFFFFFFF, header, 4);
+    for (index = 0; index < count; index++)
+    {
+        crc = nx_azure_iot_spool_crc32(crc, vec[index].iovec_base, vec[index].iovec_length);
+    }
+    nx_azure_iot_spool_ulong_put(header + 4, crc ^ 0xFFFFFFFF);
+
+    /* Pieces are written back to back and synced once per record.  */
+    segment = (UINT)(write_ptr -> position_sequence % spool_ptr -> spool_segment_count);
+    offset = write_ptr -> position_offset;
+    status = spool_ptr -> spool_backend_ptr -> backend_write(spool_ptr -> spool_backend_context, segment,
+                                                             offset, header, sizeof(header));
+    offset += sizeof(header);
+    for (index = 0; (status == NX_AZURE_IOT_SUCCESS) && (index < count); index++)
+    {
+        status = spool_ptr -> spool_backend_ptr -> backend_write(spool_ptr -> spool_backend_context, segment,
+                                                                 offset, vec[index].iovec_base,
+                                                                 vec[index].iovec_length);
+        offset += vec[index].iovec_length;
+    }
+
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = spool_ptr -> spool_backend_ptr -> backend_sync(spool_ptr -> spool_backend_context, segment);
+    }
+
+    if (status)
+    {
+
+        /* Partial record fails CRC check and is overwritten by next append.  */
+        LogError("IoT spool append fail: 0x%02x", status);
+        return(status);
+    }
+
+    write_ptr -> position_offset = offset;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_spool_peek(NX_AZURE_IOT_SPOOL *spool_ptr, ULONG *record_length_ptr)
+{
+NX_AZURE_IOT_SPOOL_POSITION *read_ptr = &(spool_ptr -> spool_read_position);
+ULONG next_offset;
+UINT status;
+
+    while ((read_ptr -> position_sequence != spool_ptr -> spool_write_position.position_sequence) ||
+           (read_ptr -> position_offset != spool_ptr -> spool_write_position.position_offset))
+    {
+        status = nx_azure_iot_spool_record_check(spool_ptr, read_ptr, record_length_ptr);
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            spool_ptr -> spool_record_length = *record_length_ptr;
+            return(NX_AZURE_IOT_SUCCESS);
+        }
+
+        if (read_ptr -> position_sequence == spool_ptr -> spool_write_position.position_sequence)
+        {
+
+            /* Skip the corrupted record if its length is sane, otherwise give up the rest of segment.
+               Read position never passes write position, so the next append is still read.  */
+            next_offset = spool_ptr -> spool_write_position.position_offset;
+            if ((status == NX_AZURE_IOT_INVALID_PACKET) &&
+                ((read_ptr -> position_offset + NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE + *record_length_ptr) <
+                 next_offset))
+            {
+                next_offset = read_ptr -> position_offset + NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE + *record_length_ptr;
+            }
+
+            LogError("IoT spool skip corrupted record at %lu", read_ptr -> position_offset);
+            read_ptr -> position_offset = next_offset;
+            continue;
+        }
+
+        /* Rest of segment is unused or corrupted.  */
+        if (status == NX_AZURE_IOT_INVALID_PACKET)
+        {
+            LogError("IoT spool skip corrupted segment %lu", read_ptr -> position_sequence);
+        }
+
+        read_ptr -> position_sequence++;
+        read_ptr -> position_offset = NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE;
+    }
+
+    return(NX_AZURE_IOT_NOT_FOUND);
+}
+
+UINT nx_azure_iot_spool_record_read(NX_AZURE_IOT_SPOOL *spool_ptr, ULONG offset, UCHAR *buffer, UINT size)
+{
+
+    /* Read data of record found by nx_azure_iot_spool_peek.  */
+    if ((offset + size) > spool_ptr -> spool_record_length)
+    {
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    return(spool_ptr -> spool_backend_ptr -> backend_read(spool_ptr -> spool_backend_context,
+                                                          (UINT)(spool_ptr -> spool_read_position.position_sequence %
+                                                                 spool_ptr -> spool_segment_count),
+                                                          spool_ptr -> spool_read_position.position_offset +
+                                                          NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE + offset,
+                                                          buffer, size));
+}
+
+UINT nx_azure_iot_spool_advance(NX_AZURE_IOT_SPOOL *spool_ptr, NX_AZURE_IOT_SPOOL_POSITION *position_ptr)
+{
+    if (spool_ptr -> spool_record_length == 0)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    spool_ptr -> spool_read_position.position_offset += NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE +
+                                                        spool_ptr -> spool_record_length;
+    spool_ptr -> spool_record_length = 0;
+    *position_ptr = spool_ptr -> spool_read_position;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_spool_commit(NX_AZURE_IOT_SPOOL *spool_ptr, const NX_AZURE_IOT_SPOOL_POSITION *position_ptr)
+{
+UCHAR index[NX_AZURE_IOT_SPOOL_INDEX_SIZE];
+UINT status;
+
+    nx_azure_iot_spool_ulong_put(index, position_ptr -> position_sequence);
+    nx_azure_iot_spool_ulong_put(index + 4, position_ptr -> position_offset);
+    nx_azure_iot_spool_ulong_put(index + 8, nx_azure_iot_spool_crc32(0xFFFFFFFF, index, 8) ^ 0xFFFFFFFF);
+
+    status = spool_ptr -> spool_backend_ptr -> backend_index_write(spool_ptr -> spool_backend_context,
+                                                                   index, sizeof(index));
+    if (status)
+    {
+        LogError("IoT spool commit fail: 0x%02x", status);
+        return(status);
+    }
+
+    spool_ptr -> spool_committed_position = *position_ptr;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+VOID nx_azure_iot_spool_rewind(NX_AZURE_IOT_SPOOL *spool_ptr)
+{
+
+    /* Records after committed position are replayed again.  */
+    spool_ptr -> spool_read_position = spool_ptr -> spool_committed_position;
+    spool_ptr -> spool_record_length = 0;
+}
@@ -0,0 +1,132 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+/**
+ * @file nx_azure_iot_spool.h
+ *
+ * @brief Definition for the Azure IoT persistent spool.
+ * @remark The spool is an append-only log split into fixed size segments. Each segment starts with
+ * a header carrying its sequence number, followed by records made of length, CRC-32 and data.
+ * A separate index holds the committed position. Records before the committed position are never
+ * read again, and segments are reused only after all their records are committed.
+ *
+ */
+
+#ifndef NX_AZURE_IOT_SPOOL_H
+#define NX_AZURE_IOT_SPOOL_H
+
+#ifdef __cplusplus
+extern   "C" {
+#endif
+
+#include "nx_azure_iot.h"
+
+/* Define the magic number of segment header.  */
+#define NX_AZURE_IOT_SPOOL_SEGMENT_MAGIC                  ((ULONG)0x4C4F4F50)
+
+/* Size of segment header: magic and sequence.  */
+#define NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE            (8)
+
+/* Size of record header: length and CRC-32.  */
+#define NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE             (8)
+
+/* Set the size of buffer used to verify record CRC. Larger buffer takes fewer backend reads.  */
+#ifndef NX_AZURE_IOT_SPOOL_CRC_BUFFER_SIZE
+#define NX_AZURE_IOT_SPOOL_CRC_BUFFER_SIZE                (128)
+#endif /* NX_AZURE_IOT_SPOOL_CRC_BUFFER_SIZE */
+
+/**
+ * @brief Azure IoT spool backend struct
+ * @details Storage operations used by the spool. Each segment is addressed by its index, from zero to
+ *          segment count minus one. All operations return #NX_AZURE_IOT_SUCCESS on success.
+ *          `backend_read` must fail if fewer than `size` bytes are available. `backend_write` may buffer
+ *          data, which must be on storage once `backend_sync` returns. A record takes several writes and
+ *          one sync. `backend_erase` leaves the segment empty. `backend_index_write` must replace the index
+ *          atomically.
+ *
+ */
+typedef struct NX_AZURE_IOT_SPOOL_BACKEND_STRUCT
+{
+    UINT (*backend_read)(VOID *context, UINT segment, ULONG offset, UCHAR *buffer, UINT size);
+    UINT (*backend_write)(VOID *context, UINT segment, ULONG offset, const UCHAR *data, UINT size);
+    UINT (*backend_sync)(VOID *context, UINT segment);
+    UINT (*backend_erase)(VOID *context, UINT segment);
+    UINT (*backend_index_read)(VOID *context, UCHAR *buffer, UINT size);
+    UINT (*backend_index_write)(VOID *context, const UCHAR *data, UINT size);
+} NX_AZURE_IOT_SPOOL_BACKEND;
+
+/**
+ * @brief Azure IoT spool position struct
+ *
+ */
+typedef struct NX_AZURE_IOT_SPOOL_POSITION_STRUCT
+{
+    ULONG                               position_sequence;
+    ULONG                               position_offset;
+} NX_AZURE_IOT_SPOOL_POSITION;
+
+/**
+ * @brief Azure IoT spool struct
+ *
+ */
+typedef struct NX_AZURE_IOT_SPOOL_STRUCT
+{
+    const NX_AZURE_IOT_SPOOL_BACKEND   *spool_backend_ptr;
+    VOID                               *spool_backend_context;
+    ULONG                               spool_segment_size;
+    UINT                                spool_segment_count;
+    NX_AZURE_IOT_SPOOL_POSITION         spool_write_position;
+    NX_AZURE_IOT_SPOOL_POSITION         spool_read_position;
+    NX_AZURE_IOT_SPOOL_POSITION         spool_committed_position;
+    ULONG                               spool_record_length;    /* Data length of record at read position. */
+} NX_AZURE_IOT_SPOOL;
+
+/**
+ * @brief Open spool
+ * @details This routine reads the committed position from the index and scans the segments after it
+ *          to recover the write position. Records that fail the CRC check end the scan. Records that
+ *          fail the CRC check when replayed are skipped.
+ *
+ * @param[in] spool_ptr A pointer to a #NX_AZURE_IOT_SPOOL.
+ * @param[in] backend_ptr A pointer to a #NX_AZURE_IOT_SPOOL_BACKEND.
+ * @param[in] backend_context Pointer passed to backend operations.
+ * @param[in] segment_size Size of each segment in bytes.
+ * @param[in] segment_count Number of segments. Must be at least 2.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if spool is opened.
+ */
+UINT nx_azure_iot_spool_open(NX_AZURE_IOT_SPOOL *spool_ptr, const NX_AZURE_IOT_SPOOL_BACKEND *backend_ptr,
+                             VOID *backend_context, ULONG segment_size, UINT segment_count);
+
+/**
+ * @brief Check if spool has records not yet committed
+ *
+ * @param[in] spool_ptr A pointer to a #NX_AZURE_IOT_SPOOL.
+ * @return A `UINT` with `NX_TRUE` if there are uncommitted records, `NX_FALSE` otherwise.
+ */
+UINT nx_azure_iot_spool_pending(NX_AZURE_IOT_SPOOL *spool_ptr);
+
+/* Internal APIs. */
+VOID nx_azure_iot_spool_ulong_put(UCHAR *buffer_ptr, ULONG value);
+ULONG nx_azure_iot_spool_ulong_get(const UCHAR *buffer_ptr);
+UINT nx_azure_iot_spool_append(NX_AZURE_IOT_SPOOL *spool_ptr, const NX_AZURE_IOT_IOVEC *vec, UINT count);
+UINT nx_azure_iot_spool_peek(NX_AZURE_IOT_SPOOL *spool_ptr, ULONG *record_length_ptr);
+UINT nx_azure_iot_spool_record_read(NX_AZURE_IOT_SPOOL *spool_ptr, ULONG offset, UCHAR *buffer, UINT size);
+UINT nx_azure_iot_spool_advance(NX_AZURE_IOT_SPOOL *spool_ptr, NX_AZURE_IOT_SPOOL_POSITION *position_ptr);
+UINT nx_azure_iot_spool_commit(NX_AZURE_IOT_SPOOL *spool_ptr, const NX_AZURE_IOT_SPOOL_POSITION *position_ptr);
+VOID nx_azure_iot_spool_rewind(NX_AZURE_IOT_SPOOL *spool_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* NX_AZURE_IOT_SPOOL_H */
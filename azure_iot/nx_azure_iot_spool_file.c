@@ -0,0 +1,321 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+/* Needed for fsync and fileno.  */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif /* _POSIX_C_SOURCE */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "nx_azure_iot_spool_file.h"
+
+static UINT nx_azure_iot_spool_file_path_get(NX_AZURE_IOT_SPOOL_FILE *file_ptr, const CHAR *name,
+                                             UINT segment, CHAR *path, UINT path_size)
+{
+INT length;
+
+    if (name)
+    {
+        length = snprintf(path, path_size, "%s/%s", file_ptr -> file_directory, name);
+    }
+    else
+    {
+        length = snprintf(path, path_size, "%s/segment_%u.log", file_ptr -> file_directory, segment);
+    }
+
+    if ((length < 0) || ((UINT)length >= path_size))
+    {
+        LogError("IoT spool file path too long");
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static FILE *nx_azure_iot_spool_file_handle_get(NX_AZURE_IOT_SPOOL_FILE *file_ptr, UINT segment)
+{
+CHAR path[NX_AZURE_IOT_SPOOL_FILE_PATH_SIZE];
+FILE *file;
+UINT index;
+
+    for (index = 0; index < NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT; index++)
+    {
+        if (file_ptr -> file_handle[index] && (file_ptr -> file_segment[index] == segment))
+        {
+            return((FILE *)file_ptr -> file_handle[index]);
+        }
+    }
+
+    if (nx_azure_iot_spool_file_path_get(file_ptr, NX_NULL, segment, path, sizeof(path)))
+    {
+        return(NX_NULL);
+    }
+
+    /* Segment is created by erase. Same handle is used to read and write a segment.  */
+    file = fopen(path, "r+b");
+    if (file == NX_NULL)
+    {
+        return(NX_NULL);
+    }
+
+    /* Data written to the handle being replaced is already synced by spool.  */
+    index = file_ptr -> file_handle_next;
+    if (file_ptr -> file_handle[index])
+    {
+        fclose((FILE *)file_ptr -> file_handle[index]);
+    }
+
+    file_ptr -> file_handle[index] = file;
+    file_ptr -> file_segment[index] = segment;
+    file_ptr -> file_handle_next = (index + 1) % NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT;
+
+    return(file);
+}
+
+static VOID nx_azure_iot_spool_file_handle_close(NX_AZURE_IOT_SPOOL_FILE *file_ptr, UINT segment)
+{
+UINT index;
+
+    for (index = 0; index < NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT; index++)
+    {
+        if (file_ptr -> file_handle[index] && (file_ptr -> file_segment[index] == segment))
+        {
+            fclose((FILE *)file_ptr -> file_handle[index]);
+            file_ptr -> file_handle[index] = NX_NULL;
+        }
+    }
+}
+
+static UINT nx_azure_iot_spool_file_sync_close(FILE *file)
+{
+UINT status = NX_AZURE_IOT_SUCCESS;
+
+    /* Make sure data reaches storage before reporting success.  */
+    if ((fflush(file) != 0) || (fsync(fileno(file)) != 0))
+    {
+        status = NX_AZURE_IOT_INVALID_PACKET;
+    }
+
+    if (fclose(file) != 0)
+    {
+        status = NX_AZURE_IOT_INVALID_PACKET;
+    }
+
+    return(status);
+}
+
+static UINT nx_azure_iot_spool_file_read(VOID *context, UINT segment, ULONG offset, UCHAR *buffer, UINT size)
+{
+FILE *file;
+
+    file = nx_azure_iot_spool_file_handle_get((NX_AZURE_IOT_SPOOL_FILE *)context, segment);
+    if (file == NX_NULL)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    if ((fseek(file, (long)offset, SEEK_SET) != 0) ||
+        (fread(buffer, 1, size, file) != size))
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_spool_file_write(VOID *context, UINT segment, ULONG offset, const UCHAR *data, UINT size)
+{
+FILE *file;
+
+    file = nx_azure_iot_spool_file_handle_get((NX_AZURE_IOT_SPOOL_FILE *)context, segment);
+    if (file == NX_NULL)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    /* Data stays in stdio buffer until sync.  */
+    if ((fseek(file, (long)offset, SEEK_SET) != 0) ||
+        (fwrite(data, 1, size, file) != size))
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_spool_file_sync(VOID *context, UINT segment)
+{
+FILE *file;
+
+    file = nx_azure_iot_spool_file_handle_get((NX_AZURE_IOT_SPOOL_FILE *)context, segment);
+    if (file == NX_NULL)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    /* Make sure data reaches storage before reporting success.  */
+    if ((fflush(file) != 0) || (fsync(fileno(file)) != 0))
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT nx_azure_iot_spool_file_erase(VOID *context, UINT segment)
+{
+CHAR path[NX_AZURE_IOT_SPOOL_FILE_PATH_SIZE];
+FILE *file;
+UINT status;
+
+    status = nx_azure_iot_spool_file_path_get((NX_AZURE_IOT_SPOOL_FILE *)context, NX_NULL, segment,
+                                              path, sizeof(path));
+    if (status)
+    {
+        return(status);
+    }
+
+    /* Truncate to empty file. Handle kept open for this segment is reopened on next access.  */
+    nx_azure_iot_spool_file_handle_close((NX_AZURE_IOT_SPOOL_FILE *)context, segment);
+    file = fopen(path, "wb");
+    if (file == NX_NULL)
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    return(nx_azure_iot_spool_file_sync_close(file));
+}
+
+static UINT nx_azure_iot_spool_file_index_read(VOID *context, UCHAR *buffer, UINT size)
+{
+CHAR path[NX_AZURE_IOT_SPOOL_FILE_PATH_SIZE];
+FILE *file;
+UINT status;
+
+    status = nx_azure_iot_spool_file_path_get((NX_AZURE_IOT_SPOOL_FILE *)context, "index", 0,
+                                              path, sizeof(path));
+    if (status)
+    {
+        return(status);
+    }
+
+    file = fopen(path, "rb");
+    if (file == NX_NULL)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    if (fread(buffer, 1, size, file) != size)
+    {
+        status = NX_AZURE_IOT_NOT_FOUND;
+    }
+
+    fclose(file);
+
+    return(status);
+}
+
+static UINT nx_azure_iot_spool_file_index_write(VOID *context, const UCHAR *data, UINT size)
+{
+CHAR path[NX_AZURE_IOT_SPOOL_FILE_PATH_SIZE];
+CHAR temp_path[NX_AZURE_IOT_SPOOL_FILE_PATH_SIZE];
+FILE *file;
+UINT status;
+
+    status = nx_azure_iot_spool_file_path_get((NX_AZURE_IOT_SPOOL_FILE *)context, "index", 0,
+                                              path, sizeof(path));
+    if (status == NX_AZURE_IOT_SUCCESS)
+    {
+        status = nx_azure_iot_spool_file_path_get((NX_AZURE_IOT_SPOOL_FILE *)context, "index.tmp", 0,
+                                                  temp_path, sizeof(temp_path));
+    }
+
+    if (status)
+    {
+        return(status);
+    }
+
+    /* Write to temporary file then rename, so index is replaced atomically.  */
+    file = fopen(temp_path, "wb");
+    if (file == NX_NULL)
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    if (fwrite(data, 1, size, file) != size)
+    {
+        fclose(file);
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    status = nx_azure_iot_spool_file_sync_close(file);
+    if (status)
+    {
+        return(status);
+    }
+
+    if (rename(temp_path, path) != 0)
+    {
+        return(NX_AZURE_IOT_INVALID_PACKET);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_spool_file_initialize(NX_AZURE_IOT_SPOOL_FILE *file_ptr, const CHAR *directory)
+{
+    if ((file_ptr == NX_NULL) || (directory == NX_NULL))
+    {
+        LogError("IoT spool file initialize fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    memset(file_ptr, 0, sizeof(NX_AZURE_IOT_SPOOL_FILE));
+    file_ptr -> file_directory = directory;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT nx_azure_iot_spool_file_deinitialize(NX_AZURE_IOT_SPOOL_FILE *file_ptr)
+{
+UINT index;
+
+    if (file_ptr == NX_NULL)
+    {
+        LogError("IoT spool file deinitialize fail: INVALID POINTER");
+        return(NX_AZURE_IOT_INVALID_PARAMETER);
+    }
+
+    for (index = 0; index < NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT; index++)
+    {
+        if (file_ptr -> file_handle[index])
+        {
+            fclose((FILE *)file_ptr -> file_handle[index]);
+            file_ptr -> file_handle[index] = NX_NULL;
+        }
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+const NX_AZURE_IOT_SPOOL_BACKEND nx_azure_iot_spool_file_backend =
+{
+    nx_azure_iot_spool_file_read,
+    nx_azure_iot_spool_file_write,
+    nx_azure_iot_spool_file_sync,
+    nx_azure_iot_spool_file_erase,
+    nx_azure_iot_spool_file_index_read,
+    nx_azure_iot_spool_file_index_write
+};
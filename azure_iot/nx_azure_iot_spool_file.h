@@ -0,0 +1,85 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Version: 6.0 Preview */
+
+/**
+ * @file nx_azure_iot_spool_file.h
+ *
+ * @brief Definition for the Azure IoT spool file backend.
+ * @remark Each segment is stored as a file in a directory, along with the index file. This backend
+ * uses POSIX file APIs and is meant for Linux builds. Recently used segment files are kept open, so
+ * appending a record costs one flush and one fsync.
+ *
+ */
+
+#ifndef NX_AZURE_IOT_SPOOL_FILE_H
+#define NX_AZURE_IOT_SPOOL_FILE_H
+
+#ifdef __cplusplus
+extern   "C" {
+#endif
+
+#include "nx_azure_iot_spool.h"
+
+/* Define the maximum length of file path.  */
+#ifndef NX_AZURE_IOT_SPOOL_FILE_PATH_SIZE
+#define NX_AZURE_IOT_SPOOL_FILE_PATH_SIZE                 (256)
+#endif /* NX_AZURE_IOT_SPOOL_FILE_PATH_SIZE */
+
+/* Define the number of segment files kept open. Two covers replaying one segment while appending to another.  */
+#ifndef NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT
+#define NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT              (2)
+#endif /* NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT */
+
+/**
+ * @brief Azure IoT spool file backend context struct
+ *
+ */
+typedef struct NX_AZURE_IOT_SPOOL_FILE_STRUCT
+{
+    const CHAR                         *file_directory;         /* Existing directory, must be NULL terminated. */
+    VOID                               *file_handle[NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT];
+    UINT                                file_segment[NX_AZURE_IOT_SPOOL_FILE_HANDLE_COUNT];
+    UINT                                file_handle_next;       /* Handle replaced when another segment is opened. */
+} NX_AZURE_IOT_SPOOL_FILE;
+
+/**
+ * @brief File backend for #NX_AZURE_IOT_SPOOL. Pass a #NX_AZURE_IOT_SPOOL_FILE initialized by
+ *        nx_azure_iot_spool_file_initialize() as backend context.
+ *
+ */
+extern const NX_AZURE_IOT_SPOOL_BACKEND nx_azure_iot_spool_file_backend;
+
+/**
+ * @brief Initialize spool file backend context
+ *
+ * @param[in] file_ptr A pointer to a #NX_AZURE_IOT_SPOOL_FILE.
+ * @param[in] directory Existing directory holding segment and index files. Must be `NULL` terminated.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if context is initialized.
+ */
+UINT nx_azure_iot_spool_file_initialize(NX_AZURE_IOT_SPOOL_FILE *file_ptr, const CHAR *directory);
+
+/**
+ * @brief Deinitialize spool file backend context
+ * @details This routine closes the segment files kept open. The spool must not be used afterwards.
+ *
+ * @param[in] file_ptr A pointer to a #NX_AZURE_IOT_SPOOL_FILE.
+ * @return A `UINT` with the result of the API.
+ *   @retval #NX_AZURE_IOT_SUCCESS Successful if context is deinitialized.
+ */
+UINT nx_azure_iot_spool_file_deinitialize(NX_AZURE_IOT_SPOOL_FILE *file_ptr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* NX_AZURE_IOT_SPOOL_FILE_H */
@@ -0,0 +1,187 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Bytes and time per telemetry message: CBOR encoder against JSON writer for the same message,
+   both writing into a packet, and CBOR decoding of the encoded message in place.
+
+   Usage: benchmark_cbor [message_count]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark_common.h"
+#include "nx_azure_iot_cbor.h"
+#include "nx_azure_iot_json_writer.h"
+
+static ULONG benchmark_message_count = 100000;
+
+static UINT benchmark_cbor_encode(NX_PACKET *packet_ptr, ULONG index)
+{
+NX_AZURE_IOT_CBOR_ENCODER encoder;
+UINT status;
+
+    if ((status = nx_azure_iot_cbor_encoder_init(&encoder, packet_ptr, NX_NO_WAIT)) ||
+        (status = nx_azure_iot_cbor_encoder_append_map(&encoder, 4)) ||
+        (status = nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"temperature",
+                                                        sizeof("temperature") - 1)) ||
+        (status = nx_azure_iot_cbor_encoder_append_double(&encoder, 20.0 + (double)(index % 1000) / 8.0)) ||
+        (status = nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"humidity",
+                                                        sizeof("humidity") - 1)) ||
+        (status = nx_azure_iot_cbor_encoder_append_double(&encoder, 0.1 * (double)(index % 997))) ||
+        (status = nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"sequence",
+                                                        sizeof("sequence") - 1)) ||
+        (status = nx_azure_iot_cbor_encoder_append_int32(&encoder, (INT)index)) ||
+        (status = nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"status", sizeof("status") - 1)) ||
+        (status = nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"ok", sizeof("ok") - 1)))
+    {
+        return(status);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT benchmark_json_encode(NX_PACKET *packet_ptr, ULONG index)
+{
+NX_AZURE_IOT_JSON_WRITER writer;
+UINT status;
+
+    if ((status = nx_azure_iot_json_writer_init(&writer, packet_ptr, NX_NO_WAIT)) ||
+        (status = nx_azure_iot_json_writer_append_begin_object(&writer)) ||
+        (status = nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"temperature",
+                                                                sizeof("temperature") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_double(&writer, 20.0 + (double)(index % 1000) / 8.0)) ||
+        (status = nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"humidity",
+                                                                sizeof("humidity") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_double(&writer, 0.1 * (double)(index % 997))) ||
+        (status = nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"sequence",
+                                                                sizeof("sequence") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_int32(&writer, (INT)index)) ||
+        (status = nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"status",
+                                                                sizeof("status") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_string(&writer, (const UCHAR *)"ok", sizeof("ok") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_end_object(&writer)))
+    {
+        return(status);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static INT benchmark_encode_run(const CHAR *name, UINT (*encode)(NX_PACKET *packet_ptr, ULONG index))
+{
+NX_PACKET *packet_ptr;
+ULONG64 bytes = 0;
+ULONG64 start;
+ULONG index;
+UINT status;
+
+    start = benchmark_time_get();
+    for (index = 0; index < benchmark_message_count; index++)
+    {
+        if ((status = nx_packet_allocate(&benchmark_pool, &packet_ptr, NX_IPv4_TCP_PACKET, NX_NO_WAIT)))
+        {
+            printf("Failed to allocate packet: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+
+        if ((status = encode(packet_ptr, index)))
+        {
+            printf("Failed to encode message %lu: error code = 0x%08x\r\n", (unsigned long)index, status);
+            nx_packet_release(packet_ptr);
+            return(1);
+        }
+
+        bytes += packet_ptr -> nx_packet_length;
+        nx_packet_release(packet_ptr);
+    }
+    benchmark_report(name, benchmark_message_count, bytes, benchmark_time_get() - start);
+
+    return(0);
+}
+
+static INT benchmark_cbor_decode_run(VOID)
+{
+NX_AZURE_IOT_CBOR_DECODER decoder;
+NX_AZURE_IOT_CBOR_ITEM item;
+NX_PACKET *packet_ptr;
+ULONG64 start;
+ULONG index;
+UINT items = 0;
+UINT status;
+
+    if ((status = nx_packet_allocate(&benchmark_pool, &packet_ptr, NX_IPv4_TCP_PACKET, NX_NO_WAIT)))
+    {
+        printf("Failed to allocate packet: error code = 0x%08x\r\n", status);
+        return(1);
+    }
+
+    if ((status = benchmark_cbor_encode(packet_ptr, 12345)))
+    {
+        printf("Failed to encode message: error code = 0x%08x\r\n", status);
+        nx_packet_release(packet_ptr);
+        return(1);
+    }
+
+    start = benchmark_time_get();
+    for (index = 0; index < benchmark_message_count; index++)
+    {
+        if ((status = nx_azure_iot_cbor_decoder_packet_init(&decoder, packet_ptr)))
+        {
+            printf("Failed to initialize decoder: error code = 0x%08x\r\n", status);
+            nx_packet_release(packet_ptr);
+            return(1);
+        }
+
+        while ((status = nx_azure_iot_cbor_decoder_next(&decoder, &item)) == NX_AZURE_IOT_SUCCESS)
+        {
+            items++;
+        }
+
+        if (status != NX_AZURE_IOT_NOT_FOUND)
+        {
+            printf("Failed to decode message: error code = 0x%08x\r\n", status);
+            nx_packet_release(packet_ptr);
+            return(1);
+        }
+    }
+    benchmark_report("cbor_decoder_packet", benchmark_message_count,
+                     (ULONG64)benchmark_message_count * packet_ptr -> nx_packet_length,
+                     benchmark_time_get() - start);
+    printf("%u items decoded\r\n", items);
+    nx_packet_release(packet_ptr);
+
+    return(0);
+}
+
+static INT benchmark_cbor_entry(VOID)
+{
+    if (benchmark_encode_run("cbor_encoder_packet", benchmark_cbor_encode) ||
+        benchmark_encode_run("json_writer_packet", benchmark_json_encode) ||
+        benchmark_cbor_decode_run())
+    {
+        return(1);
+    }
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        benchmark_message_count = strtoul(argv[1], NX_NULL, 10);
+    }
+
+    printf("%lu telemetry messages\r\n", (unsigned long)benchmark_message_count);
+    benchmark_thread_run(benchmark_cbor_entry);
+
+    return(0);
+}
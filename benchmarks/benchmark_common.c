@@ -0,0 +1,289 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Needed for clock_gettime.  */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif /* _POSIX_C_SOURCE */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "benchmark_common.h"
+
+#define BENCHMARK_THREAD_STACK_SIZE             (64 * 1024)
+#define BENCHMARK_POOL_SIZE                     ((BENCHMARK_PACKET_SIZE + sizeof(NX_PACKET)) * BENCHMARK_PACKET_COUNT)
+#define BENCHMARK_IP_STACK_SIZE                 (4096)
+#define BENCHMARK_CLOUD_STACK_SIZE              (4096)
+#define BENCHMARK_METADATA_BUFFER_SIZE          (4096)
+#define BENCHMARK_NETWORK_MTU                   (1500)
+#define BENCHMARK_HUB_HOST_NAME                 "benchmark.azure-devices.net"
+#define BENCHMARK_HUB_DEVICE_ID                 "benchmark"
+
+NX_PACKET_POOL benchmark_pool;
+
+static INT (*benchmark_entry)(VOID);
+static TX_THREAD benchmark_thread;
+static ULONG benchmark_thread_stack[BENCHMARK_THREAD_STACK_SIZE / sizeof(ULONG)];
+static ULONG benchmark_pool_area[BENCHMARK_POOL_SIZE / sizeof(ULONG) + 1];
+static NX_IP benchmark_ip;
+static NX_DNS benchmark_dns;
+static NX_AZURE_IOT benchmark_azure_iot;
+static UINT benchmark_azure_iot_created;
+static ULONG benchmark_ip_stack[BENCHMARK_IP_STACK_SIZE / sizeof(ULONG)];
+static ULONG benchmark_cloud_stack[BENCHMARK_CLOUD_STACK_SIZE / sizeof(ULONG)];
+static UCHAR benchmark_metadata_buffer[BENCHMARK_METADATA_BUFFER_SIZE];
+
+static VOID benchmark_thread_entry(ULONG parameter)
+{
+    NX_PARAMETER_NOT_USED(parameter);
+
+    exit(benchmark_entry());
+}
+
+VOID tx_application_define(VOID *first_unused_memory)
+{
+UINT status;
+
+    NX_PARAMETER_NOT_USED(first_unused_memory);
+
+    nx_system_initialize();
+
+    if ((status = nx_packet_pool_create(&benchmark_pool, "Benchmark Packet Pool", BENCHMARK_PACKET_SIZE,
+                                        benchmark_pool_area, sizeof(benchmark_pool_area))))
+    {
+        printf("nx_packet_pool_create fail: %u\r\n", status);
+        exit(1);
+    }
+
+    if ((status = tx_thread_create(&benchmark_thread, "Benchmark Thread", benchmark_thread_entry, 0,
+                                   benchmark_thread_stack, BENCHMARK_THREAD_STACK_SIZE,
+                                   BENCHMARK_THREAD_PRIORITY, BENCHMARK_THREAD_PRIORITY,
+                                   TX_NO_TIME_SLICE, TX_AUTO_START)))
+    {
+        printf("Benchmark thread creation fail: %u\r\n", status);
+        exit(1);
+    }
+}
+
+VOID benchmark_thread_run(INT (*entry)(VOID))
+{
+    benchmark_entry = entry;
+    tx_kernel_enter();
+}
+
+/* Driver of an interface that is always up and never delivers anything.  */
+static VOID benchmark_network_driver(NX_IP_DRIVER *driver_req_ptr)
+{
+NX_IP *ip_ptr = driver_req_ptr -> nx_ip_driver_ptr;
+UINT interface_index = driver_req_ptr -> nx_ip_driver_interface -> nx_interface_index;
+
+    driver_req_ptr -> nx_ip_driver_status = NX_SUCCESS;
+
+    switch (driver_req_ptr -> nx_ip_driver_command)
+    {
+        case NX_LINK_INTERFACE_ATTACH :
+        case NX_LINK_DISABLE :
+            break;
+
+        case NX_LINK_INITIALIZE :
+            nx_ip_interface_mtu_set(ip_ptr, interface_index, BENCHMARK_NETWORK_MTU);
+            nx_ip_interface_address_mapping_configure(ip_ptr, interface_index, NX_FALSE);
+            break;
+
+        case NX_LINK_ENABLE :
+            driver_req_ptr -> nx_ip_driver_interface -> nx_interface_link_up = NX_TRUE;
+            break;
+
+        case NX_LINK_PACKET_SEND :
+        case NX_LINK_PACKET_BROADCAST :
+        case NX_LINK_ARP_SEND :
+        case NX_LINK_ARP_RESPONSE_SEND :
+        case NX_LINK_RARP_SEND :
+            nx_packet_transmit_release(driver_req_ptr -> nx_ip_driver_packet);
+            break;
+
+        default :
+            driver_req_ptr -> nx_ip_driver_status = NX_UNHANDLED_COMMAND;
+            break;
+    }
+}
+
+static UINT benchmark_azure_iot_create(VOID)
+{
+UINT status;
+
+    if (benchmark_azure_iot_created)
+    {
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    if ((status = nx_ip_create(&benchmark_ip, "Benchmark IP Instance", IP_ADDRESS(192, 0, 2, 1), 0xFFFFFF00UL,
+                               &benchmark_pool, benchmark_network_driver,
+                               benchmark_ip_stack, sizeof(benchmark_ip_stack), BENCHMARK_IP_THREAD_PRIORITY)))
+    {
+        printf("nx_ip_create fail: %u\r\n", status);
+        return(status);
+    }
+
+    if ((status = nx_tcp_enable(&benchmark_ip)) ||
+        (status = nx_udp_enable(&benchmark_ip)))
+    {
+        printf("Benchmark IP enable fail: %u\r\n", status);
+        return(status);
+    }
+
+    if ((status = nx_dns_create(&benchmark_dns, &benchmark_ip, (UCHAR *)"Benchmark DNS Client")))
+    {
+        printf("nx_dns_create fail: %u\r\n", status);
+        return(status);
+    }
+
+#ifdef NX_DNS_CLIENT_USER_CREATE_PACKET_POOL
+    if ((status = nx_dns_packet_pool_set(&benchmark_dns, &benchmark_pool)))
+    {
+        printf("nx_dns_packet_pool_set fail: %u\r\n", status);
+        return(status);
+    }
+#endif /* NX_DNS_CLIENT_USER_CREATE_PACKET_POOL */
+
+    if ((status = nx_azure_iot_create(&benchmark_azure_iot, (UCHAR *)"Benchmark Azure IoT", &benchmark_ip,
+                                      &benchmark_pool, &benchmark_dns,
+                                      benchmark_cloud_stack, sizeof(benchmark_cloud_stack),
+                                      BENCHMARK_CLOUD_THREAD_PRIORITY, NX_NULL)))
+    {
+        printf("nx_azure_iot_create fail: 0x%08x\r\n", status);
+        return(status);
+    }
+
+    benchmark_azure_iot_created = NX_TRUE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT benchmark_hub_client_initialize(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+UINT status;
+
+    if ((status = benchmark_azure_iot_create()))
+    {
+        return(status);
+    }
+
+    /* TLS is only set up on connect, so no crypto is needed.  */
+    if ((status = nx_azure_iot_hub_client_initialize(hub_client_ptr, &benchmark_azure_iot,
+                                                     (UCHAR *)BENCHMARK_HUB_HOST_NAME,
+                                                     sizeof(BENCHMARK_HUB_HOST_NAME) - 1,
+                                                     (UCHAR *)BENCHMARK_HUB_DEVICE_ID,
+                                                     sizeof(BENCHMARK_HUB_DEVICE_ID) - 1,
+                                                     (UCHAR *)"", 0, NX_NULL, 0, NX_NULL, 0,
+                                                     benchmark_metadata_buffer, sizeof(benchmark_metadata_buffer),
+                                                     NX_NULL)))
+    {
+        printf("nx_azure_iot_hub_client_initialize fail: 0x%08x\r\n", status);
+        return(status);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT benchmark_publish_queue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, const CHAR *topic,
+                             const UCHAR *payload, UINT payload_length)
+{
+NXD_MQTT_CLIENT *client_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt);
+NX_PACKET *packet_ptr;
+UCHAR header[7];
+UINT header_length = 1;
+UINT topic_length = (UINT)strlen(topic);
+UINT remaining_length = 2 + topic_length + payload_length;
+UINT status;
+
+    /* Fixed header, remaining length in up to four bytes, then topic length.  */
+    header[0] = (UCHAR)(MQTT_CONTROL_PACKET_TYPE_PUBLISH << 4);
+    do
+    {
+        header[header_length] = (UCHAR)(remaining_length & 0x7F);
+        remaining_length >>= 7;
+        if (remaining_length)
+        {
+            header[header_length] |= 0x80;
+        }
+        header_length++;
+    } while (remaining_length);
+    header[header_length++] = (UCHAR)(topic_length >> 8);
+    header[header_length++] = (UCHAR)(topic_length & 0xFF);
+
+    if ((status = nx_packet_allocate(&benchmark_pool, &packet_ptr, 0, NX_NO_WAIT)))
+    {
+        return(status);
+    }
+
+    if ((status = nx_packet_data_append(packet_ptr, header, header_length, &benchmark_pool, NX_NO_WAIT)) ||
+        (status = nx_packet_data_append(packet_ptr, (VOID *)topic, topic_length, &benchmark_pool, NX_NO_WAIT)) ||
+        (payload_length &&
+         (status = nx_packet_data_append(packet_ptr, (VOID *)payload, payload_length, &benchmark_pool, NX_NO_WAIT))))
+    {
+        nx_packet_release(packet_ptr);
+        return(status);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(client_ptr -> nxd_mqtt_client_mutex_ptr, TX_WAIT_FOREVER);
+
+    packet_ptr -> nx_packet_queue_next = NX_NULL;
+    if (client_ptr -> message_receive_queue_tail)
+    {
+        client_ptr -> message_receive_queue_tail -> nx_packet_queue_next = packet_ptr;
+    }
+    else
+    {
+        client_ptr -> message_receive_queue_head = packet_ptr;
+    }
+    client_ptr -> message_receive_queue_tail = packet_ptr;
+    client_ptr -> message_receive_queue_depth++;
+
+    /* Release the mutex.  */
+    tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+ULONG64 benchmark_time_get(VOID)
+{
+struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return((ULONG64)now.tv_sec * 1000000000ULL + (ULONG64)now.tv_nsec);
+}
+
+VOID benchmark_report(const CHAR *name, ULONG operations, ULONG64 bytes, ULONG64 elapsed_ns)
+{
+double seconds = (double)elapsed_ns / 1e9;
+
+    if (seconds <= 0.0)
+    {
+        seconds = 1e-9;
+    }
+
+    printf("%-32s %10lu ops %12.1f ops/s %10.1f ns/op",
+           name, (unsigned long)operations, (double)operations / seconds,
+           (double)elapsed_ns / (double)(operations ? operations : 1));
+
+    if (bytes)
+    {
+        printf(" %8.2f MB/s %8.1f B/op", (double)bytes / seconds / 1e6,
+               (double)bytes / (double)(operations ? operations : 1));
+    }
+
+    printf("\n");
+}
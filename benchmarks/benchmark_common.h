@@ -0,0 +1,61 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef BENCHMARK_COMMON_H
+#define BENCHMARK_COMMON_H
+
+#include "nx_api.h"
+#include "nx_azure_iot_hub_client.h"
+
+#ifndef BENCHMARK_PACKET_SIZE
+#define BENCHMARK_PACKET_SIZE                   (1536)
+#endif /* BENCHMARK_PACKET_SIZE */
+
+#ifndef BENCHMARK_PACKET_COUNT
+#define BENCHMARK_PACKET_COUNT                  (64)
+#endif /* BENCHMARK_PACKET_COUNT */
+
+#ifndef BENCHMARK_THREAD_PRIORITY
+#define BENCHMARK_THREAD_PRIORITY               (16)
+#endif /* BENCHMARK_THREAD_PRIORITY */
+
+#ifndef BENCHMARK_IP_THREAD_PRIORITY
+#define BENCHMARK_IP_THREAD_PRIORITY            (1)
+#endif /* BENCHMARK_IP_THREAD_PRIORITY */
+
+#ifndef BENCHMARK_CLOUD_THREAD_PRIORITY
+#define BENCHMARK_CLOUD_THREAD_PRIORITY         (3)
+#endif /* BENCHMARK_CLOUD_THREAD_PRIORITY */
+
+/* Packet pool created before the benchmark thread starts.  */
+extern NX_PACKET_POOL benchmark_pool;
+
+/* Enter ThreadX kernel and run entry on a thread at BENCHMARK_THREAD_PRIORITY.
+   Process exits with the value returned by entry, so this function does not return.  */
+VOID benchmark_thread_run(INT (*entry)(VOID));
+
+/* Initialize hub client on an IP instance whose driver drops every packet sent. Client is never connected:
+   received messages are injected with benchmark_publish_queue(), and sends fail once the MQTT client is reached.
+   Must be called from the benchmark thread.  */
+UINT benchmark_hub_client_initialize(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+
+/* Append a QoS 0 PUBLISH of topic and payload to the MQTT receive queue of hub_client_ptr, laid out as the MQTT
+   client leaves it before calling the receive notify.  */
+UINT benchmark_publish_queue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, const CHAR *topic,
+                             const UCHAR *payload, UINT payload_length);
+
+/* Return monotonic time in nanoseconds.  */
+ULONG64 benchmark_time_get(VOID);
+
+/* Print one result line: name, operations, bytes and elapsed time.  */
+VOID benchmark_report(const CHAR *name, ULONG operations, ULONG64 bytes, ULONG64 elapsed_ns);
+
+#endif /* BENCHMARK_COMMON_H */
@@ -0,0 +1,160 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Telemetry payload compression: compression ratio and time per KB of input for a single JSON telemetry
+   message, with and without a preset dictionary of its keys, and for a JSON array of samples as sent in
+   one batch message. Payloads differ in their values from one message to the next.
+
+   Usage: benchmark_compress [message_count]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark_common.h"
+#include "nx_azure_iot_compress.h"
+
+#define BENCHMARK_OUTPUT_BUFFER_SIZE            (2048)
+#define BENCHMARK_ARENA_SIZE                    (NX_AZURE_IOT_COMPRESS_HASH_TABLE_SIZE + BENCHMARK_OUTPUT_BUFFER_SIZE)
+#define BENCHMARK_PAYLOAD_SIZE                  (1536)
+#define BENCHMARK_ARRAY_SAMPLES                 (24)
+#define BENCHMARK_DICTIONARY                    "{\"temperature\":,\"humidity\":,\"pressure\":," \
+                                                "\"sequence\":,\"status\":\"ok\"}"
+
+static ULONG benchmark_message_count = 100000;
+static ULONG benchmark_arena[BENCHMARK_ARENA_SIZE / sizeof(ULONG)];
+static NX_AZURE_IOT_COMPRESS benchmark_compress;
+
+static UINT benchmark_message_format(CHAR *buffer, UINT buffer_size, ULONG index)
+{
+INT length;
+
+    length = snprintf(buffer, buffer_size,
+                      "{\"temperature\":%.2f,\"humidity\":%.1f,\"pressure\":%.1f,\"sequence\":%lu,\"status\":\"ok\"}",
+                      20.0 + (double)(index % 1000) / 8.0, 0.1 * (double)(index % 997),
+                      1000.0 + (double)(index % 101) / 4.0, (unsigned long)index);
+    if ((length < 0) || (length >= (INT)buffer_size))
+    {
+        return(0);
+    }
+
+    return((UINT)length);
+}
+
+static UINT benchmark_array_format(CHAR *buffer, UINT buffer_size, ULONG index)
+{
+UINT length = 0;
+UINT sample;
+INT written;
+
+    for (sample = 0; sample < BENCHMARK_ARRAY_SAMPLES; sample++)
+    {
+        written = snprintf(buffer + length, buffer_size - length, "%s[%lu,%.2f]",
+                           (sample == 0) ? "[" : ",",
+                           (unsigned long)(1600000000UL + (index * BENCHMARK_ARRAY_SAMPLES + sample) * 10),
+                           20.0 + (double)((index + sample) % 1000) / 8.0);
+        if ((written < 0) || ((UINT)written >= (buffer_size - length)))
+        {
+            return(0);
+        }
+
+        length += (UINT)written;
+    }
+
+    if ((length + 2) > buffer_size)
+    {
+        return(0);
+    }
+
+    buffer[length++] = ']';
+    buffer[length] = '\0';
+
+    return(length);
+}
+
+static INT benchmark_compress_run(const CHAR *name, UINT (*format)(CHAR *buffer, UINT buffer_size, ULONG index),
+                                  const UCHAR *dictionary, UINT dictionary_size)
+{
+CHAR payload[BENCHMARK_PAYLOAD_SIZE];
+UCHAR *output_ptr;
+UINT output_size;
+UINT payload_size;
+ULONG64 input_bytes = 0;
+ULONG64 output_bytes = 0;
+ULONG64 elapsed = 0;
+ULONG64 start;
+ULONG index;
+UINT status;
+
+    if ((status = nx_azure_iot_compress_init(&benchmark_compress, (UCHAR *)benchmark_arena, sizeof(benchmark_arena),
+                                             dictionary, dictionary_size)))
+    {
+        printf("Failed to initialize compression: error code = 0x%08x\r\n", status);
+        return(1);
+    }
+
+    for (index = 0; index < benchmark_message_count; index++)
+    {
+        if ((payload_size = format(payload, sizeof(payload), index)) == 0)
+        {
+            printf("Failed to format message %lu\r\n", (unsigned long)index);
+            return(1);
+        }
+
+        /* Payload that does not get smaller is sent as is, so it counts with its own size.  */
+        start = benchmark_time_get();
+        status = nx_azure_iot_compress(&benchmark_compress, (const UCHAR *)payload, payload_size,
+                                       &output_ptr, &output_size);
+        elapsed += benchmark_time_get() - start;
+        if (status)
+        {
+            output_size = payload_size;
+        }
+
+        input_bytes += payload_size;
+        output_bytes += output_size;
+    }
+
+    benchmark_report(name, benchmark_message_count, input_bytes, elapsed);
+    printf("%-32s %10.3f ratio %10.2f us/KB %8.1f B/op in %8.1f B/op out\n", name,
+           (double)output_bytes / (double)(input_bytes ? input_bytes : 1),
+           (double)elapsed / 1e3 / ((double)(input_bytes ? input_bytes : 1) / 1024.0),
+           (double)input_bytes / (double)(benchmark_message_count ? benchmark_message_count : 1),
+           (double)output_bytes / (double)(benchmark_message_count ? benchmark_message_count : 1));
+
+    return(0);
+}
+
+static INT benchmark_compress_entry(VOID)
+{
+    if (benchmark_compress_run("compress_message", benchmark_message_format, NX_NULL, 0) ||
+        benchmark_compress_run("compress_message_dictionary", benchmark_message_format,
+                               (const UCHAR *)BENCHMARK_DICTIONARY, sizeof(BENCHMARK_DICTIONARY) - 1) ||
+        benchmark_compress_run("compress_array", benchmark_array_format, NX_NULL, 0))
+    {
+        return(1);
+    }
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        benchmark_message_count = strtoul(argv[1], NX_NULL, 10);
+    }
+
+    printf("%lu messages per run, ratio is compressed over original size\r\n",
+           (unsigned long)benchmark_message_count);
+    benchmark_thread_run(benchmark_compress_entry);
+
+    return(0);
+}
@@ -0,0 +1,125 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Telemetry JSON formatting into a packet: JSON writer against snprintf into a flat buffer
+   followed by nx_packet_data_append. snprintf uses %.17g, the precision it needs to round trip
+   a double, while the writer emits the shortest text that round trips.
+
+   Usage: benchmark_json [message_count]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark_common.h"
+#include "nx_azure_iot_json_writer.h"
+
+#define BENCHMARK_JSON_BUFFER_SIZE              (256)
+
+static ULONG benchmark_message_count = 100000;
+
+static UINT benchmark_json_writer_format(NX_PACKET *packet_ptr, ULONG index)
+{
+NX_AZURE_IOT_JSON_WRITER writer;
+UINT status;
+
+    if ((status = nx_azure_iot_json_writer_init(&writer, packet_ptr, NX_NO_WAIT)) ||
+        (status = nx_azure_iot_json_writer_append_begin_object(&writer)) ||
+        (status = nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"temperature",
+                                                                sizeof("temperature") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_double(&writer, 20.0 + (double)(index % 1000) / 8.0)) ||
+        (status = nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"humidity",
+                                                                sizeof("humidity") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_double(&writer, 0.1 * (double)(index % 997))) ||
+        (status = nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"sequence",
+                                                                sizeof("sequence") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_int32(&writer, (INT)index)) ||
+        (status = nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"status",
+                                                                sizeof("status") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_string(&writer, (const UCHAR *)"ok", sizeof("ok") - 1)) ||
+        (status = nx_azure_iot_json_writer_append_end_object(&writer)))
+    {
+        return(status);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT benchmark_snprintf_format(NX_PACKET *packet_ptr, ULONG index)
+{
+CHAR buffer[BENCHMARK_JSON_BUFFER_SIZE];
+INT length;
+
+    length = snprintf(buffer, sizeof(buffer),
+                      "{\"temperature\":%.17g,\"humidity\":%.17g,\"sequence\":%d,\"status\":\"ok\"}",
+                      20.0 + (double)(index % 1000) / 8.0, 0.1 * (double)(index % 997), (INT)index);
+    if ((length < 0) || (length >= (INT)sizeof(buffer)))
+    {
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    return(nx_packet_data_append(packet_ptr, buffer, (ULONG)length, packet_ptr -> nx_packet_pool_owner, NX_NO_WAIT));
+}
+
+static INT benchmark_json_format_run(const CHAR *name, UINT (*format)(NX_PACKET *packet_ptr, ULONG index))
+{
+NX_PACKET *packet_ptr;
+ULONG64 bytes = 0;
+ULONG64 start;
+ULONG index;
+UINT status;
+
+    start = benchmark_time_get();
+    for (index = 0; index < benchmark_message_count; index++)
+    {
+        if ((status = nx_packet_allocate(&benchmark_pool, &packet_ptr, NX_IPv4_TCP_PACKET, NX_NO_WAIT)))
+        {
+            printf("Failed to allocate packet: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+
+        if ((status = format(packet_ptr, index)))
+        {
+            printf("Failed to format message %lu: error code = 0x%08x\r\n", (unsigned long)index, status);
+            nx_packet_release(packet_ptr);
+            return(1);
+        }
+
+        bytes += packet_ptr -> nx_packet_length;
+        nx_packet_release(packet_ptr);
+    }
+    benchmark_report(name, benchmark_message_count, bytes, benchmark_time_get() - start);
+
+    return(0);
+}
+
+static INT benchmark_json_entry(VOID)
+{
+    if (benchmark_json_format_run("json_writer_packet", benchmark_json_writer_format) ||
+        benchmark_json_format_run("snprintf_packet_append", benchmark_snprintf_format))
+    {
+        return(1);
+    }
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        benchmark_message_count = strtoul(argv[1], NX_NULL, 10);
+    }
+
+    printf("%lu telemetry messages\r\n", (unsigned long)benchmark_message_count);
+    benchmark_thread_run(benchmark_json_entry);
+
+    return(0);
+}
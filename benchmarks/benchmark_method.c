@@ -0,0 +1,223 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Direct method invocation latency: a handler registered by method name and dispatched from the receive path,
+   against a thread blocked in nx_azure_iot_hub_client_direct_method_message_receive() that compares the method
+   name and responds. Each invocation is one synthetic PUBLISH put on the MQTT receive queue, timed from the
+   receive callback to the handler, and to the return of the response call. The client is not connected, so
+   the response fails once it reaches the MQTT client, at the same point for both paths.
+
+   Hub client source is included to reach its static receive path. azure_iot is a static library, so its copy
+   of the hub client is not linked in.
+
+   Usage: benchmark_method [invocation_count]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark_common.h"
+#include "nx_azure_iot_hub_client.c"
+
+#define BENCHMARK_RESPONDER_STACK_SIZE          (16 * 1024)
+#define BENCHMARK_METHOD_REGISTERED             "reboot"
+#define BENCHMARK_METHOD_RECEIVED               "resume"
+#define BENCHMARK_TOPIC_REGISTERED              "$iothub/methods/POST/" BENCHMARK_METHOD_REGISTERED "/?$rid=1"
+#define BENCHMARK_TOPIC_RECEIVED                "$iothub/methods/POST/" BENCHMARK_METHOD_RECEIVED "/?$rid=1"
+#define BENCHMARK_PAYLOAD                       "{\"delay\":30}"
+
+static NX_AZURE_IOT_HUB_CLIENT benchmark_hub_client;
+static NX_AZURE_IOT_HUB_CLIENT_METHOD_HANDLER benchmark_method_handler;
+static TX_THREAD benchmark_responder_thread;
+static ULONG benchmark_responder_stack[BENCHMARK_RESPONDER_STACK_SIZE / sizeof(ULONG)];
+static TX_SEMAPHORE benchmark_response_semaphore;
+static ULONG benchmark_invocation_count = 100000;
+static ULONG64 benchmark_handler_time;
+static ULONG64 benchmark_response_time;
+static UINT benchmark_responder_status;
+
+static UINT benchmark_method_handler_callback(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, NX_PACKET *packet_ptr,
+                                              NX_AZURE_IOT_JSON_WRITER *response_writer_ptr, VOID *args)
+{
+    NX_PARAMETER_NOT_USED(hub_client_ptr);
+    NX_PARAMETER_NOT_USED(packet_ptr);
+    NX_PARAMETER_NOT_USED(response_writer_ptr);
+    NX_PARAMETER_NOT_USED(args);
+
+    benchmark_handler_time = benchmark_time_get();
+
+    return(200);
+}
+
+static VOID benchmark_responder_entry(ULONG parameter)
+{
+NX_PACKET *packet_ptr;
+UCHAR *method_name_ptr;
+USHORT method_name_length;
+VOID *context_ptr;
+USHORT context_length;
+UINT status;
+
+    NX_PARAMETER_NOT_USED(parameter);
+
+    for (;;)
+    {
+        status = nx_azure_iot_hub_client_direct_method_message_receive(&benchmark_hub_client,
+                                                                       &method_name_ptr, &method_name_length,
+                                                                       &context_ptr, &context_length,
+                                                                       &packet_ptr, NX_WAIT_FOREVER);
+        benchmark_handler_time = benchmark_time_get();
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            if ((method_name_length == sizeof(BENCHMARK_METHOD_RECEIVED) - 1) &&
+                (memcmp(method_name_ptr, BENCHMARK_METHOD_RECEIVED, method_name_length) == 0))
+            {
+
+                /* Fails with the client not connected, as dispatch of the registered handler does.  */
+                nx_azure_iot_hub_client_direct_method_message_response(&benchmark_hub_client, 200,
+                                                                       context_ptr, context_length,
+                                                                       NX_NULL, 0, NX_NO_WAIT);
+            }
+            else
+            {
+                status = NX_AZURE_IOT_NOT_FOUND;
+            }
+
+            nx_packet_release(packet_ptr);
+        }
+
+        benchmark_response_time = benchmark_time_get();
+        benchmark_responder_status = status;
+        tx_semaphore_put(&benchmark_response_semaphore);
+    }
+}
+
+static INT benchmark_method_run(const CHAR *dispatch_name, const CHAR *response_name, const CHAR *topic,
+                                UINT responder)
+{
+NXD_MQTT_CLIENT *client_ptr = &(benchmark_hub_client.nx_azure_iot_hub_client_resource.resource_mqtt);
+ULONG64 dispatch_elapsed = 0;
+ULONG64 response_elapsed = 0;
+ULONG64 start;
+ULONG index;
+UINT status;
+
+    for (index = 0; index < benchmark_invocation_count; index++)
+    {
+        if ((status = benchmark_publish_queue(&benchmark_hub_client, topic,
+                                              (const UCHAR *)BENCHMARK_PAYLOAD, sizeof(BENCHMARK_PAYLOAD) - 1)))
+        {
+            printf("Failed to queue PUBLISH: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+
+        benchmark_handler_time = 0;
+
+        /* MQTT client calls receive notify with its mutex held.  */
+        start = benchmark_time_get();
+        tx_mutex_get(client_ptr -> nxd_mqtt_client_mutex_ptr, TX_WAIT_FOREVER);
+        nx_azure_iot_hub_client_mqtt_receive_callback(client_ptr, 1);
+        tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+
+        if (responder)
+        {
+
+            /* Responder preempts this thread as soon as the mutex is released, and signals once it responded.  */
+            tx_semaphore_get(&benchmark_response_semaphore, TX_WAIT_FOREVER);
+            if (benchmark_responder_status)
+            {
+                printf("Failed to receive method: error code = 0x%08x\r\n", benchmark_responder_status);
+                return(1);
+            }
+        }
+        else
+        {
+            benchmark_response_time = benchmark_time_get();
+        }
+
+        if (benchmark_handler_time == 0)
+        {
+            printf("Method %lu was not handled\r\n", (unsigned long)index);
+            return(1);
+        }
+
+        dispatch_elapsed += benchmark_handler_time - start;
+        response_elapsed += benchmark_response_time - start;
+    }
+    benchmark_report(dispatch_name, benchmark_invocation_count, 0, dispatch_elapsed);
+    benchmark_report(response_name, benchmark_invocation_count, 0, response_elapsed);
+
+    return(0);
+}
+
+static INT benchmark_method_entry(VOID)
+{
+UINT status;
+
+    if (benchmark_hub_client_initialize(&benchmark_hub_client))
+    {
+        return(1);
+    }
+
+    /* Enable processing as nx_azure_iot_hub_client_direct_method_enable() does once subscribed.  */
+    benchmark_hub_client.nx_azure_iot_hub_client_direct_method_message.message_process =
+        nx_azure_iot_hub_client_direct_method_process;
+
+    if ((status = nx_azure_iot_hub_client_direct_method_handler_register(&benchmark_hub_client,
+                                                                         &benchmark_method_handler,
+                                                                         (const UCHAR *)BENCHMARK_METHOD_REGISTERED,
+                                                                         sizeof(BENCHMARK_METHOD_REGISTERED) - 1,
+                                                                         benchmark_method_handler_callback,
+                                                                         NX_NULL)))
+    {
+        printf("Failed to register method handler: error code = 0x%08x\r\n", status);
+        return(1);
+    }
+
+    if ((status = tx_semaphore_create(&benchmark_response_semaphore, "Benchmark Response", 0)))
+    {
+        printf("Failed to create semaphore: error code = 0x%08x\r\n", status);
+        return(1);
+    }
+
+    /* Responder blocks in receive before this call returns.  */
+    if ((status = tx_thread_create(&benchmark_responder_thread, "Benchmark Responder", benchmark_responder_entry, 0,
+                                   benchmark_responder_stack, BENCHMARK_RESPONDER_STACK_SIZE,
+                                   BENCHMARK_THREAD_PRIORITY - 1, BENCHMARK_THREAD_PRIORITY - 1,
+                                   TX_NO_TIME_SLICE, TX_AUTO_START)))
+    {
+        printf("Failed to create responder thread: error code = 0x%08x\r\n", status);
+        return(1);
+    }
+
+    if (benchmark_method_run("method_handler_dispatch", "method_handler_response", BENCHMARK_TOPIC_REGISTERED,
+                             NX_FALSE) ||
+        benchmark_method_run("method_receive_dispatch", "method_receive_response", BENCHMARK_TOPIC_RECEIVED,
+                             NX_TRUE))
+    {
+        return(1);
+    }
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        benchmark_invocation_count = strtoul(argv[1], NX_NULL, 10);
+    }
+
+    printf("%lu invocations, ns/op is mean latency from receive callback\r\n",
+           (unsigned long)benchmark_invocation_count);
+    benchmark_thread_run(benchmark_method_entry);
+
+    return(0);
+}
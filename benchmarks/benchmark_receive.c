@@ -0,0 +1,214 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Receive path of the hub client: topic classification alone, then the MQTT receive callback from the raw
+   PUBLISH to the message queued for the application, for C2D, direct method and twin messages and a mix of them.
+   PUBLISH packets are built ahead and put on the MQTT receive queue as if they had arrived, so only the callback
+   is timed. Queued messages are taken with the receive APIs between batches, untimed.
+
+   Hub client source is included to reach its static receive path. azure_iot is a static library, so its copy
+   of the hub client is not linked in.
+
+   Usage: benchmark_receive [message_count]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark_common.h"
+#include "nx_azure_iot_hub_client.c"
+
+#define BENCHMARK_RECEIVE_BATCH                 (16)
+#define BENCHMARK_TOPIC_C2D                     "devices/benchmark/messages/devicebound/" \
+                                                "%24.to=%2Fdevices%2Fbenchmark%2Fmessages%2FdeviceBound&unit=celsius"
+#define BENCHMARK_TOPIC_METHOD                  "$iothub/methods/POST/reboot/?$rid=1"
+#define BENCHMARK_TOPIC_TWIN                    "$iothub/twin/res/200/?$rid=2"
+#define BENCHMARK_PAYLOAD                       "{\"temperature\":20.5}"
+
+static NX_AZURE_IOT_HUB_CLIENT benchmark_hub_client;
+static ULONG benchmark_message_count = 100000;
+static const CHAR *benchmark_c2d_topics[] = { BENCHMARK_TOPIC_C2D };
+static const CHAR *benchmark_method_topics[] = { BENCHMARK_TOPIC_METHOD };
+static const CHAR *benchmark_twin_topics[] = { BENCHMARK_TOPIC_TWIN };
+static const CHAR *benchmark_mixed_topics[] = { BENCHMARK_TOPIC_C2D, BENCHMARK_TOPIC_METHOD, BENCHMARK_TOPIC_TWIN };
+
+static UINT benchmark_receive_count_get(VOID)
+{
+    return(benchmark_hub_client.nx_azure_iot_hub_client_c2d_message.message_count +
+           benchmark_hub_client.nx_azure_iot_hub_client_direct_method_message.message_count +
+           benchmark_hub_client.nx_azure_iot_hub_client_device_twin_message.message_count);
+}
+
+static VOID benchmark_receive_drain(VOID)
+{
+NX_PACKET *packet_ptr;
+UCHAR *method_name_ptr;
+USHORT method_name_length;
+VOID *context_ptr;
+USHORT context_length;
+
+    /* Every receive takes the head message, or releases it when it fails.  */
+    while (benchmark_hub_client.nx_azure_iot_hub_client_c2d_message.message_head)
+    {
+        if (nx_azure_iot_hub_client_cloud_message_receive(&benchmark_hub_client, &packet_ptr,
+                                                          NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS)
+        {
+            nx_packet_release(packet_ptr);
+        }
+    }
+
+    while (benchmark_hub_client.nx_azure_iot_hub_client_direct_method_message.message_head)
+    {
+        if (nx_azure_iot_hub_client_direct_method_message_receive(&benchmark_hub_client,
+                                                                  &method_name_ptr, &method_name_length,
+                                                                  &context_ptr, &context_length,
+                                                                  &packet_ptr, NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS)
+        {
+            nx_packet_release(packet_ptr);
+        }
+    }
+
+    while (benchmark_hub_client.nx_azure_iot_hub_client_device_twin_message.message_head)
+    {
+        if (nx_azure_iot_hub_client_device_twin_properties_receive(&benchmark_hub_client, &packet_ptr,
+                                                                   NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS)
+        {
+            nx_packet_release(packet_ptr);
+        }
+    }
+}
+
+static INT benchmark_classify_run(VOID)
+{
+NX_AZURE_IOT_HUB_CLIENT_RECEIVE_MESSAGE *message_ptr;
+USHORT topic_length[3];
+ULONG64 start;
+ULONG index;
+ULONG matched = 0;
+UINT topic;
+
+    for (topic = 0; topic < 3; topic++)
+    {
+        topic_length[topic] = (USHORT)strlen(benchmark_mixed_topics[topic]);
+    }
+
+    start = benchmark_time_get();
+    for (index = 0; index < benchmark_message_count; index++)
+    {
+        topic = (UINT)(index % 3);
+        message_ptr = nx_azure_iot_hub_client_topic_classify(&benchmark_hub_client,
+                                                             (const UCHAR *)benchmark_mixed_topics[topic],
+                                                             topic_length[topic]);
+        if (message_ptr)
+        {
+            matched++;
+        }
+    }
+    benchmark_report("topic_classify", benchmark_message_count, 0, benchmark_time_get() - start);
+
+    if (matched != benchmark_message_count)
+    {
+        printf("Failed to classify %lu topics\r\n", (unsigned long)(benchmark_message_count - matched));
+        return(1);
+    }
+
+    return(0);
+}
+
+static INT benchmark_receive_run(const CHAR *name, const CHAR **topics, UINT topic_count)
+{
+NXD_MQTT_CLIENT *client_ptr = &(benchmark_hub_client.nx_azure_iot_hub_client_resource.resource_mqtt);
+ULONG64 elapsed = 0;
+ULONG64 start;
+ULONG done;
+UINT batch;
+UINT index;
+UINT status;
+
+    for (done = 0; done < benchmark_message_count; done += batch)
+    {
+        batch = BENCHMARK_RECEIVE_BATCH;
+        if (batch > benchmark_message_count - done)
+        {
+            batch = (UINT)(benchmark_message_count - done);
+        }
+
+        for (index = 0; index < batch; index++)
+        {
+            if ((status = benchmark_publish_queue(&benchmark_hub_client, topics[(done + index) % topic_count],
+                                                  (const UCHAR *)BENCHMARK_PAYLOAD, sizeof(BENCHMARK_PAYLOAD) - 1)))
+            {
+                printf("Failed to queue PUBLISH: error code = 0x%08x\r\n", status);
+                return(1);
+            }
+        }
+
+        /* MQTT client calls receive notify with its mutex held.  */
+        start = benchmark_time_get();
+        tx_mutex_get(client_ptr -> nxd_mqtt_client_mutex_ptr, TX_WAIT_FOREVER);
+        nx_azure_iot_hub_client_mqtt_receive_callback(client_ptr, batch);
+        tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+        elapsed += benchmark_time_get() - start;
+
+        if (benchmark_receive_count_get() != batch)
+        {
+            printf("Failed to queue %u of %u messages\r\n", batch - benchmark_receive_count_get(), batch);
+            return(1);
+        }
+
+        benchmark_receive_drain();
+    }
+    benchmark_report(name, benchmark_message_count, 0, elapsed);
+
+    return(0);
+}
+
+static INT benchmark_receive_entry(VOID)
+{
+    if (benchmark_hub_client_initialize(&benchmark_hub_client))
+    {
+        return(1);
+    }
+
+    /* Enable processing as the enable APIs do once subscribed.  */
+    benchmark_hub_client.nx_azure_iot_hub_client_c2d_message.message_process =
+        nx_azure_iot_hub_client_c2d_process;
+    benchmark_hub_client.nx_azure_iot_hub_client_direct_method_message.message_process =
+        nx_azure_iot_hub_client_direct_method_process;
+    benchmark_hub_client.nx_azure_iot_hub_client_device_twin_message.message_process =
+        nx_azure_iot_hub_client_device_twin_process;
+    benchmark_hub_client.nx_azure_iot_hub_client_device_twin_desired_properties_message.message_process =
+        nx_azure_iot_hub_client_device_twin_process;
+
+    if (benchmark_classify_run() ||
+        benchmark_receive_run("receive_c2d", benchmark_c2d_topics, 1) ||
+        benchmark_receive_run("receive_method", benchmark_method_topics, 1) ||
+        benchmark_receive_run("receive_twin", benchmark_twin_topics, 1) ||
+        benchmark_receive_run("receive_mixed", benchmark_mixed_topics, 3))
+    {
+        return(1);
+    }
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        benchmark_message_count = strtoul(argv[1], NX_NULL, 10);
+    }
+
+    printf("%lu messages, %u per receive callback\r\n", (unsigned long)benchmark_message_count,
+           BENCHMARK_RECEIVE_BATCH);
+    benchmark_thread_run(benchmark_receive_entry);
+
+    return(0);
+}
@@ -0,0 +1,239 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Bytes and time per sample: time series block against a JSON array of [timestamp, value] pairs
+   written by the JSON writer, and decoding of the block with the reference decoder.
+   Samples are taken every 100 ms with 1 ms jitter on every 16th sample, for two kinds of values:
+   "step" holds a value for 8 samples and moves in quarters, "noisy" changes by hundredths on every sample.
+   Blocks are sized so that they never fill up, so nothing is sent.
+
+   Usage: benchmark_series [samples_per_block] [block_count]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark_common.h"
+#include "nx_azure_iot_json_writer.h"
+#include "nx_azure_iot_series.h"
+
+#define BENCHMARK_SERIES_SAMPLES_MAX            (4096)
+#define BENCHMARK_SERIES_BLOCK_SIZE             (NX_AZURE_IOT_SERIES_HEADER_SIZE + \
+                                                 (NX_AZURE_IOT_SERIES_SAMPLE_MAX_BITS * \
+                                                  (BENCHMARK_SERIES_SAMPLES_MAX + 1) + 7) / 8)
+
+static NX_AZURE_IOT_HUB_CLIENT benchmark_hub_client;
+static NX_AZURE_IOT_SERIES benchmark_series;
+static UCHAR benchmark_block[BENCHMARK_SERIES_BLOCK_SIZE];
+static UINT benchmark_timestamps[BENCHMARK_SERIES_SAMPLES_MAX];
+static double benchmark_values[BENCHMARK_SERIES_SAMPLES_MAX];
+static UINT benchmark_samples_per_block = 1000;
+static ULONG benchmark_block_count = 100;
+
+static VOID benchmark_samples_generate(UINT noisy)
+{
+UINT index;
+
+    for (index = 0; index < benchmark_samples_per_block; index++)
+    {
+        benchmark_timestamps[index] = index * 100 + (((index % 16) == 15) ? 1 : 0);
+        if (noisy)
+        {
+            benchmark_values[index] = (double)(2000 + ((index * 37) % 100)) / 100.0;
+        }
+        else
+        {
+            benchmark_values[index] = 20.0 + 0.25 * (double)((index / 8) % 16);
+        }
+    }
+}
+
+static INT benchmark_series_encode_run(const CHAR *name)
+{
+ULONG64 bytes = 0;
+ULONG64 start;
+ULONG block;
+UINT index;
+UINT status;
+
+    start = benchmark_time_get();
+    for (block = 0; block < benchmark_block_count; block++)
+    {
+        if ((status = nx_azure_iot_series_create(&benchmark_series, &benchmark_hub_client,
+                                                 (const UCHAR *)"benchmark", sizeof("benchmark") - 1,
+                                                 benchmark_block, sizeof(benchmark_block), 0)))
+        {
+            printf("Failed to create series: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+
+        for (index = 0; index < benchmark_samples_per_block; index++)
+        {
+            if ((status = nx_azure_iot_series_sample_add(&benchmark_series, benchmark_timestamps[index],
+                                                         benchmark_values[index], NX_NO_WAIT)))
+            {
+                printf("Failed to add sample: error code = 0x%08x\r\n", status);
+                return(1);
+            }
+        }
+
+        bytes += NX_AZURE_IOT_SERIES_HEADER_SIZE + ((benchmark_series.series_bit_offset + 7) >> 3);
+    }
+    benchmark_report(name, benchmark_block_count * benchmark_samples_per_block, bytes,
+                     benchmark_time_get() - start);
+
+    return(0);
+}
+
+static INT benchmark_series_decode_run(const CHAR *name)
+{
+NX_AZURE_IOT_SERIES_DECODER decoder;
+UINT block_size;
+UINT timestamp;
+double value;
+ULONG64 start;
+ULONG block;
+UINT index;
+UINT status;
+
+    /* Block of the last encode run is decoded, and checked once against the samples.  */
+    block_size = NX_AZURE_IOT_SERIES_HEADER_SIZE + ((benchmark_series.series_bit_offset + 7) >> 3);
+    benchmark_block[0] = NX_AZURE_IOT_SERIES_FORMAT;
+    benchmark_block[1] = (UCHAR)(benchmark_samples_per_block >> 8);
+    benchmark_block[2] = (UCHAR)(benchmark_samples_per_block);
+
+    start = benchmark_time_get();
+    for (block = 0; block < benchmark_block_count; block++)
+    {
+        if ((status = nx_azure_iot_series_decoder_init(&decoder, benchmark_block, block_size)))
+        {
+            printf("Failed to initialize decoder: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+
+        for (index = 0; index < benchmark_samples_per_block; index++)
+        {
+            if ((status = nx_azure_iot_series_decoder_next(&decoder, &timestamp, &value)) ||
+                ((block == 0) &&
+                 ((timestamp != benchmark_timestamps[index]) || (value != benchmark_values[index]))))
+            {
+                printf("Failed to decode sample %u: error code = 0x%08x\r\n", index, status);
+                return(1);
+            }
+        }
+    }
+    benchmark_report(name, benchmark_block_count * benchmark_samples_per_block, 0, benchmark_time_get() - start);
+
+    return(0);
+}
+
+static INT benchmark_json_array_run(const CHAR *name)
+{
+NX_AZURE_IOT_JSON_WRITER writer;
+NX_PACKET *packet_ptr;
+ULONG64 bytes = 0;
+ULONG64 start;
+ULONG block;
+UINT index;
+UINT status;
+
+    start = benchmark_time_get();
+    for (block = 0; block < benchmark_block_count; block++)
+    {
+        if ((status = nx_packet_allocate(&benchmark_pool, &packet_ptr, NX_IPv4_TCP_PACKET, NX_NO_WAIT)))
+        {
+            printf("Failed to allocate packet: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+
+        status = nx_azure_iot_json_writer_init(&writer, packet_ptr, NX_NO_WAIT);
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            status = nx_azure_iot_json_writer_append_begin_array(&writer);
+        }
+
+        for (index = 0; (status == NX_AZURE_IOT_SUCCESS) && (index < benchmark_samples_per_block); index++)
+        {
+            if ((status = nx_azure_iot_json_writer_append_begin_array(&writer)) ||
+                (status = nx_azure_iot_json_writer_append_int32(&writer, (INT)benchmark_timestamps[index])) ||
+                (status = nx_azure_iot_json_writer_append_double(&writer, benchmark_values[index])))
+            {
+                break;
+            }
+
+            status = nx_azure_iot_json_writer_append_end_array(&writer);
+        }
+
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            status = nx_azure_iot_json_writer_append_end_array(&writer);
+        }
+
+        if (status)
+        {
+            printf("Failed to write JSON array: error code = 0x%08x\r\n", status);
+            nx_packet_release(packet_ptr);
+            return(1);
+        }
+
+        bytes += packet_ptr -> nx_packet_length;
+        nx_packet_release(packet_ptr);
+    }
+    benchmark_report(name, benchmark_block_count * benchmark_samples_per_block, bytes,
+                     benchmark_time_get() - start);
+
+    return(0);
+}
+
+static INT benchmark_series_entry(VOID)
+{
+    benchmark_samples_generate(NX_FALSE);
+    if (benchmark_series_encode_run("series_step_add") ||
+        benchmark_series_decode_run("series_step_decode") ||
+        benchmark_json_array_run("json_array_step_write"))
+    {
+        return(1);
+    }
+
+    benchmark_samples_generate(NX_TRUE);
+    if (benchmark_series_encode_run("series_noisy_add") ||
+        benchmark_series_decode_run("series_noisy_decode") ||
+        benchmark_json_array_run("json_array_noisy_write"))
+    {
+        return(1);
+    }
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        benchmark_samples_per_block = (UINT)strtoul(argv[1], NX_NULL, 10);
+    }
+
+    if (argc > 2)
+    {
+        benchmark_block_count = strtoul(argv[2], NX_NULL, 10);
+    }
+
+    if ((benchmark_samples_per_block == 0) || (benchmark_samples_per_block > BENCHMARK_SERIES_SAMPLES_MAX))
+    {
+        printf("Samples per block must be between 1 and %u\r\n", BENCHMARK_SERIES_SAMPLES_MAX);
+        return(1);
+    }
+
+    printf("%lu blocks of %u samples, B/op is bytes per sample\r\n",
+           (unsigned long)benchmark_block_count, benchmark_samples_per_block);
+    benchmark_thread_run(benchmark_series_entry);
+
+    return(0);
+}
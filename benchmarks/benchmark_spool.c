@@ -0,0 +1,175 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Spool throughput with the file backend: append (one sync per record), recovery on open
+   and replay (peek, read, advance, commit every BENCHMARK_SPOOL_COMMIT_INTERVAL records).
+
+   Usage: benchmark_spool [directory] [record_count] [record_size]  */
+
+/* Needed for mkdtemp.  */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif /* _POSIX_C_SOURCE */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchmark_common.h"
+#include "nx_azure_iot_spool_file.h"
+
+#ifndef BENCHMARK_SPOOL_SEGMENT_SIZE
+#define BENCHMARK_SPOOL_SEGMENT_SIZE            (64 * 1024)
+#endif /* BENCHMARK_SPOOL_SEGMENT_SIZE */
+
+#ifndef BENCHMARK_SPOOL_SEGMENT_COUNT
+#define BENCHMARK_SPOOL_SEGMENT_COUNT           (64)
+#endif /* BENCHMARK_SPOOL_SEGMENT_COUNT */
+
+#ifndef BENCHMARK_SPOOL_COMMIT_INTERVAL
+#define BENCHMARK_SPOOL_COMMIT_INTERVAL         (16)
+#endif /* BENCHMARK_SPOOL_COMMIT_INTERVAL */
+
+#define BENCHMARK_SPOOL_RECORD_SIZE_MAX         (4096)
+
+static NX_AZURE_IOT_SPOOL benchmark_spool;
+static NX_AZURE_IOT_SPOOL_FILE benchmark_spool_file;
+static UCHAR benchmark_record[BENCHMARK_SPOOL_RECORD_SIZE_MAX];
+
+static UINT benchmark_spool_open(const CHAR *directory)
+{
+UINT status;
+
+    if ((status = nx_azure_iot_spool_file_initialize(&benchmark_spool_file, directory)))
+    {
+        printf("Failed to initialize spool file backend: error code = 0x%08x\r\n", status);
+        return(status);
+    }
+
+    if ((status = nx_azure_iot_spool_open(&benchmark_spool, &nx_azure_iot_spool_file_backend,
+                                          &benchmark_spool_file, BENCHMARK_SPOOL_SEGMENT_SIZE,
+                                          BENCHMARK_SPOOL_SEGMENT_COUNT)))
+    {
+        printf("Failed to open spool: error code = 0x%08x\r\n", status);
+        nx_azure_iot_spool_file_deinitialize(&benchmark_spool_file);
+    }
+
+    return(status);
+}
+
+int main(int argc, char **argv)
+{
+CHAR directory_template[] = "/tmp/benchmark_spool_XXXXXX";
+const CHAR *directory = NX_NULL;
+ULONG record_count = 2000;
+UINT record_size = 256;
+NX_AZURE_IOT_IOVEC vec;
+NX_AZURE_IOT_SPOOL_POSITION position;
+ULONG record_length;
+ULONG count;
+ULONG64 start;
+UINT status;
+
+    if (argc > 1)
+    {
+        directory = argv[1];
+    }
+    else if ((directory = mkdtemp(directory_template)) == NX_NULL)
+    {
+        printf("Failed to create spool directory\r\n");
+        return(1);
+    }
+
+    if (argc > 2)
+    {
+        record_count = strtoul(argv[2], NX_NULL, 10);
+    }
+
+    if (argc > 3)
+    {
+        record_size = (UINT)strtoul(argv[3], NX_NULL, 10);
+    }
+
+    if ((record_size == 0) || (record_size > BENCHMARK_SPOOL_RECORD_SIZE_MAX) ||
+        ((ULONG64)record_count * (record_size + NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE) >
+         (ULONG64)BENCHMARK_SPOOL_SEGMENT_SIZE * (BENCHMARK_SPOOL_SEGMENT_COUNT - 1) / 2))
+    {
+        printf("Record count or size does not fit the spool\r\n");
+        return(1);
+    }
+
+    printf("Spool in %s, %lu records of %u bytes\r\n", directory, (unsigned long)record_count, record_size);
+    memset(benchmark_record, 0xA5, sizeof(benchmark_record));
+    vec.iovec_base = benchmark_record;
+    vec.iovec_length = record_size;
+
+    if (benchmark_spool_open(directory))
+    {
+        return(1);
+    }
+
+    /* Append.  */
+    start = benchmark_time_get();
+    for (count = 0; count < record_count; count++)
+    {
+        if ((status = nx_azure_iot_spool_append(&benchmark_spool, &vec, 1)))
+        {
+            printf("Failed to append record: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+    }
+    benchmark_report("spool_append", record_count, (ULONG64)record_count * record_size,
+                     benchmark_time_get() - start);
+    nx_azure_iot_spool_file_deinitialize(&benchmark_spool_file);
+
+    /* Recover write position from storage.  */
+    start = benchmark_time_get();
+    if (benchmark_spool_open(directory))
+    {
+        return(1);
+    }
+    benchmark_report("spool_open_recover", 1, 0, benchmark_time_get() - start);
+
+    /* Replay.  */
+    count = 0;
+    start = benchmark_time_get();
+    while (nx_azure_iot_spool_peek(&benchmark_spool, &record_length) == NX_AZURE_IOT_SUCCESS)
+    {
+        if ((record_length > sizeof(benchmark_record)) ||
+            (status = nx_azure_iot_spool_record_read(&benchmark_spool, 0, benchmark_record, (UINT)record_length)) ||
+            (status = nx_azure_iot_spool_advance(&benchmark_spool, &position)))
+        {
+            printf("Failed to replay record %lu\r\n", (unsigned long)count);
+            return(1);
+        }
+
+        if ((++count % BENCHMARK_SPOOL_COMMIT_INTERVAL) == 0)
+        {
+            nx_azure_iot_spool_commit(&benchmark_spool, &position);
+        }
+    }
+
+    if (count % BENCHMARK_SPOOL_COMMIT_INTERVAL)
+    {
+        nx_azure_iot_spool_commit(&benchmark_spool, &position);
+    }
+    benchmark_report("spool_replay", count, (ULONG64)count * record_size, benchmark_time_get() - start);
+
+    if (count != record_count)
+    {
+        printf("Replayed %lu of %lu records\r\n", (unsigned long)count, (unsigned long)record_count);
+        return(1);
+    }
+
+    nx_azure_iot_spool_file_deinitialize(&benchmark_spool_file);
+
+    return(0);
+}
@@ -0,0 +1,181 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Wake latency of threads blocked in nx_azure_iot_hub_client_cloud_message_receive(), with 1, 16 and 64 of them
+   waiting. Each message is one synthetic PUBLISH put on the MQTT receive queue, timed from the receive callback
+   to the return of the receive call in the thread that takes it. The oldest waiter takes the message and waits
+   again at the back, so the number of waiters stays the same during a run.
+
+   Hub client source is included to reach its static receive path. azure_iot is a static library, so its copy
+   of the hub client is not linked in.
+
+   Usage: benchmark_wake [message_count]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark_common.h"
+#include "nx_azure_iot_hub_client.c"
+
+#define BENCHMARK_WAITER_MAX                    (64)
+#define BENCHMARK_WAITER_STACK_SIZE             (8 * 1024)
+#define BENCHMARK_TOPIC_C2D                     "devices/benchmark/messages/devicebound/" \
+                                                "%24.to=%2Fdevices%2Fbenchmark%2Fmessages%2FdeviceBound"
+#define BENCHMARK_PAYLOAD                       "{\"setpoint\":21.5}"
+
+static NX_AZURE_IOT_HUB_CLIENT benchmark_hub_client;
+static TX_THREAD benchmark_waiter_thread[BENCHMARK_WAITER_MAX];
+static ULONG benchmark_waiter_stack[BENCHMARK_WAITER_MAX][BENCHMARK_WAITER_STACK_SIZE / sizeof(ULONG)];
+static UINT benchmark_waiter_count;
+static TX_SEMAPHORE benchmark_wake_semaphore;
+static ULONG benchmark_message_count = 10000;
+static ULONG64 benchmark_wake_time;
+static UINT benchmark_wake_status;
+
+static VOID benchmark_waiter_entry(ULONG parameter)
+{
+NX_PACKET *packet_ptr;
+UINT status;
+
+    NX_PARAMETER_NOT_USED(parameter);
+
+    for (;;)
+    {
+        status = nx_azure_iot_hub_client_cloud_message_receive(&benchmark_hub_client, &packet_ptr,
+                                                               NX_WAIT_FOREVER);
+        benchmark_wake_time = benchmark_time_get();
+        if (status == NX_AZURE_IOT_SUCCESS)
+        {
+            nx_packet_release(packet_ptr);
+        }
+
+        benchmark_wake_status = status;
+        tx_semaphore_put(&benchmark_wake_semaphore);
+    }
+}
+
+static UINT benchmark_waiter_count_get(VOID)
+{
+NX_AZURE_IOT_THREAD *thread_list_ptr;
+UINT count = 0;
+
+    for (thread_list_ptr = benchmark_hub_client.nx_azure_iot_hub_client_c2d_message.message_waiter_head;
+         thread_list_ptr;
+         thread_list_ptr = thread_list_ptr -> thread_next)
+    {
+        count++;
+    }
+
+    return(count);
+}
+
+static INT benchmark_wake_run(UINT waiters)
+{
+NXD_MQTT_CLIENT *client_ptr = &(benchmark_hub_client.nx_azure_iot_hub_client_resource.resource_mqtt);
+CHAR name[32];
+ULONG64 elapsed = 0;
+ULONG64 start;
+ULONG index;
+UINT status;
+
+    /* Waiters run at higher priority, so each one blocks in receive before its creation returns.  */
+    for (; benchmark_waiter_count < waiters; benchmark_waiter_count++)
+    {
+        if ((status = tx_thread_create(&benchmark_waiter_thread[benchmark_waiter_count], "Benchmark Waiter",
+                                       benchmark_waiter_entry, benchmark_waiter_count,
+                                       benchmark_waiter_stack[benchmark_waiter_count], BENCHMARK_WAITER_STACK_SIZE,
+                                       BENCHMARK_THREAD_PRIORITY - 1, BENCHMARK_THREAD_PRIORITY - 1,
+                                       TX_NO_TIME_SLICE, TX_AUTO_START)))
+        {
+            printf("Failed to create waiter thread: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+    }
+
+    if (benchmark_waiter_count_get() != waiters)
+    {
+        printf("%u of %u waiters are blocked\r\n", benchmark_waiter_count_get(), waiters);
+        return(1);
+    }
+
+    for (index = 0; index < benchmark_message_count; index++)
+    {
+        if ((status = benchmark_publish_queue(&benchmark_hub_client, BENCHMARK_TOPIC_C2D,
+                                              (const UCHAR *)BENCHMARK_PAYLOAD, sizeof(BENCHMARK_PAYLOAD) - 1)))
+        {
+            printf("Failed to queue PUBLISH: error code = 0x%08x\r\n", status);
+            return(1);
+        }
+
+        /* MQTT client calls receive notify with its mutex held. Woken waiter preempts this thread once the
+           mutex is released, and signals after it is blocked again.  */
+        start = benchmark_time_get();
+        tx_mutex_get(client_ptr -> nxd_mqtt_client_mutex_ptr, TX_WAIT_FOREVER);
+        nx_azure_iot_hub_client_mqtt_receive_callback(client_ptr, 1);
+        tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+
+        tx_semaphore_get(&benchmark_wake_semaphore, TX_WAIT_FOREVER);
+        if (benchmark_wake_status)
+        {
+            printf("Failed to receive message: error code = 0x%08x\r\n", benchmark_wake_status);
+            return(1);
+        }
+
+        elapsed += benchmark_wake_time - start;
+    }
+
+    snprintf(name, sizeof(name), "c2d_wake_%u_waiters", waiters);
+    benchmark_report(name, benchmark_message_count, 0, elapsed);
+
+    return(0);
+}
+
+static INT benchmark_wake_entry(VOID)
+{
+UINT status;
+
+    if (benchmark_hub_client_initialize(&benchmark_hub_client))
+    {
+        return(1);
+    }
+
+    /* Enable processing as nx_azure_iot_hub_client_cloud_message_enable() does once subscribed.  */
+    benchmark_hub_client.nx_azure_iot_hub_client_c2d_message.message_process = nx_azure_iot_hub_client_c2d_process;
+
+    if ((status = tx_semaphore_create(&benchmark_wake_semaphore, "Benchmark Wake", 0)))
+    {
+        printf("Failed to create semaphore: error code = 0x%08x\r\n", status);
+        return(1);
+    }
+
+    if (benchmark_wake_run(1) ||
+        benchmark_wake_run(16) ||
+        benchmark_wake_run(BENCHMARK_WAITER_MAX))
+    {
+        return(1);
+    }
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        benchmark_message_count = strtoul(argv[1], NX_NULL, 10);
+    }
+
+    printf("%lu messages per run, ns/op is mean latency from receive callback\r\n",
+           (unsigned long)benchmark_message_count);
+    benchmark_thread_run(benchmark_wake_entry);
+
+    return(0);
+}
@@ -98,11 +98,15 @@ static void sample_device_twin_thread_entry(ULONG parameter);
 
 static VOID printf_packet(NX_PACKET *packet_ptr)
 {
-    while (packet_ptr != NX_NULL)
+NX_AZURE_IOT_PACKET_CURSOR cursor;
+UCHAR *data_ptr;
+UINT length;
+
+    nx_azure_iot_packet_cursor_init(&cursor, packet_ptr);
+    while (nx_azure_iot_packet_cursor_span_get(&cursor, &data_ptr, &length) == NX_AZURE_IOT_SUCCESS)
     {
-        printf("%.*s", (INT)(packet_ptr -> nx_packet_append_ptr - packet_ptr -> nx_packet_prepend_ptr),
-               (CHAR *)packet_ptr -> nx_packet_prepend_ptr);
-        packet_ptr = packet_ptr -> nx_packet_next;
+        printf("%.*s", (INT)length, (CHAR *)data_ptr);
+        nx_azure_iot_packet_cursor_skip(&cursor, length);
     }
 }
 
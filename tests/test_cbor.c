@@ -0,0 +1,310 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* CBOR round trip: integers and doubles decode as the value encoded, in the smallest encoding, and a document
+   chained over several packets decodes item by item, including skip of nested content and truncated data.  */
+
+#include <float.h>
+#include <limits.h>
+#include <string.h>
+
+#include "test_common.h"
+#include "nx_azure_iot_cbor.h"
+
+#define TEST_RANDOM_COUNT                       (100000)
+#define TEST_ARRAY_COUNT                        (400)
+#define TEST_DOCUMENT_SIZE                      (TEST_ARRAY_COUNT * 9 + 256)
+
+static UCHAR test_document[TEST_DOCUMENT_SIZE];
+static ULONG64 test_random_state = 0x853C49E6748FEA9BULL;
+
+/* xorshift64*, so runs are repeatable.  */
+static ULONG64 test_random_get(VOID)
+{
+    test_random_state ^= test_random_state >> 12;
+    test_random_state ^= test_random_state << 25;
+    test_random_state ^= test_random_state >> 27;
+
+    return(test_random_state * 0x2545F4914F6CDD1DULL);
+}
+
+/* Encode one item with append in a packet of its own, then decode it back with the packet decoder.  */
+static INT test_item_round_trip(INT int32_value, double double_value, UINT is_double,
+                                NX_AZURE_IOT_CBOR_ITEM *item_ptr, UINT *length_ptr)
+{
+NX_AZURE_IOT_CBOR_ENCODER encoder;
+NX_AZURE_IOT_CBOR_DECODER decoder;
+NX_PACKET *packet_ptr;
+
+    TEST_ASSERT(nx_packet_allocate(&test_pool, &packet_ptr, 0, NX_NO_WAIT) == NX_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_init(&encoder, packet_ptr, NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS);
+    if (is_double)
+    {
+        TEST_ASSERT(nx_azure_iot_cbor_encoder_append_double(&encoder, double_value) == NX_AZURE_IOT_SUCCESS);
+    }
+    else
+    {
+        TEST_ASSERT(nx_azure_iot_cbor_encoder_append_int32(&encoder, int32_value) == NX_AZURE_IOT_SUCCESS);
+    }
+
+    *length_ptr = nx_azure_iot_cbor_encoder_length_get(&encoder);
+    TEST_ASSERT(packet_ptr -> nx_packet_length == *length_ptr);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_packet_init(&decoder, packet_ptr) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, item_ptr) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(decoder.cbor_decoder_offset == *length_ptr);
+    nx_packet_release(packet_ptr);
+
+    return(0);
+}
+
+static INT test_int32_check(INT value)
+{
+NX_AZURE_IOT_CBOR_ITEM item;
+UINT length;
+UINT argument;
+INT decoded;
+
+    TEST_ASSERT(test_item_round_trip(value, 0.0, NX_FALSE, &item, &length) == 0);
+    TEST_ASSERT(nx_azure_iot_cbor_item_int32_get(&item, &decoded) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(decoded == value);
+
+    /* Argument is the value, or -1 - value for negative ones, in the fewest bytes.  */
+    argument = (value < 0) ? (UINT)(-1 - value) : (UINT)value;
+    TEST_ASSERT(length == ((argument < 24) ? 1 : (argument < 0x100) ? 2 : (argument < 0x10000) ? 3 : 5));
+
+    return(0);
+}
+
+static INT test_double_check(double value, UINT expected_length)
+{
+NX_AZURE_IOT_CBOR_ITEM item;
+UINT length;
+
+    TEST_ASSERT(test_item_round_trip(0, value, NX_TRUE, &item, &length) == 0);
+    TEST_ASSERT(item.item_type == NX_AZURE_IOT_CBOR_TYPE_FLOAT);
+
+    /* NaN payload is not kept, others are compared by bits so the sign of zero is checked too.  */
+    if (value != value)
+    {
+        TEST_ASSERT(item.item_float != item.item_float);
+        TEST_ASSERT(length == 3);
+        return(0);
+    }
+
+    if (memcmp(&item.item_float, &value, sizeof(value)) != 0)
+    {
+        printf("%.17g decoded as %.17g\r\n", value, item.item_float);
+        return(1);
+    }
+
+    /* Half, single or double precision, whichever holds the value exactly.  */
+    if (expected_length == 0)
+    {
+        expected_length = ((double)(float)value == value) ? 5 : 9;
+        TEST_ASSERT((length == expected_length) || ((length == 3) && (expected_length == 5)));
+    }
+    else
+    {
+        TEST_ASSERT(length == expected_length);
+    }
+
+    return(0);
+}
+
+static INT test_number_round_trip(VOID)
+{
+static const INT int32_values[] = { 0, 1, 23, 24, 255, 256, 65535, 65536, INT_MAX,
+                                    -1, -24, -25, -256, -257, -65536, -65537, INT_MIN };
+ULONG64 bits;
+double value;
+UINT index;
+
+    for (index = 0; index < sizeof(int32_values) / sizeof(int32_values[0]); index++)
+    {
+        TEST_ASSERT(test_int32_check(int32_values[index]) == 0);
+    }
+
+    for (index = 0; index < TEST_RANDOM_COUNT; index++)
+    {
+        TEST_ASSERT(test_int32_check((INT)(test_random_get() >> 32) >> (index & 31)) == 0);
+    }
+
+    /* Half precision: zeros, normals, largest, smallest subnormal, infinity and NaN.  */
+    TEST_ASSERT(test_double_check(0.0, 3) == 0);
+    TEST_ASSERT(test_double_check(-0.0, 3) == 0);
+    TEST_ASSERT(test_double_check(1.0, 3) == 0);
+    TEST_ASSERT(test_double_check(-1.5, 3) == 0);
+    TEST_ASSERT(test_double_check(65504.0, 3) == 0);
+    TEST_ASSERT(test_double_check(0.00006103515625, 3) == 0);
+    TEST_ASSERT(test_double_check(0.000000059604644775390625, 3) == 0);
+    value = DBL_MAX;
+    value *= 2.0;
+    TEST_ASSERT(test_double_check(value, 3) == 0);
+    TEST_ASSERT(test_double_check(-value, 3) == 0);
+    TEST_ASSERT(test_double_check(value - value, 3) == 0);
+
+    /* Single and double precision.  */
+    TEST_ASSERT(test_double_check(65520.0, 5) == 0);
+    TEST_ASSERT(test_double_check(0.000000029802322387695312, 5) == 0);
+    TEST_ASSERT(test_double_check(100000.0, 5) == 0);
+    TEST_ASSERT(test_double_check(FLT_MAX, 5) == 0);
+    TEST_ASSERT(test_double_check(0.1, 9) == 0);
+    TEST_ASSERT(test_double_check(DBL_MAX, 9) == 0);
+    TEST_ASSERT(test_double_check(5e-324, 9) == 0);
+
+    /* Random bit patterns, and random singles that must not take 9 bytes.  */
+    for (index = 0; index < TEST_RANDOM_COUNT; index++)
+    {
+        bits = test_random_get();
+        memcpy(&value, &bits, sizeof(value));
+        TEST_ASSERT(test_double_check(value, 0) == 0);
+        TEST_ASSERT(test_double_check((double)(float)value, 0) == 0);
+    }
+
+    return(0);
+}
+
+static INT test_document_round_trip(VOID)
+{
+static const UCHAR raw[] = { 0x00, 0xFF, 0x10 };
+NX_AZURE_IOT_CBOR_ENCODER encoder;
+NX_AZURE_IOT_CBOR_DECODER decoder;
+NX_AZURE_IOT_CBOR_ITEM item;
+NX_PACKET *packet_ptr;
+ULONG document_length;
+ULONG64 random_state;
+UINT index;
+INT value;
+
+    /* { "id": -7, "raw": h'00FF10', "samples": [_ ... ], "nested": [[1, {}], 2], "ok": true, "none": null }  */
+    TEST_ASSERT(nx_packet_allocate(&test_pool, &packet_ptr, 0, NX_NO_WAIT) == NX_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_init(&encoder, packet_ptr, NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_map(&encoder, 6) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"id", 2) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_int32(&encoder, -7) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"raw", 3) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_bytes(&encoder, raw, sizeof(raw)) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"samples",
+                                                      7) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_array(&encoder,
+                                                       NX_AZURE_IOT_CBOR_INDEFINITE) == NX_AZURE_IOT_SUCCESS);
+
+    /* Enough samples that the document is chained over several packets.  */
+    random_state = test_random_state;
+    for (index = 0; index < TEST_ARRAY_COUNT; index++)
+    {
+        TEST_ASSERT(nx_azure_iot_cbor_encoder_append_double(&encoder,
+                                                            (double)(test_random_get() >> 11)) ==
+                    NX_AZURE_IOT_SUCCESS);
+    }
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_break(&encoder) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"nested",
+                                                      6) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_array(&encoder, 2) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_array(&encoder, 2) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_int32(&encoder, 1) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_map(&encoder, 0) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_int32(&encoder, 2) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"ok", 2) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_bool(&encoder, NX_TRUE) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_text(&encoder, (const UCHAR *)"none",
+                                                      4) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_encoder_append_null(&encoder) == NX_AZURE_IOT_SUCCESS);
+
+    TEST_ASSERT(packet_ptr -> nx_packet_next != NX_NULL);
+    TEST_ASSERT(packet_ptr -> nx_packet_length == nx_azure_iot_cbor_encoder_length_get(&encoder));
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_packet_init(&decoder,
+                                                      packet_ptr) == NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    TEST_ASSERT(nx_packet_data_extract_offset(packet_ptr, 0, test_document, sizeof(test_document),
+                                              &document_length) == NX_SUCCESS);
+    TEST_ASSERT(document_length == packet_ptr -> nx_packet_length);
+    nx_packet_release(packet_ptr);
+
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_init(&decoder, test_document,
+                                               (UINT)document_length) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT((item.item_type == NX_AZURE_IOT_CBOR_TYPE_MAP) && (item.item_value == 6));
+
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT((item.item_type == NX_AZURE_IOT_CBOR_TYPE_TEXT) && (item.item_length == 2) &&
+                (memcmp(item.item_data_ptr, "id", 2) == 0));
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_item_int32_get(&item, &value) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(value == -7);
+
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT((item.item_type == NX_AZURE_IOT_CBOR_TYPE_BYTES) && (item.item_length == sizeof(raw)) &&
+                (memcmp(item.item_data_ptr, raw, sizeof(raw)) == 0));
+    TEST_ASSERT(nx_azure_iot_cbor_item_int32_get(&item, &value) == NX_AZURE_IOT_INVALID_PARAMETER);
+
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT((item.item_type == NX_AZURE_IOT_CBOR_TYPE_ARRAY) &&
+                (item.item_value == NX_AZURE_IOT_CBOR_INDEFINITE));
+    test_random_state = random_state;
+    for (index = 0; index < TEST_ARRAY_COUNT; index++)
+    {
+        TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+        TEST_ASSERT((item.item_type == NX_AZURE_IOT_CBOR_TYPE_FLOAT) &&
+                    (item.item_float == (double)(test_random_get() >> 11)));
+    }
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(item.item_type == NX_AZURE_IOT_CBOR_TYPE_BREAK);
+
+    /* Nested content is skipped whole, so the next item is the following key.  */
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT((item.item_type == NX_AZURE_IOT_CBOR_TYPE_ARRAY) && (item.item_value == 2));
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_skip(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT((item.item_type == NX_AZURE_IOT_CBOR_TYPE_TEXT) && (item.item_length == 2) &&
+                (memcmp(item.item_data_ptr, "ok", 2) == 0));
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT((item.item_type == NX_AZURE_IOT_CBOR_TYPE_BOOL) && item.item_bool);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(item.item_type == NX_AZURE_IOT_CBOR_TYPE_NULL);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_NOT_FOUND);
+
+    /* Skipping the whole document stops at its end. Cut anywhere inside a sample, it fails.  */
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_init(&decoder, test_document,
+                                               (UINT)document_length) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_skip(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(decoder.cbor_decoder_offset == document_length);
+
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_init(&decoder, test_document,
+                                               (UINT)document_length / 2) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_next(&decoder, &item) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_cbor_decoder_skip(&decoder, &item) == NX_AZURE_IOT_INVALID_PACKET);
+
+    return(0);
+}
+
+static INT test_cbor_entry(VOID)
+{
+    TEST_ASSERT(test_number_round_trip() == 0);
+    TEST_ASSERT(test_document_round_trip() == 0);
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    NX_PARAMETER_NOT_USED(argc);
+    NX_PARAMETER_NOT_USED(argv);
+
+    test_thread_run(test_cbor_entry);
+
+    return(0);
+}
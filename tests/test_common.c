@@ -0,0 +1,366 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_common.h"
+
+#define TEST_THREAD_STACK_SIZE                  (64 * 1024)
+#define TEST_POOL_SIZE                          ((TEST_PACKET_SIZE + sizeof(NX_PACKET)) * TEST_PACKET_COUNT)
+#define TEST_IP_STACK_SIZE                      (4096)
+#define TEST_CLOUD_STACK_SIZE                   (4096)
+#define TEST_METADATA_BUFFER_SIZE               (4096)
+#define TEST_NETWORK_MTU                        (1500)
+#define TEST_HUB_HOST_NAME                      "test.azure-devices.net"
+#define TEST_HUB_DEVICE_ID                      "test"
+
+NX_PACKET_POOL test_pool;
+
+static INT (*test_entry)(VOID);
+static TX_THREAD test_thread;
+static ULONG test_thread_stack[TEST_THREAD_STACK_SIZE / sizeof(ULONG)];
+static ULONG test_pool_area[TEST_POOL_SIZE / sizeof(ULONG) + 1];
+static NX_IP test_ip;
+static NX_DNS test_dns;
+static NX_AZURE_IOT test_azure_iot;
+static UINT test_azure_iot_created;
+static ULONG test_ip_stack[TEST_IP_STACK_SIZE / sizeof(ULONG)];
+static ULONG test_cloud_stack[TEST_CLOUD_STACK_SIZE / sizeof(ULONG)];
+static UCHAR test_metadata_buffer[TEST_METADATA_BUFFER_SIZE];
+
+static UINT test_spool_ram_read(VOID *context, UINT segment, ULONG offset, UCHAR *buffer, UINT size)
+{
+TEST_SPOOL_RAM *ram_ptr = (TEST_SPOOL_RAM *)context;
+
+    if ((offset + size) > ram_ptr -> segment_length[segment])
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    memcpy(buffer, &(ram_ptr -> segment[segment][offset]), size);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT test_spool_ram_write(VOID *context, UINT segment, ULONG offset, const UCHAR *data, UINT size)
+{
+TEST_SPOOL_RAM *ram_ptr = (TEST_SPOOL_RAM *)context;
+
+    if ((offset + size) > TEST_SPOOL_SEGMENT_SIZE)
+    {
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    memcpy(&(ram_ptr -> segment[segment][offset]), data, size);
+    if (ram_ptr -> segment_length[segment] < (offset + size))
+    {
+        ram_ptr -> segment_length[segment] = offset + size;
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT test_spool_ram_sync(VOID *context, UINT segment)
+{
+    NX_PARAMETER_NOT_USED(context);
+    NX_PARAMETER_NOT_USED(segment);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT test_spool_ram_erase(VOID *context, UINT segment)
+{
+TEST_SPOOL_RAM *ram_ptr = (TEST_SPOOL_RAM *)context;
+
+    memset(ram_ptr -> segment[segment], 0xFF, TEST_SPOOL_SEGMENT_SIZE);
+    ram_ptr -> segment_length[segment] = 0;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT test_spool_ram_index_read(VOID *context, UCHAR *buffer, UINT size)
+{
+TEST_SPOOL_RAM *ram_ptr = (TEST_SPOOL_RAM *)context;
+
+    if (size > ram_ptr -> index_length)
+    {
+        return(NX_AZURE_IOT_NOT_FOUND);
+    }
+
+    memcpy(buffer, ram_ptr -> index, size);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static UINT test_spool_ram_index_write(VOID *context, const UCHAR *data, UINT size)
+{
+TEST_SPOOL_RAM *ram_ptr = (TEST_SPOOL_RAM *)context;
+
+    if (size > sizeof(ram_ptr -> index))
+    {
+        return(NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    }
+
+    memcpy(ram_ptr -> index, data, size);
+    ram_ptr -> index_length = size;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+const NX_AZURE_IOT_SPOOL_BACKEND test_spool_ram_backend =
+{
+    test_spool_ram_read,
+    test_spool_ram_write,
+    test_spool_ram_sync,
+    test_spool_ram_erase,
+    test_spool_ram_index_read,
+    test_spool_ram_index_write
+};
+
+static VOID test_thread_entry(ULONG parameter)
+{
+    NX_PARAMETER_NOT_USED(parameter);
+
+    exit(test_entry());
+}
+
+VOID tx_application_define(VOID *first_unused_memory)
+{
+UINT status;
+
+    NX_PARAMETER_NOT_USED(first_unused_memory);
+
+    nx_system_initialize();
+
+    if ((status = nx_packet_pool_create(&test_pool, "Test Packet Pool", TEST_PACKET_SIZE,
+                                        test_pool_area, sizeof(test_pool_area))))
+    {
+        printf("nx_packet_pool_create fail: %u\r\n", status);
+        exit(1);
+    }
+
+    if ((status = tx_thread_create(&test_thread, "Test Thread", test_thread_entry, 0,
+                                   test_thread_stack, TEST_THREAD_STACK_SIZE,
+                                   TEST_THREAD_PRIORITY, TEST_THREAD_PRIORITY,
+                                   TX_NO_TIME_SLICE, TX_AUTO_START)))
+    {
+        printf("Test thread creation fail: %u\r\n", status);
+        exit(1);
+    }
+}
+
+VOID test_thread_run(INT (*entry)(VOID))
+{
+    test_entry = entry;
+    tx_kernel_enter();
+}
+
+/* Driver of an interface that is always up and never delivers anything.  */
+static VOID test_network_driver(NX_IP_DRIVER *driver_req_ptr)
+{
+NX_IP *ip_ptr = driver_req_ptr -> nx_ip_driver_ptr;
+UINT interface_index = driver_req_ptr -> nx_ip_driver_interface -> nx_interface_index;
+
+    driver_req_ptr -> nx_ip_driver_status = NX_SUCCESS;
+
+    switch (driver_req_ptr -> nx_ip_driver_command)
+    {
+        case NX_LINK_INTERFACE_ATTACH :
+        case NX_LINK_DISABLE :
+            break;
+
+        case NX_LINK_INITIALIZE :
+            nx_ip_interface_mtu_set(ip_ptr, interface_index, TEST_NETWORK_MTU);
+            nx_ip_interface_address_mapping_configure(ip_ptr, interface_index, NX_FALSE);
+            break;
+
+        case NX_LINK_ENABLE :
+            driver_req_ptr -> nx_ip_driver_interface -> nx_interface_link_up = NX_TRUE;
+            break;
+
+        case NX_LINK_PACKET_SEND :
+        case NX_LINK_PACKET_BROADCAST :
+        case NX_LINK_ARP_SEND :
+        case NX_LINK_ARP_RESPONSE_SEND :
+        case NX_LINK_RARP_SEND :
+            nx_packet_transmit_release(driver_req_ptr -> nx_ip_driver_packet);
+            break;
+
+        default :
+            driver_req_ptr -> nx_ip_driver_status = NX_UNHANDLED_COMMAND;
+            break;
+    }
+}
+
+static UINT test_azure_iot_create(VOID)
+{
+UINT status;
+
+    if (test_azure_iot_created)
+    {
+        return(NX_AZURE_IOT_SUCCESS);
+    }
+
+    if ((status = nx_ip_create(&test_ip, "Test IP Instance", IP_ADDRESS(192, 0, 2, 1), 0xFFFFFF00UL,
+                               &test_pool, test_network_driver,
+                               test_ip_stack, sizeof(test_ip_stack), TEST_IP_THREAD_PRIORITY)))
+    {
+        printf("nx_ip_create fail: %u\r\n", status);
+        return(status);
+    }
+
+    if ((status = nx_tcp_enable(&test_ip)) ||
+        (status = nx_udp_enable(&test_ip)))
+    {
+        printf("Test IP enable fail: %u\r\n", status);
+        return(status);
+    }
+
+    if ((status = nx_dns_create(&test_dns, &test_ip, (UCHAR *)"Test DNS Client")))
+    {
+        printf("nx_dns_create fail: %u\r\n", status);
+        return(status);
+    }
+
+#ifdef NX_DNS_CLIENT_USER_CREATE_PACKET_POOL
+    if ((status = nx_dns_packet_pool_set(&test_dns, &test_pool)))
+    {
+        printf("nx_dns_packet_pool_set fail: %u\r\n", status);
+        return(status);
+    }
+#endif /* NX_DNS_CLIENT_USER_CREATE_PACKET_POOL */
+
+    if ((status = nx_azure_iot_create(&test_azure_iot, (UCHAR *)"Test Azure IoT", &test_ip,
+                                      &test_pool, &test_dns,
+                                      test_cloud_stack, sizeof(test_cloud_stack),
+                                      TEST_CLOUD_THREAD_PRIORITY, NX_NULL)))
+    {
+        printf("nx_azure_iot_create fail: 0x%08x\r\n", status);
+        return(status);
+    }
+
+    test_azure_iot_created = NX_TRUE;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT test_hub_client_initialize(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr)
+{
+UINT status;
+
+    if ((status = test_azure_iot_create()))
+    {
+        return(status);
+    }
+
+    /* TLS is only set up on connect, so no crypto is needed.  */
+    if ((status = nx_azure_iot_hub_client_initialize(hub_client_ptr, &test_azure_iot,
+                                                     (UCHAR *)TEST_HUB_HOST_NAME,
+                                                     sizeof(TEST_HUB_HOST_NAME) - 1,
+                                                     (UCHAR *)TEST_HUB_DEVICE_ID,
+                                                     sizeof(TEST_HUB_DEVICE_ID) - 1,
+                                                     (UCHAR *)"", 0, NX_NULL, 0, NX_NULL, 0,
+                                                     test_metadata_buffer, sizeof(test_metadata_buffer),
+                                                     NX_NULL)))
+    {
+        printf("nx_azure_iot_hub_client_initialize fail: 0x%08x\r\n", status);
+        return(status);
+    }
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT test_telemetry_packet_create(const CHAR *topic, NX_PACKET **packet_pptr)
+{
+NX_PACKET *packet_ptr;
+UINT status;
+
+    if ((status = nx_packet_allocate(&test_pool, &packet_ptr, NX_IPv4_TCP_PACKET, NX_NO_WAIT)))
+    {
+        return(status);
+    }
+
+    /* Preserve room for fixed MQTT header, as nx_azure_iot_hub_client_telemetry_message_create() does.  */
+    packet_ptr -> nx_packet_prepend_ptr += NX_AZURE_IOT_PUBLISH_PACKET_START_OFFSET;
+    packet_ptr -> nx_packet_append_ptr = packet_ptr -> nx_packet_prepend_ptr;
+
+    if ((status = nx_packet_data_append(packet_ptr, (VOID *)topic, (ULONG)strlen(topic), &test_pool, NX_NO_WAIT)))
+    {
+        nx_packet_release(packet_ptr);
+        return(status);
+    }
+
+    *packet_pptr = packet_ptr;
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+UINT test_publish_queue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, const CHAR *topic,
+                        const UCHAR *payload, UINT payload_length)
+{
+NXD_MQTT_CLIENT *client_ptr = &(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt);
+NX_PACKET *packet_ptr;
+UCHAR header[7];
+UINT header_length = 1;
+UINT topic_length = (UINT)strlen(topic);
+UINT remaining_length = 2 + topic_length + payload_length;
+UINT status;
+
+    /* Fixed header, remaining length in up to four bytes, then topic length.  */
+    header[0] = (UCHAR)(MQTT_CONTROL_PACKET_TYPE_PUBLISH << 4);
+    do
+    {
+        header[header_length] = (UCHAR)(remaining_length & 0x7F);
+        remaining_length >>= 7;
+        if (remaining_length)
+        {
+            header[header_length] |= 0x80;
+        }
+        header_length++;
+    } while (remaining_length);
+    header[header_length++] = (UCHAR)(topic_length >> 8);
+    header[header_length++] = (UCHAR)(topic_length & 0xFF);
+
+    if ((status = nx_packet_allocate(&test_pool, &packet_ptr, 0, NX_NO_WAIT)))
+    {
+        return(status);
+    }
+
+    if ((status = nx_packet_data_append(packet_ptr, header, header_length, &test_pool, NX_NO_WAIT)) ||
+        (status = nx_packet_data_append(packet_ptr, (VOID *)topic, topic_length, &test_pool, NX_NO_WAIT)) ||
+        (payload_length &&
+         (status = nx_packet_data_append(packet_ptr, (VOID *)payload, payload_length, &test_pool, NX_NO_WAIT))))
+    {
+        nx_packet_release(packet_ptr);
+        return(status);
+    }
+
+    /* Obtain the mutex.  */
+    tx_mutex_get(client_ptr -> nxd_mqtt_client_mutex_ptr, TX_WAIT_FOREVER);
+
+    packet_ptr -> nx_packet_queue_next = NX_NULL;
+    if (client_ptr -> message_receive_queue_tail)
+    {
+        client_ptr -> message_receive_queue_tail -> nx_packet_queue_next = packet_ptr;
+    }
+    else
+    {
+        client_ptr -> message_receive_queue_head = packet_ptr;
+    }
+    client_ptr -> message_receive_queue_tail = packet_ptr;
+    client_ptr -> message_receive_queue_depth++;
+
+    /* Release the mutex.  */
+    tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
@@ -0,0 +1,87 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdio.h>
+
+#include "nx_api.h"
+#include "nx_azure_iot_hub_client.h"
+#include "nx_azure_iot_spool.h"
+
+#ifndef TEST_PACKET_SIZE
+#define TEST_PACKET_SIZE                        (1536)
+#endif /* TEST_PACKET_SIZE */
+
+#ifndef TEST_PACKET_COUNT
+#define TEST_PACKET_COUNT                       (64)
+#endif /* TEST_PACKET_COUNT */
+
+#ifndef TEST_THREAD_PRIORITY
+#define TEST_THREAD_PRIORITY                    (16)
+#endif /* TEST_THREAD_PRIORITY */
+
+#ifndef TEST_IP_THREAD_PRIORITY
+#define TEST_IP_THREAD_PRIORITY                 (1)
+#endif /* TEST_IP_THREAD_PRIORITY */
+
+#ifndef TEST_CLOUD_THREAD_PRIORITY
+#define TEST_CLOUD_THREAD_PRIORITY              (3)
+#endif /* TEST_CLOUD_THREAD_PRIORITY */
+
+#define TEST_SPOOL_SEGMENT_SIZE                 (512)
+#define TEST_SPOOL_SEGMENT_COUNT                (4)
+#define TEST_SPOOL_INDEX_SIZE                   (16)
+
+/* Print the failed condition and make the calling test return 1.  */
+#define TEST_ASSERT(condition)                                                  \
+    do                                                                          \
+    {                                                                           \
+        if (!(condition))                                                       \
+        {                                                                       \
+            printf("%s:%d: check failed: %s\r\n", __FILE__, __LINE__, #condition); \
+            return(1);                                                          \
+        }                                                                       \
+    } while (0)
+
+/* Spool storage kept in RAM, so a test can reopen or corrupt it.  */
+typedef struct TEST_SPOOL_RAM_STRUCT
+{
+    UCHAR       segment[TEST_SPOOL_SEGMENT_COUNT][TEST_SPOOL_SEGMENT_SIZE];
+    ULONG       segment_length[TEST_SPOOL_SEGMENT_COUNT];   /* Bytes written since last erase. */
+    UCHAR       index[TEST_SPOOL_INDEX_SIZE];
+    UINT        index_length;
+} TEST_SPOOL_RAM;
+
+/* Backend over a TEST_SPOOL_RAM passed as backend context.  */
+extern const NX_AZURE_IOT_SPOOL_BACKEND test_spool_ram_backend;
+
+/* Packet pool created before the test thread starts.  */
+extern NX_PACKET_POOL test_pool;
+
+/* Enter ThreadX kernel and run entry on a thread at TEST_THREAD_PRIORITY.
+   Process exits with the value returned by entry, so this function does not return.  */
+VOID test_thread_run(INT (*entry)(VOID));
+
+/* Initialize hub client on an IP instance whose driver drops every packet sent. Client is never connected,
+   tests set its state directly. Must be called from the test thread.  */
+UINT test_hub_client_initialize(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr);
+
+/* Allocate a packet from test_pool holding topic, laid out as a telemetry message before it is sent.  */
+UINT test_telemetry_packet_create(const CHAR *topic, NX_PACKET **packet_pptr);
+
+/* Append a QoS 0 PUBLISH of topic and payload to the MQTT receive queue of hub_client_ptr, laid out as the MQTT
+   client leaves it before calling the receive notify.  */
+UINT test_publish_queue(NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr, const CHAR *topic,
+                        const UCHAR *payload, UINT payload_length);
+
+#endif /* TEST_COMMON_H */
@@ -0,0 +1,215 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* JSON writer round trip: formatted integers and doubles read back as the same value with the C library, and a
+   document spanning several packets is extracted as the expected text.  */
+
+#include <float.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_common.h"
+#include "nx_azure_iot_json_writer.h"
+
+#define TEST_RANDOM_COUNT                       (100000)
+#define TEST_ARRAY_COUNT                        (400)
+#define TEST_DOCUMENT_SIZE                      (TEST_ARRAY_COUNT * NX_AZURE_IOT_JSON_WRITER_NUMBER_SIZE + 256)
+
+static CHAR test_expected[TEST_DOCUMENT_SIZE];
+static CHAR test_written[TEST_DOCUMENT_SIZE];
+static ULONG64 test_random_state = 0x853C49E6748FEA9BULL;
+
+/* xorshift64*, so runs are repeatable.  */
+static ULONG64 test_random_get(VOID)
+{
+    test_random_state ^= test_random_state >> 12;
+    test_random_state ^= test_random_state << 25;
+    test_random_state ^= test_random_state >> 27;
+
+    return(test_random_state * 0x2545F4914F6CDD1DULL);
+}
+
+static INT test_int32_check(INT value)
+{
+CHAR buffer[NX_AZURE_IOT_JSON_WRITER_NUMBER_SIZE];
+CHAR expected[NX_AZURE_IOT_JSON_WRITER_NUMBER_SIZE];
+UINT length;
+
+    length = nx_azure_iot_json_int32_format(value, buffer);
+    TEST_ASSERT(length < sizeof(buffer));
+    buffer[length] = 0;
+    snprintf(expected, sizeof(expected), "%d", value);
+    TEST_ASSERT(strcmp(buffer, expected) == 0);
+
+    return(0);
+}
+
+static INT test_double_check(double value)
+{
+CHAR buffer[NX_AZURE_IOT_JSON_WRITER_NUMBER_SIZE];
+double parsed;
+UINT length;
+
+    length = nx_azure_iot_json_double_format(value, buffer);
+    TEST_ASSERT((length > 0) && (length < sizeof(buffer)));
+    buffer[length] = 0;
+    parsed = strtod(buffer, NX_NULL);
+
+    /* Bits are compared, so the sign of zero is checked too.  */
+    if (memcmp(&parsed, &value, sizeof(value)) != 0)
+    {
+        printf("%.17g formatted as %s\r\n", value, buffer);
+        return(1);
+    }
+
+    return(0);
+}
+
+static INT test_number_round_trip(VOID)
+{
+static const INT int32_values[] = { 0, 1, -1, 9, 10, 99, 100, -100, 12345, 99999999, 100000000,
+                                    INT_MAX, -INT_MAX, INT_MIN };
+static const double double_values[] = { 0.0, -0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1.0 / 3.0, 2.0 / 3.0,
+                                        3.141592653589793, 2.718281828459045, 100.0, 1e21, 1e22, 1e23,
+                                        123456789012345680.0, 5e-324, 2.2250738585072009e-308,
+                                        2.2250738585072014e-308, DBL_MAX, -DBL_MAX, DBL_MIN, DBL_EPSILON,
+                                        1.7976931348623157e308, 9007199254740993.0, 0.000001, 1e-7 };
+ULONG64 bits;
+double value;
+UINT index;
+
+    for (index = 0; index < sizeof(int32_values) / sizeof(int32_values[0]); index++)
+    {
+        TEST_ASSERT(test_int32_check(int32_values[index]) == 0);
+    }
+
+    for (index = 0; index < TEST_RANDOM_COUNT; index++)
+    {
+        TEST_ASSERT(test_int32_check((INT)(test_random_get() >> 32)) == 0);
+    }
+
+    for (index = 0; index < sizeof(double_values) / sizeof(double_values[0]); index++)
+    {
+        TEST_ASSERT(test_double_check(double_values[index]) == 0);
+    }
+
+    /* Random bit patterns cover subnormals and every exponent. NaN and infinity are skipped.  */
+    for (index = 0; index < TEST_RANDOM_COUNT; index++)
+    {
+        bits = test_random_get();
+        memcpy(&value, &bits, sizeof(value));
+        if ((value - value) != 0.0)
+        {
+            TEST_ASSERT(nx_azure_iot_json_double_format(value, test_written) == 0);
+            continue;
+        }
+
+        TEST_ASSERT(test_double_check(value) == 0);
+    }
+
+    /* Sensor-like values with two decimals are written with no more digits than that.  */
+    for (index = 0; index < TEST_RANDOM_COUNT; index++)
+    {
+        value = (double)((INT)(test_random_get() % 200001) - 100000) / 100.0;
+        TEST_ASSERT(test_double_check(value) == 0);
+        TEST_ASSERT(nx_azure_iot_json_double_format(value, test_written) <= 8);
+    }
+
+    return(0);
+}
+
+static INT test_document_round_trip(VOID)
+{
+static const UCHAR name[] = "a\"b\\c\n\x01";
+NX_AZURE_IOT_JSON_WRITER writer;
+NX_PACKET *packet_ptr;
+ULONG written_length;
+UINT expected_length;
+UINT index;
+double value;
+
+    TEST_ASSERT(nx_packet_allocate(&test_pool, &packet_ptr, 0, NX_NO_WAIT) == NX_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_init(&writer, packet_ptr, NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS);
+
+    TEST_ASSERT(nx_azure_iot_json_writer_append_begin_object(&writer) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_property_name(&writer, name,
+                                                              sizeof(name) - 1) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_string(&writer, (const UCHAR *)"\t",
+                                                       1) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"flags",
+                                                              sizeof("flags") - 1) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_begin_array(&writer) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_bool(&writer, NX_TRUE) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_bool(&writer, NX_FALSE) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_null(&writer) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_int32(&writer, -42) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_end_array(&writer) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_property_name(&writer, (const UCHAR *)"samples",
+                                                              sizeof("samples") - 1) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_begin_array(&writer) == NX_AZURE_IOT_SUCCESS);
+
+    expected_length = (UINT)snprintf(test_expected, sizeof(test_expected),
+                                     "{\"a\\\"b\\\\c\\n\\u0001\":\"\\t\",\"flags\":[true,false,null,-42],"
+                                     "\"samples\":[");
+
+    /* Enough samples that the document is chained over several packets.  */
+    for (index = 0; index < TEST_ARRAY_COUNT; index++)
+    {
+        value = (double)((INT)(test_random_get() % 2000001) - 1000000) / 1000.0;
+        TEST_ASSERT(nx_azure_iot_json_writer_append_double(&writer, value) == NX_AZURE_IOT_SUCCESS);
+        if (index)
+        {
+            test_expected[expected_length++] = ',';
+        }
+        expected_length += nx_azure_iot_json_double_format(value, test_expected + expected_length);
+    }
+    memcpy(test_expected + expected_length, "]}", 2);
+    expected_length += 2;
+
+    TEST_ASSERT(nx_azure_iot_json_writer_append_end_array(&writer) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_json_writer_append_end_object(&writer) == NX_AZURE_IOT_SUCCESS);
+
+    /* Non-finite values are rejected without writing.  */
+    value = DBL_MAX;
+    value *= 2.0;
+    TEST_ASSERT(nx_azure_iot_json_writer_append_double(&writer, value) == NX_AZURE_IOT_INVALID_PARAMETER);
+
+    TEST_ASSERT(packet_ptr -> nx_packet_next != NX_NULL);
+    TEST_ASSERT(nx_azure_iot_json_writer_length_get(&writer) == expected_length);
+    TEST_ASSERT(packet_ptr -> nx_packet_length == expected_length);
+    TEST_ASSERT(nx_packet_data_extract_offset(packet_ptr, 0, test_written, sizeof(test_written),
+                                              &written_length) == NX_SUCCESS);
+    TEST_ASSERT(written_length == expected_length);
+    TEST_ASSERT(memcmp(test_written, test_expected, expected_length) == 0);
+
+    nx_packet_release(packet_ptr);
+
+    return(0);
+}
+
+static INT test_json_writer_entry(VOID)
+{
+    TEST_ASSERT(test_number_round_trip() == 0);
+    TEST_ASSERT(test_document_round_trip() == 0);
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    NX_PARAMETER_NOT_USED(argc);
+    NX_PARAMETER_NOT_USED(argv);
+
+    test_thread_run(test_json_writer_entry);
+
+    return(0);
+}
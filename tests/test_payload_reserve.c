@@ -0,0 +1,80 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Payload reserved in place is rejected once the packet is appended to, and nothing past the payload is
+   written to the packet buffer.  */
+
+#include <string.h>
+
+#include "test_common.h"
+
+#define TEST_TOPIC                              "devices/test/messages/events/"
+#define TEST_PAYLOAD                            "{\"temperature\":20.5}"
+
+static NX_AZURE_IOT_HUB_CLIENT test_hub_client;
+
+static INT test_payload_reserve_entry(VOID)
+{
+NX_AZURE_IOT_HUB_CLIENT_PAYLOAD payload;
+NX_PACKET *packet_ptr;
+UCHAR *payload_ptr;
+UCHAR *data_end_ptr;
+UCHAR data_end[8];
+UINT available_length;
+
+    TEST_ASSERT(test_hub_client_initialize(&test_hub_client) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_telemetry_packet_create(TEST_TOPIC, &packet_ptr) == NX_AZURE_IOT_SUCCESS);
+
+    /* Reservation can not go past the free space of the last packet.  */
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_payload_reserve(&payload, packet_ptr, TEST_PACKET_SIZE, &payload_ptr,
+                                                                  &available_length) ==
+                NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    TEST_ASSERT(payload_ptr == NX_NULL);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_payload_reserve(&payload, packet_ptr, available_length,
+                                                                  &payload_ptr, NX_NULL) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(payload_ptr + available_length == packet_ptr -> nx_packet_data_end);
+
+    /* Whole reservation is usable and the end of packet buffer is left alone.  */
+    data_end_ptr = packet_ptr -> nx_packet_data_end - sizeof(data_end);
+    memcpy(data_end, data_end_ptr, sizeof(data_end));
+    memcpy(payload_ptr, TEST_PAYLOAD, sizeof(TEST_PAYLOAD) - 1);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_payload_commit(&payload, available_length + 1) ==
+                NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_payload_commit(&payload, available_length) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_payload_commit(&payload,
+                                                                 sizeof(TEST_PAYLOAD) - 1) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(memcmp(data_end, data_end_ptr, sizeof(data_end)) == 0);
+
+    /* Append after reservation writes where the payload goes, so commit and send are rejected.  */
+    TEST_ASSERT(nx_packet_data_append(packet_ptr, (VOID *)"x", 1, &test_pool, NX_NO_WAIT) == NX_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_payload_commit(&payload,
+                                                                 sizeof(TEST_PAYLOAD) - 1) == NX_AZURE_IOT_INVALID_PACKET);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_payload_send(&test_hub_client, &payload, NX_AZURE_IOT_MQTT_QOS_1,
+                                                               NX_NO_WAIT) == NX_AZURE_IOT_INVALID_PACKET);
+
+    /* Reservation that was never made is rejected too.  */
+    memset(&payload, 0, sizeof(payload));
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_payload_commit(&payload, 0) == NX_AZURE_IOT_INVALID_PACKET);
+
+    nx_packet_release(packet_ptr);
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    NX_PARAMETER_NOT_USED(argc);
+    NX_PARAMETER_NOT_USED(argv);
+
+    test_thread_run(test_payload_reserve_entry);
+
+    return(0);
+}
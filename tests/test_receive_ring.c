@@ -0,0 +1,132 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Receive ring drop policies: when the ring has no room, drop newest discards the new message whole and drop
+   oldest discards queued messages until it fits. Both count what they discard, and messages kept are read
+   back untruncated.
+
+   Hub client source is included to reach its static receive path. azure_iot is a static library, so its copy
+   of the hub client is not linked in.  */
+
+#include <string.h>
+
+#include "test_common.h"
+#include "nx_azure_iot_hub_client.c"
+
+#define TEST_TOPIC_C2D                          "devices/test/messages/devicebound/" \
+                                                "%24.to=%2Fdevices%2Ftest%2Fmessages%2FdeviceBound"
+#define TEST_PAYLOAD_SIZE                       (100)
+
+/* Room for two messages but not three.  */
+#define TEST_RING_SIZE                          (2 * (sizeof(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_RECORD) + \
+                                                      TEST_PAYLOAD_SIZE) + (TEST_PAYLOAD_SIZE / 2))
+
+static NX_AZURE_IOT_HUB_CLIENT test_hub_client;
+static UCHAR test_ring[TEST_RING_SIZE];
+
+static UINT test_message_put(UCHAR fill)
+{
+NXD_MQTT_CLIENT *client_ptr = &(test_hub_client.nx_azure_iot_hub_client_resource.resource_mqtt);
+UCHAR payload[TEST_PAYLOAD_SIZE];
+UINT status;
+
+    memset(payload, fill, sizeof(payload));
+    if ((status = test_publish_queue(&test_hub_client, TEST_TOPIC_C2D, payload, sizeof(payload))))
+    {
+        return(status);
+    }
+
+    /* MQTT client calls receive notify with its mutex held.  */
+    tx_mutex_get(client_ptr -> nxd_mqtt_client_mutex_ptr, TX_WAIT_FOREVER);
+    nx_azure_iot_hub_client_mqtt_receive_callback(client_ptr, 1);
+    tx_mutex_put(client_ptr -> nxd_mqtt_client_mutex_ptr);
+
+    return(NX_AZURE_IOT_SUCCESS);
+}
+
+static INT test_message_check(UCHAR fill)
+{
+UCHAR buffer[TEST_PAYLOAD_SIZE * 2];
+UINT payload_length;
+ULONG truncated_length;
+UINT index;
+
+    TEST_ASSERT(nx_azure_iot_hub_client_message_copy_receive(&test_hub_client, NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE,
+                                                             buffer, sizeof(buffer), NX_NULL, &payload_length,
+                                                             &truncated_length, NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(payload_length == TEST_PAYLOAD_SIZE);
+    TEST_ASSERT(truncated_length == 0);
+    for (index = 0; index < payload_length; index++)
+    {
+        TEST_ASSERT(buffer[index] == fill);
+    }
+
+    return(0);
+}
+
+static INT test_ring_policy_run(UINT policy, UCHAR first, UCHAR second)
+{
+UCHAR buffer[TEST_PAYLOAD_SIZE * 2];
+UINT payload_length;
+ULONG dropped_count;
+
+    TEST_ASSERT(nx_azure_iot_hub_client_receive_queue_configure(&test_hub_client,
+                                                                NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE,
+                                                                0, policy) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_hub_client_receive_ring_enable(&test_hub_client, NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE,
+                                                            test_ring, sizeof(test_ring), 0) == NX_AZURE_IOT_SUCCESS);
+    test_hub_client.nx_azure_iot_hub_client_c2d_message.message_dropped_count = 0;
+
+    TEST_ASSERT(test_message_put('a') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_message_put('b') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_message_put('c') == NX_AZURE_IOT_SUCCESS);
+
+    TEST_ASSERT(nx_azure_iot_hub_client_receive_queue_status_get(&test_hub_client,
+                                                                 NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE,
+                                                                 NX_NULL, NX_NULL,
+                                                                 &dropped_count) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(dropped_count == 1);
+
+    TEST_ASSERT(test_message_check(first) == 0);
+    TEST_ASSERT(test_message_check(second) == 0);
+    TEST_ASSERT(nx_azure_iot_hub_client_message_copy_receive(&test_hub_client, NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE,
+                                                             buffer, sizeof(buffer), NX_NULL, &payload_length,
+                                                             NX_NULL, NX_NO_WAIT) != NX_AZURE_IOT_SUCCESS);
+
+    TEST_ASSERT(nx_azure_iot_hub_client_receive_ring_disable(&test_hub_client,
+                                                             NX_AZURE_IOT_HUB_CLOUD_TO_DEVICE_MESSAGE) ==
+                NX_AZURE_IOT_SUCCESS);
+
+    return(0);
+}
+
+static INT test_receive_ring_entry(VOID)
+{
+    TEST_ASSERT(test_hub_client_initialize(&test_hub_client) == NX_AZURE_IOT_SUCCESS);
+
+    /* Enable processing as nx_azure_iot_hub_client_cloud_message_enable() does once subscribed.  */
+    test_hub_client.nx_azure_iot_hub_client_c2d_message.message_process = nx_azure_iot_hub_client_c2d_process;
+
+    TEST_ASSERT(test_ring_policy_run(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_NEWEST, 'a', 'b') == 0);
+    TEST_ASSERT(test_ring_policy_run(NX_AZURE_IOT_HUB_CLIENT_RECEIVE_QUEUE_DROP_OLDEST, 'b', 'c') == 0);
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    NX_PARAMETER_NOT_USED(argc);
+    NX_PARAMETER_NOT_USED(argv);
+
+    test_thread_run(test_receive_ring_entry);
+
+    return(0);
+}
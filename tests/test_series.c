@@ -0,0 +1,190 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Time series round trip: samples added to a stream are sent as blocks, which decode with the reference decoder
+   as the same timestamps and value bits, in order. Samples cover every delta of delta range, timestamps wrapping
+   past 2^32, repeated values and random bit patterns including NaN and infinity. A truncated block fails to
+   decode.
+
+   Sent blocks are kept in the telemetry store while the client is not connected. Hub client source is included
+   to reach the records of the store. azure_iot is a static library, so its copy of the hub client is not linked
+   in.  */
+
+#include <string.h>
+
+#include "test_common.h"
+#include "nx_azure_iot_hub_client.c"
+#include "nx_azure_iot_series.h"
+
+#define TEST_SAMPLE_COUNT                       (2000)
+
+/* Small block so samples are sent over many messages.  */
+#define TEST_BLOCK_SIZE                         (64)
+#define TEST_STORE_SIZE                         (128 * 1024)
+#define TEST_STREAM                             "test"
+
+static NX_AZURE_IOT_HUB_CLIENT test_hub_client;
+static NX_AZURE_IOT_SERIES test_series;
+static UCHAR test_block[TEST_BLOCK_SIZE];
+static UCHAR test_store[TEST_STORE_SIZE];
+static UCHAR test_record_data[TEST_STORE_SIZE];
+static UINT test_timestamps[TEST_SAMPLE_COUNT];
+static ULONG64 test_values[TEST_SAMPLE_COUNT];
+static ULONG64 test_random_state = 0x853C49E6748FEA9BULL;
+
+/* xorshift64*, so runs are repeatable.  */
+static ULONG64 test_random_get(VOID)
+{
+    test_random_state ^= test_random_state >> 12;
+    test_random_state ^= test_random_state << 25;
+    test_random_state ^= test_random_state >> 27;
+
+    return(test_random_state * 0x2545F4914F6CDD1DULL);
+}
+
+/* Delta of delta steps through the edges of each range.  */
+static VOID test_samples_generate(VOID)
+{
+static const INT delta_of_delta[] = { 0, 0, 0, 1, -1, 63, -64, 64, -65, 255, -256, 256, -257, 2047, -2048,
+                                      2048, -2049, 100000, -100000, 0x7FFFFFFF, 0 };
+static const ULONG64 special_values[] = { 0x0000000000000000ULL, 0x8000000000000000ULL, 0x7FF0000000000000ULL,
+                                          0xFFF0000000000000ULL, 0x7FF8000000000001ULL, 0x0000000000000001ULL };
+UINT timestamp = 0xFFFFF000;
+UINT delta = 1000;
+double value = 20.0;
+UINT index;
+
+    for (index = 0; index < TEST_SAMPLE_COUNT; index++)
+    {
+        delta += (UINT)delta_of_delta[index % (sizeof(delta_of_delta) / sizeof(delta_of_delta[0]))];
+        timestamp += delta;
+        test_timestamps[index] = timestamp;
+
+        /* Runs of repeated, slowly moving, special and random values.  */
+        switch ((index / 8) % 4)
+        {
+            case 0:
+                break;
+            case 1:
+                value += 0.25;
+                break;
+            case 2:
+                value = (double)(2000 + (test_random_get() % 100)) / 100.0;
+                break;
+            default:
+                if (index % 2)
+                {
+                    test_values[index] = special_values[(index / 2) % (sizeof(special_values) /
+                                                                       sizeof(special_values[0]))];
+                }
+                else
+                {
+                    test_values[index] = test_random_get();
+                }
+                continue;
+        }
+
+        memcpy(&test_values[index], &value, sizeof(value));
+    }
+}
+
+static INT test_series_round_trip(VOID)
+{
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE *store_ptr = &(test_hub_client.nx_azure_iot_hub_client_telemetry_store);
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD record;
+NX_AZURE_IOT_SERIES_DECODER decoder;
+ULONG message_count = 0;
+UINT sample_index = 0;
+UINT timestamp;
+double value;
+UINT index;
+UINT status;
+
+    TEST_ASSERT(nx_azure_iot_series_create(&test_series, &test_hub_client, (const UCHAR *)TEST_STREAM,
+                                           sizeof(TEST_STREAM) - 1, test_block, sizeof(test_block),
+                                           0) == NX_AZURE_IOT_SUCCESS);
+    for (index = 0; index < TEST_SAMPLE_COUNT; index++)
+    {
+        memcpy(&value, &test_values[index], sizeof(value));
+        TEST_ASSERT(nx_azure_iot_series_sample_add(&test_series, test_timestamps[index], value,
+                                                   NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS);
+    }
+    TEST_ASSERT(nx_azure_iot_series_flush(&test_series, NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_series.series_message_count > 1);
+
+    /* Each record is one block, in the order sent.  */
+    while (store_ptr -> store_used)
+    {
+        nx_azure_iot_hub_client_telemetry_store_read(store_ptr, 0, (UCHAR *)&record, sizeof(record));
+        TEST_ASSERT((record.record_payload_length >= NX_AZURE_IOT_SERIES_HEADER_SIZE) &&
+                    (record.record_payload_length <= TEST_BLOCK_SIZE));
+        nx_azure_iot_hub_client_telemetry_store_read(store_ptr, sizeof(record) + record.record_topic_length,
+                                                     test_record_data, record.record_payload_length);
+        nx_azure_iot_hub_client_telemetry_store_pop(store_ptr);
+        message_count++;
+
+        TEST_ASSERT(nx_azure_iot_series_decoder_init(&decoder, test_record_data,
+                                                     record.record_payload_length) == NX_AZURE_IOT_SUCCESS);
+        while ((status = nx_azure_iot_series_decoder_next(&decoder, &timestamp, &value)) == NX_AZURE_IOT_SUCCESS)
+        {
+            TEST_ASSERT(sample_index < TEST_SAMPLE_COUNT);
+            TEST_ASSERT(timestamp == test_timestamps[sample_index]);
+            TEST_ASSERT(memcmp(&value, &test_values[sample_index], sizeof(value)) == 0);
+            sample_index++;
+        }
+        TEST_ASSERT(status == NX_AZURE_IOT_NOT_FOUND);
+
+        /* First block cut after its first sample fails on the next one.  */
+        if (message_count == 1)
+        {
+            TEST_ASSERT(decoder.series_decoder_sample_count > 1);
+            TEST_ASSERT(nx_azure_iot_series_decoder_init(&decoder, test_record_data,
+                                                         NX_AZURE_IOT_SERIES_HEADER_SIZE + 12) ==
+                        NX_AZURE_IOT_SUCCESS);
+            TEST_ASSERT(nx_azure_iot_series_decoder_next(&decoder, &timestamp, &value) == NX_AZURE_IOT_SUCCESS);
+            TEST_ASSERT(nx_azure_iot_series_decoder_next(&decoder, &timestamp,
+                                                         &value) == NX_AZURE_IOT_INVALID_PACKET);
+        }
+    }
+
+    TEST_ASSERT(sample_index == TEST_SAMPLE_COUNT);
+    TEST_ASSERT(message_count == test_series.series_message_count);
+
+    /* Unknown format is rejected.  */
+    test_record_data[0] = NX_AZURE_IOT_SERIES_FORMAT + 1;
+    TEST_ASSERT(nx_azure_iot_series_decoder_init(&decoder, test_record_data,
+                                                 NX_AZURE_IOT_SERIES_HEADER_SIZE) == NX_AZURE_IOT_INVALID_PACKET);
+
+    return(0);
+}
+
+static INT test_series_entry(VOID)
+{
+    TEST_ASSERT(test_hub_client_initialize(&test_hub_client) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_store_enable(&test_hub_client, test_store, sizeof(test_store),
+                                                               NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_NEWEST) ==
+                NX_AZURE_IOT_SUCCESS);
+
+    test_samples_generate();
+    TEST_ASSERT(test_series_round_trip() == 0);
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    NX_PARAMETER_NOT_USED(argc);
+    NX_PARAMETER_NOT_USED(argv);
+
+    test_thread_run(test_series_entry);
+
+    return(0);
+}
@@ -0,0 +1,215 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Spool recovery and full policy on a RAM backend: records are read back in order after reopen, replay resumes
+   after the committed position, a record failing its CRC check ends recovery or is skipped on replay, and a
+   full spool rejects new records until a segment is committed.  */
+
+#include <string.h>
+
+#include "test_common.h"
+
+#define TEST_RECORD_SIZE                        (100)
+
+/* Records of TEST_RECORD_SIZE bytes that fit in one segment, and in the whole spool.  */
+#define TEST_SEGMENT_RECORDS                    ((TEST_SPOOL_SEGMENT_SIZE - NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE) / \
+                                                 (NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE + TEST_RECORD_SIZE))
+#define TEST_SPOOL_RECORDS                      (TEST_SEGMENT_RECORDS * TEST_SPOOL_SEGMENT_COUNT)
+
+static NX_AZURE_IOT_SPOOL test_spool;
+static TEST_SPOOL_RAM test_spool_ram;
+
+static UINT test_spool_open(VOID)
+{
+    return(nx_azure_iot_spool_open(&test_spool, &test_spool_ram_backend, &test_spool_ram,
+                                   TEST_SPOOL_SEGMENT_SIZE, TEST_SPOOL_SEGMENT_COUNT));
+}
+
+static UINT test_record_append(UCHAR fill)
+{
+UCHAR data[TEST_RECORD_SIZE];
+NX_AZURE_IOT_IOVEC vec[2];
+
+    /* Record is appended in two pieces, as the hub client writes header and message.  */
+    memset(data, fill, sizeof(data));
+    vec[0].iovec_base = data;
+    vec[0].iovec_length = 10;
+    vec[1].iovec_base = data + 10;
+    vec[1].iovec_length = sizeof(data) - 10;
+
+    return(nx_azure_iot_spool_append(&test_spool, vec, 2));
+}
+
+static INT test_record_check(UCHAR fill, NX_AZURE_IOT_SPOOL_POSITION *position_ptr)
+{
+UCHAR data[TEST_RECORD_SIZE];
+ULONG record_length;
+UINT index;
+
+    TEST_ASSERT(nx_azure_iot_spool_peek(&test_spool, &record_length) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(record_length == TEST_RECORD_SIZE);
+    TEST_ASSERT(nx_azure_iot_spool_record_read(&test_spool, 0, data, sizeof(data)) == NX_AZURE_IOT_SUCCESS);
+    for (index = 0; index < sizeof(data); index++)
+    {
+        TEST_ASSERT(data[index] == fill);
+    }
+
+    TEST_ASSERT(nx_azure_iot_spool_advance(&test_spool, position_ptr) == NX_AZURE_IOT_SUCCESS);
+
+    return(0);
+}
+
+static INT test_spool_reopen(VOID)
+{
+NX_AZURE_IOT_SPOOL_POSITION position;
+ULONG record_length;
+
+    memset(&test_spool_ram, 0, sizeof(test_spool_ram));
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(!nx_azure_iot_spool_pending(&test_spool));
+
+    TEST_ASSERT(test_record_append('a') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('b') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('c') == NX_AZURE_IOT_SUCCESS);
+
+    /* Nothing is committed, so all records are replayed after reopen.  */
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_spool_pending(&test_spool));
+    TEST_ASSERT(test_record_check('a', &position) == 0);
+    TEST_ASSERT(test_record_check('b', &position) == 0);
+    TEST_ASSERT(test_record_check('c', &position) == 0);
+    TEST_ASSERT(nx_azure_iot_spool_peek(&test_spool, &record_length) == NX_AZURE_IOT_NOT_FOUND);
+
+    return(0);
+}
+
+static INT test_spool_commit_recovery(VOID)
+{
+NX_AZURE_IOT_SPOOL_POSITION position;
+ULONG record_length;
+
+    memset(&test_spool_ram, 0, sizeof(test_spool_ram));
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('a') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('b') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('c') == NX_AZURE_IOT_SUCCESS);
+
+    /* Commit the first two records only.  */
+    TEST_ASSERT(test_record_check('a', &position) == 0);
+    TEST_ASSERT(test_record_check('b', &position) == 0);
+    TEST_ASSERT(nx_azure_iot_spool_commit(&test_spool, &position) == NX_AZURE_IOT_SUCCESS);
+
+    /* Replay resumes at committed offset, and write position is recovered after the last record.  */
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_spool.spool_committed_position.position_offset == position.position_offset);
+    TEST_ASSERT(test_record_append('d') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_check('c', &position) == 0);
+    TEST_ASSERT(test_record_check('d', &position) == 0);
+    TEST_ASSERT(nx_azure_iot_spool_peek(&test_spool, &record_length) == NX_AZURE_IOT_NOT_FOUND);
+
+    /* Rewind replays what is not committed.  */
+    nx_azure_iot_spool_rewind(&test_spool);
+    TEST_ASSERT(test_record_check('c', &position) == 0);
+    TEST_ASSERT(nx_azure_iot_spool_commit(&test_spool, &position) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_spool_pending(&test_spool));
+    TEST_ASSERT(test_record_check('d', &position) == 0);
+    TEST_ASSERT(nx_azure_iot_spool_commit(&test_spool, &position) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(!nx_azure_iot_spool_pending(&test_spool));
+
+    return(0);
+}
+
+static INT test_spool_crc(VOID)
+{
+NX_AZURE_IOT_SPOOL_POSITION position;
+ULONG record_offset = NX_AZURE_IOT_SPOOL_SEGMENT_HEADER_SIZE + NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE;
+ULONG record_length;
+
+    memset(&test_spool_ram, 0, sizeof(test_spool_ram));
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('a') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('b') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('c') == NX_AZURE_IOT_SUCCESS);
+
+    /* Corrupted record in the middle is skipped on replay.  */
+    test_spool_ram.segment[0][record_offset + (NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE + TEST_RECORD_SIZE) + 50] ^= 0x01;
+    TEST_ASSERT(test_record_check('a', &position) == 0);
+    TEST_ASSERT(test_record_check('c', &position) == 0);
+    TEST_ASSERT(nx_azure_iot_spool_peek(&test_spool, &record_length) == NX_AZURE_IOT_NOT_FOUND);
+
+    /* Corrupted last record, as left by a lost write, ends recovery and is overwritten by next append.  */
+    memset(&test_spool_ram, 0, sizeof(test_spool_ram));
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('a') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('b') == NX_AZURE_IOT_SUCCESS);
+    test_spool_ram.segment[0][record_offset + (NX_AZURE_IOT_SPOOL_RECORD_HEADER_SIZE + TEST_RECORD_SIZE) + 50] ^= 0x01;
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append('c') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_check('a', &position) == 0);
+    TEST_ASSERT(test_record_check('c', &position) == 0);
+    TEST_ASSERT(nx_azure_iot_spool_peek(&test_spool, &record_length) == NX_AZURE_IOT_NOT_FOUND);
+
+    return(0);
+}
+
+static INT test_spool_full(VOID)
+{
+NX_AZURE_IOT_SPOOL_POSITION position;
+UINT index;
+
+    memset(&test_spool_ram, 0, sizeof(test_spool_ram));
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+
+    /* Uncommitted records are never overwritten, so a full spool rejects the new record.  */
+    for (index = 0; index < TEST_SPOOL_RECORDS; index++)
+    {
+        TEST_ASSERT(test_record_append((UCHAR)index) == NX_AZURE_IOT_SUCCESS);
+    }
+    TEST_ASSERT(test_record_append(0xEE) == NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE);
+
+    /* First segment is reused once the committed position has moved past it.  */
+    for (index = 0; index <= TEST_SEGMENT_RECORDS; index++)
+    {
+        TEST_ASSERT(test_record_check((UCHAR)index, &position) == 0);
+    }
+    TEST_ASSERT(nx_azure_iot_spool_commit(&test_spool, &position) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_record_append(0xEE) == NX_AZURE_IOT_SUCCESS);
+
+    /* Remaining records and the new one are replayed in order after reopen.  */
+    TEST_ASSERT(test_spool_open() == NX_AZURE_IOT_SUCCESS);
+    for (index = TEST_SEGMENT_RECORDS + 1; index < TEST_SPOOL_RECORDS; index++)
+    {
+        TEST_ASSERT(test_record_check((UCHAR)index, &position) == 0);
+    }
+    TEST_ASSERT(test_record_check(0xEE, &position) == 0);
+
+    return(0);
+}
+
+static INT test_spool_entry(VOID)
+{
+    TEST_ASSERT(test_spool_reopen() == 0);
+    TEST_ASSERT(test_spool_commit_recovery() == 0);
+    TEST_ASSERT(test_spool_crc() == 0);
+    TEST_ASSERT(test_spool_full() == 0);
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    NX_PARAMETER_NOT_USED(argc);
+    NX_PARAMETER_NOT_USED(argv);
+
+    test_thread_run(test_spool_entry);
+
+    return(0);
+}
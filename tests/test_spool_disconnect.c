@@ -0,0 +1,79 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Telemetry sent after the link drops goes to the spool instead of the MQTT client.
+
+   Hub client source is included to reach its static disconnect notify. azure_iot is a static library, so its
+   copy of the hub client is not linked in.  */
+
+#include "test_common.h"
+#include "nx_azure_iot_hub_client.c"
+
+#define TEST_TOPIC                              "devices/test/messages/events/"
+#define TEST_PAYLOAD                            "{\"temperature\":20.5}"
+
+static NX_AZURE_IOT_HUB_CLIENT test_hub_client;
+static NX_AZURE_IOT_SPOOL test_spool;
+static TEST_SPOOL_RAM test_spool_ram;
+
+static INT test_spool_disconnect_entry(VOID)
+{
+NX_AZURE_IOT_HUB_CLIENT *hub_client_ptr = &test_hub_client;
+UCHAR header[NX_AZURE_IOT_HUB_CLIENT_SPOOL_RECORD_HEADER_SIZE];
+UCHAR topic[sizeof(TEST_TOPIC) - 1];
+UCHAR payload[sizeof(TEST_PAYLOAD) - 1];
+NX_PACKET *packet_ptr;
+ULONG record_length;
+
+    TEST_ASSERT(test_hub_client_initialize(hub_client_ptr) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_spool_open(&test_spool, &test_spool_ram_backend, &test_spool_ram,
+                                        TEST_SPOOL_SEGMENT_SIZE, TEST_SPOOL_SEGMENT_COUNT) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_spool_set(hub_client_ptr, &test_spool) == NX_AZURE_IOT_SUCCESS);
+
+    /* Connected with an empty spool, telemetry would be sent directly. Then the link drops.  */
+    hub_client_ptr -> nx_azure_iot_hub_client_state = NX_AZURE_IOT_HUB_CLIENT_STATUS_CONNECTED;
+    tx_mutex_get(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr, TX_WAIT_FOREVER);
+    nx_azure_iot_hub_client_mqtt_disconnect_notify(&(hub_client_ptr -> nx_azure_iot_hub_client_resource.resource_mqtt));
+    tx_mutex_put(hub_client_ptr -> nx_azure_iot_ptr -> nx_azure_iot_mutex_ptr);
+    TEST_ASSERT(hub_client_ptr -> nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_NOT_CONNECTED);
+
+    /* Put after disconnect is persisted and consumes the packet.  */
+    TEST_ASSERT(test_telemetry_packet_create(TEST_TOPIC, &packet_ptr) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_send(hub_client_ptr, packet_ptr, (UCHAR *)TEST_PAYLOAD,
+                                                       sizeof(TEST_PAYLOAD) - 1, NX_NO_WAIT) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_spool_pending(&test_spool));
+
+    /* Record holds header, topic and payload of the message.  */
+    TEST_ASSERT(nx_azure_iot_spool_peek(&test_spool, &record_length) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(record_length == sizeof(header) + sizeof(topic) + sizeof(payload));
+    TEST_ASSERT(nx_azure_iot_spool_record_read(&test_spool, 0, header, sizeof(header)) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(nx_azure_iot_spool_ulong_get(header) == sizeof(topic));
+    TEST_ASSERT(nx_azure_iot_spool_ulong_get(header + 4) == sizeof(payload));
+    TEST_ASSERT(header[8] == NX_AZURE_IOT_MQTT_QOS_1);
+    TEST_ASSERT(nx_azure_iot_spool_record_read(&test_spool, sizeof(header), topic,
+                                               sizeof(topic)) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(memcmp(topic, TEST_TOPIC, sizeof(topic)) == 0);
+    TEST_ASSERT(nx_azure_iot_spool_record_read(&test_spool, sizeof(header) + sizeof(topic), payload,
+                                               sizeof(payload)) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(memcmp(payload, TEST_PAYLOAD, sizeof(payload)) == 0);
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    NX_PARAMETER_NOT_USED(argc);
+    NX_PARAMETER_NOT_USED(argv);
+
+    test_thread_run(test_spool_disconnect_entry);
+
+    return(0);
+}
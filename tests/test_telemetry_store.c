@@ -0,0 +1,130 @@
+/**************************************************************************/
+/*                                                                        */
+/*       Copyright (c) Microsoft Corporation. All rights reserved.        */
+/*                                                                        */
+/*       This software is licensed under the Microsoft Software License   */
+/*       Terms for Microsoft Azure RTOS. Full text of the license can be  */
+/*       found in the LICENSE file at https://aka.ms/AzureRTOS_EULA       */
+/*       and in the root directory of this software.                      */
+/*                                                                        */
+/**************************************************************************/
+
+/* Telemetry store drop policies: telemetry sent while not connected is kept in the store, and when the store is
+   full, drop newest rejects the new message while drop oldest discards stored ones until it fits. Both count
+   what they discard, and records kept hold the topic and payload of the messages.
+
+   Hub client source is included to reach the records of the store. azure_iot is a static library, so its copy
+   of the hub client is not linked in.  */
+
+#include <string.h>
+
+#include "test_common.h"
+#include "nx_azure_iot_hub_client.c"
+
+#define TEST_TOPIC                              "devices/test/messages/events/"
+#define TEST_PAYLOAD_SIZE                       (64)
+#define TEST_RECORD_SIZE                        (sizeof(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD) + \
+                                                 sizeof(TEST_TOPIC) - 1 + TEST_PAYLOAD_SIZE)
+
+/* Room for two records but not three.  */
+#define TEST_STORE_SIZE                         (2 * TEST_RECORD_SIZE + (TEST_RECORD_SIZE / 2))
+
+static NX_AZURE_IOT_HUB_CLIENT test_hub_client;
+static UCHAR test_store[TEST_STORE_SIZE];
+
+static UINT test_message_send(UCHAR fill)
+{
+UCHAR payload[TEST_PAYLOAD_SIZE];
+NX_PACKET *packet_ptr;
+UINT status;
+
+    memset(payload, fill, sizeof(payload));
+    if ((status = test_telemetry_packet_create(TEST_TOPIC, &packet_ptr)))
+    {
+        return(status);
+    }
+
+    /* Packet is consumed only on success.  */
+    status = nx_azure_iot_hub_client_telemetry_send(&test_hub_client, packet_ptr, payload, sizeof(payload),
+                                                    NX_NO_WAIT);
+    if (status)
+    {
+        nx_packet_release(packet_ptr);
+    }
+
+    return(status);
+}
+
+static INT test_record_check(UCHAR fill)
+{
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE *store_ptr = &(test_hub_client.nx_azure_iot_hub_client_telemetry_store);
+NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_RECORD record;
+UCHAR data[sizeof(TEST_TOPIC) - 1 + TEST_PAYLOAD_SIZE];
+UINT index;
+
+    TEST_ASSERT(store_ptr -> store_used >= TEST_RECORD_SIZE);
+    nx_azure_iot_hub_client_telemetry_store_read(store_ptr, 0, (UCHAR *)&record, sizeof(record));
+    TEST_ASSERT(record.record_topic_length == sizeof(TEST_TOPIC) - 1);
+    TEST_ASSERT(record.record_payload_length == TEST_PAYLOAD_SIZE);
+    TEST_ASSERT(record.record_qos == NX_AZURE_IOT_MQTT_QOS_1);
+
+    nx_azure_iot_hub_client_telemetry_store_read(store_ptr, sizeof(record), data, sizeof(data));
+    TEST_ASSERT(memcmp(data, TEST_TOPIC, sizeof(TEST_TOPIC) - 1) == 0);
+    for (index = sizeof(TEST_TOPIC) - 1; index < sizeof(data); index++)
+    {
+        TEST_ASSERT(data[index] == fill);
+    }
+
+    nx_azure_iot_hub_client_telemetry_store_pop(store_ptr);
+
+    return(0);
+}
+
+static INT test_store_policy_run(UINT policy, UINT third_status, UCHAR first, UCHAR second)
+{
+UINT used_bytes;
+ULONG dropped_count;
+
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_store_enable(&test_hub_client, test_store, sizeof(test_store),
+                                                               policy) == NX_AZURE_IOT_SUCCESS);
+
+    TEST_ASSERT(test_message_send('a') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_message_send('b') == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_message_send('c') == third_status);
+
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_store_status_get(&test_hub_client, &used_bytes,
+                                                                   &dropped_count) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(used_bytes == 2 * TEST_RECORD_SIZE);
+    TEST_ASSERT(dropped_count == 1);
+
+    TEST_ASSERT(test_record_check(first) == 0);
+    TEST_ASSERT(test_record_check(second) == 0);
+    TEST_ASSERT(test_hub_client.nx_azure_iot_hub_client_telemetry_store.store_used == 0);
+
+    TEST_ASSERT(nx_azure_iot_hub_client_telemetry_store_disable(&test_hub_client) == NX_AZURE_IOT_SUCCESS);
+
+    return(0);
+}
+
+static INT test_telemetry_store_entry(VOID)
+{
+    TEST_ASSERT(test_hub_client_initialize(&test_hub_client) == NX_AZURE_IOT_SUCCESS);
+    TEST_ASSERT(test_hub_client.nx_azure_iot_hub_client_state == NX_AZURE_IOT_HUB_CLIENT_STATUS_NOT_CONNECTED);
+
+    TEST_ASSERT(test_store_policy_run(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_NEWEST,
+                                      NX_AZURE_IOT_INSUFFICIENT_BUFFER_SPACE, 'a', 'b') == 0);
+    TEST_ASSERT(test_store_policy_run(NX_AZURE_IOT_HUB_CLIENT_TELEMETRY_STORE_DROP_OLDEST,
+                                      NX_AZURE_IOT_SUCCESS, 'b', 'c') == 0);
+
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    NX_PARAMETER_NOT_USED(argc);
+    NX_PARAMETER_NOT_USED(argv);
+
+    test_thread_run(test_telemetry_store_entry);
+
+    return(0);
+}